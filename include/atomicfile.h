@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/* atomicfile.h -- replace a file atomically
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _ATOMICFILE_H
+#define _ATOMICFILE_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  /* Write the content produced by 'emit' (called with 'data') to a
+   * temporary file, flush it to the disk and rename it to 'path', so the
+   * readers see either the old or the new file, never a partial one.
+   * 'emit' returns 0 on success or a negative errno.  The file is made
+   * readable by everyone.  Return 0 on success or a negative errno.  */
+  int atomic_write_file (const char *path,
+			 int (*emit) (FILE *, const void *),
+			 const void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif				/* _ATOMICFILE_H */
@@ -87,6 +87,23 @@ extern "C"
 					long long unsigned int *memory,
 					bool verbose);
 
+  struct container_stats
+  {
+    unsigned int containers;		/* number of containers read */
+    unsigned long long memory_current;	/* memory.current (bytes) */
+    unsigned long long memory_anon;	/* memory.stat: anon (bytes) */
+    unsigned long long memory_file;	/* memory.stat: file (bytes) */
+    unsigned long long memory_swap;	/* memory.swap.current (bytes) */
+    unsigned long long cpu_usage_usec;	/* cpu.stat: usage_usec */
+    unsigned long long cpu_user_usec;	/* cpu.stat: user_usec */
+    unsigned long long cpu_system_usec;	/* cpu.stat: system_usec */
+  };
+
+  /* Sum the memory and CPU usage of the running Docker/Podman containers
+   * reading their cgroups, without querying the Docker/Podman API.
+   * Return -1 if the cgroup v2 unified hierarchy is not mounted.  */
+  int cgroup_containers_stats (struct container_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -38,6 +38,11 @@ extern "C"
    * proc filesystem */
   void cpu_desc_read (struct cpu_desc * __restrict cpudesc);
 
+  /* Same as cpu_desc_read(), but the static values are saved in the
+   * cache directory 'cachedir', and reused until the next reboot  */
+  void cpu_desc_read_cached (struct cpu_desc * __restrict cpudesc,
+			     const char *cachedir);
+
   /* Drop a reference of the cpu_desc library context. If the refcount of
    * reaches zero, the resources of the context will be released.  */
   struct cpu_desc *cpu_desc_unref (struct cpu_desc *cpudesc);
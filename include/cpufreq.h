@@ -17,6 +17,8 @@
 #ifndef _CPUFREQ_H
 #define _CPUFREQ_H
 
+#include "system.h"
+
 struct cpufreq_available_frequencies;
 
 #ifdef __cplusplus
@@ -24,6 +26,44 @@ extern "C"
 {
 #endif
 
+  /* A frequency domain, shared by one or more CPUs */
+  struct cpufreq_policy
+  {
+    unsigned int id;		/* the N of cpufreq/policy<N> */
+    unsigned int cpu;		/* the first CPU of the domain */
+    unsigned int ncpus;		/* number of CPUs of the domain */
+    unsigned long freq_min;	/* hardware limits (kHz), 0 if unknown */
+    unsigned long freq_max;
+    unsigned long freq_kernel;	/* current frequency (kHz), 0 if unknown */
+  };
+
+  /* Read the frequencies of all the policies of the first 'ncpus' CPUs,
+   * one sysfs pass per policy.  The array must be released with
+   * cpufreq_policies_free().  */
+  struct cpufreq_policy *cpufreq_get_policies (unsigned int ncpus,
+					       unsigned int *npolicies);
+  void cpufreq_policies_free (struct cpufreq_policy *policies);
+
+  /* Get the time (in 10ms units) spent by the policy of 'cpu' below the
+   * frequency 'freq' (kHz), and in all the frequencies, since boot.
+   * Return -ENODEV if the cpufreq statistics are not available.  */
+  int cpufreq_get_time_in_state (unsigned int cpu, unsigned long freq,
+				 unsigned long long *below,
+				 unsigned long long *total);
+
+  struct cpufreq_throttle
+  {
+    unsigned long long core_count;	/* events since boot */
+    unsigned long long package_count;
+    bool has_package_count;
+    unsigned int package_id;
+  };
+
+  /* Get the thermal throttling counters of 'cpu' (x86 only).
+   * Return -ENODEV if they are not available.  */
+  int cpufreq_get_throttle (unsigned int cpu,
+			    struct cpufreq_throttle *throttle);
+
   int cpufreq_get_hardware_limits (unsigned int cpu,
 				   unsigned long *min, unsigned long *max);
   unsigned long cpufreq_get_transition_latency (unsigned int cpu);
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/* cpuidle.h -- a library for reading the CPU idle states statistics
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _CPUIDLE_H
+#define _CPUIDLE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  /* the kernel supports at most CPUIDLE_STATE_MAX (10) idle states */
+# define CPUIDLE_STATES_MAX	10
+
+  struct cpuidle_state
+  {
+    char name[16];		/* POLL, C1, C1E, C6, ... */
+    unsigned long long latency;	/* exit latency (us) */
+    unsigned long long time;	/* time spent in the state since boot (us) */
+    unsigned long long usage;	/* number of entries since boot */
+  };
+
+  /* Read the idle states of 'cpu' in 'states' (CPUIDLE_STATES_MAX items).
+   * Return the number of states, or -ENODEV if the cpuidle framework is
+   * not available for this cpu.  */
+  int cpuidle_get_states (unsigned int cpu, struct cpuidle_state *states);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif				/* _CPUIDLE_H */
@@ -18,6 +18,7 @@
 #define _CPUTOPOLOGY_H
 
 #include <sched.h>
+#include "system.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -69,6 +70,49 @@ extern "C"
   /* Get the maximum cpu index allowed by the kernel configuration. */
   int get_processor_number_kernel_max ();
 
+  struct cputopology_cpu
+  {
+    unsigned int cpu;		/* the logical CPU number */
+    int package_id;		/* -1 if unknown (offline CPU) */
+    int die_id;
+    int core_id;
+    int node;			/* NUMA node, -1 if unknown */
+    bool online;
+  };
+
+  struct cputopology_cache
+  {
+    unsigned int level;
+    char type[16];		/* Data, Instruction, Unified */
+    unsigned long size;		/* kB */
+    unsigned int ninstances;	/* number of caches in the system */
+  };
+
+# define CPUTOPOLOGY_CACHES_MAX	8
+
+  struct cputopology
+  {
+    unsigned int ncpus;		/* number of present CPUs */
+    unsigned int nonline;
+    unsigned int npackages, ndies, ncores, nnodes;
+    unsigned int threads_per_core, cores_per_socket;
+    struct cputopology_cpu *cpus;	/* the present CPUs, sorted */
+    unsigned int ncaches;
+    struct cputopology_cache caches[CPUTOPOLOGY_CACHES_MAX];
+  };
+
+  /* Get the topology of the present CPUs.  It is read from sysfs once per
+   * process; when 'cachedir' is not NULL, it is also saved in and loaded
+   * from the file 'cachedir'/cputopology, which is valid until the next
+   * reboot or CPU hotplug event.  */
+  const struct cputopology *cputopology_read (const char *cachedir);
+  const struct cputopology_cpu *
+	cputopology_get_cpu (const struct cputopology *topology,
+			     unsigned int cpu);
+
+  /* Get the physical socket of the cpu, or -1 if unknown. */
+  int get_cputopology_package_id (unsigned int cpu);
+
   /* Get the number of sockets, cores, and threads. */
   int get_cputopology_nthreads ();
   void get_cputopology_read (unsigned int *nsockets, unsigned int *ncores,
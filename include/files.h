@@ -17,6 +17,9 @@
 #ifndef _FILES_H_
 #define _FILES_H_
 
+#include <stdint.h>
+#include <time.h>
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -30,7 +33,20 @@ extern "C"
     FILES_IGNORE_UNKNOWN   = (1 << 2),
     FILES_INCLUDE_HIDDEN   = (1 << 3),
     FILES_RECURSIVE        = (1 << 4),
-    FILES_REGULAR_ONLY     = (1 << 5)
+    FILES_REGULAR_ONLY     = (1 << 5),
+    /* stat the files through io_uring, if built with liburing */
+    FILES_URING_STAT       = (1 << 6),
+    /* sum the size of the regular files counted */
+    FILES_SUM_SIZES        = (1 << 7),
+    /* do not descend into the directories of other file systems */
+    FILES_ONE_FILE_SYSTEM  = (1 << 8)
+  };
+
+  struct files_entry
+  {
+    char *path;
+    int64_t size;
+    time_t mtime;
   };
 
   struct files_types
@@ -43,11 +59,58 @@ extern "C"
     int64_t regular_file;
     int64_t total;
     int64_t unknown;
+    /* apparent size and 512-byte blocks allocated (FILES_SUM_SIZES) */
+    int64_t bytes;
+    int64_t blocks;
+    /* the largest and the oldest regular files, sorted (see 'ntop') */
+    unsigned int nlargest, noldest;
+    struct files_entry *largest, *oldest;
+    /* age histogram of the regular files counted (see 'age_bins'):
+     * age_count[i] is the number of files younger than age_bins[i], the
+     * last of the nage_bins + 1 counters the number of the older files */
+    unsigned int nage_bins;
+    int64_t *age_count;
+    /* age in seconds of the oldest of these files */
+    int64_t oldest_age;
+  };
+
+  struct files_options
+  {
+    unsigned int flags;
+    int64_t age;
+    int64_t size;
+    const char *pattern;
+    /* do not descend more than this number of levels below the directory
+     * (FILES_RECURSIVE, 0: no limit) */
+    unsigned int max_depth;
+    /* only count the names matching one of the 'include' patterns (if any,
+     * 'pattern' is added to them) and none of the 'exclude' ones */
+    const char *const *include;
+    unsigned int ninclude;
+    const char *const *exclude;
+    unsigned int nexclude;
+    /* number of threads scanning a tree in parallel (FILES_RECURSIVE) */
+    unsigned int nthreads;
+    /* number of largest and oldest regular files to be reported */
+    unsigned int ntop;
+    /* file storing the state of the previous scan (incremental mode) */
+    const char *cache_file;
+    /* rescan the directories counted more than these seconds ago */
+    int64_t cache_max_age;
+    /* upper bounds in seconds, in ascending order, of the age bins */
+    const int64_t *age_bins;
+    unsigned int nage_bins;
   };
 
   int files_filecount (const char *dir, unsigned int flags,
 		       int64_t age, int64_t size, const char *pattern,
 		       struct files_types **filecount);
+  int files_filecount_opts (const char *dir,
+			    const struct files_options *opts,
+			    struct files_types **filecount);
+  void files_types_free (struct files_types *filecount);
+  char *files_cache_path (const char *cachedir, const char *dir,
+			  const struct files_options *opts);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/* fsfilter.h -- a library for selecting the mounted file systems by type
+                 and mount point
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _FSFILTER_H
+#define _FSFILTER_H
+
+#include "collection.h"
+#include "mountlist.h"
+#include "system.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  struct fs_filter
+  {
+    hashtable_t *select_types;	/* if NULL, all the types are selected */
+    hashtable_t *exclude_types;	/* if NULL, no type is excluded */
+    hashtable_t *mountpoints;	/* the file systems given as arguments */
+    bool show_all_fs;		/* include the dummy file systems */
+    bool show_local_fs;		/* only the local file systems */
+  };
+
+  /* Add FSTYPE to the types to be selected (-T) or omitted (-X) */
+  void fs_filter_select_type (struct fs_filter *filter, const char *fstype);
+  void fs_filter_exclude_type (struct fs_filter *filter, const char *fstype);
+
+  /* Return a type both selected and excluded, or NULL */
+  const char *fs_filter_type_conflict (const struct fs_filter *filter);
+
+  bool fs_filter_selected_fstype (const struct fs_filter *filter,
+				  const char *fstype);
+  bool fs_filter_excluded_fstype (const struct fs_filter *filter,
+				  const char *fstype);
+
+  /* Return true if the mount 'me' is filtered out by its type or by the
+   * all/local flags */
+  bool fs_filter_skip (const struct fs_filter *filter,
+		       const struct mount_entry *me);
+
+  /* Add a file system (a mount point or a device name) given in the
+   * command line.  The counter of the returned entry can be used by the
+   * caller to mark the file systems found in the mount table.  */
+  hashable_t *fs_filter_add_mountpoint (struct fs_filter *filter,
+					const char *name);
+
+  /* Return the entry of the file system 'name' given in the command line,
+   * or NULL */
+  hashable_t *fs_filter_mountpoint (const struct fs_filter *filter,
+				    const char *name);
+
+  /* Return true if the mount 'me' is one of the file systems given in the
+   * command line, by mount point or device name */
+  bool fs_filter_listed (const struct fs_filter *filter,
+			 const struct mount_entry *me);
+
+  void fs_filter_free (struct fs_filter *filter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif				/* _FSFILTER_H */
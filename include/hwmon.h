@@ -0,0 +1,57 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/* hwmon.h -- a library for reading the hwmon temperature sensors
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _HWMON_H
+#define _HWMON_H
+
+#include "system.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  struct hwmon_sensor
+  {
+    char label[32];		/* Package id 0, Core 0, Composite, ... */
+    unsigned int index;		/* the N of temp<N>_input */
+    long long input;		/* the temperature (millidegree Celsius) */
+    long long crit;		/* the critical temperature, if has_crit */
+    bool has_crit;
+  };
+
+  struct hwmon_chip
+  {
+    unsigned int id;		/* the N of /sys/class/hwmon/hwmon<N> */
+    char name[32];		/* coretemp, k10temp, nvme, jc42, ... */
+    unsigned int nsensors;
+    struct hwmon_sensor *sensors;	/* sorted by index */
+  };
+
+  /* Read all the chips exporting at least one temperature sensor.
+   * Return an array of 'nchips' chips sorted by id, to be released with
+   * hwmon_chips_free().  */
+  struct hwmon_chip *hwmon_get_chips (unsigned int *nchips);
+  void hwmon_chips_free (struct hwmon_chip *chips, unsigned int nchips);
+
+  /* Return the path of the hwmon class in sysfs */
+  const char *hwmon_sysfs_path (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif				/* _HWMON_H */
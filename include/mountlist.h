@@ -28,15 +28,20 @@ struct mount_entry
   char *me_type;                /* "nfs", "4.2", etc. */
   char *me_opts;                /* Comma-separated options for fs. */
   dev_t me_dev;                 /* Device number of me_mountdir. */
+  unsigned int me_mntid;        /* Unique ID of the mount. */
+  unsigned int me_parentid;     /* ID of the parent mount. */
   unsigned int me_dummy : 1;    /* Nonzero for dummy file systems. */
   unsigned int me_remote : 1;   /* Nonzero for remote fileystems. */
   unsigned int me_readonly : 1; /* Nonzero for readonly fileystems. */
   unsigned int me_type_malloced : 1; /* Nonzero if me_type was malloced. */
   unsigned int me_opts_malloced : 1; /* Nonzero if me_opts was malloced. */
+  unsigned int me_arena : 1;    /* Nonzero if the whole list and its
+                                   strings are a single memory block. */
   struct mount_entry *me_next;
 };
 
 struct mount_entry *read_file_system_list (bool need_fs_type);
+void free_mount_list (struct mount_entry *mount_list);
 int file_system_type_exists (const char *fs_type, char **fs_mp);
 
 #endif /* mountlist.h */
@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/* mountwatch.h -- a library for recording the read-only transitions of
+                   the mounted file systems
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _MOUNTWATCH_H
+#define _MOUNTWATCH_H
+
+#include <time.h>
+
+#include "mountlist.h"
+#include "system.h"
+
+/* Number of events kept in the state file */
+#define MOUNTWATCH_MAX_EVENTS	64
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  struct mountwatch_event
+  {
+    time_t when;
+    bool readonly;		/* the mount became read-only (or read-write) */
+    char *type;
+    char *mountdir;
+  };
+
+  struct mountwatch_state
+  {
+    struct mountwatch_event events[MOUNTWATCH_MAX_EVENTS];
+    unsigned int nevents;	/* the oldest events come first */
+  };
+
+  /* Load the events recorded in 'path' into 'state'.  A missing file is
+   * not an error.  Return 0 on success or a negative errno.  */
+  int mountwatch_state_read (const char *path, struct mountwatch_state *state);
+
+  /* Atomically replace 'path' with the events of 'state'.
+   * Return 0 on success or a negative errno.  */
+  int mountwatch_state_write (const char *path,
+			      const struct mountwatch_state *state);
+
+  /* Append an event, discarding the oldest one when 'state' is full */
+  void mountwatch_state_add (struct mountwatch_state *state, time_t when,
+			     bool readonly, const char *type,
+			     const char *mountdir);
+  void mountwatch_state_free (struct mountwatch_state *state);
+
+  /* Record in 'state' the mounts of 'new_list' whose read-only flag
+   * differs from the one they had in 'old_list' (mounts are matched by
+   * mount ID and mount point).  The mounts for which 'skip' returns true
+   * are ignored.  Return the number of recorded events.  */
+  unsigned int mountwatch_diff (struct mount_entry *old_list,
+				struct mount_entry *new_list, time_t now,
+				bool (*skip) (const struct mount_entry *),
+				struct mountwatch_state *state);
+
+  /* Return a file descriptor to be passed to mountwatch_wait(),
+   * or a negative errno.  */
+  int mountwatch_open (void);
+
+  /* Wait at most 'timeout' milliseconds (-1 means forever) for a change
+   * of the mount table.  Return 1 if the table changed, 0 if the timeout
+   * expired, or a negative errno.  */
+  int mountwatch_wait (int fd, int timeout);
+
+  /* Wait like mountwatch_wait(), then reread the mount table with
+   * 'read_list' and record in 'state' the read-only transitions since
+   * '*mounts', that is replaced by the new table.  The table is reread
+   * also when the timeout expires.  Return the number of recorded events
+   * or a negative errno.  */
+  int mountwatch_update (int fd, int timeout, struct mount_entry **mounts,
+			 struct mount_entry *(*read_list) (void),
+			 bool (*skip) (const struct mount_entry *),
+			 struct mountwatch_state *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif				/* _MOUNTWATCH_H */
@@ -42,6 +42,10 @@ extern "C"
   typedef struct iflist
   {
     char *ifname;
+    char *kind;		   /* IFLA_INFO_KIND, NULL for physical devices */
+    int ifindex;
+    int master;		   /* IFLA_MASTER, zero if not enslaved */
+    char *ports;	   /* the ports of a bridge (with --rollup only) */
     uint8_t duplex;	   /* the duplex as defined in <linux/ethtool.h> */
     uint32_t speed;	   /* the link speed in Mbps */
     unsigned int flags;
@@ -49,8 +53,31 @@ extern "C"
     struct iflist *next;
   } iflist_t;
 
+  typedef struct qdiscstats
+  {
+    unsigned long long bytes;
+    unsigned int packets;
+    unsigned int drops;
+    unsigned int overlimits;
+    unsigned int requeues;
+    unsigned int backlog;	/* bytes waiting in the queue */
+    unsigned int qlen;		/* packets waiting in the queue */
+  } qdiscstats_t;
+
+  typedef struct qdisclist
+  {
+    char *ifname;
+    char *kind;		   /* TCA_KIND: fq_codel, mq, htb, pfifo_fast... */
+    int ifindex;
+    uint32_t handle;
+    struct qdiscstats stats;
+    struct qdisclist *next;
+  } qdisclist_t;
+
   struct iflist *get_netinfo_snapshot (unsigned int options,
+				       unsigned int kinds,
 				       const regex_t *iface_regex);
+  struct qdisclist *get_qdisc_snapshot (const regex_t *iface_regex);
 
 #ifdef __cplusplus
 }
@@ -45,7 +45,20 @@ extern "C"
     NO_MULTICAST	= (1 << 6),
     NO_PACKETS		= (1 << 7),
     RX_ONLY		= (1 << 8),
-    TX_ONLY		= (1 << 9)
+    TX_ONLY		= (1 << 9),
+    ROLLUP_SLAVES	= (1 << 10)
+  };
+
+  enum
+  {
+    /* interface kinds, as reported by IFLA_INFO_KIND */
+    IF_KIND_PHYSICAL	= (1 << 0),	/* no kind and not a loopback */
+    IF_KIND_BOND	= (1 << 1),
+    IF_KIND_BRIDGE	= (1 << 2),
+    IF_KIND_VLAN	= (1 << 3),
+    IF_KIND_VETH	= (1 << 4),
+    IF_KIND_OTHER	= (1 << 5),	/* loopback, tun, macvlan, vxlan... */
+    IF_KIND_ALL		= (1 << 6) - 1
   };
 
   enum duplex
@@ -56,8 +69,9 @@ extern "C"
     _DUP_UNKNOWN = DUPLEX_UNKNOWN
   };
 
-  struct iflist *netinfo (unsigned int options, const char *ifname_regex,
-			  unsigned int seconds, unsigned int *ninterfaces);
+  struct iflist *netinfo (unsigned int options, unsigned int kinds,
+			  const char *ifname_regex, unsigned int seconds,
+			  unsigned int *ninterfaces);
   struct iflist *iflist_get_next (struct iflist *ifentry);
 #define iflist_foreach(list_entry, list) \
 	for (list_entry = list; list_entry != NULL; \
@@ -65,6 +79,7 @@ extern "C"
 
   /* Accessing the values from struct iflist */
   const char *iflist_get_ifname (struct iflist *ifentry);
+  const char *iflist_get_kind (struct iflist *ifentry);
   uint8_t iflist_get_duplex (struct iflist *ifentry);
   uint32_t iflist_get_speed (struct iflist *ifentry);
   unsigned int iflist_get_tx_packets (struct iflist *ifentry);
@@ -79,9 +94,33 @@ extern "C"
   unsigned int iflist_get_flags (struct iflist *ifentry);
   unsigned int iflist_get_multicast (struct iflist *ifentry);
 
+  struct qdisclist *qdiscinfo (const char *ifname_regex, unsigned int seconds,
+			       unsigned int *nqdiscs);
+  struct qdisclist *qdisclist_get_next (struct qdisclist *qdentry);
+#define qdisclist_foreach(list_entry, list) \
+	for (list_entry = list; list_entry != NULL; \
+	     list_entry = qdisclist_get_next(list_entry))
+
+  /* Accessing the values from struct qdisclist */
+  const char *qdisclist_get_ifname (struct qdisclist *qdentry);
+  const char *qdisclist_get_kind (struct qdisclist *qdentry);
+  unsigned long long qdisclist_get_bytes (struct qdisclist *qdentry);
+  unsigned int qdisclist_get_packets (struct qdisclist *qdentry);
+  unsigned int qdisclist_get_drops (struct qdisclist *qdentry);
+  unsigned int qdisclist_get_overlimits (struct qdisclist *qdentry);
+  unsigned int qdisclist_get_requeues (struct qdisclist *qdentry);
+  unsigned int qdisclist_get_backlog (struct qdisclist *qdentry);
+  unsigned int qdisclist_get_qlen (struct qdisclist *qdentry);
+
+  void print_qdisc_debug (struct qdisclist *qdhead);
+  void freeqdisclist (struct qdisclist *qdhead);
+
   void print_ifname_debug (struct iflist *iflhead, unsigned int options);
   void freeiflist (struct iflist *iflhead);
 
+  /* parse a comma-separated list of interface kinds */
+  unsigned int if_kinds_parse (const char *list);
+
   /* helper functions for parsing and priting interface flags */
   bool if_flags_LOOPBACK (unsigned int flags);
   bool if_flags_RUNNING (unsigned int flags);
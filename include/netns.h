@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/* netns.h -- a library for getting network statistics of all the
+              network namespaces
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef _NETNS_H
+#define _NETNS_H
+
+#include <sys/types.h>
+
+#include "netinfo-private.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+  typedef struct netnsinfo
+  {
+    char *name;		   /* "default", the name in /run/netns, or "pid<N>" */
+    char *path;		   /* the namespace file to be passed to setns() */
+    dev_t dev;		   /* device and inode identifying the namespace */
+    ino_t inode;
+    int error;		   /* errno if the namespace could not be entered */
+    unsigned int ninterfaces;	/* number of interfaces matching the regex */
+    struct ifstats stats;  /* sum of the statistics of these interfaces */
+  } netnsinfo_t;
+
+  /* Enumerate the network namespaces (from /proc/self/ns/net, /run/netns
+   * and /proc/<pid>/ns/net, deduplicated by inode), take one or two netlink
+   * snapshots of each of them and return an array of 'nnamespaces' entries
+   * with the aggregated statistics of the interfaces of the given 'kinds'
+   * matching 'ifname_regex'.  When 'seconds' is not zero, the counters are
+   * converted into per-second rates.  */
+  struct netnsinfo *netns_netinfo (unsigned int options,
+				   unsigned int kinds,
+				   const char *ifname_regex,
+				   unsigned int seconds,
+				   unsigned int *nnamespaces);
+  void netns_free (struct netnsinfo *nslist, unsigned int nnamespaces);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif				/* _NETNS_H */
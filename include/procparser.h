@@ -22,6 +22,8 @@ extern "C"
 {
 #endif
 
+#define PATH_PROC_BOOT_ID	"/proc/sys/kernel/random/boot_id"
+
   typedef struct proc_table_struct
   {
     const char *name;		/* proc type name */
@@ -37,6 +39,10 @@ extern "C"
    */
   int linelookup (char *line, char *pattern, char **value);
 
+  /* Get the boot id, a random UUID generated by the kernel at each boot,
+   * from 'path' (usually PATH_PROC_BOOT_ID).  Return NULL on error.  */
+  char *procparser_boot_id (const char *path);
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,6 +19,7 @@
 
 #include <dirent.h>
 #include <limits.h>
+#include <sys/types.h>
 #include "system.h"
 
 #define PATH_SYS  "/sys"
@@ -43,6 +44,39 @@ extern "C"
   int sysfsparser_getvalue (unsigned long long *value, const char *filename, ...)
        _attribute_format_printf_(2, 3);
 
+  /* cached directories */
+
+  /* Size of the buffer large enough for a numeric sysfs attribute */
+# define SYSFSPARSER_VALUE_MAX	64
+
+  struct sysfsparser_attr
+  {
+    const char *name;		/* file name, relative to the directory */
+    unsigned long long value;	/* set to 0 on error */
+    int err;			/* 0 or -1 */
+  };
+
+  /* Return a file descriptor of the directory, or -errno.  The directory
+   * is kept open and cached: the caller must not close it, and it remains
+   * valid until 64 other directories have been opened or until
+   * sysfsparser_closedirfds() is called.  */
+  int sysfsparser_opendirfd (const char *format, ...)
+       _attribute_format_printf_(1, 2);
+  void sysfsparser_closedirfds (void);
+
+  /* Read the attribute 'name' of the directory 'dirfd' in 'buf' (without
+   * the trailing newline) and return its length, or -errno */
+  ssize_t sysfsparser_read_at (int dirfd, const char *name, char *buf,
+			       size_t size);
+  int sysfsparser_getvalue_at (int dirfd, const char *name,
+			       unsigned long long *value);
+
+  /* Read 'nattrs' numeric attributes of one directory; return the number
+   * of attributes successfully read */
+  unsigned int sysfsparser_getvalues_at (int dirfd,
+					 struct sysfsparser_attr *attrs,
+					 size_t nattrs);
+
   /* Lookup a pattern and get the value from line
    * Format is:
    *     "<pattern> <numeric-key>"
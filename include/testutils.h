@@ -43,6 +43,7 @@
 #define NPL_TEST_PATH_PROCVMSTAT abs_srcdir "/ts_procvmstat.data"
 #define NPL_TEST_PATH_PROCPRESSURE_CPU abs_srcdir "/ts_procpressurecpu.data"
 #define NPL_TEST_PATH_PROCPRESSURE_IO abs_srcdir "/ts_procpressureio.data"
+#define NPL_TEST_PATH_PROCMOUNTINFO abs_srcdir "/ts_procmountinfo.data"
 
 /* simulate the test of a query to the docker rest API */
 #define NPL_TEST_PATH_CONTAINER_JSON abs_srcdir "/ts_container_docker.data"
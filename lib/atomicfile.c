@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A library for replacing a file atomically.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The data is written to a temporary file in the same directory, that
+ * is synced and then renamed over the target: a crash or a concurrent
+ * plugin never leave a truncated file behind.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "atomicfile.h"
+#include "xasprintf.h"
+
+int
+atomic_write_file (const char *path, int (*emit) (FILE *, const void *),
+		   const void *data)
+{
+  char *tmpfile = xasprintf ("%s.XXXXXX", path);
+  FILE *fp;
+  int fd, err = 0;
+
+  if ((fd = mkstemp (tmpfile)) < 0)
+    {
+      err = -errno;
+      free (tmpfile);
+      return err;
+    }
+  /* the files are written by root and read by the monitoring user */
+  fchmod (fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+  if ((fp = fdopen (fd, "w")) == NULL)
+    {
+      err = -errno;
+      close (fd);
+      unlink (tmpfile);
+      free (tmpfile);
+      return err;
+    }
+
+  err = emit (fp, data);
+  if (0 == err && (fflush (fp) != 0 || fsync (fd) != 0))
+    err = -errno;
+  if (fclose (fp) != 0 && 0 == err)
+    err = -errno;
+  if (0 == err && rename (tmpfile, path) != 0)
+    err = -errno;
+  if (err)
+    unlink (tmpfile);
+
+  free (tmpfile);
+  return err;
+}
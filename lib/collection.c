@@ -31,14 +31,40 @@
 /* hash: form hash value for string s */
 
 static unsigned
-hash (const char *s)
+hash (const char *s, unsigned int capacity)
 {
   unsigned hashval;
 
   for (hashval = 0; *s != '\0'; s++)
     hashval = *s + 31 * hashval;
 
-  return hashval % HASHSIZE;
+  return hashval % capacity;
+}
+
+/* Double the number of buckets, to keep the chains short when many
+ * unique keys are stored */
+
+static void
+counter_grow (hashtable_t * hashtable)
+{
+  unsigned int i, capacity = 2 * hashtable->capacity + 1;
+  hashable_t **table = xnmalloc (capacity, sizeof (hashable_t *));
+  hashable_t *np, *next;
+
+  dbg ("hashtable: growing from %u to %u buckets\n",
+       hashtable->capacity, capacity);
+  for (i = 0; i < hashtable->capacity; i++)
+    for (np = hashtable->table[i]; np != NULL; np = next)
+      {
+	unsigned int hashval = hash (np->key, capacity);
+	next = np->next;
+	np->next = table[hashval];
+	table[hashval] = np;
+      }
+
+  free (hashtable->table);
+  hashtable->table = table;
+  hashtable->capacity = capacity;
 }
 
 /* initialize the hash pointer table */
@@ -65,7 +91,8 @@ counter_lookup (const hashtable_t * hashtable, const char *key)
   hashable_t *np;
 
   dbg ("hashtable lookup for key \"%s\"\n", key);
-  for (np = hashtable->table[hash (key)]; np != NULL; np = np->next)
+  for (np = hashtable->table[hash (key, hashtable->capacity)]; np != NULL;
+       np = np->next)
     if (STREQ (key, np->key))
       {
 	dbg ("hashtable lookup: found key \"%s\"\n", key);
@@ -91,15 +118,23 @@ counter_put (hashtable_t * hashtable, const char *key, unsigned long increment)
       np = xmalloc (sizeof (*np));
       np->key = xstrdup (key);
 
-      unsigned int hashval = hash (key);
+      if (hashtable->uniq >= hashtable->capacity)
+	counter_grow (hashtable);
+
+      unsigned int hashval = hash (key, hashtable->capacity);
       np->count = increment;
       np->next = hashtable->table[hashval];
       hashtable->table[hashval] = np;
 
-      unsigned long new_size =
-	sizeof (*(hashtable->keys)) * (hashtable->uniq + 1);
-      hashtable->keys = xrealloc (hashtable->keys, new_size);
-      dbg ("xrealloc'ed hashtable->keys to %lu bytes\n", new_size);
+      /* the array of keys has room for a power of two of elements */
+      if (hashtable->uniq > 0
+	  && (hashtable->uniq & (hashtable->uniq - 1)) == 0)
+	{
+	  unsigned long new_size =
+	    sizeof (*(hashtable->keys)) * 2 * hashtable->uniq;
+	  hashtable->keys = xrealloc (hashtable->keys, new_size);
+	  dbg ("xrealloc'ed hashtable->keys to %lu bytes\n", new_size);
+	}
 
       (hashtable->keys)[hashtable->uniq] = np->key;
       dbg ("(hashtable->keys)[%u] = \"%s\"\n", hashtable->uniq,
@@ -150,13 +185,14 @@ counter_free (hashtable_t * hashtable)
 {
   hashable_t *np, *np2;
 
-  for (int i = 0; i < HASHSIZE; i++)
+  for (unsigned int i = 0; i < hashtable->capacity; i++)
     {
       np = hashtable->table[i];
       while (np != NULL)
 	{
 	  np2 = np;
 	  np = np->next;
+	  free (np2->key);
 	  free (np2);
 	}
     }
@@ -24,6 +24,7 @@
 
 #include <assert.h>
 #include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -41,6 +42,7 @@
 #include "logging.h"
 #include "messages.h"
 #include "string-macros.h"
+#include "sysfsparser.h"
 #include "system.h"
 #include "url_encode.h"
 #include "xalloc.h"
@@ -54,6 +56,17 @@
 #define DOCKER_CONTAINERS_JSON  0x01
 #define DOCKER_STATS_JSON       0x02
 
+/* the maximum number of connections opened at once to the Docker socket */
+#define DOCKER_STATS_MAX_CONNECTIONS  16
+
+#define PATH_SYS_CGROUP		PATH_SYS "/fs/cgroup"
+
+/* the length of a full Docker/Podman container id */
+#define CONTAINER_ID_LEN	64
+
+/* Large enough for the memory.stat and cpu.stat cgroup files */
+#define CGROUP_KEYED_MAX	8192
+
 /* returns the last portion of the given container image.
    example:
      "prom/prometheus:v2.39.0"  -->  "prometheus:v2.39.0"
@@ -107,6 +120,255 @@ docker_json_parser_search (const char *json, const char *token,
   return hashtable;
 }
 
+/* The cgroup v2 backend.
+   The containers run in their own cgroup, whose name contains the full
+   container id:
+     system.slice/docker-<id>.scope    Docker (systemd cgroup driver)
+     docker/<id>                       Docker (cgroupfs cgroup driver)
+     machine.slice/libpod-<id>.scope   Podman
+   and the memory and CPU usage can be read there without querying the
+   Docker/Podman API.  */
+
+struct cgroup_container
+{
+  char id[CONTAINER_ID_LEN + 1];
+  char *path;
+};
+
+static const char *cgroup_container_parents[] = {
+  "system.slice", "machine.slice", "docker"
+};
+
+/* return the container id found in the cgroup name 'name' of the
+   directory 'parent' (see above), or false if the cgroup does not belong
+   to a container.  */
+static bool
+cgroup_container_id (const char *parent, const char *name, char *id)
+{
+  const char *suffix = "";
+  size_t len;
+
+  if (STREQ (parent, "docker"))
+    ;
+  else if (STRPREFIX (name, "docker-") || STRPREFIX (name, "libpod-"))
+    {
+      name = strchr (name, '-') + 1;
+      suffix = ".scope";
+    }
+  else
+    return false;
+
+  /* note that the conmon scopes (libpod-conmon-<id>.scope) are skipped */
+  len = strspn (name, "0123456789abcdef");
+  if (len != CONTAINER_ID_LEN || STRNEQ (name + len, suffix))
+    return false;
+
+  memcpy (id, name, CONTAINER_ID_LEN);
+  id[CONTAINER_ID_LEN] = '\0';
+  return true;
+}
+
+/* return the list of the containers found in the cgroup v2 hierarchy
+   mounted at 'cgroot', or NULL if the hierarchy is not a cgroup v2 one */
+static struct cgroup_container *
+cgroup_containers_scan (const char *cgroot, unsigned int *ncontainers,
+			bool *cgroup2)
+{
+  struct cgroup_container *containers = NULL;
+  unsigned int i, n = 0;
+
+  *ncontainers = 0;
+  *cgroup2 = sysfsparser_path_exist ("%s/cgroup.controllers", cgroot);
+  if (!*cgroup2)
+    return NULL;
+
+  for (i = 0; i < sizeof (cgroup_container_parents) / sizeof (char *); i++)
+    {
+      const char *parent = cgroup_container_parents[i];
+      struct dirent *dp;
+      char id[CONTAINER_ID_LEN + 1];
+      char *path = xasprintf ("%s/%s", cgroot, parent);
+      DIR *dirp = opendir (path);
+
+      free (path);
+      if (NULL == dirp)
+	continue;
+
+      while ((dp = readdir (dirp)))
+	{
+	  if (!cgroup_container_id (parent, dp->d_name, id))
+	    continue;
+	  if ((n & (n - 1)) == 0)
+	    containers = xrealloc (containers, (n ? 2 * n : 1) *
+				   sizeof (struct cgroup_container));
+	  memcpy (containers[n].id, id, sizeof (id));
+	  containers[n].path =
+	    xasprintf ("%s/%s/%s", cgroot, parent, dp->d_name);
+	  n++;
+	}
+      closedir (dirp);
+    }
+
+  *ncontainers = n;
+  return containers;
+}
+
+static void
+cgroup_containers_free (struct cgroup_container *containers,
+			unsigned int ncontainers)
+{
+  unsigned int i;
+
+  for (i = 0; i < ncontainers; i++)
+    free (containers[i].path);
+  free (containers);
+}
+
+/* add to 'values' the values of the 'keys' found in the flat keyed cgroup
+   file 'name' (lines in the format "<key> <value>") */
+static void
+cgroup_read_keyed (int dirfd, const char *name, const char *const *keys,
+		   unsigned long long **values, size_t nkeys)
+{
+  char buf[CGROUP_KEYED_MAX], *line, *saveptr = NULL;
+  size_t i;
+
+  if (sysfsparser_read_at (dirfd, name, buf, sizeof buf) < 1)
+    return;
+
+  for (line = strtok_r (buf, "\n", &saveptr); line;
+       line = strtok_r (NULL, "\n", &saveptr))
+    {
+      unsigned long long value;
+      char key[64];
+
+      if (sscanf (line, "%63s %llu", key, &value) != 2)
+	continue;
+      for (i = 0; i < nkeys; i++)
+	if (STREQ (key, keys[i]))
+	  *values[i] += value;
+    }
+}
+
+/* add to 'stats' the memory and CPU usage of the container whose cgroup is
+   'path'.  return -1 if the cgroup cannot be read (the container has been
+   stopped in the meantime).  */
+static int
+cgroup_container_read (const char *path, struct container_stats *stats)
+{
+  static const char *const memory_keys[] = { "anon", "file" };
+  static const char *const cpu_keys[] =
+    { "usage_usec", "user_usec", "system_usec" };
+  unsigned long long memory_current, memory_swap;
+  int dirfd;
+
+  if ((dirfd = sysfsparser_opendirfd ("%s", path)) < 0
+      || sysfsparser_getvalue_at (dirfd, "memory.current",
+				  &memory_current) < 0)
+    return -1;
+
+  stats->containers++;
+  stats->memory_current += memory_current;
+  /* memory.swap.current is missing when the swap accounting is disabled */
+  if (sysfsparser_getvalue_at (dirfd, "memory.swap.current",
+			       &memory_swap) == 0)
+    stats->memory_swap += memory_swap;
+
+  cgroup_read_keyed (dirfd, "memory.stat", memory_keys,
+		     (unsigned long long *[]) {
+		     &stats->memory_anon, &stats->memory_file}, 2);
+  cgroup_read_keyed (dirfd, "cpu.stat", cpu_keys,
+		     (unsigned long long *[]) {
+		     &stats->cpu_usage_usec, &stats->cpu_user_usec,
+		     &stats->cpu_system_usec}, 3);
+
+  return 0;
+}
+
+static int
+cgroup_containers_read (const char *cgroot, struct container_stats *stats)
+{
+  struct cgroup_container *containers;
+  unsigned int i, n;
+  bool cgroup2;
+
+  memset (stats, 0, sizeof (struct container_stats));
+
+  containers = cgroup_containers_scan (cgroot, &n, &cgroup2);
+  if (!cgroup2)
+    return -1;
+
+  for (i = 0; i < n; i++)
+    {
+      dbg ("reading the cgroup of the container \"%s\": %s\n",
+	   containers[i].id, containers[i].path);
+      cgroup_container_read (containers[i].path, stats);
+    }
+
+  cgroup_containers_free (containers, n);
+  return 0;
+}
+
+#if defined NPL_TESTING || defined HAVE_LIBCURL
+
+static const struct cgroup_container *
+cgroup_container_lookup (const struct cgroup_container *containers,
+			 unsigned int ncontainers, const char *id)
+{
+  unsigned int i;
+
+  for (i = 0; i < ncontainers; i++)
+    if (STREQ (containers[i].id, id))
+      return &containers[i];
+
+  return NULL;
+}
+
+/* add to 'memory' the memory usage (in kB) of the 'n' containers listed in
+   'ids', read from the cgroup v2 hierarchy mounted at 'cgroot'.
+   the ids of the containers not found there are moved at the beginning of
+   'ids' and their number is returned  */
+static unsigned int
+cgroup_containers_memory (const char *cgroot, char **ids, unsigned int n,
+			  long long unsigned int *memory)
+{
+  struct cgroup_container *cgroups;
+  unsigned int j, left = 0, ncgroups;
+  bool cgroup2;
+
+  cgroups = cgroup_containers_scan (cgroot, &ncgroups, &cgroup2);
+
+  for (j = 0; j < n; j++)
+    {
+      const struct cgroup_container *cgroup =
+	cgroup_container_lookup (cgroups, ncgroups, ids[j]);
+      struct container_stats stats = { 0 };
+
+      if (cgroup && cgroup_container_read (cgroup->path, &stats) == 0)
+	{
+	  dbg ("memory usage for container id \"%s\" (cgroup): %llu bytes\n",
+	       ids[j], stats.memory_current);
+	  *memory += (stats.memory_current >> 10);
+	}
+      else
+	ids[left++] = ids[j];
+    }
+
+  cgroup_containers_free (cgroups, ncgroups);
+  return left;
+}
+
+#endif
+
+/* Returns the memory and CPU usage of the running Docker/Podman containers
+   read from the cgroup v2 hierarchy  */
+
+int
+cgroup_containers_stats (struct container_stats *stats)
+{
+  return cgroup_containers_read (PATH_SYS_CGROUP, stats);
+}
+
 #if !defined NPL_TESTING && defined HAVE_LIBCURL
 
 static size_t
@@ -126,12 +388,11 @@ write_memory_callback (void *contents, size_t size, size_t nmemb, void *userp)
   return realsize;
 }
 
-static void
-docker_init (CURL **curl_handle, chunk_t *chunk, const char *socket)
+/* return the socket of the Docker/Podman API: 'socket' if set, or the
+   content of the environment variable DOCKER_HOST.  */
+static const char *
+docker_socket (const char *socket)
 {
-  chunk->memory = malloc (1);	/* will be grown as needed by the realloc above */
-  chunk->size = 0;		/* no data at this point */
-
   if (NULL == socket)
     {
       const char *env_docker_host = secure_getenv ("DOCKER_HOST");
@@ -145,33 +406,57 @@ docker_init (CURL **curl_handle, chunk_t *chunk, const char *socket)
 		      "the socket path was not set, nor was the environment variable DOCKER_HOST");
     }
 
-  curl_global_init (CURL_GLOBAL_ALL);
+  return socket;
+}
 
-  /* init the curl session */
-  *curl_handle = curl_easy_init ();
-  if (NULL == (*curl_handle))
+/* init a curl easy session writing the data received from 'socket' in
+   'chunk'.  */
+static CURL *
+docker_easy_init (const char *socket, chunk_t *chunk)
+{
+  CURL *curl_handle;
+
+  chunk->memory = malloc (1);	/* will be grown as needed by the realloc above */
+  chunk->size = 0;		/* no data at this point */
+
+  curl_handle = curl_easy_init ();
+  if (NULL == curl_handle)
     plugin_error (STATE_UNKNOWN, errno,
 		  "cannot start a libcurl easy session");
 
-  curl_easy_setopt (*curl_handle, CURLOPT_UNIX_SOCKET_PATH, socket);
+  curl_easy_setopt (curl_handle, CURLOPT_UNIX_SOCKET_PATH, socket);
   dbg ("CURLOPT_UNIX_SOCKET_PATH is set to \"%s\"\n", socket);
 
   /* send all data to this function */
-  curl_easy_setopt (*curl_handle, CURLOPT_WRITEFUNCTION,
+  curl_easy_setopt (curl_handle, CURLOPT_WRITEFUNCTION,
 		    write_memory_callback);
-  curl_easy_setopt (*curl_handle, CURLOPT_WRITEDATA, (void *) chunk);
-  curl_easy_setopt (*curl_handle, CURLOPT_NOPROGRESS, 1L);
+  curl_easy_setopt (curl_handle, CURLOPT_WRITEDATA, (void *) chunk);
+  curl_easy_setopt (curl_handle, CURLOPT_NOPROGRESS, 1L);
 
   /* some servers don't like requests that are made without a user-agent
      field, so we provide one */
-  curl_easy_setopt (*curl_handle, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+  curl_easy_setopt (curl_handle, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+
+  return curl_handle;
 }
 
-static CURLcode
-docker_get (CURL *curl_handle, const int query, const char *id)
+static void
+docker_init (CURL **curl_handle, chunk_t *chunk, const char *socket)
 {
-  CURLcode res;
-  char *api_version, *class, *url, *filter = NULL;
+  socket = docker_socket (socket);
+
+  curl_global_init (CURL_GLOBAL_ALL);
+
+  /* init the curl session */
+  *curl_handle = docker_easy_init (socket, chunk);
+}
+
+/* return the url of the Docker/Podman API for the given query.
+   the returned string must be freed by the caller.  */
+static char *
+docker_url (const int query, const char *id)
+{
+  char *api_version, *filter, *url;
 
   api_version = secure_getenv ("DOCKER_API_VERSION");
   if (NULL == api_version)
@@ -186,24 +471,31 @@ docker_get (CURL *curl_handle, const int query, const char *id)
       plugin_error (STATE_UNKNOWN, 0, "unknown docker query");
     case DOCKER_CONTAINERS_JSON:
       filter = url_encode ("{\"status\":{\"running\":true}}");
-      class = xasprintf ("containers/json");
       url = filter ?
-	xasprintf ("http://v%s/%s?filters=%s", api_version, class, filter) :
-	xasprintf ("http://v%s/%s", api_version, class);
+	xasprintf ("http://v%s/containers/json?filters=%s", api_version,
+		   filter) :
+	xasprintf ("http://v%s/containers/json", api_version);
+      free (filter);
       break;
     case DOCKER_STATS_JSON:
-      class = xasprintf ("containers/%s/stats", id);
-      url = xasprintf ("http://v%s/%s?stream=false", api_version, class);
+      url = xasprintf ("http://v%s/containers/%s/stats?stream=false",
+		       api_version, id);
       break;
     }
 
   dbg ("docker rest url: %s\n", url);
+  return url;
+}
+
+static CURLcode
+docker_get (CURL *curl_handle, const int query, const char *id)
+{
+  CURLcode res;
+  char *url = docker_url (query, id);
 
   curl_easy_setopt (curl_handle, CURLOPT_URL, url);
   res = curl_easy_perform (curl_handle);
 
-  free (class);
-  free (filter);
   free (url);
 
   return res;
@@ -226,7 +518,7 @@ docker_close (CURL *curl_handle, chunk_t *chunk)
 static int
 docker_api_call (char *socket, chunk_t *chunk,
 #ifndef NPL_TESTING
-		 CURL *curl_handle,
+		 CURL **curl_handle,
 #endif
 		 const char *search_key, bool verbose)
 {
@@ -234,12 +526,11 @@ docker_api_call (char *socket, chunk_t *chunk,
 
   CURLcode res;
 
-  curl_handle = NULL;
-  docker_init (&curl_handle, chunk, socket);
-  res = docker_get (curl_handle, DOCKER_CONTAINERS_JSON, NULL);
+  docker_init (curl_handle, chunk, socket);
+  res = docker_get (*curl_handle, DOCKER_CONTAINERS_JSON, NULL);
   if (CURLE_OK != res)
     {
-      docker_close (curl_handle, chunk);
+      docker_close (*curl_handle, chunk);
       plugin_error (STATE_UNKNOWN, errno, "%s", curl_easy_strerror (res));
     }
 
@@ -282,7 +573,7 @@ docker_running_containers (char *socket, unsigned int *count,
   char *search_key = "Image";
 
 #ifndef NPL_TESTING
-  docker_api_call (socket, &chunk, curl_handle, search_key, verbose);
+  docker_api_call (socket, &chunk, &curl_handle, search_key, verbose);
 #else
   docker_api_call (socket, &chunk, search_key, verbose);
 #endif
@@ -332,42 +623,22 @@ docker_running_containers (char *socket, unsigned int *count,
 
 #ifndef NPL_TESTING
 
-/* Returns the memory usage of a Docker/Podman container  */
+/* Returns the memory usage of a Docker/Podman container, read from the
+   json 'chunk' returned by the stats API  */
 static int
-docker_container_memory (char *socket, const char *id,
+docker_container_memory (const chunk_t *chunk,
 			 long long unsigned int *memory, bool verbose)
 {
-  chunk_t chunk;
-  CURL *curl_handle = NULL;
-  CURLcode res;
   char *errmesg = NULL;
   int ret;
 
-  docker_init (&curl_handle, &chunk, socket);
-  res = docker_get (curl_handle, DOCKER_STATS_JSON, id);
-  if (CURLE_OK != res)
-    {
-      docker_close (curl_handle, &chunk);
-      plugin_error (STATE_UNKNOWN, errno, "%s", curl_easy_strerror (res));
-    }
-
-  assert (chunk.memory);
-  dbg ("%zu bytes retrieved\n", chunk.size);
-  dbg ("json data: %s", chunk.memory);
-
-#ifdef ENABLE_DEBUG
-  /*
-  char *dump;
-
-  json_dump_pretty (chunk.memory, &dump, 1);
-  dbg ("json data pretty formatted:%s", dump);
-  free (dump);
-  */
-#endif
+  assert (chunk->memory);
+  dbg ("%zu bytes retrieved\n", chunk->size);
+  dbg ("json data: %s", chunk->memory);
 
   /* get the memory usage  */
   char *value = NULL;
-  json_search (chunk.memory, ".memory_stats.usage", &value);
+  json_search (chunk->memory, ".memory_stats.usage", &value);
 
   /* FIXME: remove cast  */
   ret = sizetollint (value, (long long int *)memory, &errmesg);
@@ -381,6 +652,81 @@ docker_container_memory (char *socket, const char *id,
   return 0;
 }
 
+/* Returns the sum of the memory usage (in kB) of the 'n' containers listed
+   in 'ids'.  The Docker daemon takes a second or more to answer to each
+   stats query, so all the queries are sent at once through a curl multi
+   handle, which also keeps the connections to the socket open and reuses
+   them for the queries exceeding DOCKER_STATS_MAX_CONNECTIONS  */
+static void
+docker_containers_memory (const char *socket, char **ids, unsigned int n,
+			  long long unsigned int *memory, bool verbose)
+{
+  unsigned int j;
+  long long unsigned int memory_usage;
+  CURL **curl_handles;
+  CURLMsg *msg;
+  CURLM *multi_handle;
+  chunk_t *chunks;
+  int msgs_left, running = 0;
+  char **urls;
+
+  *memory = 0;
+  if (0 == n)
+    return;
+
+  multi_handle = curl_multi_init ();
+  if (NULL == multi_handle)
+    plugin_error (STATE_UNKNOWN, errno,
+		  "cannot start a libcurl multi session");
+  curl_multi_setopt (multi_handle, CURLMOPT_MAX_HOST_CONNECTIONS,
+		     (long) DOCKER_STATS_MAX_CONNECTIONS);
+
+  curl_handles = xnmalloc (n, sizeof (CURL *));
+  chunks = xnmalloc (n, sizeof (chunk_t));
+  urls = xnmalloc (n, sizeof (char *));
+
+  for (j = 0; j < n; j++)
+    {
+      curl_handles[j] = docker_easy_init (socket, &chunks[j]);
+      urls[j] = docker_url (DOCKER_STATS_JSON, ids[j]);
+      curl_easy_setopt (curl_handles[j], CURLOPT_URL, urls[j]);
+      curl_multi_add_handle (multi_handle, curl_handles[j]);
+    }
+
+  do
+    {
+      CURLMcode mc = curl_multi_perform (multi_handle, &running);
+      if (CURLM_OK == mc && running)
+	mc = curl_multi_wait (multi_handle, NULL, 0, 1000, NULL);
+      if (CURLM_OK != mc)
+	plugin_error (STATE_UNKNOWN, 0, "%s", curl_multi_strerror (mc));
+    }
+  while (running);
+
+  while ((msg = curl_multi_info_read (multi_handle, &msgs_left)))
+    if (CURLMSG_DONE == msg->msg && CURLE_OK != msg->data.result)
+      plugin_error (STATE_UNKNOWN, 0, "%s",
+		    curl_easy_strerror (msg->data.result));
+
+  for (j = 0; j < n; j++)
+    {
+      docker_container_memory (&chunks[j], &memory_usage, verbose);
+      dbg ("memory usage for container id \"%s\": %llu\" bytes\n", ids[j],
+	   memory_usage);
+      *memory += (memory_usage >> 10);
+
+      curl_multi_remove_handle (multi_handle, curl_handles[j]);
+      curl_easy_cleanup (curl_handles[j]);
+      free (chunks[j].memory);
+      free (urls[j]);
+    }
+
+  curl_multi_cleanup (multi_handle);
+  free (urls);
+  free (chunks);
+  free (curl_handles);
+}
+
 /* Returns the memory usage of running Docker/Podman containers  */
 
 int
@@ -390,10 +736,14 @@ docker_running_containers_memory (char *socket, long long unsigned int *memory,
   chunk_t chunk;
   CURL *curl_handle = NULL;
   hashtable_t *hashtable;
-  char *search_key = "Id";
+  long long unsigned int api_memory;
+  unsigned int n;
+  char *search_key = "Id", **ids;
+
+  socket = (char *) docker_socket (socket);
 
   /* get the list of running containers  */
-  docker_api_call (socket, &chunk, curl_handle, search_key, verbose);
+  docker_api_call (socket, &chunk, &curl_handle, search_key, verbose);
 
   hashtable =
     docker_json_parser_search (chunk.memory, search_key, NULL, 1);
@@ -403,24 +753,20 @@ docker_running_containers_memory (char *socket, long long unsigned int *memory,
   dbg ("number of docker containers: %u\n",
        counter_get_unique_elements (hashtable));
 
-  long long unsigned int memory_usage;
+  /* the memory usage is read from the cgroups of the containers, when
+     possible, and asked to the API only for the remaining ones  */
   *memory = 0;
+  ids = xnmalloc (hashtable->uniq ? hashtable->uniq : 1, sizeof (char *));
+  memcpy (ids, hashtable->keys, hashtable->uniq * sizeof (char *));
+  n = cgroup_containers_memory (PATH_SYS_CGROUP, ids, hashtable->uniq,
+				memory);
 
-  /* FIXME: this loop must be threaded and run in parallel  */
-  for (unsigned int j = 0; j < hashtable->uniq; j++)
-    {
-      const char *id = hashtable->keys[j];
-      docker_container_memory (socket, id, &memory_usage, verbose);
-      dbg ("memory usage for container id \"%s\": %llu\" bytes\n", id,
-	   memory_usage);
-      *memory += (memory_usage >> 10);
-    }
+  docker_containers_memory (socket, ids, n, &api_memory, verbose);
+  *memory += api_memory;
 
-  docker_close (
-#ifndef NPL_TESTING
-                 curl_handle,
-#endif
-                 &chunk);
+  free (ids);
+  counter_free (hashtable);
+  docker_close (curl_handle, &chunk);
 
   return 0;
 }
@@ -29,14 +29,17 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "atomicfile.h"
 #include "common.h"
 #include "cputopology.h"
+#include "logging.h"
 #include "string-macros.h"
 #include "messages.h"
 #include "procparser.h"
 #include "sysfsparser.h"
 #include "system.h"
 #include "xalloc.h"
+#include "xasprintf.h"
 
 #define PATH_PROC_CPUINFO	"/proc/cpuinfo"
 
@@ -104,25 +107,192 @@ cpu_desc_new (struct cpu_desc **cpudesc)
   return 0;
 }
 
-/* Fill the cpu_desc structure pointed with the values found in the
- * proc and sysfs filesystems  */
+/* Store the value of the cpuinfo 'line' in 'value' if the line begins
+ * with 'pattern'  */
 
-void
-cpu_desc_read (struct cpu_desc *cpudesc)
+static bool
+cpu_desc_lookup (char *line, char *pattern, char **value)
+{
+  char *v;
+
+  if (!linelookup (line, pattern, &v))
+    return false;
+
+  free (*value);
+  *value = v;
+  return true;
+}
+
+static bool
+cpu_desc_parse_line (struct cpu_desc *cpudesc, char *line)
+{
+  return cpu_desc_lookup (line, "vendor", &cpudesc->vendor)
+    || cpu_desc_lookup (line, "vendor_id", &cpudesc->vendor)
+    || cpu_desc_lookup (line, "family", &cpudesc->family)
+    || cpu_desc_lookup (line, "cpu family", &cpudesc->family)
+    || cpu_desc_lookup (line, "model", &cpudesc->model)
+    || cpu_desc_lookup (line, "model name", &cpudesc->modelname)
+    || cpu_desc_lookup (line, "flags", &cpudesc->flags);	/* x86 */
+}
+
+/* Parse the static fields of the first processor block of 'fp'.
+ * The other blocks repeat the same values, so there is no need to read
+ * the whole file, that on x86 also samples the frequency of every CPU */
+
+static void
+cpu_desc_parse (struct cpu_desc *cpudesc, FILE *fp)
 {
   char *line = NULL;
-  FILE *fp;
   size_t len = 0;
+  bool inblock = false;
+
+  while (getline (&line, &len, fp) != -1)
+    {
+      if (line[0] == '\n')
+	{
+	  if (inblock)
+	    break;
+	  continue;
+	}
+      inblock = true;
+      cpu_desc_parse_line (cpudesc, line);
+    }
+
+  free (line);
+}
+
+/* The descriptor can be saved in a cache file, which is valid until the
+ * next boot.  The file has the same format as /proc/cpuinfo, preceded by
+ * a version header and the boot id:
+ *
+ *   NPLCPUDESC <version>
+ *   boot_id : <boot id>
+ *   vendor_id : GenuineIntel
+ *   ...
+ */
+
+#define CPU_DESC_CACHE_MAGIC	"NPLCPUDESC"
+#define CPU_DESC_CACHE_VERSION	1U
+
+static bool
+cpu_desc_cache_load (struct cpu_desc *cpudesc, const char *cachefile,
+		     const char *boot_id)
+{
+  char *line = NULL, *id = NULL;
+  size_t len = 0;
+  unsigned int version;
+  bool valid;
+  FILE *fp;
+
+  if ((fp = fopen (cachefile, "re")) == NULL)
+    return false;
+
+  valid = getline (&line, &len, fp) > 0
+    && sscanf (line, CPU_DESC_CACHE_MAGIC " %u", &version) == 1
+    && version == CPU_DESC_CACHE_VERSION
+    && getline (&line, &len, fp) > 0
+    && linelookup (line, "boot_id", &id) && STREQ (id, boot_id);
+  if (valid)
+    cpu_desc_parse (cpudesc, fp);
+  else
+    dbg ("discarding the cpu description cache %s\n", cachefile);
+
+  free (id);
+  free (line);
+  fclose (fp);
+
+  return valid;
+}
+
+struct cpu_desc_cache_entry
+{
+  const struct cpu_desc *cpudesc;
+  const char *boot_id;
+};
+
+static int
+cpu_desc_cache_emit (FILE *fp, const void *data)
+{
+  const struct cpu_desc_cache_entry *entry = data;
+  const struct cpu_desc *cpudesc = entry->cpudesc;
+  const struct
+  {
+    const char *key;
+    const char *value;
+  } fields[] = {
+    { "vendor_id", cpudesc->vendor },
+    { "cpu family", cpudesc->family },
+    { "model", cpudesc->model },
+    { "model name", cpudesc->modelname },
+    { "flags", cpudesc->flags }
+  };
+  size_t i;
+
+  fprintf (fp, CPU_DESC_CACHE_MAGIC " %u\nboot_id\t: %s\n",
+	   CPU_DESC_CACHE_VERSION, entry->boot_id);
+  for (i = 0; i < sizeof (fields) / sizeof (fields[0]); i++)
+    if (fields[i].value)
+      fprintf (fp, "%s\t: %s\n", fields[i].key, fields[i].value);
+
+  return ferror (fp) ? -EIO : 0;
+}
+
+static int
+cpu_desc_cache_save (const struct cpu_desc *cpudesc, const char *cachefile,
+		     const char *boot_id)
+{
+  const struct cpu_desc_cache_entry entry = { cpudesc, boot_id };
+  return atomic_write_file (cachefile, cpu_desc_cache_emit, &entry);
+}
+
+/* Read the static fields from the cache file in 'cachedir', if any and
+ * still valid, or else from 'cpuinfo'  */
+
+static void
+cpu_desc_load (struct cpu_desc *cpudesc, const char *cpuinfo,
+	       const char *boot_id_path, const char *cachedir)
+{
+  char *boot_id = NULL, *cachefile = NULL;
+  FILE *fp;
+
+  if (cachedir && (boot_id = procparser_boot_id (boot_id_path)))
+    {
+      cachefile = xasprintf ("%s/cpudesc", cachedir);
+      if (cpu_desc_cache_load (cpudesc, cachefile, boot_id))
+	{
+	  free (cachefile);
+	  free (boot_id);
+	  return;
+	}
+    }
+
+  if ((fp = fopen (cpuinfo, "re")) == NULL)
+    plugin_error (STATE_UNKNOWN, errno, "error opening %s", cpuinfo);
+  cpu_desc_parse (cpudesc, fp);
+  fclose (fp);
+
+  if (cachefile && cpu_desc_cache_save (cpudesc, cachefile, boot_id) < 0)
+    dbg ("cannot write the cpu description cache %s\n", cachefile);
+
+  free (cachefile);
+  free (boot_id);
+}
+
+/* Fill the cpu_desc structure pointed with the values found in the
+ * proc and sysfs filesystems, or in the cache directory 'cachedir'
+ * when not NULL  */
+
+void
+cpu_desc_read_cached (struct cpu_desc *cpudesc, const char *cachedir)
+{
   struct utsname utsbuf;
 
   if (cpudesc == NULL)
     return;
 
-  if ((fp = fopen (PATH_PROC_CPUINFO,  "r")) == NULL)
-    plugin_error (STATE_UNKNOWN, errno, "error opening %s", PATH_PROC_CPUINFO);
-
   if (uname (&utsbuf) == -1)
     plugin_error (STATE_UNKNOWN, errno, "uname() failed");
+  free (cpudesc->arch);
   cpudesc->arch = xstrdup (utsbuf.machine);
 
   cpudesc->ncpus = get_processor_number_total ();
@@ -139,26 +309,16 @@ cpu_desc_read (struct cpu_desc *cpudesc)
   cpudesc->mode |= MODE_32BIT;
 #endif
 
-  while (getline (&line, &len, fp) != -1)
-    {
-      if (linelookup (line, "vendor", &cpudesc->vendor));
-      else if (linelookup (line, "vendor_id", &cpudesc->vendor));
-      else if (linelookup (line, "family", &cpudesc->family));
-      else if (linelookup (line, "cpu family", &cpudesc->family));
-      else if (linelookup (line, "model", &cpudesc->model));
-      else if (linelookup (line, "model name", &cpudesc->modelname)) ;
-      else if (linelookup (line, "cpu MHz", &cpudesc->mhz)) ;
-      else if (linelookup (line, "flags", &cpudesc->flags)) ;	/* x86 */
-      else
-	continue;
-    }
+  cpu_desc_load (cpudesc, PATH_PROC_CPUINFO, PATH_PROC_BOOT_ID, cachedir);
 
   if (cpudesc->flags)
     {
-      size_t buflen = strlen (cpudesc->flags) + 2;
+      size_t buflen = strlen (cpudesc->flags) + 3;
       char *buf = xmalloc (buflen);
 
       snprintf (buf, buflen, " %s ", cpudesc->flags);
+      free (cpudesc->virtflag);
+      cpudesc->virtflag = NULL;
       if (strstr (buf, " svm "))
         cpudesc->virtflag = xstrdup ("svm");
       else if (strstr (buf, " vmx "))
@@ -172,8 +332,12 @@ cpu_desc_read (struct cpu_desc *cpudesc)
 
       free (buf);
     }
+}
 
-  free (line);
+void
+cpu_desc_read (struct cpu_desc *cpudesc)
+{
+  cpu_desc_read_cached (cpudesc, NULL);
 }
 
 /* Drop a reference of the cpu_desc library context. If the refcount of
@@ -188,6 +352,14 @@ cpu_desc_unref (struct cpu_desc *cpudesc)
   if (cpudesc->refcount > 0)
     return cpudesc;
 
+  free (cpudesc->arch);
+  free (cpudesc->vendor);
+  free (cpudesc->family);
+  free (cpudesc->model);
+  free (cpudesc->modelname);
+  free (cpudesc->virtflag);
+  free (cpudesc->mhz);
+  free (cpudesc->flags);
   free (cpudesc);
   return NULL;
 }
@@ -237,9 +409,35 @@ cpu_desc_get_virtualization_flag (struct cpu_desc *cpudesc)
     return cpudesc->virtflag;
 }
 
+/* Get the frequency of the first CPU from 'cpuinfo'  */
+
+static char *
+cpu_desc_read_mhz (const char *cpuinfo)
+{
+  char *line = NULL, *mhz = NULL;
+  size_t len = 0;
+  FILE *fp;
+
+  if ((fp = fopen (cpuinfo, "re")) == NULL)
+    return NULL;
+
+  while (getline (&line, &len, fp) != -1)
+    if (line[0] == '\n' || linelookup (line, "cpu MHz", &mhz))
+      break;
+
+  free (line);
+  fclose (fp);
+
+  return mhz;
+}
+
+/* The frequency changes at run time: it is read again at each call */
+
 char *
 cpu_desc_get_mhz (struct cpu_desc *cpudesc)
 {
+  free (cpudesc->mhz);
+  cpudesc->mhz = cpu_desc_read_mhz (PATH_PROC_CPUINFO);
   return cpudesc->mhz;
 }
 
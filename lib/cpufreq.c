@@ -19,12 +19,16 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "common.h"
 #include "cpufreq.h"
+#include "cputopology.h"
+#include "logging.h"
 #include "sysfsparser.h"
 #include "xalloc.h"
 #include "xasprintf.h"
@@ -131,6 +135,214 @@ cpufreq_get_available_governors (unsigned int cpu)
   return sysfsparser_cpufreq_get_available_governors (cpu);
 }
 
+/* The CPUs of a frequency domain share the same cpufreq policy: on Linux
+ * 4.3+ /sys/devices/system/cpu/cpu<N>/cpufreq is a link to
+ * /sys/devices/system/cpu/cpufreq/policy<M>, and 'related_cpus' lists all
+ * the CPUs (online or offline) of the domain.  The CPUs are scanned in
+ * order and the CPUs already covered by a policy are skipped, so the
+ * attributes of each policy are read only once.  */
+
+static unsigned int
+cpufreq_policy_id (const char *syscpu, unsigned int cpu)
+{
+  char path[PATH_MAX], link[PATH_MAX], *name;
+  unsigned int id;
+  ssize_t len;
+
+  snprintf (path, PATH_MAX, "%s/cpu%u/cpufreq", syscpu, cpu);
+  if ((len = readlink (path, link, sizeof (link) - 1)) < 0)
+    return cpu;		/* kernels older than 4.3 */
+  link[len] = '\0';
+
+  name = strrchr (link, '/');
+  if (sscanf (name ? name + 1 : link, "policy%u", &id) != 1)
+    return cpu;
+
+  return id;
+}
+
+/* Mark the CPUs listed in 'related_cpus' (a space separated list of CPU
+ * numbers) as covered, and return how many there are */
+static unsigned int
+cpufreq_mark_related_cpus (const char *related_cpus, bool *covered,
+			   unsigned int ncpus)
+{
+  const char *str = related_cpus;
+  unsigned int nrelated = 0;
+  char *endptr;
+
+  for (;;)
+    {
+      unsigned long cpu = strtoul (str, &endptr, 10);
+      if (endptr == str)
+	break;
+      if (cpu < ncpus)
+	covered[cpu] = true;
+      nrelated++;
+      str = endptr;
+    }
+
+  return nrelated;
+}
+
+static struct cpufreq_policy *
+cpufreq_read_policies (const char *syscpu, unsigned int ncpus,
+		       unsigned int *npolicies)
+{
+  struct cpufreq_policy *policies = NULL;
+  bool *covered = xnmalloc (ncpus ? ncpus : 1, sizeof (bool));
+  unsigned int cpu, n = 0;
+
+  for (cpu = 0; cpu < ncpus; cpu++)
+    {
+      struct sysfsparser_attr freqs[] = {
+	{ .name = "cpuinfo_min_freq" },
+	{ .name = "cpuinfo_max_freq" },
+	{ .name = "scaling_cur_freq" }
+      };
+      struct cpufreq_policy *policy;
+      char related_cpus[4096];
+      int dirfd;
+
+      if (covered[cpu])
+	continue;
+      covered[cpu] = true;
+
+      if ((dirfd = sysfsparser_opendirfd ("%s/cpu%u/cpufreq", syscpu,
+					  cpu)) < 0)
+	continue;
+
+      if ((n & (n - 1)) == 0)
+	policies = xrealloc (policies, (n ? 2 * n : 1) * sizeof (*policies));
+      policy = &policies[n++];
+
+      policy->id = cpufreq_policy_id (syscpu, cpu);
+      policy->cpu = cpu;
+      policy->ncpus = 1;
+      if (sysfsparser_read_at (dirfd, "related_cpus", related_cpus,
+			       sizeof related_cpus) > 0)
+	policy->ncpus =
+	  cpufreq_mark_related_cpus (related_cpus, covered, ncpus);
+
+      sysfsparser_getvalues_at (dirfd, freqs, 3);
+      policy->freq_min = freqs[0].value;
+      policy->freq_max = freqs[1].value;
+      policy->freq_kernel = freqs[2].value;
+
+      dbg ("cpufreq policy%u: cpu%u, %u cpu(s), %lu kHz (%lu-%lu kHz)\n",
+	   policy->id, cpu, policy->ncpus, policy->freq_kernel,
+	   policy->freq_min, policy->freq_max);
+    }
+
+  free (covered);
+  *npolicies = n;
+
+  return policies;
+}
+
+struct cpufreq_policy *
+cpufreq_get_policies (unsigned int ncpus, unsigned int *npolicies)
+{
+  return cpufreq_read_policies (PATH_SYS "/devices/system/cpu", ncpus,
+				npolicies);
+}
+
+void
+cpufreq_policies_free (struct cpufreq_policy *policies)
+{
+  free (policies);
+}
+
+/* cpufreq/stats/time_in_state lists the time spent by the policy at each
+ * frequency, one "<frequency (kHz)> <time (10ms)>" pair per line */
+
+static int
+cpufreq_read_time_in_state (const char *syscpu, unsigned int cpu,
+			    unsigned long freq, unsigned long long *below,
+			    unsigned long long *total)
+{
+  char buf[4096], *line, *saveptr;
+  bool found = false;
+  int dirfd;
+
+  *below = *total = 0;
+  if ((dirfd = sysfsparser_opendirfd ("%s/cpu%u/cpufreq/stats", syscpu,
+				      cpu)) < 0
+      || sysfsparser_read_at (dirfd, "time_in_state", buf, sizeof buf) < 1)
+    return -ENODEV;
+
+  for (line = strtok_r (buf, "\n", &saveptr); line;
+       line = strtok_r (NULL, "\n", &saveptr))
+    {
+      unsigned long state_freq;
+      unsigned long long state_time;
+
+      if (sscanf (line, "%lu %llu", &state_freq, &state_time) != 2)
+	continue;
+      found = true;
+      *total += state_time;
+      if (state_freq < freq)
+	*below += state_time;
+    }
+
+  return found ? 0 : -ENODEV;
+}
+
+int
+cpufreq_get_time_in_state (unsigned int cpu, unsigned long freq,
+			   unsigned long long *below,
+			   unsigned long long *total)
+{
+  return cpufreq_read_time_in_state (PATH_SYS "/devices/system/cpu", cpu,
+				     freq, below, total);
+}
+
+/* The x86 thermal_throttle counters: the core counter is shared by the
+ * hyperthreads of a core, the package counter by all the CPUs of the
+ * package */
+
+static int
+cpufreq_read_throttle (const char *syscpu, unsigned int cpu,
+		       struct cpufreq_throttle *throttle)
+{
+  struct sysfsparser_attr counts[] = {
+    { .name = "core_throttle_count" },
+    { .name = "package_throttle_count" }
+  };
+  int dirfd;
+
+  if ((dirfd = sysfsparser_opendirfd ("%s/cpu%u/thermal_throttle", syscpu,
+				      cpu)) < 0
+      || sysfsparser_getvalues_at (dirfd, counts, 2) == 0)
+    return -ENODEV;
+
+  throttle->core_count = counts[0].value;
+  throttle->package_count = counts[1].value;
+  throttle->has_package_count = (counts[1].err == 0);
+  throttle->package_id = 0;
+
+  return 0;
+}
+
+int
+cpufreq_get_throttle (unsigned int cpu, struct cpufreq_throttle *throttle)
+{
+  int err, package_id;
+
+  err = cpufreq_read_throttle (PATH_SYS "/devices/system/cpu", cpu,
+			       throttle);
+  if (err < 0)
+    return err;
+
+  /* the package of the CPU is taken from the topology model */
+  if ((package_id = get_cputopology_package_id (cpu)) < 0)
+    throttle->has_package_count = false;
+  else
+    throttle->package_id = package_id;
+
+  return 0;
+}
+
 char *
 cpufreq_freq_to_string (unsigned long freq)
 {
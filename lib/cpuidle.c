@@ -0,0 +1,72 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A library for reading the CPU idle states statistics
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The statistics of the idle states are exported by the kernel in
+ * /sys/devices/system/cpu/cpu<N>/cpuidle/state<M>:
+ *    |---name:     the name of the state (POLL, C1, C6, ...)
+ *    |---latency:  the exit latency (us)
+ *    |---time:     the time spent in the state since boot (us)
+ *    |---usage:    the number of times the state has been entered
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "cpuidle.h"
+#include "sysfsparser.h"
+
+static int
+cpuidle_read_states (const char *syscpu, unsigned int cpu,
+		     struct cpuidle_state *states)
+{
+  unsigned int n;
+
+  for (n = 0; n < CPUIDLE_STATES_MAX; n++)
+    {
+      struct sysfsparser_attr attrs[] = {
+	{ .name = "latency" },
+	{ .name = "time" },
+	{ .name = "usage" }
+      };
+      int dirfd;
+
+      if ((dirfd = sysfsparser_opendirfd ("%s/cpu%u/cpuidle/state%u",
+					  syscpu, cpu, n)) < 0)
+	break;
+
+      if (sysfsparser_read_at (dirfd, "name", states[n].name,
+			       sizeof (states[n].name)) < 1)
+	snprintf (states[n].name, sizeof (states[n].name), "state%u", n);
+
+      sysfsparser_getvalues_at (dirfd, attrs, 3);
+      states[n].latency = attrs[0].value;
+      states[n].time = attrs[1].value;
+      states[n].usage = attrs[2].value;
+    }
+
+  return (n > 0) ? (int) n : -ENODEV;
+}
+
+int
+cpuidle_get_states (unsigned int cpu, struct cpuidle_state *states)
+{
+  return cpuidle_read_states (PATH_SYS "/devices/system/cpu", cpu, states);
+}
@@ -32,15 +32,23 @@
 
 #include <sys/sysinfo.h>
 
-#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
 #include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "atomicfile.h"
 #include "common.h"
 #include "cputopology.h"
+#include "logging.h"
+#include "procparser.h"
+#include "string-macros.h"
 #include "sysfsparser.h"
+#include "xalloc.h"
+#include "xasprintf.h"
 
 #define PATH_SYS_SYSTEM		PATH_SYS "/devices/system"
 #define PATH_SYS_CPU		PATH_SYS_SYSTEM "/cpu"
@@ -129,119 +137,496 @@ get_processor_number_kernel_max ()
   return value + 1;
 }
 
-static inline int
-char_to_val (int c)
+static unsigned int *
+cpulist_parse (const char *str, unsigned int *ncpus)
 {
-  int cl;
+  unsigned int *cpus = NULL, n = 0;
+  char *endptr;
 
-  cl = tolower (c);
-  if (c >= '0' && c <= '9')
-    return c - '0';
-  else if (cl >= 'a' && cl <= 'f')
-    return cl + (10 - 'a');
-  else
-    return -1;
+  while (*str)
+    {
+      unsigned long first, last, cpu;
+
+      first = last = strtoul (str, &endptr, 10);
+      if (endptr == str)
+	break;
+      if (*endptr == '-')
+	{
+	  str = endptr + 1;
+	  last = strtoul (str, &endptr, 10);
+	  if (endptr == str || last < first)
+	    break;
+	}
+      for (cpu = first; cpu <= last && cpu <= INT_MAX; cpu++)
+	{
+	  if ((n & (n - 1)) == 0)
+	    cpus = xrealloc (cpus, (n ? 2 * n : 1) * sizeof (unsigned int));
+	  cpus[n++] = cpu;
+	}
+      str = endptr;
+      if (*str == ',')
+	str++;
+    }
+
+  *ncpus = n;
+  return cpus;
 }
 
-/* Parses string with CPUs mask and return the number of CPUs present. */
+static unsigned int
+cpulist_weight (const char *str)
+{
+  unsigned int n, *cpus = cpulist_parse (str, &n);
+  free (cpus);
+  return n;
+}
 
 static int
-cpumask_parse (const char *str, cpu_set_t *set, size_t setsize)
+cputopology_cpu_cmp (const void *key, const void *elem)
 {
-  const char *ptr;
-  int len, cpu = 0;
+  unsigned int cpu = *(const unsigned int *) key;
+  const struct cputopology_cpu *c = elem;
+  return (cpu > c->cpu) - (cpu < c->cpu);
+}
 
-  if (!str)
-    return -1;
+const struct cputopology_cpu *
+cputopology_get_cpu (const struct cputopology *topology, unsigned int cpu)
+{
+  return bsearch (&cpu, topology->cpus, topology->ncpus,
+		  sizeof (struct cputopology_cpu), cputopology_cpu_cmp);
+}
 
-  len = strlen (str);
-  ptr = str + len - 1;
+static int
+ullcmp (const void *a, const void *b)
+{
+  unsigned long long x = *(const unsigned long long *) a,
+		     y = *(const unsigned long long *) b;
+  return (x > y) - (x < y);
+}
 
-  /* skip 0x, it's all hex anyway */
-  if (len > 1 && !memcmp (str, "0x", 2L))
-    str += 2;
+/* Number of distinct values among the first 'n' items of 'keys' */
+static unsigned int
+count_distinct (unsigned long long *keys, unsigned int n)
+{
+  unsigned int i, ndistinct = 0;
 
-  CPU_ZERO_S (setsize, set);
+  qsort (keys, n, sizeof (unsigned long long), ullcmp);
+  for (i = 0; i < n; i++)
+    if (i == 0 || keys[i] != keys[i - 1])
+      ndistinct++;
 
-  while (ptr >= str)
+  return ndistinct;
+}
+
+#define TOPOLOGY_KEY(a, b, c)  \
+  (((unsigned long long) ((a) + 1) << 42) \
+   | ((unsigned long long) ((b) + 1) << 21) | (unsigned long long) ((c) + 1))
+
+/* Compute the counters of the topology from the CPUs and caches */
+static void
+cputopology_summarize (struct cputopology *topology)
+{
+  unsigned long long *keys =
+    xnmalloc (topology->ncpus ? topology->ncpus : 1,
+	      sizeof (unsigned long long));
+  unsigned int i, n;
+
+  topology->nonline = 0;
+  for (i = 0, n = 0; i < topology->ncpus; i++)
     {
-      char val;
-
-      /* cpu masks in /sys uses comma as a separator */
-      if (*ptr == ',')
-	ptr--;
-
-      val = char_to_val (*ptr);
-      if (val == (char) -1)
-	return -1;
-      if (val & 1)
-	CPU_SET_S (cpu, setsize, set);
-      if (val & 2)
-	CPU_SET_S (cpu + 1, setsize, set);
-      if (val & 4)
-	CPU_SET_S (cpu + 2, setsize, set);
-      if (val & 8)
-	CPU_SET_S (cpu + 3, setsize, set);
-      ptr--;
-      cpu += 4;
+      const struct cputopology_cpu *cpu = &topology->cpus[i];
+      topology->nonline += cpu->online;
+      if (cpu->core_id >= 0)
+	keys[n++] = TOPOLOGY_KEY (cpu->package_id, cpu->die_id, cpu->core_id);
     }
+  topology->ncores = count_distinct (keys, n);
+  topology->threads_per_core =
+    topology->ncores ? (n + topology->ncores - 1) / topology->ncores : 1;
+
+  for (i = 0, n = 0; i < topology->ncpus; i++)
+    if (topology->cpus[i].core_id >= 0)
+      keys[n++] = TOPOLOGY_KEY (topology->cpus[i].package_id,
+				topology->cpus[i].die_id, 0);
+  topology->ndies = count_distinct (keys, n);
+
+  for (i = 0, n = 0; i < topology->ncpus; i++)
+    if (topology->cpus[i].package_id >= 0)
+      keys[n++] = topology->cpus[i].package_id;
+  topology->npackages = count_distinct (keys, n);
+
+  for (i = 0, n = 0; i < topology->ncpus; i++)
+    if (topology->cpus[i].node >= 0)
+      keys[n++] = topology->cpus[i].node;
+  topology->nnodes = count_distinct (keys, n);
+
+  if (topology->ncores == 0)
+    topology->ncores = 1;
+  if (topology->npackages == 0)
+    topology->npackages = 1;
+  if (topology->ndies == 0)
+    topology->ndies = 1;
+  topology->cores_per_socket =
+    (topology->ncores + topology->npackages - 1) / topology->npackages;
+
+  free (keys);
+}
+
+/* Mark the CPUs listed in the file 'name' of the directory 'dirfd' */
+static void
+cputopology_mark_cpus (struct cputopology *topology, int dirfd,
+		       const char *name, int node)
+{
+  char buf[4096];
+  unsigned int i, n, *cpus;
 
-  return CPU_COUNT_S (setsize, set);
+  if (dirfd < 0 || sysfsparser_read_at (dirfd, name, buf, sizeof buf) < 1)
+    return;
+
+  cpus = cpulist_parse (buf, &n);
+  for (i = 0; i < n; i++)
+    {
+      struct cputopology_cpu *cpu = (struct cputopology_cpu *)
+	cputopology_get_cpu (topology, cpus[i]);
+      if (NULL == cpu)
+	continue;
+      if (node < 0)
+	cpu->online = true;
+      else
+	cpu->node = node;
+    }
+  free (cpus);
 }
 
-/* Get the number of threads within one core */
+static void
+cputopology_read_caches (struct cputopology *topology, const char *syssystem)
+{
+  unsigned int index;
+
+  topology->ncaches = 0;
+  if (topology->ncpus == 0)
+    return;
 
-void
-get_cputopology_read (unsigned int *nsockets, unsigned int *ncores,
-		      unsigned int *nthreads)
+  for (index = 0; index < CPUTOPOLOGY_CACHES_MAX; index++)
+    {
+      struct cputopology_cache *cache = &topology->caches[topology->ncaches];
+      char buf[4096];
+      unsigned long long level;
+      unsigned int nshared;
+      int dirfd;
+
+      dirfd = sysfsparser_opendirfd ("%s/cpu/cpu%u/cache/index%u", syssystem,
+				     topology->cpus[0].cpu, index);
+      if (dirfd < 0)
+	break;
+
+      if (sysfsparser_getvalue_at (dirfd, "level", &level) < 0
+	  || sysfsparser_read_at (dirfd, "type", cache->type,
+				  sizeof (cache->type)) < 1)
+	continue;
+      cache->level = level;
+      cache->size = 0;
+      if (sysfsparser_read_at (dirfd, "size", buf, sizeof buf) > 0)
+	cache->size = strtoul (buf, NULL, 10);	/* "32K" */
+
+      nshared = 1;
+      if (sysfsparser_read_at (dirfd, "shared_cpu_list", buf, sizeof buf) > 0)
+	nshared = cpulist_weight (buf);
+      if (nshared == 0)
+	nshared = 1;
+      cache->ninstances = (topology->ncpus + nshared - 1) / nshared;
+
+      topology->ncaches++;
+    }
+}
+
+/* Build the topology of the present CPUs.  'syssystem' is the path of
+ * /sys/devices/system */
+static struct cputopology *
+cputopology_build (const char *syssystem)
 {
-  cpu_set_t *set;
-  size_t cpu,	/* most 32 bit architectures use "unsigned int" size_t,
-		 * and all 64 bit architectures use "unsigned long" size_t */
-	 maxcpus, setsize = 0;
+  struct cputopology *topology = xmalloc (sizeof (struct cputopology));
+  unsigned int i, n, *present;
+  char buf[4096];
+  DIR *dirp;
+  int dirfd;
+
+  dirfd = sysfsparser_opendirfd ("%s/cpu", syssystem);
+  if (dirfd < 0
+      || sysfsparser_read_at (dirfd, "present", buf, sizeof buf) < 1)
+    snprintf (buf, sizeof buf, "0-%d",
+	      (get_processor_number_total () > 0)
+	      ? get_processor_number_total () - 1 : 0);
+
+  present = cpulist_parse (buf, &n);
+  topology->ncpus = n;
+  topology->cpus = xnmalloc (n ? n : 1, sizeof (struct cputopology_cpu));
+
+  for (i = 0; i < n; i++)
+    {
+      struct cputopology_cpu *cpu = &topology->cpus[i];
+      struct sysfsparser_attr ids[] = {
+	{ .name = "physical_package_id" },
+	{ .name = "die_id" },
+	{ .name = "core_id" }
+      };
+      int topofd;
+
+      cpu->cpu = present[i];
+      cpu->package_id = cpu->die_id = cpu->core_id = cpu->node = -1;
+      cpu->online = false;
+
+      topofd = sysfsparser_opendirfd ("%s/cpu/cpu%u/topology", syssystem,
+				      cpu->cpu);
+      if (topofd < 0)
+	continue;
 
-  *nsockets = *ncores = *nthreads = 1;
-  maxcpus = get_processor_number_kernel_max ();
+      /* the ids of the offline CPUs are -1 */
+      sysfsparser_getvalues_at (topofd, ids, 3);
+      if (ids[0].err == 0 && ids[0].value <= INT_MAX)
+	cpu->package_id = ids[0].value;
+      cpu->die_id = (ids[1].err == 0 && ids[1].value <= INT_MAX)
+	? (int) ids[1].value : 0;
+      if (ids[2].err == 0 && ids[2].value <= INT_MAX)
+	cpu->core_id = ids[2].value;
+    }
+  free (present);
 
-  if (!(set = CPU_ALLOC (maxcpus)))
-    return;
-  setsize = CPU_ALLOC_SIZE (maxcpus);
+  /* the directory fd may have been recycled by the per-CPU lookups */
+  dirfd = sysfsparser_opendirfd ("%s/cpu", syssystem);
 
-  for (cpu = 0; cpu < maxcpus; cpu++)
+  /* the kernel does not list the online CPUs when none is hotpluggable */
+  if (dirfd >= 0
+      && sysfsparser_read_at (dirfd, "online", buf, sizeof buf) > 0)
+    cputopology_mark_cpus (topology, dirfd, "online", -1);
+  else
+    for (i = 0; i < topology->ncpus; i++)
+      topology->cpus[i].online = true;
+
+  snprintf (buf, sizeof buf, "%s/node", syssystem);
+  if ((dirp = opendir (buf)) != NULL)
     {
-      /* thread_siblings: internal kernel map of cpu#'s hardware threads
-       * within the same core as cpu#   */
-      char *thread_siblings =
-	sysfsparser_getline (PATH_SYS_CPU "/cpu%lu/topology/thread_siblings",
-			     (unsigned long)cpu);
-      if (!thread_siblings)
-        continue;
-
-      /* threads within one core */
-      *nthreads = cpumask_parse (thread_siblings, set, setsize);
-      if (*nthreads == 0)
-	*nthreads = 1;
-
-      /* core_siblings: internal kernel map of cpu#'s hardware threads
-       * within the same physical_package_id.  */
-      char *core_siblings =
-	sysfsparser_getline (PATH_SYS_CPU "/cpu%lu/topology/core_siblings",
-			     (unsigned long)cpu);
-      /* cores within one socket */
-      *ncores = cpumask_parse (core_siblings, set, setsize) / *nthreads;
-      if (*ncores == 0)
-	*ncores = 1;
-
-      int ncpus_online = get_processor_number_online ();
-      unsigned int ncpus = ncpus_online > 0 ? ncpus_online : 0;
-
-      *nsockets = ncpus / *nthreads / *ncores;
-      if (!*nsockets)
-	*nsockets = 1;
-
-      free (core_siblings);
-      free (thread_siblings);
+      struct dirent *dp;
+      while ((dp = readdir (dirp)))
+	{
+	  unsigned int node;
+	  char c;
+	  if (sscanf (dp->d_name, "node%u%c", &node, &c) != 1
+	      || node > INT_MAX)
+	    continue;
+	  cputopology_mark_cpus (topology,
+				 sysfsparser_opendirfd ("%s/node/%s",
+							syssystem,
+							dp->d_name),
+				 "cpulist", node);
+	}
+      closedir (dirp);
     }
 
-  CPU_FREE (set);
+  cputopology_read_caches (topology, syssystem);
+  cputopology_summarize (topology);
+
+  return topology;
+}
+
+static void
+cputopology_free (struct cputopology *topology)
+{
+  if (topology)
+    free (topology->cpus);
+  free (topology);
+}
+
+/* The topology can be saved in a cache file, which is valid until the
+ * next boot or CPU hotplug event.  The kernel has no hotplug generation
+ * counter, so the lists of the present and online CPUs are used as
+ * the key, together with the boot id.  */
+
+#define CPUTOPOLOGY_CACHE_MAGIC	"NPLTOPO"
+#define CPUTOPOLOGY_CACHE_VERSION	1U
+
+static char *
+cputopology_cache_key (const char *syssystem, const char *boot_id_path)
+{
+  char present[4096], online[4096], *boot_id, *key;
+  int dirfd;
+
+  dirfd = sysfsparser_opendirfd ("%s/cpu", syssystem);
+  if (dirfd < 0
+      || sysfsparser_read_at (dirfd, "present", present, sizeof present) < 1)
+    return NULL;
+  if (sysfsparser_read_at (dirfd, "online", online, sizeof online) < 1)
+    online[0] = '\0';
+
+  if ((boot_id = procparser_boot_id (boot_id_path)) == NULL)
+    return NULL;
+  key = xasprintf ("%s %s %s", boot_id, present, online);
+  free (boot_id);
+
+  return key;
+}
+
+static struct cputopology *
+cputopology_cache_load (const char *cachefile, const char *key)
+{
+  struct cputopology *topology;
+  char *line = NULL;
+  size_t len = 0, ncpus = 0;
+  unsigned int version;
+  ssize_t nread;
+  bool valid;
+  FILE *fp;
+
+  if ((fp = fopen (cachefile, "re")) == NULL)
+    return NULL;
+
+  topology = xmalloc (sizeof (struct cputopology));
+  valid = false;
+  if (getline (&line, &len, fp) > 0
+      && sscanf (line, CPUTOPOLOGY_CACHE_MAGIC " %u", &version) == 1
+      && version == CPUTOPOLOGY_CACHE_VERSION
+      && (nread = getline (&line, &len, fp)) > 0)
+    {
+      if (line[nread - 1] == '\n')
+	line[nread - 1] = '\0';
+      valid = STREQ (line, key)
+	&& getline (&line, &len, fp) > 0
+	&& sscanf (line, "%zu", &ncpus) == 1 && ncpus > 0 && ncpus < INT_MAX;
+    }
+
+  if (valid)
+    {
+      topology->cpus = xnmalloc (ncpus, sizeof (struct cputopology_cpu));
+      while (valid && topology->ncpus < ncpus
+	     && getline (&line, &len, fp) > 0)
+	{
+	  struct cputopology_cpu *cpu = &topology->cpus[topology->ncpus++];
+	  int online;
+	  valid = (sscanf (line, "cpu %u %d %d %d %d %d", &cpu->cpu,
+			   &cpu->package_id, &cpu->die_id, &cpu->core_id,
+			   &cpu->node, &online) == 6)
+	    /* the cpus are looked up with bsearch() */
+	    && (topology->ncpus == 1 || cpu[-1].cpu < cpu->cpu);
+	  cpu->online = online;
+	}
+      valid = valid && topology->ncpus == ncpus;
+
+      while (valid && topology->ncaches < CPUTOPOLOGY_CACHES_MAX
+	     && getline (&line, &len, fp) > 0)
+	{
+	  struct cputopology_cache *cache =
+	    &topology->caches[topology->ncaches++];
+	  valid = (sscanf (line, "cache %u %15s %lu %u", &cache->level,
+			   cache->type, &cache->size,
+			   &cache->ninstances) == 4);
+	}
+    }
+
+  free (line);
+  fclose (fp);
+
+  if (!valid)
+    {
+      dbg ("discarding the topology cache %s\n", cachefile);
+      cputopology_free (topology);
+      return NULL;
+    }
+
+  cputopology_summarize (topology);
+  return topology;
+}
+
+struct cputopology_cache_entry
+{
+  const char *key;
+  const struct cputopology *topology;
+};
+
+static int
+cputopology_cache_emit (FILE *fp, const void *data)
+{
+  const struct cputopology_cache_entry *entry = data;
+  const struct cputopology *topology = entry->topology;
+  unsigned int i;
+
+  fprintf (fp, CPUTOPOLOGY_CACHE_MAGIC " %u\n%s\n%u\n",
+	   CPUTOPOLOGY_CACHE_VERSION, entry->key, topology->ncpus);
+  for (i = 0; i < topology->ncpus; i++)
+    {
+      const struct cputopology_cpu *cpu = &topology->cpus[i];
+      fprintf (fp, "cpu %u %d %d %d %d %d\n", cpu->cpu, cpu->package_id,
+	       cpu->die_id, cpu->core_id, cpu->node, cpu->online);
+    }
+  for (i = 0; i < topology->ncaches; i++)
+    fprintf (fp, "cache %u %s %lu %u\n", topology->caches[i].level,
+	     topology->caches[i].type, topology->caches[i].size,
+	     topology->caches[i].ninstances);
+
+  return ferror (fp) ? -EIO : 0;
+}
+
+static int
+cputopology_cache_save (const char *cachefile, const char *key,
+			const struct cputopology *topology)
+{
+  const struct cputopology_cache_entry entry = { key, topology };
+  return atomic_write_file (cachefile, cputopology_cache_emit, &entry);
+}
+
+static struct cputopology *
+cputopology_load (const char *syssystem, const char *boot_id_path,
+		  const char *cachedir)
+{
+  struct cputopology *topology = NULL;
+  char *cachefile = NULL, *key = NULL;
+
+  if (cachedir && (key = cputopology_cache_key (syssystem, boot_id_path)))
+    {
+      cachefile = xasprintf ("%s/cputopology", cachedir);
+      topology = cputopology_cache_load (cachefile, key);
+    }
+
+  if (NULL == topology)
+    {
+      topology = cputopology_build (syssystem);
+      if (cachefile && cputopology_cache_save (cachefile, key, topology) < 0)
+	dbg ("cannot write the topology cache %s\n", cachefile);
+    }
+
+  free (cachefile);
+  free (key);
+
+  return topology;
+}
+
+static struct cputopology *topology_model;
+
+const struct cputopology *
+cputopology_read (const char *cachedir)
+{
+  if (NULL == topology_model)
+    topology_model = cputopology_load (PATH_SYS_SYSTEM, PATH_PROC_BOOT_ID,
+				       cachedir);
+  return topology_model;
+}
+
+/* Get the physical socket of the cpu, or -1 if unknown. */
+
+int
+get_cputopology_package_id (unsigned int cpu)
+{
+  const struct cputopology_cpu *c =
+    cputopology_get_cpu (cputopology_read (NULL), cpu);
+  return c ? c->package_id : -1;
+}
+
+/* Get the number of sockets, cores per socket, and threads per core */
+
+void
+get_cputopology_read (unsigned int *nsockets, unsigned int *ncores,
+		      unsigned int *nthreads)
+{
+  const struct cputopology *topology = cputopology_read (NULL);
+
+  *nsockets = topology->npackages;
+  *ncores = topology->cores_per_socket;
+  *nthreads = topology->threads_per_core;
 }
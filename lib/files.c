@@ -3,7 +3,7 @@
  * License: GPLv3+
  * Copyright (c) 2022 Davide Madrisan <davide.madrisan@gmail.com>
  *
- * A library for checking the Linux Pressure Stall Information (PSI)
+ * A library for counting the files found in a directory tree
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -18,16 +18,28 @@
  * You should have received a copy of the GNU General Public License
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.  */
 
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE /* activate extra prototypes for glibc */
+#endif
+
 #include <errno.h>
 #include <dirent.h>
+#include <fcntl.h>
 #include <fnmatch.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
+#include <sys/sysmacros.h>
+#ifdef HAVE_LIBURING
+# include <liburing.h>
+#endif
 
 #include "files.h"
 #include "logging.h"
@@ -37,8 +49,6 @@
 #include "xalloc.h"
 #include "xasprintf.h"
 
-static int deep = 0;
-
 static void
 files_data_init (struct files_types **filecount)
 {
@@ -46,21 +56,178 @@ files_data_init (struct files_types **filecount)
     {
       struct files_types *t;
       t = xmalloc (sizeof (struct files_types));
+      memset (t, 0, sizeof (struct files_types));
       *filecount = t;
     }
 }
 
-static int
-files_filematch (const char *pattern, const char *name)
+/* The name patterns are compiled once.  Most of them are plain names,
+ * prefixes ("myapp-*"), suffixes ("*.log") or substrings ("*core*"), that
+ * are matched with a memory comparison; fnmatch() is only called for the
+ * other wildcards.  */
+
+enum files_pattern_kind
+{
+  FILES_PATTERN_ANY,		/* "*" */
+  FILES_PATTERN_LITERAL,
+  FILES_PATTERN_PREFIX,
+  FILES_PATTERN_SUFFIX,
+  FILES_PATTERN_SUBSTRING,
+  FILES_PATTERN_GLOB
+};
+
+struct files_pattern
+{
+  enum files_pattern_kind kind;
+  const char *pattern;		/* the pattern, for fnmatch() */
+  char *literal;		/* the pattern without the wildcards */
+  size_t len;
+};
+
+struct files_matcher
+{
+  unsigned int ninclude, nexclude;
+  struct files_pattern *include;
+  struct files_pattern *exclude;
+};
+
+static bool
+files_has_wildcards (const char *str, size_t len)
+{
+  size_t i;
+
+  for (i = 0; i < len; i++)
+    if (str[i] == '*' || str[i] == '?' || str[i] == '[' || str[i] == '\\')
+      return true;
+
+  return false;
+}
+
+static void
+files_pattern_compile (struct files_pattern *p, const char *pattern)
 {
-  if (pattern != NULL)
+  size_t len = strlen (pattern);
+  bool star_head = (len > 0 && pattern[0] == '*'),
+       star_tail = (len > 1 && pattern[len - 1] == '*');
+  const char *body = pattern + star_head;
+  size_t body_len = len - star_head - star_tail;
+
+  p->pattern = pattern;
+  p->literal = NULL;
+  p->len = 0;
+
+  if (files_has_wildcards (body, body_len))
+    p->kind = FILES_PATTERN_GLOB;
+  else if (star_head && 0 == body_len)
+    p->kind = FILES_PATTERN_ANY;
+  else
     {
-      int status = fnmatch (pattern, name, /* flags = */ 0);
-      if (status != 0)
-	return FNM_NOMATCH;
+      p->kind = star_head ? (star_tail ? FILES_PATTERN_SUBSTRING
+					: FILES_PATTERN_SUFFIX)
+			  : (star_tail ? FILES_PATTERN_PREFIX
+				       : FILES_PATTERN_LITERAL);
+      p->literal = xsubstrdup (body, body_len);
+      p->len = body_len;
     }
+}
 
-  return 0;
+static inline bool
+files_pattern_match (const struct files_pattern *p, const char *name,
+		     size_t namelen)
+{
+  switch (p->kind)
+    {
+    case FILES_PATTERN_ANY:
+      return true;
+    case FILES_PATTERN_LITERAL:
+      return namelen == p->len && 0 == memcmp (name, p->literal, p->len);
+    case FILES_PATTERN_PREFIX:
+      return namelen >= p->len && 0 == memcmp (name, p->literal, p->len);
+    case FILES_PATTERN_SUFFIX:
+      return namelen >= p->len
+	&& 0 == memcmp (name + namelen - p->len, p->literal, p->len);
+    case FILES_PATTERN_SUBSTRING:
+      return NULL != memmem (name, namelen, p->literal, p->len);
+    default:
+      return 0 == fnmatch (p->pattern, name, /* flags = */ 0);
+    }
+}
+
+static struct files_pattern *
+files_patterns_compile (const char *const *patterns, unsigned int npatterns,
+			const char *extra, unsigned int *count)
+{
+  struct files_pattern *compiled;
+  unsigned int i;
+
+  *count = npatterns + (extra != NULL);
+  if (0 == *count)
+    return NULL;
+
+  compiled = xnmalloc (*count, sizeof (struct files_pattern));
+  for (i = 0; i < npatterns; i++)
+    files_pattern_compile (&compiled[i], patterns[i]);
+  if (extra)
+    files_pattern_compile (&compiled[npatterns], extra);
+
+  return compiled;
+}
+
+/* Return NULL when every name matches */
+static struct files_matcher *
+files_matcher_new (const struct files_options *opts)
+{
+  struct files_matcher *m;
+
+  if (NULL == opts->pattern && 0 == opts->ninclude && 0 == opts->nexclude)
+    return NULL;
+
+  m = xmalloc (sizeof (struct files_matcher));
+  m->include = files_patterns_compile (opts->include, opts->ninclude,
+				       opts->pattern, &m->ninclude);
+  m->exclude = files_patterns_compile (opts->exclude, opts->nexclude,
+				       NULL, &m->nexclude);
+
+  return m;
+}
+
+static void
+files_matcher_free (struct files_matcher *m)
+{
+  unsigned int i;
+
+  if (NULL == m)
+    return;
+
+  for (i = 0; i < m->ninclude; i++)
+    free (m->include[i].literal);
+  for (i = 0; i < m->nexclude; i++)
+    free (m->exclude[i].literal);
+  free (m->include);
+  free (m->exclude);
+  free (m);
+}
+
+/* A name matches if it matches one of the include patterns (if any) and
+ * none of the exclude patterns */
+static bool
+files_matcher_match (const struct files_matcher *m, const char *name)
+{
+  size_t namelen;
+  unsigned int i;
+  bool match;
+
+  if (NULL == m)
+    return true;
+
+  namelen = strlen (name);
+  match = (0 == m->ninclude);
+  for (i = 0; !match && i < m->ninclude; i++)
+    match = files_pattern_match (&m->include[i], name, namelen);
+  for (i = 0; match && i < m->nexclude; i++)
+    match = !files_pattern_match (&m->exclude[i], name, namelen);
+
+  return match;
 }
 
 static bool
@@ -103,150 +270,1622 @@ files_check_size (int64_t size, off_t filesize)
 	  ((size > 0) && (filesize > abs_size)));
 }
 
-int
-files_filecount (const char *dir, unsigned int flags,
-		 int64_t age, int64_t size, const char *pattern,
-		 struct files_types **filecount)
+/* The largest and the oldest files are kept in two bounded min-heaps of
+ * 'ntop' entries, ordered by size and by reversed modification time: the
+ * root is the entry to be dropped when a better candidate is found.  The
+ * path of a file is only built when it enters a heap.  */
+
+static inline int64_t
+files_entry_key (const struct files_entry *e, bool by_age)
 {
-  int status;
-  DIR *dirp;
+  return by_age ? -(int64_t) e->mtime : e->size;
+}
+
+static bool
+files_top_accepts (const struct files_entry *heap, unsigned int count,
+		   unsigned int ntop, bool by_age, int64_t key)
+{
+  return (count < ntop) || (key > files_entry_key (&heap[0], by_age));
+}
+
+/* Add 'e' (that the heap takes the ownership of) to the heap, that must
+ * accept it */
+static void
+files_top_insert (struct files_entry *heap, unsigned int *count,
+		  unsigned int ntop, bool by_age, const struct files_entry *e)
+{
+  int64_t key = files_entry_key (e, by_age);
+  unsigned int i, child;
+
+  if (*count < ntop)
+    {
+      /* sift up */
+      for (i = (*count)++; i > 0; i = (i - 1) / 2)
+	{
+	  unsigned int parent = (i - 1) / 2;
+	  if (files_entry_key (&heap[parent], by_age) <= key)
+	    break;
+	  heap[i] = heap[parent];
+	}
+      heap[i] = *e;
+      return;
+    }
+
+  /* replace the root and sift it down */
+  free (heap[0].path);
+  for (i = 0; (child = 2 * i + 1) < *count; i = child)
+    {
+      if (child + 1 < *count
+	  && files_entry_key (&heap[child + 1], by_age)
+	     < files_entry_key (&heap[child], by_age))
+	child++;
+      if (key <= files_entry_key (&heap[child], by_age))
+	break;
+      heap[i] = heap[child];
+    }
+  heap[i] = *e;
+}
+
+static void
+files_top_add (struct files_types *filecount, unsigned int ntop,
+	       const char *path, const char *name, const struct stat *statbuf)
+{
+  struct files_entry e = {
+    .path = NULL,
+    .size = statbuf->st_size,
+    .mtime = statbuf->st_mtime
+  };
+
+  if (files_top_accepts (filecount->largest, filecount->nlargest, ntop,
+			 false, e.size))
+    {
+      e.path = xasprintf ("%s/%s", path, name);
+      files_top_insert (filecount->largest, &filecount->nlargest, ntop,
+			false, &e);
+    }
+  if (files_top_accepts (filecount->oldest, filecount->noldest, ntop,
+			 true, -(int64_t) e.mtime))
+    {
+      e.path = xasprintf ("%s/%s", path, name);
+      files_top_insert (filecount->oldest, &filecount->noldest, ntop,
+			true, &e);
+    }
+}
+
+/* Move the entries of the heap 'src' into the heap 'dest' */
+static void
+files_top_merge (struct files_entry *dest, unsigned int *ndest,
+		 struct files_entry *src, unsigned int *nsrc,
+		 unsigned int ntop, bool by_age)
+{
+  unsigned int i;
+
+  for (i = 0; i < *nsrc; i++)
+    if (files_top_accepts (dest, *ndest, ntop, by_age,
+			   files_entry_key (&src[i], by_age)))
+      files_top_insert (dest, ndest, ntop, by_age, &src[i]);
+    else
+      free (src[i].path);
+  *nsrc = 0;
+}
+
+static int
+files_cmp_largest (const void *a, const void *b)
+{
+  const struct files_entry *ea = a, *eb = b;
+  return (ea->size < eb->size) - (ea->size > eb->size);
+}
+
+static int
+files_cmp_oldest (const void *a, const void *b)
+{
+  const struct files_entry *ea = a, *eb = b;
+  return (ea->mtime > eb->mtime) - (ea->mtime < eb->mtime);
+}
+
+static void
+files_top_init (struct files_types *filecount, unsigned int ntop)
+{
+  if (ntop > 0 && NULL == filecount->largest)
+    {
+      filecount->largest = xnmalloc (ntop, sizeof (struct files_entry));
+      filecount->oldest = xnmalloc (ntop, sizeof (struct files_entry));
+    }
+}
+
+static void
+files_histogram_init (struct files_types *filecount, unsigned int nbins)
+{
+  if (nbins > 0 && NULL == filecount->age_count)
+    {
+      filecount->nage_bins = nbins;
+      filecount->age_count = xnmalloc (nbins + 1, sizeof (int64_t));
+      memset (filecount->age_count, 0, (nbins + 1) * sizeof (int64_t));
+    }
+}
+
+/* Return the index of the first bin whose upper bound is greater than
+ * 'age'.  The bins are few and sorted, so counting the bounds crossed
+ * costs no mispredicted branch.  */
+static inline unsigned int
+files_age_bin (const int64_t *bins, unsigned int nbins, int64_t age)
+{
+  unsigned int i, bin = 0;
+
+  for (i = 0; i < nbins; i++)
+    bin += (age >= bins[i]);
+
+  return bin;
+}
+
+void
+files_types_free (struct files_types *filecount)
+{
+  unsigned int i;
+
+  if (NULL == filecount)
+    return;
+
+  for (i = 0; i < filecount->nlargest; i++)
+    free (filecount->largest[i].path);
+  for (i = 0; i < filecount->noldest; i++)
+    free (filecount->oldest[i].path);
+  free (filecount->largest);
+  free (filecount->oldest);
+  free (filecount->age_count);
+  free (filecount);
+}
+
+/* Map the file type returned by readdir() to the 'st_mode' format.
+ * Return zero when the type is not known (DT_UNKNOWN: some file systems
+ * like xfs with ftype=0 or old reiserfs do not fill 'd_type') */
+static mode_t
+files_dtype_to_mode (unsigned char d_type)
+{
+  switch (d_type)
+    {
+    case DT_BLK:  return S_IFBLK;
+    case DT_CHR:  return S_IFCHR;
+    case DT_DIR:  return S_IFDIR;
+    case DT_FIFO: return S_IFIFO;
+    case DT_LNK:  return S_IFLNK;
+    case DT_REG:  return S_IFREG;
+    case DT_SOCK: return S_IFSOCK;
+    default:      return 0;
+    }
+}
+
+/* Parameters of a files_filecount() traversal */
+struct files_walk
+{
+  unsigned int flags;
+  int64_t age;
+  int64_t size;
+  const struct files_matcher *matcher;
+  unsigned int max_depth;
+  dev_t dev;			/* the file system of the root directory */
+  unsigned int ntop;
+  const int64_t *age_bins;
+  unsigned int nage_bins;
   time_t now;
+  /* the regular files must be stat'ed when an age or a size is given,
+   * or when their sizes, their ages or the top-N files are requested */
+  bool need_stat;
+};
 
-  errno = 0;
-  if ((dirp = opendir (dir)) == NULL)
+struct files_worker;
+
+/* State of a traversal owned by a single thread */
+struct files_scan
+{
+  const struct files_walk *w;
+  struct files_types *filecount;
+  struct files_worker *worker;	/* NULL unless running the parallel walker */
+  struct files_cache *cache;	/* NULL unless running the incremental walker */
+#ifdef HAVE_LIBURING
+  struct io_uring ring;
+  bool uring;			/* statx requests are sent through 'ring' */
+#endif
+};
+
+#ifdef HAVE_LIBURING
+/* The entries to be stat'ed are collected and their IORING_OP_STATX
+ * requests submitted all together, with a single system call for
+ * FILES_URING_BATCH entries.  */
+# define FILES_URING_BATCH	64
+
+struct files_batch
+{
+  unsigned int count;
+  struct files_batch_entry
+  {
+    char name[NAME_MAX + 1];
+    bool is_hidden;
+    int res;			/* result of the statx request */
+    struct statx stx;
+  } entries[FILES_URING_BATCH];
+};
+#endif
+
+struct files_cache;
+static void files_worker_push (struct files_worker *self, int parentfd,
+			       const char *parent, const char *name,
+			       int depth);
+static void files_cache_add_subdir (struct files_cache *c, const char *name);
+static void files_cache_note_mtime (struct files_cache *c, time_t mtime);
+static void files_filecount_at (struct files_scan *s, int fd,
+				const char *path, int depth);
+
+static void
+files_scan_init (struct files_scan *s, const struct files_walk *w,
+		 struct files_types *filecount, struct files_worker *worker)
+{
+  s->w = w;
+  s->filecount = filecount;
+  s->worker = worker;
+  s->cache = NULL;
+#ifdef HAVE_LIBURING
+  s->uring = false;
+  if (w->need_stat && (w->flags & FILES_URING_STAT))
     {
-      dbg ("(e) cannot open %s (%s)\n", dir, strerror (errno));
-      return -1;
+      /* io_uring may be disabled (sysctl kernel.io_uring_disabled) or
+       * filtered out by a seccomp profile: fall back to fstatat() */
+      int ret = io_uring_queue_init (FILES_URING_BATCH, &s->ring, 0);
+      if (ret < 0)
+	dbg ("(e) cannot set up io_uring (%s), using fstatat()\n",
+	     strerror (-ret));
+      s->uring = (ret == 0);
     }
+#endif
+}
 
-  files_data_init (filecount);
-  now = time (NULL);
+static void
+files_scan_fini (struct files_scan *s)
+{
+#ifdef HAVE_LIBURING
+  if (s->uring)
+    io_uring_queue_exit (&s->ring);
+#else
+  (void) s;
+#endif
+}
 
-  /* Scan entries under the 'dirp' directory */
-  for (;;)
+/* Return false if the entry 'name' has been removed in the meantime */
+static bool
+files_stat_at (int fd, const char *path, const char *name,
+	       struct stat *statbuf)
+{
+  if (fstatat (fd, name, statbuf, AT_SYMLINK_NOFOLLOW) != 0)
     {
-      char abs_path[PATH_MAX];
-      struct dirent *dp;
-      struct stat statbuf;
-      bool is_hidden, age_match, size_match;
-      errno = 0;
+      if (errno == ENOENT)
+	return false;
+      plugin_error (STATE_UNKNOWN, errno, "fstatat (%s/%s) failed",
+		    path, name);
+    }
 
-      if ((dp = readdir (dirp)) == NULL)
+  return true;
+}
+
+/* Return true if the subdirectory 'name' of the directory open as 'fd',
+ * found at the given 'depth', is to be scanned.  The directories are not
+ * stat'ed, unless the one-file-system boundary is to be checked and their
+ * type has been given by readdir().  */
+
+static bool
+files_descend (const struct files_walk *w, int fd, const char *path,
+	       int depth, const char *name, const struct stat *statbuf)
+{
+  struct stat st;
+
+  if (w->max_depth > 0 && depth + 1 > (int) w->max_depth)
+    {
+      dbg ("(%d) %s/%s: maximum depth reached\n", depth, path, name);
+      return false;
+    }
+
+  if (w->flags & FILES_ONE_FILE_SYSTEM)
+    {
+      if (NULL == statbuf)
 	{
-	  if (errno != 0)
-	    plugin_error (STATE_UNKNOWN, errno, "readdir() failure");
-	  else
-	    break;		/* end-of-directory */
+	  if (fstatat (fd, name, &st, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT)
+	      != 0)
+	    {
+	      dbg ("(e) cannot stat %s/%s (%s)\n", path, name,
+		   strerror (errno));
+	      return false;
+	    }
+	  statbuf = &st;
 	}
+      if (statbuf->st_dev != w->dev)
+	{
+	  dbg ("(%d) %s/%s: skipping a different file system\n", depth, path,
+	       name);
+	  return false;
+	}
+    }
 
-      /* ignore directory entries */
-      if (STREQ (dp->d_name, ".") || STREQ (dp->d_name, ".."))
-	continue;
-
-      is_hidden = files_is_hidden (dp->d_name);
-      if (!(flags & FILES_INCLUDE_HIDDEN) && is_hidden)
-	continue;
+  return true;
+}
 
-      snprintf (abs_path, sizeof (abs_path), "%s/%s", dir, dp->d_name);
+/* Count the entry 'name' of the directory open as 'fd', whose file type is
+ * 'mode'.  'statbuf' is NULL when the entry has not been stat'ed.  */
 
-      status = lstat (abs_path, &statbuf);
-      if (status != 0)
-	plugin_error (STATE_UNKNOWN, errno, "lstat (%s) failed", abs_path);
+static void
+files_count_entry (struct files_scan *s, int fd, const char *path,
+		   int depth, const char *name, bool is_hidden, mode_t mode,
+		   const struct stat *statbuf)
+{
+  const struct files_walk *w = s->w;
+  struct files_types *filecount = s->filecount;
+  bool age_match, size_match,
+       match = files_matcher_match (w->matcher, name);
 
-      if (S_IFDIR == (statbuf.st_mode & S_IFMT))
+  if (S_IFDIR == mode)
+    {
+      dbg ("(%d) %s/%s (%sdirectory)\n", depth, path, name,
+	   is_hidden ? "hidden " : "");
+      if (w->flags & FILES_RECURSIVE)
 	{
-	  dbg ("(%d) %s (%sdirectory)\n", deep, abs_path,
-	       is_hidden ? "hidden " : "");
-	  if (flags & FILES_RECURSIVE)
+	  int subfd;
+	  if (!(w->flags & FILES_REGULAR_ONLY))
 	    {
-	     char *subdir = xasprintf ("%s/%s", dir, dp->d_name);
-	      if (!(flags & FILES_REGULAR_ONLY))
+	      if (match)
 		{
-		  if (0 == files_filematch (pattern, dp->d_name))
-		    {
-		      (*filecount)->directory++;
-		      (*filecount)->total++;
-		      if (is_hidden)
-			(*filecount)->hidden++;
-		    }
-		  dbg ("(%d)  --> #%lu\n", deep,
-		       (unsigned long)(*filecount)->total);
+		  filecount->directory++;
+		  filecount->total++;
+		  if (is_hidden)
+		    filecount->hidden++;
 		}
+	      dbg ("(%d)  --> #%lu\n", depth,
+		   (unsigned long)filecount->total);
+	    }
 
-	      deep++;
-	      dbg ("+ recursive call of files_filecount for %s\n", subdir);
-	      files_filecount (subdir, flags, age, size,
-			       pattern, filecount);
-	      dbg ("(%d)  --> #%lu\n", deep,
-		   (unsigned long)(*filecount)->total);
-	      free (subdir);
-	      continue;
+	  if (!files_descend (w, fd, path, depth, name, statbuf))
+	    return;
+	  if (s->worker)
+	    {
+	      files_worker_push (s->worker, fd, path, name, depth + 1);
+	      return;
+	    }
+	  if (s->cache)
+	    {
+	      files_cache_add_subdir (s->cache, name);
+	      return;
 	    }
-	  if (flags & FILES_REGULAR_ONLY)
-	    continue;
-	}
 
-      if (0 != files_filematch (pattern, dp->d_name))
-	{
-	  dbg ("(%d) %s does not match the pattern\n", deep, abs_path);
-	  continue;
+	  subfd = openat (fd, name,
+			  O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	  if (subfd < 0)
+	    {
+	      dbg ("(e) cannot open %s/%s (%s)\n", path, name,
+		   strerror (errno));
+	      return;
+	    }
+
+	  char *subdir = xasprintf ("%s/%s", path, name);
+	  dbg ("+ recursive scan of %s\n", subdir);
+	  files_filecount_at (s, subfd, subdir, depth + 1);
+	  dbg ("(%d)  --> #%lu\n", depth + 1,
+	       (unsigned long)filecount->total);
+	  free (subdir);
+	  return;
 	}
+      if (w->flags & FILES_REGULAR_ONLY)
+	return;
+    }
+
+  if (!match)
+    {
+      dbg ("(%d) %s/%s does not match the pattern\n", depth, path, name);
+      return;
+    }
 
-      switch (statbuf.st_mode & S_IFMT)
+  switch (mode)
+    {
+    default:
+      dbg ("(%d) %s/%s (unknown file)\n", depth, path, name);
+      filecount->unknown++;
+      if (w->flags & FILES_IGNORE_UNKNOWN)
+	return;
+      break;
+    case S_IFBLK:
+    case S_IFCHR:
+    case S_IFIFO:
+    case S_IFSOCK:
+      dbg ("(%d) %s/%s (special file)\n", depth, path, name);
+      filecount->special_file++;
+      if (w->flags & FILES_REGULAR_ONLY)
+	return;
+      break;
+    case S_IFLNK:
+      dbg ("(%d) %s/%s (symlink)\n", depth, path, name);
+      if (w->flags & (FILES_IGNORE_SYMLINKS | FILES_REGULAR_ONLY))
+	return;
+      filecount->symlink++;
+      break;
+    case S_IFREG:
+      if (w->need_stat)
 	{
-	default:
-	  dbg ("(%d) %s (unknown file)\n", deep, abs_path);
-	  (*filecount)->unknown++;
-	  if (flags & FILES_IGNORE_UNKNOWN)
-	    continue;
-	  break;
-	case S_IFBLK:
-	case S_IFCHR:
-	case S_IFIFO:
-	case S_IFSOCK:
-	  dbg ("(%d) %s (special file)\n", deep, abs_path);
-	  (*filecount)->special_file++;
-	  if (flags & FILES_REGULAR_ONLY)
-	    continue;
-	  break;
-	case S_IFLNK:
-	  dbg ("(%d) %s (symlink)\n", deep, abs_path);
-	  if (flags & (FILES_IGNORE_SYMLINKS | FILES_REGULAR_ONLY))
-	    continue;
-	  (*filecount)->symlink++;
-	  break;
-	case S_IFREG:
-	  age_match = files_check_age (age, now, statbuf.st_mtime);
-	  size_match = files_check_size (size, statbuf.st_size);
-	  dbg ("(%d) %s (%s file), touched %.2f days ago (%s)"
+	  if (s->cache)
+	    files_cache_note_mtime (s->cache, statbuf->st_mtime);
+	  age_match = files_check_age (w->age, w->now, statbuf->st_mtime);
+	  size_match = files_check_size (w->size, statbuf->st_size);
+	  dbg ("(%d) %s/%s (%s file), touched %.2f days ago (%s)"
 	       " with size %lu bytes (%s)\n"
-	       , deep
-	       , abs_path
+	       , depth, path, name
 	       , is_hidden ? "hidden" : "regular"
-	       , (long)(now - statbuf.st_mtime) / 60.0 / 60.0 / 24.0
+	       , (long)(w->now - statbuf->st_mtime) / 60.0 / 60.0 / 24.0
 	       , age_match ? "match" : "skip"
-	       , (unsigned long) statbuf.st_size
+	       , (unsigned long) statbuf->st_size
 	       , size_match ? "match" : "skip");
 	  if (!age_match)
-	    continue;
+	    return;
 	  if (!size_match)
-	    continue;
+	    return;
+	}
+      else
+	dbg ("(%d) %s/%s (%s file)\n", depth, path, name,
+	     is_hidden ? "hidden" : "regular");
+
+      filecount->regular_file++;
+      if (is_hidden)
+	filecount->hidden++;
+      if (w->flags & FILES_SUM_SIZES)
+	{
+	  filecount->bytes += statbuf->st_size;
+	  filecount->blocks += statbuf->st_blocks;
+	}
+      if (w->ntop > 0)
+	files_top_add (filecount, w->ntop, path, name, statbuf);
+      if (w->nage_bins > 0)
+	{
+	  int64_t age = w->now - statbuf->st_mtime;
+	  filecount->age_count[files_age_bin (w->age_bins, w->nage_bins,
+					      age)]++;
+	  if (age > filecount->oldest_age)
+	    filecount->oldest_age = age;
+	}
+      break;
+    }
+
+  filecount->total++;
+  dbg ("(%d)  --> #%lu\n", depth, (unsigned long)filecount->total);
+}
+
+#ifdef HAVE_LIBURING
+/* Send the statx requests of all the entries in 'batch', wait for their
+ * completion, then count the entries.  The ring is empty again when
+ * files_count_entry() is called, so that it can be used by a recursive
+ * scan.  */
+
+static void
+files_batch_flush (struct files_scan *s, struct files_batch *batch, int fd,
+		   const char *path, int depth)
+{
+  unsigned int i, count = batch->count;
+  int ret;
+
+  for (i = 0; i < count; i++)
+    {
+      struct files_batch_entry *e = &batch->entries[i];
+      struct io_uring_sqe *sqe = io_uring_get_sqe (&s->ring);
+      io_uring_prep_statx (sqe, fd, e->name,
+			   AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT,
+			   STATX_TYPE | STATX_MTIME | STATX_SIZE | STATX_BLOCKS,
+			   &e->stx);
+      io_uring_sqe_set_data (sqe, e);
+    }
+
+  if ((ret = io_uring_submit_and_wait (&s->ring, count)) < 0)
+    plugin_error (STATE_UNKNOWN, -ret, "io_uring_submit_and_wait() failed");
+
+  for (i = 0; i < count; i++)
+    {
+      struct io_uring_cqe *cqe = NULL;
+      struct files_batch_entry *e;
+
+      if ((ret = io_uring_wait_cqe (&s->ring, &cqe)) < 0)
+	plugin_error (STATE_UNKNOWN, -ret, "io_uring_wait_cqe() failed");
+      e = io_uring_cqe_get_data (cqe);
+      e->res = cqe->res;
+      io_uring_cqe_seen (&s->ring, cqe);
+    }
+  batch->count = 0;
+
+  for (i = 0; i < count; i++)
+    {
+      struct files_batch_entry *e = &batch->entries[i];
+      struct stat statbuf;
 
-	  (*filecount)->regular_file++;
-	  if (is_hidden)
-	    (*filecount)->hidden++;
+      switch (e->res)
+	{
+	case 0:
+	  memset (&statbuf, 0, sizeof (struct stat));
+	  statbuf.st_dev = makedev (e->stx.stx_dev_major,
+				    e->stx.stx_dev_minor);
+	  statbuf.st_mode = e->stx.stx_mode;
+	  statbuf.st_size = e->stx.stx_size;
+	  statbuf.st_blocks = e->stx.stx_blocks;
+	  statbuf.st_mtime = e->stx.stx_mtime.tv_sec;
+	  break;
+	case -ENOENT:
+	  /* the file has been removed in the meantime */
+	  continue;
+	case -EINVAL:
+	case -EOPNOTSUPP:
+	  /* IORING_OP_STATX is not supported (Linux < 5.6) */
+	  dbg ("(e) io_uring statx not supported, using fstatat()\n");
+	  if (!files_stat_at (fd, path, e->name, &statbuf))
+	    continue;
 	  break;
+	default:
+	  plugin_error (STATE_UNKNOWN, -e->res, "statx (%s/%s) failed",
+			path, e->name);
 	}
 
-      if (files_filematch (pattern, dp->d_name) != 0)
-	continue;
+      files_count_entry (s, fd, path, depth, e->name, e->is_hidden,
+			 statbuf.st_mode & S_IFMT, &statbuf);
+    }
+}
+#endif
+
+/* Scan the entries of the directory open as 'fd' (and, if requested, its
+ * subdirectories).  The entries are accessed relative to the file
+ * descriptor of their parent directory, and stat'ed only when 'd_type' is
+ * not enough.  'path' is only used for the (debug and error) messages.
+ * The subdirectories are scanned recursively, or queued for the threads
+ * of the parallel walker.  */
+
+static void
+files_filecount_at (struct files_scan *s, int fd, const char *path,
+		    int depth)
+{
+  const struct files_walk *w = s->w;
+  DIR *dirp;
+#ifdef HAVE_LIBURING
+  struct files_batch *batch = NULL;
+#endif
 
-      (*filecount)->total++;
-      dbg ("(%d)  --> #%lu\n", deep, (unsigned long)(*filecount)->total);
+  if ((dirp = fdopendir (fd)) == NULL)
+    {
+      dbg ("(e) cannot open %s (%s)\n", path, strerror (errno));
+      close (fd);
+      return;
     }
 
-  dbg ("- return #%lu (%s)\n", (unsigned long)(*filecount)->total, dir);
-  deep--;
-  closedir (dirp);
-  return 0;
+  /* Scan entries under the 'dirp' directory */
+  for (;;)
+    {
+      struct dirent *dp;
+      struct stat statbuf, *st = NULL;
+      bool is_hidden;
+      mode_t mode;
+      errno = 0;
+
+      if ((dp = readdir (dirp)) == NULL)
+	{
+	  if (errno != 0)
+	    plugin_error (STATE_UNKNOWN, errno, "readdir() failure");
+	  else
+	    break;		/* end-of-directory */
+	}
+
+      /* ignore directory entries */
+      if (STREQ (dp->d_name, ".") || STREQ (dp->d_name, ".."))
+	continue;
+
+      is_hidden = files_is_hidden (dp->d_name);
+      if (!(w->flags & FILES_INCLUDE_HIDDEN) && is_hidden)
+	continue;
+
+      mode = files_dtype_to_mode (dp->d_type);
+      if (0 == mode || (S_IFREG == mode && w->need_stat))
+	{
+#ifdef HAVE_LIBURING
+	  if (s->uring)
+	    {
+	      struct files_batch_entry *e;
+	      if (NULL == batch)
+		{
+		  batch = xmalloc (sizeof (struct files_batch));
+		  batch->count = 0;
+		}
+	      e = &batch->entries[batch->count++];
+	      strcpy (e->name, dp->d_name);
+	      e->is_hidden = is_hidden;
+	      if (FILES_URING_BATCH == batch->count)
+		files_batch_flush (s, batch, fd, path, depth);
+	      continue;
+	    }
+#endif
+	  if (!files_stat_at (fd, path, dp->d_name, &statbuf))
+	    continue;
+	  mode = statbuf.st_mode & S_IFMT;
+	  st = &statbuf;
+	}
+
+      files_count_entry (s, fd, path, depth, dp->d_name, is_hidden, mode,
+			 st);
+    }
+
+#ifdef HAVE_LIBURING
+  if (batch)
+    {
+      if (batch->count > 0)
+	files_batch_flush (s, batch, fd, path, depth);
+      free (batch);
+    }
+#endif
+
+  dbg ("- return #%lu (%s)\n", (unsigned long)s->filecount->total, path);
+  closedir (dirp);
+}
+
+/* Parallel walker.
+ *
+ * Each worker owns a deque of directories waiting to be scanned.  The owner
+ * pushes the subdirectories it finds and pops them back at the tail, so it
+ * scans its part of the tree depth first and keeps its deque short; an idle
+ * worker steals at the head of the deque of another worker, that is the
+ * oldest entry, and so likely the root of the largest subtree not visited
+ * yet.  The directories are queued already open (relative to the file
+ * descriptor of their parent), as long as the number of file descriptors
+ * kept open in the deques does not exceed 'fds_budget'; afterwards only
+ * their path is queued.  Every worker counts the files in its own
+ * 'struct files_types', and these counters are merged at the end.  */
+
+#define FILES_THREADS_MAX	256
+#define FILES_FDS_BUDGET_MAX	1024
+
+struct files_job
+{
+  int fd;			/* -1 if the directory has not been opened */
+  int depth;
+  char *path;
+};
+
+struct files_deque
+{
+  pthread_mutex_t lock;
+  struct files_job *jobs;	/* the jobs in the range [head, tail) */
+  size_t head, tail, capacity;
+};
+
+struct files_pool;
+
+struct files_worker
+{
+  struct files_pool *pool;
+  unsigned int id;
+  pthread_t thread;
+  struct files_deque deque;
+  struct files_scan scan;
+  struct files_types filecount;
+};
+
+struct files_pool
+{
+  const struct files_walk *w;
+  struct files_worker *workers;
+  unsigned int nworkers;
+  pthread_mutex_t lock;		/* protects 'nidle' */
+  pthread_cond_t wakeup;
+  unsigned int nidle;		/* workers waiting for a job */
+  /* updated with atomic operations */
+  size_t pending;		/* directories queued or being scanned */
+  long fds_budget;		/* file descriptors that can still be queued */
+};
+
+static void
+files_deque_push (struct files_deque *dq, const struct files_job *job)
+{
+  pthread_mutex_lock (&dq->lock);
+  if (dq->tail == dq->capacity)
+    {
+      if (dq->head > 0)
+	{
+	  memmove (dq->jobs, dq->jobs + dq->head,
+		   (dq->tail - dq->head) * sizeof (struct files_job));
+	  dq->tail -= dq->head;
+	  dq->head = 0;
+	}
+      else
+	{
+	  dq->capacity = dq->capacity ? 2 * dq->capacity : 64;
+	  dq->jobs =
+	    xrealloc (dq->jobs, dq->capacity * sizeof (struct files_job));
+	}
+    }
+  dq->jobs[dq->tail++] = *job;
+  pthread_mutex_unlock (&dq->lock);
+}
+
+/* Take the job at the tail (owner) or at the head (thief) of the deque */
+static bool
+files_deque_take (struct files_deque *dq, bool steal, struct files_job *job)
+{
+  bool found = false;
+
+  pthread_mutex_lock (&dq->lock);
+  if (dq->head < dq->tail)
+    {
+      *job = steal ? dq->jobs[dq->head++] : dq->jobs[--dq->tail];
+      if (dq->head == dq->tail)
+	dq->head = dq->tail = 0;
+      found = true;
+    }
+  pthread_mutex_unlock (&dq->lock);
+
+  return found;
+}
+
+static bool
+files_worker_steal (struct files_worker *self, struct files_job *job)
+{
+  struct files_pool *pool = self->pool;
+  unsigned int i;
+
+  for (i = 1; i < pool->nworkers; i++)
+    {
+      struct files_worker *victim =
+	&pool->workers[(self->id + i) % pool->nworkers];
+      if (files_deque_take (&victim->deque, true, job))
+	{
+	  dbg ("(%u) stolen %s from worker %u\n", self->id, job->path,
+	       victim->id);
+	  return true;
+	}
+    }
+
+  return false;
+}
+
+static void
+files_worker_push (struct files_worker *self, int parentfd,
+		   const char *parent, const char *name, int depth)
+{
+  struct files_pool *pool = self->pool;
+  struct files_job job = {
+    .fd = -1,
+    .depth = depth,
+    .path = xasprintf ("%s/%s", parent, name)
+  };
+
+  if (__atomic_sub_fetch (&pool->fds_budget, 1, __ATOMIC_RELAXED) >= 0)
+    {
+      job.fd = openat (parentfd, name,
+		       O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+      if (job.fd < 0)
+	{
+	  __atomic_add_fetch (&pool->fds_budget, 1, __ATOMIC_RELAXED);
+	  dbg ("(e) cannot open %s (%s)\n", job.path, strerror (errno));
+	  free (job.path);
+	  return;
+	}
+    }
+  else
+    __atomic_add_fetch (&pool->fds_budget, 1, __ATOMIC_RELAXED);
+
+  /* the job must be accounted before it can be stolen and completed */
+  __atomic_add_fetch (&pool->pending, 1, __ATOMIC_SEQ_CST);
+  dbg ("+ (%u) queued %s\n", self->id, job.path);
+  files_deque_push (&self->deque, &job);
+
+  pthread_mutex_lock (&pool->lock);
+  if (pool->nidle > 0)
+    pthread_cond_signal (&pool->wakeup);
+  pthread_mutex_unlock (&pool->lock);
+}
+
+static void
+files_worker_scan (struct files_worker *self, struct files_job *job)
+{
+  struct files_pool *pool = self->pool;
+  int fd = job->fd;
+
+  if (fd < 0)
+    fd = open (job->path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0)
+    dbg ("(e) cannot open %s (%s)\n", job->path, strerror (errno));
+  else
+    files_filecount_at (&self->scan, fd, job->path, job->depth);
+
+  /* the directory has been closed by files_filecount_at() */
+  if (job->fd >= 0)
+    __atomic_add_fetch (&pool->fds_budget, 1, __ATOMIC_RELAXED);
+  free (job->path);
+}
+
+static void *
+files_worker_run (void *arg)
+{
+  struct files_worker *self = arg;
+  struct files_pool *pool = self->pool;
+  struct files_job job;
+
+  files_scan_init (&self->scan, pool->w, &self->filecount, self);
+
+  for (;;)
+    {
+      if (!files_deque_take (&self->deque, false, &job)
+	  && !files_worker_steal (self, &job))
+	{
+	  /* The deques are searched once again with the pool lock held,
+	   * so that a job pushed in the meantime is not missed: its owner
+	   * needs this lock to signal it.  */
+	  pthread_mutex_lock (&pool->lock);
+	  for (;;)
+	    {
+	      if (__atomic_load_n (&pool->pending, __ATOMIC_SEQ_CST) == 0)
+		{
+		  pthread_mutex_unlock (&pool->lock);
+		  files_scan_fini (&self->scan);
+		  return NULL;
+		}
+	      if (files_worker_steal (self, &job))
+		break;
+	      pool->nidle++;
+	      pthread_cond_wait (&pool->wakeup, &pool->lock);
+	      pool->nidle--;
+	    }
+	  pthread_mutex_unlock (&pool->lock);
+	}
+
+      files_worker_scan (self, &job);
+
+      if (__atomic_sub_fetch (&pool->pending, 1, __ATOMIC_SEQ_CST) == 0)
+	{
+	  pthread_mutex_lock (&pool->lock);
+	  if (pool->nidle > 0)
+	    pthread_cond_broadcast (&pool->wakeup);
+	  pthread_mutex_unlock (&pool->lock);
+	}
+    }
+}
+
+/* Add the counters of 'src' to 'dest' and move its top-N entries */
+static void
+files_types_add (struct files_types *dest, struct files_types *src,
+		 unsigned int ntop)
+{
+  unsigned int i;
+
+  dest->directory += src->directory;
+  dest->hidden += src->hidden;
+  dest->special_file += src->special_file;
+  dest->symlink += src->symlink;
+  dest->regular_file += src->regular_file;
+  dest->total += src->total;
+  dest->unknown += src->unknown;
+  dest->bytes += src->bytes;
+  dest->blocks += src->blocks;
+
+  for (i = 0; i < src->nage_bins + 1 && src->age_count; i++)
+    dest->age_count[i] += src->age_count[i];
+  if (src->oldest_age > dest->oldest_age)
+    dest->oldest_age = src->oldest_age;
+
+  if (ntop > 0)
+    {
+      files_top_merge (dest->largest, &dest->nlargest,
+		       src->largest, &src->nlargest, ntop, false);
+      files_top_merge (dest->oldest, &dest->noldest,
+		       src->oldest, &src->noldest, ntop, true);
+    }
+}
+
+static long
+files_fds_budget (unsigned int nthreads)
+{
+  struct rlimit rlim;
+  long budget = FILES_FDS_BUDGET_MAX;
+
+  /* leave room for the directories being scanned and for the caller */
+  if (getrlimit (RLIMIT_NOFILE, &rlim) == 0 && rlim.rlim_cur != RLIM_INFINITY
+      && rlim.rlim_cur / 2 < (rlim_t) budget)
+    budget = rlim.rlim_cur / 2;
+
+  return budget - nthreads;
+}
+
+static void
+files_filecount_parallel (const struct files_walk *w, int fd,
+			  const char *dir, unsigned int nthreads,
+			  struct files_types *filecount)
+{
+  struct files_pool pool = {
+    .w = w,
+    .nworkers = nthreads,
+    .pending = 1,
+    .fds_budget = files_fds_budget (nthreads) - 1
+  };
+  struct files_job root = { .fd = fd, .depth = 0, .path = xstrdup (dir) };
+  unsigned int i, nstarted;
+
+  pthread_mutex_init (&pool.lock, NULL);
+  pthread_cond_init (&pool.wakeup, NULL);
+
+  pool.workers = xnmalloc (nthreads, sizeof (struct files_worker));
+  memset (pool.workers, 0, nthreads * sizeof (struct files_worker));
+  for (i = 0; i < nthreads; i++)
+    {
+      pool.workers[i].pool = &pool;
+      pool.workers[i].id = i;
+      pthread_mutex_init (&pool.workers[i].deque.lock, NULL);
+      files_top_init (&pool.workers[i].filecount, w->ntop);
+      files_histogram_init (&pool.workers[i].filecount, w->nage_bins);
+    }
+  files_deque_push (&pool.workers[0].deque, &root);
+
+  /* the calling thread is the worker #0; if some threads cannot be
+   * created, the remaining workers just do the job */
+  for (nstarted = 1; nstarted < nthreads; nstarted++)
+    if (pthread_create (&pool.workers[nstarted].thread, NULL,
+			files_worker_run, &pool.workers[nstarted]) != 0)
+      {
+	dbg ("(e) cannot create the worker thread #%u\n", nstarted);
+	break;
+      }
+  dbg ("parallel scan of %s with %u threads\n", dir, nstarted);
+
+  files_worker_run (&pool.workers[0]);
+
+  /* the other workers may still be stealing from any deque */
+  for (i = 1; i < nstarted; i++)
+    pthread_join (pool.workers[i].thread, NULL);
+
+  for (i = 0; i < nthreads; i++)
+    {
+      files_types_add (filecount, &pool.workers[i].filecount, w->ntop);
+      free (pool.workers[i].filecount.largest);
+      free (pool.workers[i].filecount.oldest);
+      free (pool.workers[i].filecount.age_count);
+      free (pool.workers[i].deque.jobs);
+      pthread_mutex_destroy (&pool.workers[i].deque.lock);
+    }
+
+  free (pool.workers);
+  pthread_cond_destroy (&pool.wakeup);
+  pthread_mutex_destroy (&pool.lock);
+}
+
+/* Incremental walker.
+ *
+ * The cache file stores one record per directory, identified by its device
+ * and inode numbers, with its modification and change times, the counters
+ * of its own entries, and the names of its subdirectories.  A directory
+ * whose times did not change since the previous run is not read again:
+ * its counters are taken from the cache and the walker descends straight
+ * into its subdirectories, that are checked in the same way.
+ *
+ * The age of a file changes with the time, while the directory holding it
+ * does not.  So each record also stores the time of the scan and the range
+ * of the modification times of its regular files: the directory is read
+ * again when the age boundary has crossed this range in the meantime.
+ *
+ * The files modified in place (not created, removed or renamed) do not
+ * change the time of their directory.  The records older than
+ * 'cache_max_age' seconds are thus discarded, when this limit is set.
+ *
+ * The file is made of a header, an array of records and a block of names
+ * (NUL-terminated strings), and it is mapped in memory when loaded.  */
+
+#define FILES_CACHE_MAGIC	"NPLFCNT"
+#define FILES_CACHE_VERSION	1
+
+struct files_cache_header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t params;		/* hash of the parameters of the walk */
+  uint64_t nrecords;
+  uint64_t names_size;
+};
+
+struct files_cache_record
+{
+  uint64_t dev;
+  uint64_t ino;
+  int64_t mtime_sec, mtime_nsec;	/* -1: do not trust the record */
+  int64_t ctime_sec, ctime_nsec;
+  int64_t scan_time;		/* when the entries have been counted */
+  int64_t min_mtime, max_mtime;	/* of the regular files stat'ed */
+  /* counters of the entries of the directory (not of the subdirectories) */
+  int64_t directory, hidden, special_file, symlink, regular_file, total,
+	  unknown, bytes, blocks;
+  uint64_t names;		/* offset of the names of the subdirectories */
+  uint64_t nsubdirs;
+};
+
+struct files_cache
+{
+  const struct files_walk *w;
+  int64_t max_age;
+  uint64_t params;
+  /* the cache loaded from disk, and an hash index of its records */
+  void *map;
+  size_t map_size;
+  const struct files_cache_record *old_records;
+  const char *old_names;
+  uint64_t old_nrecords;
+  uint32_t *index;		/* record number + 1, 0 for empty slots */
+  size_t index_mask;
+  /* the cache being built */
+  struct files_cache_record *records;
+  size_t nrecords, records_capacity;
+  char *names;
+  size_t names_size, names_capacity;
+  /* the directory being scanned */
+  int64_t min_mtime, max_mtime;
+  uint64_t nsubdirs;
+  /* statistics */
+  unsigned long hits, misses;
+};
+
+static uint64_t
+files_hash (uint64_t hash, const void *data, size_t len)
+{
+  const unsigned char *p = data;
+
+  /* FNV-1a */
+  while (len--)
+    {
+      hash ^= *p++;
+      hash *= 0x100000001b3ULL;
+    }
+
+  return hash;
+}
+
+static uint64_t
+files_cache_params (const struct files_options *opts)
+{
+  unsigned int flags = opts->flags & ~FILES_URING_STAT;
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  uint32_t version = FILES_CACHE_VERSION;
+  unsigned int i;
+
+  hash = files_hash (hash, &version, sizeof (version));
+  hash = files_hash (hash, &flags, sizeof (flags));
+  hash = files_hash (hash, &opts->age, sizeof (opts->age));
+  hash = files_hash (hash, &opts->size, sizeof (opts->size));
+  hash = files_hash (hash, &opts->max_depth, sizeof (opts->max_depth));
+  if (opts->pattern)
+    hash = files_hash (hash, opts->pattern, strlen (opts->pattern) + 1);
+  for (i = 0; i < opts->ninclude; i++)
+    hash = files_hash (hash, opts->include[i], strlen (opts->include[i]) + 1);
+  /* keep "-n a -x b" and "-n a -n b" apart */
+  hash = files_hash (hash, "", 1);
+  for (i = 0; i < opts->nexclude; i++)
+    hash = files_hash (hash, opts->exclude[i], strlen (opts->exclude[i]) + 1);
+
+  return hash;
+}
+
+char *
+files_cache_path (const char *cachedir, const char *dir,
+		  const struct files_options *opts)
+{
+  uint64_t hash = files_hash (files_cache_params (opts), dir, strlen (dir));
+  return xasprintf ("%s/filecount-%016llx.cache", cachedir,
+		    (unsigned long long) hash);
+}
+
+static inline size_t
+files_cache_slot (uint64_t dev, uint64_t ino, size_t mask)
+{
+  return (size_t) ((ino * 0x9e3779b97f4a7c15ULL) ^ dev) & mask;
+}
+
+/* Check that the names of the subdirectories of each record are in the
+   names block and are valid file names: the cache file may have been
+   truncated or edited, and a name like "." would make files_cached_at()
+   recurse without end.  */
+static bool
+files_cache_check_records (const struct files_cache_record *records,
+			   uint64_t nrecords, const char *names,
+			   uint64_t names_size)
+{
+  uint64_t i, j;
+
+  if (names_size > 0 && names[names_size - 1] != '\0')
+    return false;
+
+  for (i = 0; i < nrecords; i++)
+    {
+      uint64_t offset = records[i].names;
+
+      if (offset > names_size)
+	return false;
+      for (j = 0; j < records[i].nsubdirs; j++)
+	{
+	  const char *name = names + offset;
+	  const char *end = memchr (name, '\0', names_size - offset);
+
+	  if (NULL == end || end == name || memchr (name, '/', end - name)
+	      || STREQ (name, ".") || STREQ (name, ".."))
+	    return false;
+	  offset += end - name + 1;
+	}
+    }
+
+  return true;
+}
+
+static void
+files_cache_load (struct files_cache *c, const char *filename)
+{
+  const struct files_cache_header *hdr;
+  struct stat st;
+  size_t i, size;
+  int fd;
+
+  if ((fd = open (filename, O_RDONLY | O_CLOEXEC)) < 0)
+    {
+      dbg ("cache %s not found (%s), full scan\n", filename,
+	   strerror (errno));
+      return;
+    }
+  if (fstat (fd, &st) < 0
+      || (size_t) st.st_size < sizeof (struct files_cache_header)
+      || (c->map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0))
+	 == MAP_FAILED)
+    {
+      c->map = NULL;
+      close (fd);
+      return;
+    }
+  close (fd);
+  c->map_size = st.st_size;
+
+  hdr = c->map;
+  size = sizeof (struct files_cache_header);
+  if (memcmp (hdr->magic, FILES_CACHE_MAGIC, sizeof (FILES_CACHE_MAGIC))
+      || hdr->version != FILES_CACHE_VERSION
+      || hdr->record_size != sizeof (struct files_cache_record)
+      || hdr->params != c->params
+      || hdr->nrecords > (c->map_size - size) / hdr->record_size
+      || hdr->names_size
+	 != c->map_size - size - hdr->nrecords * hdr->record_size)
+    {
+      dbg ("cache %s is not valid, full scan\n", filename);
+      return;
+    }
+
+  c->old_records =
+    (const struct files_cache_record *) ((const char *) c->map + size);
+  c->old_names = (const char *) (c->old_records + hdr->nrecords);
+  if (!files_cache_check_records (c->old_records, hdr->nrecords,
+				  c->old_names, hdr->names_size))
+    {
+      dbg ("cache %s is corrupted, full scan\n", filename);
+      return;
+    }
+  c->old_nrecords = hdr->nrecords;
+
+  for (c->index_mask = 15; c->index_mask < 2 * c->old_nrecords; )
+    c->index_mask = 2 * c->index_mask + 1;
+  c->index = xnmalloc (c->index_mask + 1, sizeof (uint32_t));
+  memset (c->index, 0, (c->index_mask + 1) * sizeof (uint32_t));
+  for (i = 0; i < c->old_nrecords; i++)
+    {
+      const struct files_cache_record *r = &c->old_records[i];
+      size_t slot = files_cache_slot (r->dev, r->ino, c->index_mask);
+      while (c->index[slot])
+	slot = (slot + 1) & c->index_mask;
+      c->index[slot] = i + 1;
+    }
+
+  dbg ("cache %s: %lu directories\n", filename,
+       (unsigned long) c->old_nrecords);
+}
+
+static const struct files_cache_record *
+files_cache_lookup (const struct files_cache *c, const struct stat *st)
+{
+  size_t slot;
+
+  if (NULL == c->index)
+    return NULL;
+
+  for (slot = files_cache_slot (st->st_dev, st->st_ino, c->index_mask);
+       c->index[slot]; slot = (slot + 1) & c->index_mask)
+    {
+      const struct files_cache_record *r = &c->old_records[c->index[slot] - 1];
+      if (r->dev == (uint64_t) st->st_dev && r->ino == (uint64_t) st->st_ino)
+	return r;
+    }
+
+  return NULL;
+}
+
+/* Return true if the counters of the record 'r' are still valid for the
+ * directory described by 'st' */
+static bool
+files_cache_valid (const struct files_cache *c,
+		   const struct files_cache_record *r, const struct stat *st)
+{
+  const struct files_walk *w = c->w;
+
+  if (r->mtime_sec != st->st_mtim.tv_sec
+      || r->mtime_nsec != st->st_mtim.tv_nsec
+      || r->ctime_sec != st->st_ctim.tv_sec
+      || r->ctime_nsec != st->st_ctim.tv_nsec)
+    return false;
+
+  if (c->max_age > 0 && w->now - r->scan_time > c->max_age)
+    return false;
+
+  /* the files with a modification time between the age boundaries of the
+   * two scans may have changed their state */
+  if (w->age != 0 && r->min_mtime <= r->max_mtime)
+    {
+      int64_t abs_age = (w->age < 0) ? -w->age : w->age;
+      if (r->max_mtime >= r->scan_time - abs_age
+	  && r->min_mtime <= w->now - abs_age)
+	return false;
+    }
+
+  return true;
+}
+
+static size_t
+files_cache_new_record (struct files_cache *c)
+{
+  if (c->nrecords == c->records_capacity)
+    {
+      c->records_capacity =
+	c->records_capacity ? 2 * c->records_capacity : 256;
+      c->records =
+	xrealloc (c->records,
+		  c->records_capacity * sizeof (struct files_cache_record));
+    }
+  memset (&c->records[c->nrecords], 0, sizeof (struct files_cache_record));
+  return c->nrecords++;
+}
+
+static void
+files_cache_add_names (struct files_cache *c, const char *names, size_t len)
+{
+  if (c->names_size + len > c->names_capacity)
+    {
+      while (c->names_size + len > c->names_capacity)
+	c->names_capacity =
+	  c->names_capacity ? 2 * c->names_capacity : 4096;
+      c->names = xrealloc (c->names, c->names_capacity);
+    }
+  memcpy (c->names + c->names_size, names, len);
+  c->names_size += len;
+}
+
+static void
+files_cache_add_subdir (struct files_cache *c, const char *name)
+{
+  files_cache_add_names (c, name, strlen (name) + 1);
+  c->nsubdirs++;
+}
+
+static void
+files_cache_note_mtime (struct files_cache *c, time_t mtime)
+{
+  if (mtime < c->min_mtime)
+    c->min_mtime = mtime;
+  if (mtime > c->max_mtime)
+    c->max_mtime = mtime;
+}
+
+static void files_cached_at (struct files_scan *s, int fd, const char *path,
+			     int depth);
+
+/* Scan the subdirectories listed in the new record 'n' */
+static void
+files_cached_subdirs (struct files_scan *s, size_t n, int fd,
+		      const char *path, int depth)
+{
+  struct files_cache *c = s->cache;
+  uint64_t i, nsubdirs = c->records[n].nsubdirs;
+  size_t offset = c->records[n].names;
+
+  /* 'c->records' and 'c->names' may be moved by the recursive calls */
+  for (i = 0; i < nsubdirs; i++)
+    {
+      const char *name = c->names + offset;
+      size_t len = strlen (name) + 1;
+      int subfd = openat (fd, name,
+			  O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+
+      if (subfd < 0)
+	dbg ("(e) cannot open %s/%s (%s)\n", path, name, strerror (errno));
+      else
+	{
+	  char *subdir = xasprintf ("%s/%s", path, name);
+	  files_cached_at (s, subfd, subdir, depth + 1);
+	  free (subdir);
+	}
+      offset += len;
+    }
+}
+
+static void
+files_cached_at (struct files_scan *s, int fd, const char *path, int depth)
+{
+  struct files_cache *c = s->cache;
+  const struct files_walk *w = s->w;
+  const struct files_cache_record *old;
+  struct files_cache_record *r;
+  struct files_types own, *parent = s->filecount;
+  struct stat st;
+  size_t n;
+  int dupfd;
+
+  if (fstat (fd, &st) < 0)
+    {
+      dbg ("(e) cannot stat %s (%s)\n", path, strerror (errno));
+      close (fd);
+      return;
+    }
+  /* a file system may have been mounted since the last scan */
+  if ((w->flags & FILES_ONE_FILE_SYSTEM) && st.st_dev != w->dev)
+    {
+      dbg ("(%d) %s: skipping a different file system\n", depth, path);
+      close (fd);
+      return;
+    }
+
+  n = files_cache_new_record (c);
+  old = files_cache_lookup (c, &st);
+  if (old && files_cache_valid (c, old, &st))
+    {
+      const char *names = c->old_names + old->names;
+      size_t len = 0;
+      uint64_t i;
+
+      dbg ("(%d) %s unchanged, using the cache\n", depth, path);
+      c->hits++;
+
+      for (i = 0; i < old->nsubdirs; i++)
+	len += strlen (names + len) + 1;
+      r = &c->records[n];
+      *r = *old;
+      r->names = c->names_size;
+      files_cache_add_names (c, names, len);
+
+      parent->directory += r->directory;
+      parent->hidden += r->hidden;
+      parent->special_file += r->special_file;
+      parent->symlink += r->symlink;
+      parent->regular_file += r->regular_file;
+      parent->total += r->total;
+      parent->unknown += r->unknown;
+      parent->bytes += r->bytes;
+      parent->blocks += r->blocks;
+
+      files_cached_subdirs (s, n, fd, path, depth);
+      close (fd);
+      return;
+    }
+
+  dbg ("(%d) %s changed, scanning it\n", depth, path);
+  c->misses++;
+
+  /* files_filecount_at() closes the file descriptor */
+  if ((dupfd = fcntl (fd, F_DUPFD_CLOEXEC, 0)) < 0)
+    plugin_error (STATE_UNKNOWN, errno, "cannot duplicate a file descriptor");
+
+  memset (&own, 0, sizeof (struct files_types));
+  c->min_mtime = INT64_MAX;
+  c->max_mtime = INT64_MIN;
+  c->nsubdirs = 0;
+  s->filecount = &own;
+  r = &c->records[n];
+  r->names = c->names_size;
+
+  files_filecount_at (s, fd, path, depth);
+  s->filecount = parent;
+
+  r = &c->records[n];
+  r->dev = st.st_dev;
+  r->ino = st.st_ino;
+  /* a directory modified during this second might be modified again
+   * without any visible change of its time: do not trust it */
+  if (st.st_mtim.tv_sec >= w->now - 1)
+    r->mtime_sec = r->mtime_nsec = -1;
+  else
+    {
+      r->mtime_sec = st.st_mtim.tv_sec;
+      r->mtime_nsec = st.st_mtim.tv_nsec;
+    }
+  r->ctime_sec = st.st_ctim.tv_sec;
+  r->ctime_nsec = st.st_ctim.tv_nsec;
+  r->scan_time = w->now;
+  r->min_mtime = c->min_mtime;
+  r->max_mtime = c->max_mtime;
+  r->directory = own.directory;
+  r->hidden = own.hidden;
+  r->special_file = own.special_file;
+  r->symlink = own.symlink;
+  r->regular_file = own.regular_file;
+  r->total = own.total;
+  r->unknown = own.unknown;
+  r->bytes = own.bytes;
+  r->blocks = own.blocks;
+  r->nsubdirs = c->nsubdirs;
+  files_types_add (parent, &own, 0);
+
+  files_cached_subdirs (s, n, dupfd, path, depth);
+  close (dupfd);
+}
+
+static bool
+files_write_all (int fd, const void *buf, size_t len)
+{
+  const char *p = buf;
+
+  while (len > 0)
+    {
+      ssize_t ret = write (fd, p, len);
+      if (ret < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return false;
+	}
+      p += ret;
+      len -= ret;
+    }
+
+  return true;
+}
+
+/* Write the new cache to a temporary file, then rename it atomically */
+static void
+files_cache_save (const struct files_cache *c, const char *filename)
+{
+  struct files_cache_header hdr = {
+    .magic = FILES_CACHE_MAGIC,
+    .version = FILES_CACHE_VERSION,
+    .record_size = sizeof (struct files_cache_record),
+    .params = c->params,
+    .nrecords = c->nrecords,
+    .names_size = c->names_size
+  };
+  char *tmpname = xasprintf ("%s.XXXXXX", filename);
+  int fd;
+
+  if ((fd = mkstemp (tmpname)) < 0)
+    {
+      dbg ("(e) cannot create %s (%s)\n", tmpname, strerror (errno));
+      free (tmpname);
+      return;
+    }
+
+  if (!files_write_all (fd, &hdr, sizeof (hdr))
+      || !files_write_all (fd, c->records,
+			   c->nrecords * sizeof (struct files_cache_record))
+      || !files_write_all (fd, c->names, c->names_size)
+      || close (fd) < 0
+      || rename (tmpname, filename) < 0)
+    {
+      dbg ("(e) cannot write %s (%s)\n", filename, strerror (errno));
+      unlink (tmpname);
+    }
+
+  free (tmpname);
+}
+
+static void
+files_filecount_cached (const struct files_walk *w,
+			const struct files_options *opts, int fd,
+			const char *dir, struct files_types *filecount)
+{
+  struct files_cache c;
+  struct files_scan s;
+
+  memset (&c, 0, sizeof (struct files_cache));
+  c.w = w;
+  c.max_age = opts->cache_max_age;
+  c.params = files_cache_params (opts);
+  files_cache_load (&c, opts->cache_file);
+
+  files_scan_init (&s, w, filecount, NULL);
+  s.cache = &c;
+  files_cached_at (&s, fd, dir, 0);
+  files_scan_fini (&s);
+
+  dbg ("cache: %lu directories unchanged, %lu scanned\n", c.hits, c.misses);
+  files_cache_save (&c, opts->cache_file);
+
+  if (c.map)
+    munmap (c.map, c.map_size);
+  free (c.index);
+  free (c.records);
+  free (c.names);
+}
+
+int
+files_filecount_opts (const char *dir, const struct files_options *opts,
+		      struct files_types **filecount)
+{
+  int fd;
+  unsigned int nthreads = opts->nthreads;
+  struct files_matcher *matcher;
+  struct files_walk w = {
+    .flags = opts->flags,
+    .age = opts->age,
+    .size = opts->size,
+    .now = time (NULL),
+    .ntop = opts->ntop,
+    .max_depth = opts->max_depth,
+    .age_bins = opts->age_bins,
+    .nage_bins = opts->nage_bins,
+    .need_stat = (opts->age != 0 || opts->size != 0 || opts->ntop > 0
+		  || opts->nage_bins > 0 || (opts->flags & FILES_SUM_SIZES))
+  };
+
+  errno = 0;
+  if ((fd = open (dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+    {
+      dbg ("(e) cannot open %s (%s)\n", dir, strerror (errno));
+      return -1;
+    }
+  if (w.flags & FILES_ONE_FILE_SYSTEM)
+    {
+      struct stat st;
+      if (fstat (fd, &st) < 0)
+	{
+	  dbg ("(e) cannot stat %s (%s)\n", dir, strerror (errno));
+	  close (fd);
+	  return -1;
+	}
+      w.dev = st.st_dev;
+    }
+
+  files_data_init (filecount);
+  files_top_init (*filecount, w.ntop);
+  files_histogram_init (*filecount, w.nage_bins);
+  w.matcher = matcher = files_matcher_new (opts);
+
+  if (nthreads > FILES_THREADS_MAX)
+    nthreads = FILES_THREADS_MAX;
+  /* the top-N files and the age histogram cannot be rebuilt from the
+   * cache */
+  if (opts->cache_file && 0 == w.ntop && 0 == w.nage_bins)
+    files_filecount_cached (&w, opts, fd, dir, *filecount);
+  else if (nthreads > 1 && (w.flags & FILES_RECURSIVE))
+    files_filecount_parallel (&w, fd, dir, nthreads, *filecount);
+  else
+    {
+      struct files_scan s;
+      files_scan_init (&s, &w, *filecount, NULL);
+      files_filecount_at (&s, fd, dir, 0);
+      files_scan_fini (&s);
+    }
+
+  if (w.ntop > 0)
+    {
+      qsort ((*filecount)->largest, (*filecount)->nlargest,
+	     sizeof (struct files_entry), files_cmp_largest);
+      qsort ((*filecount)->oldest, (*filecount)->noldest,
+	     sizeof (struct files_entry), files_cmp_oldest);
+    }
+
+  files_matcher_free (matcher);
+  return 0;
+}
+
+int
+files_filecount (const char *dir, unsigned int flags,
+		 int64_t age, int64_t size, const char *pattern,
+		 struct files_types **filecount)
+{
+  struct files_options opts = {
+    .flags = flags,
+    .age = age,
+    .size = size,
+    .pattern = pattern,
+    .nthreads = 1
+  };
+
+  return files_filecount_opts (dir, &opts, filecount);
 }
@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A library for selecting the mounted file systems by type and mount point.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The file system types (-T, -X) and the file systems given in the
+ * command line are stored in hash tables, so that checking a mount costs
+ * one lookup whatever the length of these lists.
+ */
+
+#include <stdlib.h>
+
+#include "collection.h"
+#include "fsfilter.h"
+#include "mountlist.h"
+
+void
+fs_filter_select_type (struct fs_filter *filter, const char *fstype)
+{
+  if (NULL == filter->select_types)
+    filter->select_types = counter_create ();
+  counter_put (filter->select_types, fstype, 1);
+}
+
+void
+fs_filter_exclude_type (struct fs_filter *filter, const char *fstype)
+{
+  if (NULL == filter->exclude_types)
+    filter->exclude_types = counter_create ();
+  counter_put (filter->exclude_types, fstype, 1);
+}
+
+const char *
+fs_filter_type_conflict (const struct fs_filter *filter)
+{
+  unsigned int i;
+
+  if (NULL == filter->select_types || NULL == filter->exclude_types)
+    return NULL;
+
+  for (i = 0; i < filter->select_types->uniq; i++)
+    if (counter_lookup (filter->exclude_types, filter->select_types->keys[i]))
+      return filter->select_types->keys[i];
+
+  return NULL;
+}
+
+/* Is FSTYPE a type of file system that should be listed?  */
+
+bool
+fs_filter_selected_fstype (const struct fs_filter *filter, const char *fstype)
+{
+  if (NULL == filter->select_types || NULL == fstype)
+    return true;
+  return counter_lookup (filter->select_types, fstype) != NULL;
+}
+
+/* Is FSTYPE a type of file system that should be omitted?  */
+
+bool
+fs_filter_excluded_fstype (const struct fs_filter *filter, const char *fstype)
+{
+  if (NULL == filter->exclude_types || NULL == fstype)
+    return false;
+  return counter_lookup (filter->exclude_types, fstype) != NULL;
+}
+
+bool
+fs_filter_skip (const struct fs_filter *filter, const struct mount_entry *me)
+{
+  if (me->me_remote && filter->show_local_fs)
+    return true;
+
+  if (me->me_dummy && !filter->show_all_fs)
+    return true;
+
+  if (!fs_filter_selected_fstype (filter, me->me_type)
+      || fs_filter_excluded_fstype (filter, me->me_type))
+    return true;
+
+  return false;
+}
+
+hashable_t *
+fs_filter_add_mountpoint (struct fs_filter *filter, const char *name)
+{
+  if (NULL == filter->mountpoints)
+    filter->mountpoints = counter_create ();
+  return counter_put (filter->mountpoints, name, 0);
+}
+
+hashable_t *
+fs_filter_mountpoint (const struct fs_filter *filter, const char *name)
+{
+  if (NULL == filter->mountpoints)
+    return NULL;
+  return counter_lookup (filter->mountpoints, name);
+}
+
+bool
+fs_filter_listed (const struct fs_filter *filter,
+		  const struct mount_entry *me)
+{
+  return fs_filter_mountpoint (filter, me->me_mountdir)
+    || fs_filter_mountpoint (filter, me->me_devname);
+}
+
+void
+fs_filter_free (struct fs_filter *filter)
+{
+  if (filter->select_types)
+    counter_free (filter->select_types);
+  if (filter->exclude_types)
+    counter_free (filter->exclude_types);
+  if (filter->mountpoints)
+    counter_free (filter->mountpoints);
+  filter->select_types = filter->exclude_types = filter->mountpoints = NULL;
+}
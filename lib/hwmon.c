@@ -0,0 +1,234 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A library for reading the hwmon temperature sensors
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The hwmon drivers export their temperature sensors in
+ * /sys/class/hwmon/hwmon<N> (or in its 'device' subdirectory, for the
+ * old drivers):
+ *    |---name:            the name of the chip (coretemp, nvme, ...)
+ *    |---temp<M>_input:   the temperature (millidegree Celsius)
+ *    |---temp<M>_crit:    the critical temperature (optional)
+ *    |---temp<M>_label:   the name of the sensor (optional)
+ *
+ * See: <https://www.kernel.org/doc/Documentation/hwmon/sysfs-interface>
+ */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hwmon.h"
+#include "string-macros.h"
+#include "sysfsparser.h"
+#include "xalloc.h"
+#include "xasprintf.h"
+
+#define PATH_SYS_HWMON	PATH_SYS "/class/hwmon"
+
+/* Large enough for "temp<M>_input" */
+#define HWMON_ATTR_MAX	32
+
+static int
+uintcmp (const void *a, const void *b)
+{
+  unsigned int x = *(const unsigned int *) a, y = *(const unsigned int *) b;
+  return (x > y) - (x < y);
+}
+
+/* Return the sorted indexes M of the temp<M>_input attributes found in
+ * the directory 'dir' */
+static unsigned int *
+hwmon_temp_indexes (const char *dir, unsigned int *n)
+{
+  unsigned int *indexes = NULL;
+  struct dirent *dp;
+  DIR *dirp;
+
+  *n = 0;
+  if ((dirp = opendir (dir)) == NULL)
+    return NULL;
+
+  while ((dp = readdir (dirp)))
+    {
+      unsigned int index;
+      char suffix[8];
+
+      if (sscanf (dp->d_name, "temp%u_%7s", &index, suffix) != 2
+	  || !STREQ (suffix, "input"))
+	continue;
+      if ((*n & (*n - 1)) == 0)
+	indexes = xrealloc (indexes,
+			    (*n ? 2 * *n : 1) * sizeof (unsigned int));
+      indexes[(*n)++] = index;
+    }
+  closedir (dirp);
+
+  if (*n > 1)
+    qsort (indexes, *n, sizeof (unsigned int), uintcmp);
+  return indexes;
+}
+
+/* Read the sensors of the chip in the directory 'path'.  All the
+ * temperatures are read in one batch, through the same directory fd */
+static void
+hwmon_read_chip (struct hwmon_chip *chip, const char *path)
+{
+  struct sysfsparser_attr *attrs;
+  char (*names)[HWMON_ATTR_MAX], *devdir = NULL;
+  const char *dir = path;
+  unsigned int i, n, *indexes;
+  int dirfd;
+
+  chip->nsensors = 0;
+  chip->sensors = NULL;
+
+  indexes = hwmon_temp_indexes (dir, &n);
+  if (0 == n)
+    {
+      free (indexes);
+      dir = devdir = xasprintf ("%s/device", path);
+      indexes = hwmon_temp_indexes (dir, &n);
+    }
+  if (0 == n || (dirfd = sysfsparser_opendirfd ("%s", dir)) < 0)
+    {
+      free (indexes);
+      free (devdir);
+      return;
+    }
+
+  if (sysfsparser_read_at (dirfd, "name", chip->name,
+			   sizeof (chip->name)) < 1)
+    snprintf (chip->name, sizeof (chip->name), "hwmon%u", chip->id);
+
+  attrs = xnmalloc (2 * n, sizeof (struct sysfsparser_attr));
+  names = xnmalloc (2 * n, HWMON_ATTR_MAX);
+  for (i = 0; i < n; i++)
+    {
+      snprintf (names[2 * i], HWMON_ATTR_MAX, "temp%u_input", indexes[i]);
+      snprintf (names[2 * i + 1], HWMON_ATTR_MAX, "temp%u_crit",
+		indexes[i]);
+      attrs[2 * i].name = names[2 * i];
+      attrs[2 * i + 1].name = names[2 * i + 1];
+    }
+  sysfsparser_getvalues_at (dirfd, attrs, 2 * n);
+
+  chip->sensors = xnmalloc (n, sizeof (struct hwmon_sensor));
+  for (i = 0; i < n; i++)
+    {
+      struct hwmon_sensor *sensor = &chip->sensors[chip->nsensors];
+      char label[HWMON_ATTR_MAX];
+
+      /* the sensors not connected return an error (ENODATA) */
+      if (attrs[2 * i].err < 0)
+	continue;
+
+      /* the temperatures below zero are negative numbers */
+      sensor->index = indexes[i];
+      sensor->input = (long long) attrs[2 * i].value;
+      sensor->has_crit = (attrs[2 * i + 1].err == 0);
+      sensor->crit = (long long) attrs[2 * i + 1].value;
+
+      snprintf (label, sizeof label, "temp%u_label", indexes[i]);
+      if (sysfsparser_read_at (dirfd, label, sensor->label,
+			       sizeof (sensor->label)) < 1)
+	snprintf (sensor->label, sizeof (sensor->label), "temp%u",
+		  indexes[i]);
+
+      chip->nsensors++;
+    }
+
+  free (names);
+  free (attrs);
+  free (indexes);
+  free (devdir);
+}
+
+static int
+hwmon_chip_cmp (const void *a, const void *b)
+{
+  const struct hwmon_chip *x = a, *y = b;
+  return (x->id > y->id) - (x->id < y->id);
+}
+
+static struct hwmon_chip *
+hwmon_read_chips (const char *syshwmon, unsigned int *nchips)
+{
+  struct hwmon_chip *chips = NULL;
+  struct dirent *dp;
+  unsigned int n = 0;
+  DIR *dirp;
+
+  *nchips = 0;
+  if ((dirp = opendir (syshwmon)) == NULL)
+    return NULL;
+
+  while ((dp = readdir (dirp)))
+    {
+      struct hwmon_chip chip;
+      unsigned int id;
+      char *path, c;
+
+      if (sscanf (dp->d_name, "hwmon%u%c", &id, &c) != 1)
+	continue;
+
+      chip.id = id;
+      path = xasprintf ("%s/%s", syshwmon, dp->d_name);
+      hwmon_read_chip (&chip, path);
+      free (path);
+
+      if (0 == chip.nsensors)
+	{
+	  free (chip.sensors);
+	  continue;
+	}
+      if ((n & (n - 1)) == 0)
+	chips = xrealloc (chips, (n ? 2 * n : 1) * sizeof (struct hwmon_chip));
+      chips[n++] = chip;
+    }
+  closedir (dirp);
+
+  if (n > 1)
+    qsort (chips, n, sizeof (struct hwmon_chip), hwmon_chip_cmp);
+
+  *nchips = n;
+  return chips;
+}
+
+struct hwmon_chip *
+hwmon_get_chips (unsigned int *nchips)
+{
+  return hwmon_read_chips (PATH_SYS_HWMON, nchips);
+}
+
+void
+hwmon_chips_free (struct hwmon_chip *chips, unsigned int nchips)
+{
+  unsigned int i;
+
+  for (i = 0; i < nchips; i++)
+    free (chips[i].sensors);
+  free (chips);
+}
+
+const char *
+hwmon_sysfs_path (void)
+{
+  return PATH_SYS_HWMON;
+}
@@ -27,7 +27,10 @@
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
 #include <unistd.h>
 
 #include "string-macros.h"
@@ -140,18 +143,504 @@ dev_from_mount_options (char const *mount_options)
   return -1;
 }
 
-/* Return a list of the currently mounted file systems, or NULL on error.
-   Add each entry to the tail of the list so that they stay in order.
-   If NEED_FS_TYPE is true, ensure that the file system type fields in
-   the returned list are valid.  Otherwise, they might not be.  */
+/* The table of the mounts seen by the current process, see proc(5):
+ *  36 35 98:0 /mnt1 /mnt2 rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+ *  (1)(2)(3)   (4)   (5)      (6)      (7)   (8) (9)   (10)         (11)
+ * It is parsed in place: the whole file and the array of the mount entries
+ * are stored in a single memory block, released by free_mount_list().  */
+#define MOUNTINFO "/proc/self/mountinfo"
 
-struct mount_entry *
-read_file_system_list (bool need_fs_type)
+#define MOUNTINFO_BUFSIZ 65536
+
+/* Read the whole file 'path' in a buffer, followed by a null byte */
+static char *
+mountinfo_slurp (const char *path, size_t *len)
+{
+  size_t size = MOUNTINFO_BUFSIZ;
+  char *buf;
+  ssize_t n;
+  int fd;
+
+  if ((fd = open (path, O_RDONLY | O_CLOEXEC)) < 0)
+    return NULL;
+
+  buf = xmalloc (size);
+  *len = 0;
+  for (;;)
+    {
+      if (*len + 1 == size)
+	buf = xrealloc (buf, (size *= 2));
+      n = read (fd, buf + *len, size - *len - 1);
+      if (n == 0)
+	break;
+      if (n < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  int saved_errno = errno;
+	  free (buf);
+	  close (fd);
+	  errno = saved_errno;
+	  return NULL;
+	}
+      *len += n;
+    }
+  close (fd);
+  buf[*len] = '\0';
+
+  return buf;
+}
+
+/* Return the next field of 'line', separated by a space, null terminated */
+static char *
+mountinfo_next_field (char **line)
+{
+  char *field = *line, *end = strchr (field, ' ');
+
+  if (end)
+    {
+      *end = '\0';
+      *line = end + 1;
+    }
+  else
+    *line = field + strlen (field);
+
+  return field;
+}
+
+/* Decode in place the octal escapes ("\040" for a space) that the kernel
+ * uses for the spaces, tabs, newlines and backslashes of the paths */
+static char *
+mountinfo_unescape (char *str)
+{
+  char *src = strchr (str, '\\'), *dst;
+
+  if (NULL == src)
+    return str;
+
+  for (dst = src; *src; )
+    {
+      if (src[0] == '\\'
+	  && src[1] >= '0' && src[1] <= '3'
+	  && src[2] >= '0' && src[2] <= '7'
+	  && src[3] >= '0' && src[3] <= '7')
+	{
+	  *dst++ = ((src[1] - '0') << 6) | ((src[2] - '0') << 3)
+		   | (src[3] - '0');
+	  src += 4;
+	}
+      else
+	*dst++ = *src++;
+    }
+  *dst = '\0';
+
+  return str;
+}
+
+/* Return true if "ro" is one of the comma separated 'options' */
+static bool
+mountinfo_readonly (const char *options)
+{
+  const char *p;
+
+  for (p = options; (p = strstr (p, "ro")); p += 2)
+    if ((p == options || p[-1] == ',') && (p[2] == ',' || p[2] == '\0'))
+      return true;
+
+  return false;
+}
+
+/* Parse a line of the mountinfo file.  Return false if it is malformed. */
+static bool
+mountinfo_parse_line (char *line, struct mount_entry *me)
+{
+  char *field, *end, *mntopts;
+  unsigned long major, minor;
+
+  me->me_mntid = strtoul (mountinfo_next_field (&line), &end, 10);
+  if (*end != '\0')
+    return false;
+  me->me_parentid = strtoul (mountinfo_next_field (&line), &end, 10);
+  if (*end != '\0')
+    return false;
+  field = mountinfo_next_field (&line);
+  major = strtoul (field, &end, 10);
+  if (*end != ':')
+    return false;
+  minor = strtoul (end + 1, &end, 10);
+  if (*end != '\0')
+    return false;
+  me->me_dev = makedev (major, minor);
+
+  mountinfo_next_field (&line);		/* root of the mount */
+  me->me_mountdir = mountinfo_unescape (mountinfo_next_field (&line));
+  mntopts = mountinfo_next_field (&line);
+
+  /* skip the optional fields, up to the separator "-" */
+  do
+    {
+      if (*line == '\0')
+	return false;
+      field = mountinfo_next_field (&line);
+    }
+  while (!STREQ (field, "-"));
+
+  me->me_type = mountinfo_unescape (mountinfo_next_field (&line));
+  me->me_devname = mountinfo_unescape (mountinfo_next_field (&line));
+  me->me_opts = mntopts;
+  me->me_type_malloced = 0;
+  me->me_opts_malloced = 0;
+  me->me_arena = 1;
+  me->me_dummy = ME_DUMMY (me->me_devname, me->me_type);
+  me->me_remote = ME_REMOTE (me->me_devname, me->me_type);
+  /* either the mount or the super block (field 11) may be read-only */
+  me->me_readonly =
+    mountinfo_readonly (mntopts) || mountinfo_readonly (line);
+
+  return true;
+}
+
+/* Return the list of the mounts described in the mountinfo file 'path',
+ * or NULL on error */
+static struct mount_entry *
+mountinfo_read (const char *path)
+{
+  struct mount_entry *mount_list, *me;
+  size_t len, nlines = 0, n = 0;
+  char *buf, *text, *line, *next;
+
+  if ((buf = mountinfo_slurp (path, &len)) == NULL)
+    return NULL;
+
+  for (line = buf; (line = memchr (line, '\n', buf + len - line)); line++)
+    nlines++;
+  nlines++;				/* a last line without newline */
+
+  mount_list = xmalloc (nlines * sizeof (struct mount_entry) + len + 1);
+  text = (char *) (mount_list + nlines);
+  memcpy (text, buf, len + 1);
+  free (buf);
+
+  for (line = text; line < text + len; line = next)
+    {
+      if ((next = strchr (line, '\n')))
+	*next++ = '\0';
+      else
+	next = line + strlen (line);
+
+      me = &mount_list[n];
+      if (!mountinfo_parse_line (line, me))
+	continue;
+      me->me_next = &mount_list[n + 1];
+      n++;
+    }
+
+  if (0 == n)
+    {
+      free (mount_list);
+      errno = EINVAL;
+      return NULL;
+    }
+  mount_list[n - 1].me_next = NULL;
+
+  return mount_list;
+}
+
+#if !defined __NR_statmount && defined __linux__ && !defined __alpha__
+/* the syscall numbers are the same on all the architectures but alpha */
+# define __NR_statmount 457
+# define __NR_listmount 458
+#endif
+
+#ifdef __NR_statmount
+/* The statmount() and listmount() system calls (Linux 6.8+) return the
+ * mount table in binary form, without formatting and parsing text lines.
+ * However one statmount() call per mount is needed, and the resolution of
+ * the mount point path costs as much as the formatting of mountinfo: this
+ * backend is only used when /proc/self/mountinfo cannot be read.
+ * The structures are not in the headers of the distributions built before
+ * 2024, so they are copied from linux/mount.h.  */
+
+struct npl_mnt_id_req
+{
+  uint32_t size;
+  uint32_t spare;
+  uint64_t mnt_id;
+  uint64_t param;
+};
+#define NPL_MNT_ID_REQ_SIZE_VER0	24
+
+struct npl_statmount
+{
+  uint32_t size;
+  uint32_t mnt_opts;
+  uint64_t mask;
+  uint32_t sb_dev_major;
+  uint32_t sb_dev_minor;
+  uint64_t sb_magic;
+  uint32_t sb_flags;
+  uint32_t fs_type;
+  uint64_t mnt_id;
+  uint64_t mnt_parent_id;
+  uint32_t mnt_id_old;
+  uint32_t mnt_parent_id_old;
+  uint64_t mnt_attr;
+  uint64_t mnt_propagation;
+  uint64_t mnt_peer_group;
+  uint64_t mnt_master;
+  uint64_t propagate_from;
+  uint32_t mnt_root;
+  uint32_t mnt_point;
+  uint64_t mnt_ns_id;
+  uint32_t fs_subtype;
+  uint32_t sb_source;
+  uint32_t opt_num;
+  uint32_t opt_array;
+  uint32_t opt_sec_num;
+  uint32_t opt_sec_array;
+  uint64_t spare2[46];
+  char str[];
+};
+
+#define NPL_STATMOUNT_SB_BASIC		0x00000001U
+#define NPL_STATMOUNT_MNT_BASIC		0x00000002U
+#define NPL_STATMOUNT_MNT_POINT		0x00000010U
+#define NPL_STATMOUNT_FS_TYPE		0x00000020U
+#define NPL_STATMOUNT_SB_SOURCE		0x00000200U
+/* the only fields needed by the plugins */
+#define NPL_STATMOUNT_MASK \
+  (NPL_STATMOUNT_SB_BASIC | NPL_STATMOUNT_MNT_BASIC | NPL_STATMOUNT_MNT_POINT \
+   | NPL_STATMOUNT_FS_TYPE | NPL_STATMOUNT_SB_SOURCE)
+
+#define NPL_LSMT_ROOT		0xffffffffffffffffULL
+
+#define NPL_MOUNT_ATTR_RDONLY		0x00000001
+#define NPL_MOUNT_ATTR_NOSUID		0x00000002
+#define NPL_MOUNT_ATTR_NODEV		0x00000004
+#define NPL_MOUNT_ATTR_NOEXEC		0x00000008
+#define NPL_MOUNT_ATTR__ATIME		0x00000070
+#define NPL_MOUNT_ATTR_RELATIME		0x00000000
+#define NPL_MOUNT_ATTR_NOATIME		0x00000010
+#define NPL_MOUNT_ATTR_NODIRATIME	0x00000080
+#define NPL_MOUNT_ATTR_NOSYMFOLLOW	0x00200000
+#define NPL_SB_RDONLY			0x00000001
+
+#define STATMOUNT_LIST_CHUNK	1024
+#define STATMOUNT_BUFSIZ	4096
+
+/* The strings of the mount entries, stored in a growing buffer */
+struct statmount_pool
+{
+  char *buf;
+  size_t len, size;
+};
+
+static size_t
+statmount_pool_add (struct statmount_pool *pool, const char *str)
+{
+  size_t offset = pool->len, len = strlen (str) + 1;
+
+  if (pool->len + len > pool->size)
+    {
+      while (pool->len + len > pool->size)
+	pool->size *= 2;
+      pool->buf = xrealloc (pool->buf, pool->size);
+    }
+  memcpy (pool->buf + pool->len, str, len);
+  pool->len += len;
+
+  return offset;
+}
+
+/* The offsets in the pool of the strings of a mount entry */
+struct statmount_strings
+{
+  size_t devname, mountdir, type, opts;
+};
+
+/* Write the mount options as shown in the field 6 of mountinfo */
+static void
+statmount_mnt_opts (char *buf, uint64_t attr)
+{
+  static const struct
+  {
+    uint64_t mask, value;
+    const char *name;
+  } opts[] = {
+    { NPL_MOUNT_ATTR_NOSUID, NPL_MOUNT_ATTR_NOSUID, ",nosuid" },
+    { NPL_MOUNT_ATTR_NODEV, NPL_MOUNT_ATTR_NODEV, ",nodev" },
+    { NPL_MOUNT_ATTR_NOEXEC, NPL_MOUNT_ATTR_NOEXEC, ",noexec" },
+    { NPL_MOUNT_ATTR__ATIME, NPL_MOUNT_ATTR_NOATIME, ",noatime" },
+    { NPL_MOUNT_ATTR_NODIRATIME, NPL_MOUNT_ATTR_NODIRATIME, ",nodiratime" },
+    { NPL_MOUNT_ATTR__ATIME, NPL_MOUNT_ATTR_RELATIME, ",relatime" },
+    { NPL_MOUNT_ATTR_NOSYMFOLLOW, NPL_MOUNT_ATTR_NOSYMFOLLOW, ",nosymfollow" }
+  };
+  size_t i;
+  char *p = stpcpy (buf, (attr & NPL_MOUNT_ATTR_RDONLY) ? "ro" : "rw");
+
+  for (i = 0; i < sizeof (opts) / sizeof (opts[0]); i++)
+    if ((attr & opts[i].mask) == opts[i].value)
+      p = stpcpy (p, opts[i].name);
+}
+
+/* Return the IDs of all the mounts of the current mount namespace */
+static uint64_t *
+statmount_list_ids (size_t *nids)
+{
+  struct npl_mnt_id_req req = {
+    .size = NPL_MNT_ID_REQ_SIZE_VER0,
+    .mnt_id = NPL_LSMT_ROOT,
+    .param = 0
+  };
+  size_t size = STATMOUNT_LIST_CHUNK;
+  uint64_t *ids = xnmalloc (size, sizeof (uint64_t));
+  long n;
+
+  *nids = 0;
+  for (;;)
+    {
+      n = syscall (__NR_listmount, &req, ids + *nids, size - *nids, 0);
+      if (n < 0)
+	{
+	  int saved_errno = errno;
+	  free (ids);
+	  errno = saved_errno;
+	  return NULL;
+	}
+      *nids += n;
+      if (*nids < size)
+	break;
+      /* continue after the last mount ID returned */
+      req.param = ids[*nids - 1];
+      ids = xrealloc (ids, (size *= 2) * sizeof (uint64_t));
+    }
+
+  return ids;
+}
+
+/* Return the list of the mounts returned by listmount() and statmount(),
+ * or NULL with errno set (ENOSYS on the kernels older than 6.8) */
+static struct mount_entry *
+statmount_read (void)
+{
+  struct npl_mnt_id_req req = {
+    .size = NPL_MNT_ID_REQ_SIZE_VER0,
+    .param = NPL_STATMOUNT_MASK
+  };
+  struct statmount_pool pool = { .size = STATMOUNT_BUFSIZ * 4 };
+  struct mount_entry *mount_list, *me;
+  struct npl_statmount *sm;
+  struct statmount_strings *strings;
+  size_t i, n, nids, bufsize = STATMOUNT_BUFSIZ;
+  uint64_t *ids;
+  char mnt_opts[128], *text;
+
+  if ((ids = statmount_list_ids (&nids)) == NULL)
+    return NULL;
+  if (0 == nids)
+    {
+      free (ids);
+      errno = ENOENT;
+      return NULL;
+    }
+
+  strings = xnmalloc (nids, sizeof (struct statmount_strings));
+  mount_list = xnmalloc (nids, sizeof (struct mount_entry));
+  pool.buf = xmalloc (pool.size);
+  sm = xmalloc (bufsize);
+
+  for (i = n = 0; i < nids; i++)
+    {
+      req.mnt_id = ids[i];
+      if (syscall (__NR_statmount, &req, sm, bufsize, 0) < 0)
+	{
+	  if (errno == EOVERFLOW)
+	    {
+	      sm = xrealloc (sm, (bufsize *= 2));
+	      i--;
+	      continue;
+	    }
+	  if (errno == ENOENT)	/* unmounted in the meantime */
+	    continue;
+	  goto fail;
+	}
+      if ((sm->mask & NPL_STATMOUNT_MASK) != NPL_STATMOUNT_MASK)
+	{
+	  /* the mount source is only returned by the latest kernels */
+	  errno = EOPNOTSUPP;
+	  goto fail;
+	}
+
+      me = &mount_list[n];
+      me->me_mntid = sm->mnt_id_old;
+      me->me_parentid = sm->mnt_parent_id_old;
+      me->me_dev = makedev (sm->sb_dev_major, sm->sb_dev_minor);
+      me->me_readonly = (sm->mnt_attr & NPL_MOUNT_ATTR_RDONLY)
+			|| (sm->sb_flags & NPL_SB_RDONLY);
+      me->me_type_malloced = 0;
+      me->me_opts_malloced = 0;
+      me->me_arena = 1;
+      me->me_dummy = ME_DUMMY (sm->str + sm->sb_source, sm->str + sm->fs_type);
+      me->me_remote =
+	ME_REMOTE (sm->str + sm->sb_source, sm->str + sm->fs_type);
+
+      statmount_mnt_opts (mnt_opts, sm->mnt_attr);
+      strings[n].devname = statmount_pool_add (&pool, sm->str + sm->sb_source);
+      strings[n].mountdir = statmount_pool_add (&pool, sm->str + sm->mnt_point);
+      strings[n].type = statmount_pool_add (&pool, sm->str + sm->fs_type);
+      strings[n].opts = statmount_pool_add (&pool, mnt_opts);
+      n++;
+    }
+
+  if (0 == n)
+    {
+      errno = ENOENT;
+      goto fail;
+    }
+
+  /* move the entries and their strings in a single memory block */
+  mount_list = xrealloc (mount_list, n * sizeof (struct mount_entry)
+				     + pool.len);
+  text = (char *) (mount_list + n);
+  memcpy (text, pool.buf, pool.len);
+  for (i = 0; i < n; i++)
+    {
+      me = &mount_list[i];
+      me->me_devname = text + strings[i].devname;
+      me->me_mountdir = text + strings[i].mountdir;
+      me->me_type = text + strings[i].type;
+      me->me_opts = text + strings[i].opts;
+      me->me_next = (i + 1 < n) ? &mount_list[i + 1] : NULL;
+    }
+
+  free (strings);
+  free (pool.buf);
+  free (sm);
+  free (ids);
+  return mount_list;
+
+fail:
+  {
+    int saved_errno = errno;
+    free (mount_list);
+    free (strings);
+    free (pool.buf);
+    free (sm);
+    free (ids);
+    errno = saved_errno;
+    return NULL;
+  }
+}
+#endif				/* __NR_statmount */
+
+/* Read the mount table with getmntent(): a fallback for the systems where
+ * /proc/self/mountinfo is not available */
+static struct mount_entry *
+read_mtab (void)
 {
   struct mount_entry *mount_list;
   struct mount_entry *me;
   struct mount_entry **mtail = &mount_list;
-  (void) need_fs_type;
 
   {
     struct mntent *mnt;
@@ -171,6 +660,8 @@ read_file_system_list (bool need_fs_type)
 	me->me_type_malloced = 1;
 	me->me_opts = xstrdup (mnt->mnt_opts);
 	me->me_opts_malloced = 1;
+	me->me_arena = 0;
+	me->me_mntid = me->me_parentid = 0;
 	me->me_dummy = ME_DUMMY (me->me_devname, me->me_type);
 	me->me_remote = ME_REMOTE (me->me_devname, me->me_type);
 #if HAVE_HASMNTOPT
@@ -197,25 +688,59 @@ free_then_fail:
   {
     int saved_errno = errno;
     *mtail = NULL;
-
-    while (mount_list)
-      {
-	me = mount_list->me_next;
-	free (mount_list->me_devname);
-	free (mount_list->me_mountdir);
-	if (mount_list->me_type_malloced)
-	  free (mount_list->me_type);
-	if (mount_list->me_opts_malloced)
-	  free (mount_list->me_opts);
-	free (mount_list);
-	mount_list = me;
-      }
-
+    free_mount_list (mount_list);
     errno = saved_errno;
     return NULL;
   }
 }
 
+/* Return a list of the currently mounted file systems, or NULL on error.
+   Add each entry to the tail of the list so that they stay in order.
+   If NEED_FS_TYPE is true, ensure that the file system type fields in
+   the returned list are valid.  Otherwise, they might not be.  */
+
+struct mount_entry *
+read_file_system_list (bool need_fs_type)
+{
+  struct mount_entry *mount_list;
+  (void) need_fs_type;
+
+  if ((mount_list = mountinfo_read (MOUNTINFO)))
+    return mount_list;
+#ifdef __NR_statmount
+  /* /proc may not be mounted (chroots, minimal containers) */
+  if ((mount_list = statmount_read ()))
+    return mount_list;
+#endif
+
+  return read_mtab ();
+}
+
+void
+free_mount_list (struct mount_entry *mount_list)
+{
+  struct mount_entry *me;
+
+  if (mount_list && mount_list->me_arena)
+    {
+      free (mount_list);
+      return;
+    }
+
+  while (mount_list)
+    {
+      me = mount_list->me_next;
+      free (mount_list->me_devname);
+      free (mount_list->me_mountdir);
+      if (mount_list->me_type_malloced)
+	free (mount_list->me_type);
+      if (mount_list->me_opts_malloced)
+	free (mount_list->me_opts);
+      free (mount_list);
+      mount_list = me;
+    }
+}
+
 int
 file_system_type_exists (const char *fs_type, char **fs_mp)
 {
@@ -232,10 +757,11 @@ file_system_type_exists (const char *fs_type, char **fs_mp)
   for (me = mount_list; me; me = me->me_next)
     if (STREQ (me->me_type, fs_type))
       {
-	*fs_mp = me->me_mountdir;
+	*fs_mp = xstrdup (me->me_mountdir);
         exists = 1;
         break;
       }
 
+  free_mount_list (mount_list);
   return exists;
 }
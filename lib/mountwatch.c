@@ -0,0 +1,265 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A library for recording the read-only transitions of the mounted
+ * file systems.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The kernel flags /proc/self/mountinfo with POLLERR|POLLPRI every time
+ * the mount table of the namespace changes (mount, umount, remount), so
+ * a watcher can sleep in poll() instead of rereading the table at short
+ * intervals.  The kernel does not notify the read-only remounts forced
+ * by an I/O error, so the table is still reread when a (long) timeout
+ * expires.  The transitions are saved in a small text file, one event
+ * per line:
+ *
+ *   <seconds since the epoch> <ro|rw> <file system type> <mount point>
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "atomicfile.h"
+#include "mountlist.h"
+#include "mountwatch.h"
+#include "string-macros.h"
+#include "xalloc.h"
+
+#define MOUNTINFO "/proc/self/mountinfo"
+
+void
+mountwatch_state_add (struct mountwatch_state *state, time_t when,
+		      bool readonly, const char *type, const char *mountdir)
+{
+  struct mountwatch_event *event;
+
+  if (state->nevents == MOUNTWATCH_MAX_EVENTS)
+    {
+      free (state->events[0].type);
+      free (state->events[0].mountdir);
+      memmove (state->events, state->events + 1,
+	       (MOUNTWATCH_MAX_EVENTS - 1) * sizeof (struct mountwatch_event));
+      state->nevents--;
+    }
+
+  event = &state->events[state->nevents++];
+  event->when = when;
+  event->readonly = readonly;
+  event->type = xstrdup (type);
+  event->mountdir = xstrdup (mountdir);
+}
+
+void
+mountwatch_state_free (struct mountwatch_state *state)
+{
+  unsigned int i;
+
+  for (i = 0; i < state->nevents; i++)
+    {
+      free (state->events[i].type);
+      free (state->events[i].mountdir);
+    }
+  state->nevents = 0;
+}
+
+int
+mountwatch_state_read (const char *path, struct mountwatch_state *state)
+{
+  char *line = NULL;
+  size_t len = 0;
+  ssize_t nread;
+  FILE *fp;
+
+  state->nevents = 0;
+  if ((fp = fopen (path, "re")) == NULL)
+    return (errno == ENOENT) ? 0 : -errno;
+
+  while ((nread = getline (&line, &len, fp)) != -1)
+    {
+      long long when;
+      char mode[3], *type, *mountdir;
+      int offset;
+
+      if (nread > 0 && line[nread - 1] == '\n')
+	line[nread - 1] = '\0';
+      if (sscanf (line, "%lld %2s %n", &when, mode, &offset) != 2
+	  || (!STREQ (mode, "ro") && !STREQ (mode, "rw")))
+	continue;
+
+      type = line + offset;
+      if ((mountdir = strchr (type, ' ')) == NULL || mountdir[1] == '\0')
+	continue;
+      *mountdir++ = '\0';
+
+      mountwatch_state_add (state, when, STREQ (mode, "ro"), type, mountdir);
+    }
+
+  free (line);
+  fclose (fp);
+
+  return 0;
+}
+
+static int
+mountwatch_state_emit (FILE *fp, const void *data)
+{
+  const struct mountwatch_state *state = data;
+  unsigned int i;
+
+  for (i = 0; i < state->nevents; i++)
+    fprintf (fp, "%lld %s %s %s\n", (long long) state->events[i].when,
+	     state->events[i].readonly ? "ro" : "rw",
+	     state->events[i].type, state->events[i].mountdir);
+
+  return ferror (fp) ? -EIO : 0;
+}
+
+int
+mountwatch_state_write (const char *path,
+			const struct mountwatch_state *state)
+{
+  return atomic_write_file (path, mountwatch_state_emit, state);
+}
+
+static int
+mountwatch_cmp (const void *a, const void *b)
+{
+  const struct mount_entry *const *ma = a, *const *mb = b;
+
+  if ((*ma)->me_mntid != (*mb)->me_mntid)
+    return ((*ma)->me_mntid < (*mb)->me_mntid) ? -1 : 1;
+  return strcmp ((*ma)->me_mountdir, (*mb)->me_mountdir);
+}
+
+/* Return an array with the 'nmounts' entries of 'list' sorted by
+ * mount ID and mount point */
+static struct mount_entry **
+mountwatch_sort (struct mount_entry *list, size_t *nmounts)
+{
+  struct mount_entry **sorted, *me;
+  size_t n = 0;
+
+  for (me = list; me; me = me->me_next)
+    n++;
+
+  sorted = xnmalloc (n ? n : 1, sizeof (struct mount_entry *));
+  for (n = 0, me = list; me; me = me->me_next)
+    sorted[n++] = me;
+  qsort (sorted, n, sizeof (struct mount_entry *), mountwatch_cmp);
+
+  *nmounts = n;
+  return sorted;
+}
+
+unsigned int
+mountwatch_diff (struct mount_entry *old_list, struct mount_entry *new_list,
+		 time_t now, bool (*skip) (const struct mount_entry *),
+		 struct mountwatch_state *state)
+{
+  struct mount_entry **old_sorted, **new_sorted;
+  size_t i = 0, j = 0, nold, nnew;
+  unsigned int nevents = 0;
+
+  old_sorted = mountwatch_sort (old_list, &nold);
+  new_sorted = mountwatch_sort (new_list, &nnew);
+
+  /* the mounts that have been added or removed are not transitions */
+  while (i < nold && j < nnew)
+    {
+      int cmp = mountwatch_cmp (&old_sorted[i], &new_sorted[j]);
+      if (cmp < 0)
+	i++;
+      else if (cmp > 0)
+	j++;
+      else
+	{
+	  const struct mount_entry *me = new_sorted[j];
+	  if (me->me_readonly != old_sorted[i]->me_readonly
+	      && !(skip && skip (me)))
+	    {
+	      mountwatch_state_add (state, now, me->me_readonly, me->me_type,
+				    me->me_mountdir);
+	      nevents++;
+	    }
+	  i++, j++;
+	}
+    }
+
+  free (old_sorted);
+  free (new_sorted);
+
+  return nevents;
+}
+
+int
+mountwatch_open (void)
+{
+  int fd = open (MOUNTINFO, O_RDONLY | O_CLOEXEC);
+  return (fd < 0) ? -errno : fd;
+}
+
+int
+mountwatch_wait (int fd, int timeout)
+{
+  struct pollfd pfd = { .fd = fd, .events = POLLPRI };
+  int ret;
+
+  for (;;)
+    {
+      if ((ret = poll (&pfd, 1, timeout)) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return -errno;
+	}
+      if (0 == ret)
+	return 0;
+      if (pfd.revents & (POLLPRI | POLLERR))
+	return 1;
+      if (pfd.revents & POLLNVAL)
+	return -EBADF;
+    }
+}
+
+int
+mountwatch_update (int fd, int timeout, struct mount_entry **mounts,
+		   struct mount_entry *(*read_list) (void),
+		   bool (*skip) (const struct mount_entry *),
+		   struct mountwatch_state *state)
+{
+  struct mount_entry *new_list;
+  int err, nevents;
+
+  /* a file system remounted read-only by the kernel after an I/O error
+   * does not raise any event, so the table is also reread when the
+   * timeout expires */
+  if ((err = mountwatch_wait (fd, timeout)) < 0)
+    return err;
+  if ((new_list = read_list ()) == NULL)
+    return 0;
+
+  nevents = mountwatch_diff (*mounts, new_list, time (NULL), skip, state);
+  free_mount_list (*mounts);
+  *mounts = new_list;
+
+  return nevents;
+}
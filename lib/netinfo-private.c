@@ -25,12 +25,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/param.h>
 #include <unistd.h>
 #include <linux/ethtool.h>
+#include <linux/gen_stats.h>
 #ifdef HAVE_LINUX_IF_LINK_H
 # include <linux/if_link.h>
 #endif
 #include <linux/netlink.h>
+#include <linux/pkt_sched.h>
 #include <linux/rtnetlink.h>
 #include <linux/sockios.h>
 #include <linux/wireless.h>
@@ -42,6 +45,7 @@
 #include "string-macros.h"
 #include "system.h"
 #include "xalloc.h"
+#include "xasprintf.h"
 
 typedef struct nl_req_s
 {
@@ -49,6 +53,12 @@ typedef struct nl_req_s
   struct rtgenmsg gen;
 } nl_req_t;
 
+typedef struct nl_tcreq_s
+{
+  struct nlmsghdr hdr;
+  struct tcmsg tcm;
+} nl_tcreq_t;
+
 const char *const duplex_table[_DUP_MAX] = {
   [DUPLEX_HALF] = "half",
   [DUPLEX_FULL] = "full"
@@ -306,6 +316,42 @@ sendmsg_rtnl_links_dump (int fd, struct iovec *iov, struct sockaddr_nl *kernel)
   return 0;
 }
 
+/* Prepare and send the RTNL request for dumping the queueing disciplines
+ * of all the network interfaces */
+static int
+sendmsg_rtnl_qdiscs_dump (int fd, struct iovec *iov,
+			  struct sockaddr_nl *kernel)
+{
+  nl_tcreq_t req;
+  struct msghdr rtnl_msg;
+
+  memset (&rtnl_msg, 0, sizeof (rtnl_msg));
+  memset (kernel, 0, sizeof (*kernel));
+  memset (&req, 0, sizeof (req));
+
+  kernel->nl_family = AF_NETLINK;
+
+  req.hdr.nlmsg_len = NLMSG_LENGTH (sizeof (struct tcmsg));
+  req.hdr.nlmsg_type = RTM_GETQDISC;
+  req.hdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  req.hdr.nlmsg_seq = 1;
+  req.hdr.nlmsg_pid = getpid ();
+  /* tcm_ifindex set to zero: we will get the qdiscs of all interfaces */
+  req.tcm.tcm_family = AF_UNSPEC;
+
+  iov->iov_base = &req;
+  iov->iov_len = req.hdr.nlmsg_len;
+  rtnl_msg.msg_iov = iov;
+  rtnl_msg.msg_iovlen = 1;
+  rtnl_msg.msg_name = kernel;
+  rtnl_msg.msg_namelen = sizeof (*kernel);
+
+  if (sendmsg (fd, (struct msghdr *) &rtnl_msg, 0) < 0)
+    return errno;
+
+  return 0;
+}
+
 static int
 parse_rtattr (struct rtattr *tb[], int max, struct rtattr *rta, int len)
 {
@@ -321,14 +367,221 @@ parse_rtattr (struct rtattr *tb[], int max, struct rtattr *rta, int len)
   return 0;
 }
 
+/* Map the IFLA_INFO_KIND of an interface to one of the IF_KIND_* classes */
+static unsigned int
+if_kind_class (const char *kind, unsigned int ifi_flags)
+{
+  if (NULL == kind)
+    return if_flags_LOOPBACK (ifi_flags) ? IF_KIND_OTHER : IF_KIND_PHYSICAL;
+  else if (STREQ (kind, "bond"))
+    return IF_KIND_BOND;
+  else if (STREQ (kind, "bridge"))
+    return IF_KIND_BRIDGE;
+  else if (STREQ (kind, "vlan"))
+    return IF_KIND_VLAN;
+  else if (STREQ (kind, "veth"))
+    return IF_KIND_VETH;
+
+  return IF_KIND_OTHER;
+}
+
+static struct iflist *
+iflist_lookup_ifindex (struct iflist *iflhead, int ifindex)
+{
+  struct iflist *ifl;
+
+  for (ifl = iflhead; ifl != NULL; ifl = ifl->next)
+    if (ifl->ifindex == ifindex)
+      return ifl;
+
+  return NULL;
+}
+
+static bool
+iflist_is_master (struct iflist *iflhead, int ifindex)
+{
+  struct iflist *ifl;
+
+  for (ifl = iflhead; ifl != NULL; ifl = ifl->next)
+    if (ifl->master == ifindex)
+      return true;
+
+  return false;
+}
+
+/* Return the master device the counters of the enslaved interface 'ifl'
+ * are rolled up into: the top-level bond of a physical device, which can
+ * in turn be enslaved to another bond.  The bridges are never a target:
+ * their own counters only include the traffic to and from the host, the
+ * forwarded one is also counted by the ports, so summing the ports would
+ * inflate the bridge rates.  */
+static struct iflist *
+iflist_rollup_master (struct iflist *iflhead, struct iflist *ifl)
+{
+  struct iflist *master = ifl, *next;
+  int depth = 0;
+
+  while (master->master > 0 && depth++ < 8
+	 && (next = iflist_lookup_ifindex (iflhead, master->master))
+	 && !(next->kind && STREQ (next->kind, "bridge")))
+    master = next;
+
+  return (master == ifl) ? NULL : master;
+}
+
+/* Append the name of the interface 'ifl' to the list of the ports of the
+ * bridge 'bridge' */
+static void
+iflist_add_port (struct iflist *bridge, const struct iflist *ifl)
+{
+  char *ports = bridge->ports ?
+    xasprintf ("%s,%s", bridge->ports, ifl->ifname) : xstrdup (ifl->ifname);
+
+  free (bridge->ports);
+  bridge->ports = ports;
+}
+
+/* Replace the counters of the bond devices by the sum of the counters of
+ * their leaf slaves, where the traffic is actually measured, keep the
+ * counters of the bridges and record their ports, then drop from the list
+ * the interfaces rolled up into a bond.  The bridge ports (a bond with
+ * the summed counters of its slaves, a veth, ...) are kept.  */
+static struct iflist *
+rollup_slaves (struct iflist *iflhead)
+{
+  struct iflist *ifl, *master, **pifl;
+  unsigned int n;
+  bool *rolled;
+
+  for (ifl = iflhead; ifl != NULL; ifl = ifl->next)
+    if (ifl->master > 0 && ifl->stats
+	&& (master = iflist_rollup_master (iflhead, ifl)) && master->stats)
+      memset (master->stats, 0, sizeof (struct ifstats));
+
+  for (ifl = iflhead; ifl != NULL; ifl = ifl->next)
+    {
+      if (ifl->master > 0
+	  && (master = iflist_lookup_ifindex (iflhead, ifl->master))
+	  && master->kind && STREQ (master->kind, "bridge"))
+	iflist_add_port (master, ifl);
+
+      if (ifl->master == 0 || NULL == ifl->stats
+	  || iflist_is_master (iflhead, ifl->ifindex)
+	  || NULL == (master = iflist_rollup_master (iflhead, ifl))
+	  || NULL == master->stats)
+	continue;
+
+      dbg ("rolling up the counters of '%s' into '%s'\n",
+	   ifl->ifname, master->ifname);
+      master->stats->tx_packets += ifl->stats->tx_packets;
+      master->stats->rx_packets += ifl->stats->rx_packets;
+      master->stats->tx_bytes   += ifl->stats->tx_bytes;
+      master->stats->rx_bytes   += ifl->stats->rx_bytes;
+      master->stats->tx_errors  += ifl->stats->tx_errors;
+      master->stats->rx_errors  += ifl->stats->rx_errors;
+      master->stats->tx_dropped += ifl->stats->tx_dropped;
+      master->stats->rx_dropped += ifl->stats->rx_dropped;
+      master->stats->collisions += ifl->stats->collisions;
+      master->stats->multicast  += ifl->stats->multicast;
+    }
+
+  /* the interfaces to be dropped are marked before unlinking any of them,
+   * because iflist_rollup_master() walks the list */
+  for (ifl = iflhead, n = 0; ifl != NULL; ifl = ifl->next)
+    n++;
+  rolled = xnmalloc (n ? n : 1, sizeof (bool));
+  for (ifl = iflhead, n = 0; ifl != NULL; ifl = ifl->next)
+    rolled[n++] = (iflist_rollup_master (iflhead, ifl) != NULL);
+
+  for (pifl = &iflhead, n = 0; *pifl != NULL; n++)
+    {
+      ifl = *pifl;
+      if (rolled[n])
+	{
+	  *pifl = ifl->next;
+	  ifl->next = NULL;
+	  freeiflist (ifl);
+	}
+      else
+	pifl = &ifl->next;
+    }
+  free (rolled);
+
+  return iflhead;
+}
+
+/* Create a new list structure from the RTM_NEWLINK message 'h': the name,
+ * kind, master and link statistics are copied from the netlink attributes,
+ * the link speed and duplex are left unknown.  */
+static struct iflist *
+iflist_new_from_nlmsg (struct nlmsghdr *h)
+{
+  struct ifinfomsg *ifi = NLMSG_DATA (h);
+  struct rtattr *tb[IFLA_MAX+1];
+  struct rtattr *linkinfo[IFLA_INFO_MAX+1];
+  struct rtnl_link_stats *stats;
+  struct iflist *ifl;
+  int attr_len = h->nlmsg_len - NLMSG_LENGTH (sizeof (*ifi));
+
+  parse_rtattr (tb, IFLA_MAX, IFLA_RTA (ifi), attr_len);
+  if (NULL == tb[IFLA_IFNAME])
+    plugin_error (STATE_UNKNOWN, 0,
+		  "BUG: nil ifname returned by parse_rtattr()");
+
+  ifl = xmalloc (sizeof (struct iflist));
+  ifl->ifname = xstrdup ((char *) RTA_DATA (tb[IFLA_IFNAME]));
+  ifl->kind = NULL;
+  if (tb[IFLA_LINKINFO])
+    {
+      parse_rtattr (linkinfo, IFLA_INFO_MAX,
+		    RTA_DATA (tb[IFLA_LINKINFO]),
+		    RTA_PAYLOAD (tb[IFLA_LINKINFO]));
+      if (linkinfo[IFLA_INFO_KIND])
+	ifl->kind = xstrdup ((const char *)
+			     RTA_DATA (linkinfo[IFLA_INFO_KIND]));
+    }
+  ifl->ports = NULL;
+  ifl->ifindex = ifi->ifi_index;
+  ifl->master = tb[IFLA_MASTER] ? *(int *) RTA_DATA (tb[IFLA_MASTER]) : 0;
+  ifl->flags = ifi->ifi_flags;
+  ifl->duplex = DUPLEX_UNKNOWN;
+  ifl->speed = 0;
+  ifl->next = NULL;
+  ifl->stats = NULL;
+
+  stats = tb[IFLA_STATS] ?
+    (struct rtnl_link_stats *) RTA_DATA (tb[IFLA_STATS]) : NULL;
+  if (stats)
+    {
+      /* copy the link statistics into the list structure 'ifl' */
+      ifl->stats = xmalloc (sizeof (struct ifstats));
+      ifl->stats->collisions = stats->collisions;
+      ifl->stats->multicast  = stats->multicast;
+      ifl->stats->tx_packets = stats->tx_packets;
+      ifl->stats->rx_packets = stats->rx_packets;
+      ifl->stats->tx_bytes   = stats->tx_bytes;
+      ifl->stats->rx_bytes   = stats->rx_bytes;
+      ifl->stats->tx_errors  = stats->tx_errors;
+      ifl->stats->rx_errors  = stats->rx_errors;
+      ifl->stats->tx_dropped = stats->tx_dropped;
+      ifl->stats->rx_dropped = stats->rx_dropped;
+    }
+  else
+    dbg ("no network interface stats for '%s'...\n", ifl->ifname);
+
+  return ifl;
+}
+
 #define IFLIST_REPLY_BUFFER	8192
 
 struct iflist *
-get_netinfo_snapshot (unsigned int options, const regex_t *if_regex)
+get_netinfo_snapshot (unsigned int options, unsigned int kinds,
+		      const regex_t *if_regex)
 {
   bool msg_done = false,
        opt_ignore_loopback = (options & NO_LOOPBACK),
-       opt_ignore_wireless = (options & NO_WIRELESS);
+       opt_ignore_wireless = (options & NO_WIRELESS),
+       opt_rollup = (options & ROLLUP_SLAVES);
   char reply[IFLIST_REPLY_BUFFER];
   int fd, ret;
   struct iflist *iflhead = NULL, *iflprev = NULL;
@@ -368,12 +621,7 @@ get_netinfo_snapshot (unsigned int options, const regex_t *if_regex)
 	  continue;
 	}
 
-      char name[IFNAMSIZ];
-      int attr_len;
       struct iflist *ifl;
-      struct ifinfomsg *ifi;
-      struct rtattr *tb[IFLA_MAX+1];
-      struct rtnl_link_stats *stats;
 
       for (h = (struct nlmsghdr *) reply;
 	   NLMSG_OK (h, len); h = NLMSG_NEXT (h, len))
@@ -386,69 +634,239 @@ get_netinfo_snapshot (unsigned int options, const regex_t *if_regex)
 	      msg_done = true;
 	      break;
 	    case RTM_NEWLINK:
-	      ifi = NLMSG_DATA (h);
-	      attr_len = h->nlmsg_len - NLMSG_LENGTH (sizeof (*ifi));
-
-	      parse_rtattr (tb, IFLA_MAX, IFLA_RTA (ifi), attr_len);
-	      if (NULL == tb[IFLA_IFNAME])
-		plugin_error (STATE_UNKNOWN, 0,
-			      "BUG: nil ifname returned by parse_rtattr()");
-
-	      strcpy (name, (char *) RTA_DATA (tb[IFLA_IFNAME]));
-
-	      bool is_loopback = if_flags_LOOPBACK (ifi->ifi_flags);
-	      bool is_wireless = link_wireless (name);
-	      bool skip_interface =
-		     ((is_loopback && opt_ignore_loopback)
-		      || (is_wireless && opt_ignore_wireless)
-		      || (regexec (if_regex, name, (size_t) 0, NULL, 0)));
+	      ifl = iflist_new_from_nlmsg (h);
+
+	      /* the slaves are kept until their counters are rolled up
+	       * into the master device, whatever the filters are */
+	      bool is_slave = opt_rollup && (ifl->master > 0);
+	      bool is_loopback = if_flags_LOOPBACK (ifl->flags);
+	      bool skip_interface = !is_slave
+		  && ((is_loopback && opt_ignore_loopback)
+		      || !(kinds & if_kind_class (ifl->kind, ifl->flags))
+		      || (regexec (if_regex, ifl->ifname, (size_t) 0, NULL, 0))
+		      || (opt_ignore_wireless && link_wireless (ifl->ifname)));
 	      if (skip_interface)
 		{
-		  dbg ("skipping network interface '%s'...\n", name);
+		  dbg ("skipping network interface '%s'...\n", ifl->ifname);
+		  freeiflist (ifl);
 		  continue;
 		}
 
-	      /* create a new list structure 'ifl' and initialize
-	       * all the members, except stats-related ones  */
-	      ifl = xmalloc (sizeof (struct iflist));
-	      ifl->ifname = xstrdup (name);
-	      ifl->flags = ifi->ifi_flags;
-	      check_link_speed (name, &(ifl->speed), &(ifl->duplex));
-
-	      ifl->next = NULL;
-	      ifl->stats = NULL;
+	      /* the slaves are not reported: no need for the ethtool
+	       * ioctls */
+	      if (!is_slave)
+		check_link_speed (ifl->ifname, &(ifl->speed), &(ifl->duplex));
 
 	      if (NULL == iflhead)
 		iflhead = ifl;
 	      else
 		iflprev->next = ifl;
 	      iflprev = ifl;
+	      break;
+	    }
+	}
+    }
+
+  close (fd);
+
+  if (opt_rollup)
+    iflhead = rollup_slaves (iflhead);
+
+  return iflhead;
+}
+
+#undef IFLIST_REPLY_BUFFER
+
+/* Get the name of the network interface with index 'ifindex' */
+static bool
+ifindex_to_name (int ctl_fd, int ifindex, char *name)
+{
+  struct ifreq ifr = {};
+
+  ifr.ifr_ifindex = ifindex;
+  if (ioctl (ctl_fd, SIOCGIFNAME, &ifr) < 0)
+    return false;
+
+  memcpy (name, ifr.ifr_name, IFNAMSIZ);
+  name[IFNAMSIZ - 1] = '\0';
+  return true;
+}
+
+/* Copy the TCA_STATS2 (or the legacy TCA_STATS) counters of a qdisc */
+static bool
+parse_qdisc_stats (struct rtattr *tb[], struct qdiscstats *qstats)
+{
+  memset (qstats, 0, sizeof (struct qdiscstats));
+
+  if (tb[TCA_STATS2])
+    {
+      struct rtattr *tbs[TCA_STATS_MAX + 1];
+      struct gnet_stats_basic bs;
+      struct gnet_stats_queue q;
+
+      parse_rtattr (tbs, TCA_STATS_MAX, RTA_DATA (tb[TCA_STATS2]),
+		    RTA_PAYLOAD (tb[TCA_STATS2]));
+      if (tbs[TCA_STATS_BASIC])
+	{
+	  memset (&bs, 0, sizeof (bs));
+	  memcpy (&bs, RTA_DATA (tbs[TCA_STATS_BASIC]),
+		  MIN (RTA_PAYLOAD (tbs[TCA_STATS_BASIC]), sizeof (bs)));
+	  qstats->bytes = bs.bytes;
+	  qstats->packets = bs.packets;
+	}
+      if (tbs[TCA_STATS_QUEUE])
+	{
+	  memset (&q, 0, sizeof (q));
+	  memcpy (&q, RTA_DATA (tbs[TCA_STATS_QUEUE]),
+		  MIN (RTA_PAYLOAD (tbs[TCA_STATS_QUEUE]), sizeof (q)));
+	  qstats->drops = q.drops;
+	  qstats->overlimits = q.overlimits;
+	  qstats->requeues = q.requeues;
+	  qstats->backlog = q.backlog;
+	  qstats->qlen = q.qlen;
+	}
+      return true;
+    }
+  else if (tb[TCA_STATS])
+    {
+      struct tc_stats st;
+
+      memset (&st, 0, sizeof (st));
+      memcpy (&st, RTA_DATA (tb[TCA_STATS]),
+	      MIN (RTA_PAYLOAD (tb[TCA_STATS]), sizeof (st)));
+      qstats->bytes = st.bytes;
+      qstats->packets = st.packets;
+      qstats->drops = st.drops;
+      qstats->overlimits = st.overlimits;
+      qstats->backlog = st.backlog;
+      qstats->qlen = st.qlen;
+      return true;
+    }
+
+  return false;
+}
+
+#define QDISC_REPLY_BUFFER	32768
+
+/* Dump the root queueing discipline of each network interface matching
+ * 'if_regex'.  The child qdiscs (mq children, htb leaves, ...) are skipped
+ * because their counters are already accounted in the root one. */
+
+struct qdisclist *
+get_qdisc_snapshot (const regex_t *if_regex)
+{
+  bool msg_done = false;
+  char reply[QDISC_REPLY_BUFFER];
+  int ctl_fd, fd, ret;
+  struct qdisclist *qdhead = NULL, *qdprev = NULL;
+
+  struct iovec iov;
+  struct sockaddr_nl kernel;
+
+  if ((ctl_fd = get_ctl_fd ()) < 0)
+    plugin_error (STATE_UNKNOWN, errno, "socket() failed");
+
+  fd = get_rtnl_fd ();
+  ret = sendmsg_rtnl_qdiscs_dump (fd, &iov, &kernel);
+  if (ret != 0)
+    plugin_error (STATE_UNKNOWN, ret, "error in sendmsg");
 
-	      stats = (struct rtnl_link_stats *) RTA_DATA (tb[IFLA_STATS]);
-	      if (stats)
+  while (!msg_done)
+    {
+      ssize_t len;
+      struct nlmsghdr *h;
+      struct msghdr rtnl_reply;
+
+      memset (&rtnl_reply, 0, sizeof (rtnl_reply));
+
+      iov.iov_base = reply;
+      iov.iov_len = QDISC_REPLY_BUFFER;
+      rtnl_reply.msg_iov = &iov;
+      rtnl_reply.msg_iovlen = 1;
+      rtnl_reply.msg_name = &kernel;
+      rtnl_reply.msg_namelen = sizeof (kernel);
+
+      if ((len = recvmsg (fd, &rtnl_reply, 0)) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  plugin_error (STATE_UNKNOWN, errno, "error in recvmsg");
+	}
+
+      char name[IFNAMSIZ];
+      const char *kind;
+      int attr_len;
+      struct qdisclist *qd;
+      struct qdiscstats qstats;
+      struct tcmsg *tcm;
+      struct rtattr *tb[TCA_MAX+1];
+
+      for (h = (struct nlmsghdr *) reply;
+	   NLMSG_OK (h, len); h = NLMSG_NEXT (h, len))
+	{
+	  switch (h->nlmsg_type)
+	    {
+	    case NLMSG_DONE:
+	      msg_done = true;
+	      break;
+	    case NLMSG_ERROR:
+	      {
+		struct nlmsgerr *err = NLMSG_DATA (h);
+		plugin_error (STATE_UNKNOWN, -err->error,
+			      "RTM_GETQDISC request failed");
+	      }
+	    case RTM_NEWQDISC:
+	      tcm = NLMSG_DATA (h);
+	      attr_len = h->nlmsg_len - NLMSG_LENGTH (sizeof (*tcm));
+
+	      if (tcm->tcm_parent != TC_H_ROOT)
+		continue;
+
+	      parse_rtattr (tb, TCA_MAX, TCA_RTA (tcm), attr_len);
+	      kind = tb[TCA_KIND] ? (const char *) RTA_DATA (tb[TCA_KIND])
+				  : "unknown";
+	      /* the "noqueue" pseudo-qdisc never queues any packet */
+	      if (STREQ (kind, "noqueue"))
+		continue;
+
+	      if (!ifindex_to_name (ctl_fd, tcm->tcm_ifindex, name))
+		{
+		  dbg ("qdisc %s: interface #%d has gone\n",
+		       kind, tcm->tcm_ifindex);
+		  continue;
+		}
+	      if (regexec (if_regex, name, (size_t) 0, NULL, 0))
+		{
+		  dbg ("skipping the qdisc of interface '%s'...\n", name);
+		  continue;
+		}
+	      if (!parse_qdisc_stats (tb, &qstats))
 		{
-		  /* copy the link statistics into the list structure 'ifl' */
-		  ifl->stats = xmalloc (sizeof (struct ifstats));
-		  ifl->stats->collisions = stats->collisions;
-		  ifl->stats->multicast  = stats->multicast;
-		  ifl->stats->tx_packets = stats->tx_packets;
-		  ifl->stats->rx_packets = stats->rx_packets;
-		  ifl->stats->tx_bytes   = stats->tx_bytes;
-		  ifl->stats->rx_bytes   = stats->rx_bytes;
-		  ifl->stats->tx_errors  = stats->tx_errors;
-		  ifl->stats->rx_errors  = stats->rx_errors;
-		  ifl->stats->tx_dropped = stats->tx_dropped;
-		  ifl->stats->rx_dropped = stats->rx_dropped;
+		  dbg ("no qdisc stats for interface '%s'...\n", name);
+		  continue;
 		}
+
+	      qd = xmalloc (sizeof (struct qdisclist));
+	      qd->ifname = xstrdup (name);
+	      qd->kind = xstrdup (kind);
+	      qd->ifindex = tcm->tcm_ifindex;
+	      qd->handle = tcm->tcm_handle;
+	      qd->stats = qstats;
+	      qd->next = NULL;
+
+	      if (NULL == qdhead)
+		qdhead = qd;
 	      else
-		dbg ("no network interface stats for '%s'...\n", name);
+		qdprev->next = qd;
+	      qdprev = qd;
 	      break;
 	    }
 	}
     }
 
+  close (ctl_fd);
   close (fd);
-  return iflhead;
+  return qdhead;
 }
 
-#undef IFLIST_REPLY_BUFFER
+#undef QDISC_REPLY_BUFFER
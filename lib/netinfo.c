@@ -36,13 +36,14 @@
 #include "netinfo.h"
 #include "netinfo-private.h"
 #include "system.h"
+#include "xalloc.h"
 #include "xasprintf.h"
 
 extern char *const duplex_table[];
 
 struct iflist *
-netinfo (unsigned int options, const char *ifname_regex, unsigned int seconds,
-	 unsigned int *ninterfaces)
+netinfo (unsigned int options, unsigned int kinds, const char *ifname_regex,
+	 unsigned int seconds, unsigned int *ninterfaces)
 {
   bool opt_check_link = (options & CHECK_LINK);
   char msgbuf[256];
@@ -58,14 +59,14 @@ netinfo (unsigned int options, const char *ifname_regex, unsigned int seconds,
     }
 
   dbg ("getting network informations...\n");
-  iflhead = get_netinfo_snapshot (options, &regex);
+  iflhead = get_netinfo_snapshot (options, kinds, &regex);
 
   if (seconds > 0)
     {
       sleep (seconds);
 
       dbg ("getting network informations again (after %us)...\n", seconds);
-      iflhead2 = get_netinfo_snapshot (options, &regex);
+      iflhead2 = get_netinfo_snapshot (options, kinds, &regex);
 
       *ninterfaces = 0;
       for (ifl = iflhead, ifl2 = iflhead2; ifl != NULL && ifl2 != NULL;
@@ -157,6 +158,94 @@ netinfo (unsigned int options, const char *ifname_regex, unsigned int seconds,
   return iflhead;
 }
 
+static struct qdisclist *
+qdisclist_lookup (struct qdisclist *qdhead, int ifindex, uint32_t handle)
+{
+  struct qdisclist *qd;
+
+  for (qd = qdhead; qd != NULL; qd = qd->next)
+    if (qd->ifindex == ifindex && qd->handle == handle)
+      return qd;
+
+  return NULL;
+}
+
+struct qdisclist *
+qdiscinfo (const char *ifname_regex, unsigned int seconds,
+	   unsigned int *nqdiscs)
+{
+  char msgbuf[256];
+  int rc;
+  regex_t regex;
+  struct qdisclist *qdhead, *qdhead2, *qd, *qd2, **pqd;
+
+  if ((rc =
+       regcomp (&regex, ifname_regex ? ifname_regex : ".*", REG_EXTENDED)))
+    {
+      regerror (rc, &regex, msgbuf, sizeof (msgbuf));
+      plugin_error (STATE_UNKNOWN, 0, "could not compile regex: %s", msgbuf);
+    }
+
+  dbg ("getting qdisc informations...\n");
+  qdhead = get_qdisc_snapshot (&regex);
+  *nqdiscs = 0;
+
+  if (seconds > 0)
+    {
+      sleep (seconds);
+
+      dbg ("getting qdisc informations again (after %us)...\n", seconds);
+      qdhead2 = get_qdisc_snapshot (&regex);
+
+      for (pqd = &qdhead; *pqd != NULL; )
+	{
+	  qd = *pqd;
+	  qd2 = qdisclist_lookup (qdhead2, qd->ifindex, qd->handle);
+	  if (NULL == qd2)
+	    {
+	      dbg ("the qdisc of '%s' has been replaced or removed\n",
+		   qd->ifname);
+	      *pqd = qd->next;
+	      qd->next = NULL;
+	      freeqdisclist (qd);
+	      continue;
+	    }
+
+	  dbg ("qdisc %s on '%s'\n", qd->kind, qd->ifname);
+#define DIV(a, b) ceil (((b) - (a)) / (double)seconds)
+#define __qdisc_rate__(arg) \
+  dbg ("\t%-10s : %llu %llu\n", #arg, \
+       (unsigned long long) qd->stats.arg, \
+       (unsigned long long) qd2->stats.arg); \
+  qd->stats.arg = DIV (qd->stats.arg, qd2->stats.arg)
+	  __qdisc_rate__ (bytes);
+	  __qdisc_rate__ (packets);
+	  __qdisc_rate__ (drops);
+	  __qdisc_rate__ (overlimits);
+	  __qdisc_rate__ (requeues);
+#undef __qdisc_rate__
+#undef DIV
+	  /* backlog and qlen are gauges: report the last values */
+	  qd->stats.backlog = qd2->stats.backlog;
+	  qd->stats.qlen = qd2->stats.qlen;
+	  dbg ("\tbacklog    : %uB (%u packets)\n",
+	       qd->stats.backlog, qd->stats.qlen);
+
+	  (*nqdiscs)++;
+	  pqd = &qd->next;
+	}
+
+      freeqdisclist (qdhead2);
+    }
+  else
+    for (qd = qdhead; qd != NULL; qd = qd->next)
+      (*nqdiscs)++;
+
+  regfree (&regex);
+
+  return qdhead;
+}
+
 struct iflist *
 iflist_get_next (struct iflist *ifentry)
 {
@@ -171,6 +260,12 @@ iflist_get_ifname (struct iflist *ifentry)
   return ifentry->ifname;
 }
 
+const char *
+iflist_get_kind (struct iflist *ifentry)
+{
+  return ifentry->kind;
+}
+
 uint8_t
 iflist_get_duplex (struct iflist *ifentry)
 {
@@ -208,6 +303,39 @@ __iflist_get__(tx_dropped)
 __iflist_get__(rx_dropped)
 #undef __iflist_get__
 
+/* Accessing the values from struct qdisclist */
+
+struct qdisclist *
+qdisclist_get_next (struct qdisclist *qdentry)
+{
+  return qdentry->next;
+}
+
+const char *
+qdisclist_get_ifname (struct qdisclist *qdentry)
+{
+  return qdentry->ifname;
+}
+
+const char *
+qdisclist_get_kind (struct qdisclist *qdentry)
+{
+  return qdentry->kind;
+}
+
+#define __qdisclist_get__(type, arg) \
+type qdisclist_get_ ## arg (struct qdisclist *qdentry) \
+  { return qdentry->stats.arg; }
+
+__qdisclist_get__(unsigned long long, bytes)
+__qdisclist_get__(unsigned int, packets)
+__qdisclist_get__(unsigned int, drops)
+__qdisclist_get__(unsigned int, overlimits)
+__qdisclist_get__(unsigned int, requeues)
+__qdisclist_get__(unsigned int, backlog)
+__qdisclist_get__(unsigned int, qlen)
+#undef __qdisclist_get__
+
 /* Print the list of network interfaces (for debug) */
 
 void print_ifname_debug (struct iflist *iflhead, unsigned int options)
@@ -245,12 +373,18 @@ void print_ifname_debug (struct iflist *iflhead, unsigned int options)
 	ifspeed = xasprintf (" link-speed:%uMbps", ifl->speed);
       if (ifl->duplex != _DUP_UNKNOWN)
 	ifduplex = xasprintf (" %s-duplex", duplex_table[ifl->duplex]);
-      printf ("%s%s%s%s\n"
+      printf ("%s [%s]%s%s%s\n"
 	      , ifl->ifname
+	      , ifl->kind ? ifl->kind
+			  : if_flags_LOOPBACK (ifl->flags) ? "loopback"
+							   : "physical"
 	      , if_up && !if_running ? " (NO-CARRIER)"
 				     : if_up ? "" : " (DOWN)"
 	      , ifspeed ? ifspeed : ""
 	      , ifduplex ? ifduplex : "");
+      /* the bridge counters do not include the ones of its ports */
+      if (ifl->ports)
+	printf (" - ports: %s (not summed)\n", ifl->ports);
 
       if (ifl->stats)
 	{
@@ -280,11 +414,82 @@ freeiflist (struct iflist *iflhead)
     {
       iflnext = ifl->next;
       free (ifl->ifname);
+      free (ifl->kind);
+      free (ifl->ports);
+      free (ifl->stats);
       free (ifl);
       ifl = iflnext;
     }
 }
 
+/* Print the list of queueing disciplines (for debug) */
+
+void
+print_qdisc_debug (struct qdisclist *qdhead)
+{
+  struct qdisclist *qd;
+
+  for (qd = qdhead; qd != NULL; qd = qd->next)
+    {
+      printf ("%s qdisc %s %x:\n", qd->ifname, qd->kind, qd->handle >> 16);
+      printf (" - %s_qdrop/s\t %s_qbacklog\n", qd->ifname, qd->ifname);
+      printf (" - %s_qoverlimit/s\t %s_qrequeue/s\n",
+	      qd->ifname, qd->ifname);
+    }
+}
+
+void
+freeqdisclist (struct qdisclist *qdhead)
+{
+  struct qdisclist *qd = qdhead, *qdnext;
+
+  while (qd != NULL)
+    {
+      qdnext = qd->next;
+      free (qd->ifname);
+      free (qd->kind);
+      free (qd);
+      qd = qdnext;
+    }
+}
+
+/* Parse a comma-separated list of interface kinds and return the
+ * corresponding IF_KIND_* bitmask */
+unsigned int
+if_kinds_parse (const char *list)
+{
+  static const struct
+  {
+    const char *name;
+    unsigned int kind;
+  } kinds_table[] = {
+    { "all",      IF_KIND_ALL      },
+    { "bond",     IF_KIND_BOND     },
+    { "bridge",   IF_KIND_BRIDGE   },
+    { "other",    IF_KIND_OTHER    },
+    { "physical", IF_KIND_PHYSICAL },
+    { "veth",     IF_KIND_VETH     },
+    { "vlan",     IF_KIND_VLAN     }
+  };
+  char *copy = xstrdup (list), *token, *saveptr;
+  unsigned int kinds = 0;
+
+  for (token = strtok_r (copy, ",", &saveptr); token;
+       token = strtok_r (NULL, ",", &saveptr))
+    {
+      size_t i, ntable = sizeof (kinds_table) / sizeof (kinds_table[0]);
+      for (i = 0; i < ntable; i++)
+	if (STREQ (token, kinds_table[i].name))
+	  break;
+      if (i == ntable)
+	plugin_error (STATE_UNKNOWN, 0, "unknown interface kind: %s", token);
+      kinds |= kinds_table[i].kind;
+    }
+
+  free (copy);
+  return kinds;
+}
+
 /* helper functions for parsing interface flags */
 #define ifa_flags_parser(arg) \
 bool if_flags_ ## arg (unsigned int flags) \
@@ -0,0 +1,449 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A library for getting the network statistics of all the network
+ * namespaces (container hosts, 'ip netns' managed namespaces).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE /* activate extra prototypes for glibc */
+#endif
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <regex.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/ethtool.h>
+#ifndef HAVE_SETNS
+# include <sys/syscall.h>
+#endif
+
+#include "common.h"
+#include "logging.h"
+#include "messages.h"
+#include "netinfo.h"
+#include "netinfo-private.h"
+#include "netns.h"
+#include "string-macros.h"
+#include "system.h"
+#include "xalloc.h"
+#include "xasprintf.h"
+
+#define NETNS_RUN_DIR		"/run/netns"
+#define NETNS_PROC_ROOT		"/proc"
+#define NETNS_MAX_WORKERS	16
+
+#ifndef HAVE_SETNS
+static int
+setns (int fd, int nstype)
+{
+  return syscall (__NR_setns, fd, nstype);
+}
+#endif
+
+/* A candidate namespace file, before the deduplication by inode */
+struct netns_candidate
+{
+  dev_t dev;
+  ino_t inode;
+  unsigned int order;	/* discovery order: the first name found wins */
+  char *name;
+  char *path;
+};
+
+struct netns_candidates
+{
+  struct netns_candidate *items;
+  size_t nitems;
+  size_t capacity;
+};
+
+static void
+netns_candidate_add (struct netns_candidates *cands, char *name, char *path)
+{
+  struct stat st;
+
+  if (stat (path, &st) < 0)
+    {
+      dbg ("cannot stat %s: %s\n", path, strerror (errno));
+      free (name);
+      free (path);
+      return;
+    }
+
+  if (cands->nitems == cands->capacity)
+    {
+      cands->capacity = cands->capacity ? 2 * cands->capacity : 64;
+      cands->items = xrealloc (cands->items,
+			       cands->capacity * sizeof (*cands->items));
+    }
+
+  struct netns_candidate *c = &cands->items[cands->nitems];
+  c->dev = st.st_dev;
+  c->inode = st.st_ino;
+  c->order = cands->nitems++;
+  c->name = name;
+  c->path = path;
+}
+
+static int
+netns_candidate_cmp_inode (const void *a, const void *b)
+{
+  const struct netns_candidate *ca = a, *cb = b;
+
+  if (ca->dev != cb->dev)
+    return ca->dev < cb->dev ? -1 : 1;
+  if (ca->inode != cb->inode)
+    return ca->inode < cb->inode ? -1 : 1;
+  return ca->order < cb->order ? -1 : (ca->order > cb->order);
+}
+
+static int
+netns_candidate_cmp_order (const void *a, const void *b)
+{
+  const struct netns_candidate *ca = a, *cb = b;
+  return ca->order < cb->order ? -1 : (ca->order > cb->order);
+}
+
+static void
+netns_scan_run_dir (struct netns_candidates *cands)
+{
+  DIR *dirp;
+  struct dirent *dp;
+
+  if ((dirp = opendir (NETNS_RUN_DIR)) == NULL)
+    {
+      dbg ("cannot open %s: %s\n", NETNS_RUN_DIR, strerror (errno));
+      return;
+    }
+
+  while ((dp = readdir (dirp)) != NULL)
+    {
+      if (dp->d_name[0] == '.')
+	continue;
+      netns_candidate_add (cands, xstrdup (dp->d_name),
+			   xasprintf (NETNS_RUN_DIR "/%s", dp->d_name));
+    }
+
+  closedir (dirp);
+}
+
+static void
+netns_scan_proc (struct netns_candidates *cands)
+{
+  DIR *dirp;
+  struct dirent *dp;
+
+  if ((dirp = opendir (NETNS_PROC_ROOT)) == NULL)
+    plugin_error (STATE_UNKNOWN, errno, "cannot open %s", NETNS_PROC_ROOT);
+
+  while ((dp = readdir (dirp)) != NULL)
+    {
+      if (!isdigit ((unsigned char) dp->d_name[0]))
+	continue;
+      netns_candidate_add (cands, xasprintf ("pid%s", dp->d_name),
+			   xasprintf (NETNS_PROC_ROOT "/%s/ns/net",
+				      dp->d_name));
+    }
+
+  closedir (dirp);
+}
+
+/* Return the list of the network namespaces, deduplicated by inode.
+ * The namespace of the running process comes first and is named
+ * "default", then the named namespaces, then the ones only reachable
+ * via a process.  */
+
+static struct netnsinfo *
+netns_enumerate (unsigned int *nnamespaces)
+{
+  struct netns_candidates cands = { NULL, 0, 0 };
+  struct netnsinfo *nslist;
+  size_t i, nuniq = 0;
+
+  netns_candidate_add (&cands, xstrdup ("default"),
+		       xstrdup (NETNS_PROC_ROOT "/self/ns/net"));
+  netns_scan_run_dir (&cands);
+  netns_scan_proc (&cands);
+
+  if (cands.nitems == 0)
+    plugin_error (STATE_UNKNOWN, 0, "no network namespace found");
+
+  /* sort by inode, keep the first discovered name of each namespace,
+   * then restore the discovery order */
+  qsort (cands.items, cands.nitems, sizeof (*cands.items),
+	 netns_candidate_cmp_inode);
+  for (i = 0; i < cands.nitems; i++)
+    {
+      struct netns_candidate *c = &cands.items[i];
+      if (nuniq > 0
+	  && c->dev == cands.items[nuniq - 1].dev
+	  && c->inode == cands.items[nuniq - 1].inode)
+	{
+	  free (c->name);
+	  free (c->path);
+	  continue;
+	}
+      cands.items[nuniq++] = *c;
+    }
+  qsort (cands.items, nuniq, sizeof (*cands.items),
+	 netns_candidate_cmp_order);
+
+  nslist = xnmalloc (nuniq, sizeof (struct netnsinfo));
+  memset (nslist, 0, nuniq * sizeof (struct netnsinfo));
+  for (i = 0; i < nuniq; i++)
+    {
+      nslist[i].name = cands.items[i].name;
+      nslist[i].path = cands.items[i].path;
+      nslist[i].dev = cands.items[i].dev;
+      nslist[i].inode = cands.items[i].inode;
+      dbg ("network namespace '%s' (inode %lu)\n",
+	   nslist[i].name, (unsigned long) nslist[i].inode);
+    }
+
+  free (cands.items);
+  *nnamespaces = nuniq;
+  return nslist;
+}
+
+/* The work shared by the helper threads: each one picks the next
+ * namespace to be processed, moves into it with setns() (which only
+ * affects the calling thread) and takes a netlink snapshot there.  */
+
+struct netns_pool
+{
+  struct netnsinfo *nslist;
+  struct iflist **snapshots;
+  unsigned int nnamespaces;
+  unsigned int next;
+  unsigned int options;
+  unsigned int kinds;
+  const regex_t *if_regex;
+};
+
+static void *
+netns_snapshot_worker (void *arg)
+{
+  struct netns_pool *pool = arg;
+  unsigned int i;
+
+  while ((i = __atomic_fetch_add (&pool->next, 1, __ATOMIC_RELAXED))
+	 < pool->nnamespaces)
+    {
+      struct netnsinfo *ns = &pool->nslist[i];
+      int fd;
+
+      if (ns->error)
+	continue;
+
+      if ((fd = open (ns->path, O_RDONLY | O_CLOEXEC)) < 0)
+	{
+	  ns->error = errno;
+	  dbg ("cannot open %s: %s\n", ns->path, strerror (errno));
+	  continue;
+	}
+      if (setns (fd, CLONE_NEWNET) < 0)
+	{
+	  ns->error = errno;
+	  dbg ("setns (%s) failed: %s\n", ns->path, strerror (errno));
+	  close (fd);
+	  continue;
+	}
+      close (fd);
+
+      pool->snapshots[i] =
+	get_netinfo_snapshot (pool->options, pool->kinds, pool->if_regex);
+    }
+
+  return NULL;
+}
+
+static void
+netns_snapshot (struct netns_pool *pool)
+{
+  pthread_t workers[NETNS_MAX_WORKERS];
+  unsigned int i, nworkers;
+  int err;
+
+  nworkers = (pool->nnamespaces < NETNS_MAX_WORKERS) ?
+	     pool->nnamespaces : NETNS_MAX_WORKERS;
+  pool->next = 0;
+
+  for (i = 0; i < nworkers; i++)
+    if ((err = pthread_create (&workers[i], NULL, netns_snapshot_worker,
+			       pool)))
+      plugin_error (STATE_UNKNOWN, err, "pthread_create() failed");
+  for (i = 0; i < nworkers; i++)
+    pthread_join (workers[i], NULL);
+}
+
+static struct iflist *
+netns_iflist_lookup (struct iflist *iflhead, const char *ifname)
+{
+  struct iflist *ifl;
+
+  for (ifl = iflhead; ifl != NULL; ifl = ifl->next)
+    if (STREQ (ifl->ifname, ifname))
+      return ifl;
+
+  return NULL;
+}
+
+#define NETNS_STATS_FOREACH(op) \
+  op (tx_packets); op (rx_packets); op (tx_bytes); op (rx_bytes); \
+  op (tx_errors); op (rx_errors); op (tx_dropped); op (rx_dropped); \
+  op (collisions); op (multicast)
+
+/* Sum the statistics of the interfaces in 'iflhead' or, when 'iflhead2'
+ * is not NULL, the per-second rates computed from the two snapshots.
+ * Interfaces appearing or disappearing between them are ignored.  */
+
+static void
+netns_aggregate (struct netnsinfo *ns, struct iflist *iflhead,
+		 struct iflist *iflhead2, unsigned int seconds)
+{
+  struct iflist *ifl, *ifl2;
+
+  memset (&ns->stats, 0, sizeof (ns->stats));
+  ns->ninterfaces = 0;
+
+  for (ifl = iflhead; ifl != NULL; ifl = ifl->next)
+    {
+      if (NULL == ifl->stats)
+	continue;
+
+      if (NULL == iflhead2)
+	{
+#define SUM(counter) ns->stats.counter += ifl->stats->counter
+	  NETNS_STATS_FOREACH (SUM);
+#undef SUM
+	}
+      else
+	{
+	  ifl2 = netns_iflist_lookup (iflhead2, ifl->ifname);
+	  if (NULL == ifl2 || NULL == ifl2->stats)
+	    continue;
+#define SUM(counter) \
+  ns->stats.counter += ceil ((ifl2->stats->counter - ifl->stats->counter) \
+			     / (double) seconds)
+	  NETNS_STATS_FOREACH (SUM);
+#undef SUM
+	}
+
+      ns->ninterfaces++;
+    }
+}
+
+#undef NETNS_STATS_FOREACH
+
+struct netnsinfo *
+netns_netinfo (unsigned int options, unsigned int kinds,
+	       const char *ifname_regex,
+	       unsigned int seconds, unsigned int *nnamespaces)
+{
+  char msgbuf[256];
+  int rc;
+  regex_t regex;
+  unsigned int i, nreachable = 0;
+  struct netns_pool pool;
+  struct iflist **snapshots2 = NULL;
+
+  if ((rc =
+       regcomp (&regex, ifname_regex ? ifname_regex : ".*", REG_EXTENDED)))
+    {
+      regerror (rc, &regex, msgbuf, sizeof (msgbuf));
+      plugin_error (STATE_UNKNOWN, 0, "could not compile regex: %s", msgbuf);
+    }
+
+  memset (&pool, 0, sizeof (pool));
+  pool.nslist = netns_enumerate (&pool.nnamespaces);
+  pool.snapshots = xnmalloc (pool.nnamespaces, sizeof (struct iflist *));
+  memset (pool.snapshots, 0, pool.nnamespaces * sizeof (struct iflist *));
+  pool.options = options;
+  pool.kinds = kinds;
+  pool.if_regex = &regex;
+
+  dbg ("getting network informations for %u namespace(s)...\n",
+       pool.nnamespaces);
+  netns_snapshot (&pool);
+
+  if (seconds > 0)
+    {
+      snapshots2 = pool.snapshots;
+      pool.snapshots = xnmalloc (pool.nnamespaces, sizeof (struct iflist *));
+      memset (pool.snapshots, 0,
+	      pool.nnamespaces * sizeof (struct iflist *));
+
+      sleep (seconds);
+
+      dbg ("getting network informations again (after %us)...\n", seconds);
+      netns_snapshot (&pool);
+    }
+
+  for (i = 0; i < pool.nnamespaces; i++)
+    {
+      struct netnsinfo *ns = &pool.nslist[i];
+
+      if (!ns->error)
+	{
+	  nreachable++;
+	  if (seconds > 0)
+	    netns_aggregate (ns, snapshots2[i], pool.snapshots[i], seconds);
+	  else
+	    netns_aggregate (ns, pool.snapshots[i], NULL, 0);
+	}
+
+      if (snapshots2)
+	freeiflist (snapshots2[i]);
+      freeiflist (pool.snapshots[i]);
+    }
+
+  if (nreachable == 0)
+    plugin_error (STATE_UNKNOWN, pool.nslist[0].error,
+		  "cannot enter any network namespace");
+
+  free (snapshots2);
+  free (pool.snapshots);
+  regfree (&regex);
+
+  *nnamespaces = pool.nnamespaces;
+  return pool.nslist;
+}
+
+void
+netns_free (struct netnsinfo *nslist, unsigned int nnamespaces)
+{
+  unsigned int i;
+
+  for (i = 0; i < nnamespaces; i++)
+    {
+      free (nslist[i].name);
+      free (nslist[i].path);
+    }
+  free (nslist);
+}
@@ -130,3 +130,22 @@ linelookup (char *line, char *pattern, char **value)
   *value = xstrdup (v);
   return 1;
 }
+
+char *
+procparser_boot_id (const char *path)
+{
+  char buf[64];
+  ssize_t len;
+  int fd;
+
+  if ((fd = open (path, O_RDONLY | O_CLOEXEC)) < 0)
+    return NULL;
+  len = read (fd, buf, sizeof (buf) - 1);
+  close (fd);
+  if (len < 1)
+    return NULL;
+
+  buf[len] = '\0';
+  buf[strcspn (buf, "\n")] = '\0';
+  return xstrdup (buf);
+}
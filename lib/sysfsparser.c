@@ -31,6 +31,7 @@
 #include <ctype.h>
 #include <dirent.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -42,6 +43,7 @@
 #include "string-macros.h"
 #include "messages.h"
 #include "sysfsparser.h"
+#include "xalloc.h"
 #include "xasprintf.h"
 
 #define PATH_SYS_SYSTEM		PATH_SYS "/devices/system"
@@ -100,31 +102,46 @@ sysfsparser_check_for_sysfs (void)
 		  "The sysfs filesystem (" PATH_SYS ") is not mounted");
 }
 
+/* Expand the printf-like 'format' in 'filename' (PATH_MAX bytes).
+ * Return false if the resulting path does not fit.  */
+
+static bool _attribute_format_printf_ (2, 0)
+sysfsparser_vpath (char *filename, const char *format, va_list args)
+{
+  int len = vsnprintf (filename, PATH_MAX, format, args);
+  if (len < 0)
+    plugin_error (STATE_UNKNOWN, errno, "vsnprintf has failed");
+
+  return len < PATH_MAX;
+}
+
 bool
 sysfsparser_path_exist (const char *path, ...)
 {
-  char *filename;
+  char filename[PATH_MAX];
+  bool valid;
   va_list args;
 
   va_start (args, path);
-  if (vasprintf (&filename, path, args) < 0)
-    plugin_error (STATE_UNKNOWN, errno, "vasprintf has failed");
+  valid = sysfsparser_vpath (filename, path, args);
   va_end (args);
 
-  return access (filename, F_OK) == 0;
+  return valid && access (filename, F_OK) == 0;
 }
 
 void
 sysfsparser_opendir(DIR **dirp, const char *path, ...)
 {
-  char *dirname;
+  char dirname[PATH_MAX];
+  bool valid;
   va_list args;
 
   va_start (args, path);
-  if (vasprintf (&dirname, path, args) < 0)
-    plugin_error (STATE_UNKNOWN, errno, "vasprintf has failed");
+  valid = sysfsparser_vpath (dirname, path, args);
   va_end (args);
 
+  if (!valid)
+    plugin_error (STATE_UNKNOWN, ENAMETOOLONG, "Cannot open %s", dirname);
   if ((*dirp = opendir (dirname)) == NULL)
     plugin_error (STATE_UNKNOWN, errno, "Cannot open %s", dirname);
 }
@@ -162,16 +179,19 @@ char *
 sysfsparser_getline (const char *format, ...)
 {
   FILE *fp;
-  char *filename, *line = NULL;
+  char filename[PATH_MAX], *line = NULL;
   size_t len = 0;
   ssize_t chread;
+  bool valid;
   va_list args;
 
   va_start (args, format);
-  if (vasprintf (&filename, format, args) < 0)
-    plugin_error (STATE_UNKNOWN, errno, "vasprintf has failed");
+  valid = sysfsparser_vpath (filename, format, args);
   va_end (args);
 
+  if (!valid)
+    return NULL;
+
   dbg ("reading sysfs data: %s\n", filename);
   if ((fp = fopen (filename, "r")) == NULL)
     {
@@ -183,7 +203,10 @@ sysfsparser_getline (const char *format, ...)
   fclose (fp);
 
   if (chread < 1)
-    return NULL;
+    {
+      free (line);
+      return NULL;
+    }
 
   len = strlen (line);
   if (line[len-1] == '\n')
@@ -193,28 +216,176 @@ sysfsparser_getline (const char *format, ...)
   return line;
 }
 
+/* Convert the content of a sysfs attribute to a number */
+
+static int
+sysfsparser_strtoull (const char *buf, unsigned long long *value)
+{
+  char *endptr;
+
+  errno = 0;
+  *value = strtoull (buf, &endptr, 0);
+  if ((endptr == buf) || (errno == ERANGE))
+    return -1;
+
+  return 0;
+}
+
 int
 sysfsparser_getvalue (unsigned long long *value, const char *format, ...)
 {
-  char *line, *endptr, *filename;
-  int retvalue = 0;
+  char filename[PATH_MAX], buf[SYSFSPARSER_VALUE_MAX];
+  bool valid;
   va_list args;
 
   va_start (args, format);
-  if (vasprintf (&filename, format, args) < 0)
-    plugin_error (STATE_UNKNOWN, errno, "vasprintf has failed");
+  valid = sysfsparser_vpath (filename, format, args);
   va_end (args);
 
-  if (NULL == (line = sysfsparser_getline ("%s", filename)))
+  if (!valid
+      || sysfsparser_read_at (AT_FDCWD, filename, buf, sizeof buf) < 1)
     return -1;
 
-  errno = 0;
-  *value = strtoull (line, &endptr, 0);
-  if ((endptr == line) || (errno == ERANGE))
-    retvalue = -1;
+  return sysfsparser_strtoull (buf, value);
+}
+
+/* The directories of the devices are opened with O_PATH and kept in a
+ * small cache, so that reading several attributes of a device, or the
+ * same attributes at every sampling, costs one openat(), one pread() and
+ * one close() per attribute, without heap allocations or path lookups
+ * from the root of sysfs.  */
+
+#define SYSFSPARSER_DIRFD_CACHE_SIZE	64
+
+static struct sysfsparser_dirfd_cache
+{
+  char *path;
+  int fd;
+} dirfd_cache[SYSFSPARSER_DIRFD_CACHE_SIZE];
+static unsigned int dirfd_cache_next;
+
+int
+sysfsparser_opendirfd (const char *format, ...)
+{
+  struct sysfsparser_dirfd_cache *slot;
+  char dirname[PATH_MAX];
+  unsigned int i;
+  bool valid;
+  va_list args;
+  int fd;
+
+  va_start (args, format);
+  valid = sysfsparser_vpath (dirname, format, args);
+  va_end (args);
+
+  if (!valid)
+    return -ENAMETOOLONG;
+
+  for (i = 0; i < SYSFSPARSER_DIRFD_CACHE_SIZE; i++)
+    if (dirfd_cache[i].path && STREQ (dirfd_cache[i].path, dirname))
+      return dirfd_cache[i].fd;
+
+  dbg ("opening sysfs directory: %s\n", dirname);
+  if ((fd = open (dirname, O_PATH | O_DIRECTORY | O_CLOEXEC)) < 0)
+    {
+      dbg ("  \\ error: %s\n", strerror (errno));
+      return -errno;
+    }
+
+  /* replace the oldest directory in the cache */
+  slot = &dirfd_cache[dirfd_cache_next];
+  dirfd_cache_next = (dirfd_cache_next + 1) % SYSFSPARSER_DIRFD_CACHE_SIZE;
+  if (slot->path)
+    {
+      close (slot->fd);
+      free (slot->path);
+    }
+  slot->path = xstrdup (dirname);
+  slot->fd = fd;
+
+  return fd;
+}
 
-  free (line);
-  return retvalue;
+void
+sysfsparser_closedirfds (void)
+{
+  unsigned int i;
+
+  for (i = 0; i < SYSFSPARSER_DIRFD_CACHE_SIZE; i++)
+    if (dirfd_cache[i].path)
+      {
+	close (dirfd_cache[i].fd);
+	free (dirfd_cache[i].path);
+	dirfd_cache[i].path = NULL;
+      }
+  dirfd_cache_next = 0;
+}
+
+ssize_t
+sysfsparser_read_at (int dirfd, const char *name, char *buf, size_t size)
+{
+  ssize_t chread;
+  int fd;
+
+  if (size < 1)
+    return -EINVAL;
+
+  if ((fd = openat (dirfd, name, O_RDONLY | O_CLOEXEC)) < 0)
+    {
+      dbg ("reading sysfs data: %s\n  \\ error: %s\n", name,
+	   strerror (errno));
+      return -errno;
+    }
+
+  /* sysfs returns the whole attribute at the first read */
+  do
+    chread = pread (fd, buf, size - 1, 0);
+  while (chread < 0 && errno == EINTR);
+  if (chread < 0)
+    chread = -errno;
+  close (fd);
+
+  if (chread < 0)
+    return chread;
+
+  buf[chread] = '\0';
+  if (chread > 0 && buf[chread - 1] == '\n')
+    buf[--chread] = '\0';
+
+  dbg ("reading sysfs data: %s\n  \\ \"%s\"\n", name, buf);
+  return chread;
+}
+
+int
+sysfsparser_getvalue_at (int dirfd, const char *name,
+			 unsigned long long *value)
+{
+  char buf[SYSFSPARSER_VALUE_MAX];
+
+  if (sysfsparser_read_at (dirfd, name, buf, sizeof buf) < 1)
+    return -1;
+
+  return sysfsparser_strtoull (buf, value);
+}
+
+unsigned int
+sysfsparser_getvalues_at (int dirfd, struct sysfsparser_attr *attrs,
+			  size_t nattrs)
+{
+  unsigned int nread = 0;
+  size_t i;
+
+  for (i = 0; i < nattrs; i++)
+    {
+      attrs[i].err =
+	sysfsparser_getvalue_at (dirfd, attrs[i].name, &attrs[i].value);
+      if (attrs[i].err < 0)
+	attrs[i].value = 0;
+      else
+	nread++;
+    }
+
+  return nread;
 }
 
 int
@@ -238,24 +409,20 @@ static unsigned long
 sysfsparser_cpufreq_get_value (unsigned int cpunum,
 			       enum sysfsparser_cpufreq_sysfile_numeric_id which)
 {
-  char *line, *endptr;
-  long value;
+  unsigned long long value;
+  int dirfd;
 
   if (which >= MAX_VALUE_FILES)
     return 0;
 
-  line =
-    sysfsparser_getline (PATH_SYS_CPU "/cpu%u/cpufreq/%s", cpunum,
-			 sysfsparser_devices_system_cpu_file_numeric[which]);
-  if (NULL == line)
+  dirfd = sysfsparser_opendirfd (PATH_SYS_CPU "/cpu%u/cpufreq", cpunum);
+  if (dirfd < 0
+      || sysfsparser_getvalue_at (dirfd,
+				  sysfsparser_devices_system_cpu_file_numeric
+				  [which], &value) < 0
+      || value > ULONG_MAX)
     return 0;
 
-  errno = 0;
-  value = strtoul (line, &endptr, 10);
-  if ((endptr == line) || (errno == ERANGE))
-    value = 0;
-
-  free (line);
   return value;
 }
 
@@ -263,23 +430,21 @@ static char *
 sysfsparser_cpufreq_get_string (unsigned int cpunum,
 				enum sysfsparser_cpufreq_sysfile_string_id which)
 {
-  char *line;
-  size_t len = 0;
+  /* the sysfs attributes are at most one page long */
+  char buf[4096];
+  int dirfd;
 
   if (which >= MAX_STRING_FILES)
     return NULL;
 
-  line =
-    sysfsparser_getline (PATH_SYS_CPU "/cpu%u/cpufreq/%s", cpunum,
-			 sysfsparser_devices_system_cpu_file_string[which]);
-  if (NULL == line)
-    return 0;
-
-  len = strlen (line);
-  if (line[len-1] == '\n')
-    line[len-1] = '\0';
+  dirfd = sysfsparser_opendirfd (PATH_SYS_CPU "/cpu%u/cpufreq", cpunum);
+  if (dirfd < 0
+      || sysfsparser_read_at (dirfd,
+			      sysfsparser_devices_system_cpu_file_string[which],
+			      buf, sizeof buf) < 1)
+    return NULL;
 
-  return line;
+  return xstrdup (buf);
 }
 
 /* CPU Freq functions  */
@@ -289,15 +454,23 @@ sysfsparser_cpufreq_get_hardware_limits (unsigned int cpu,
 					 unsigned long *min,
 					 unsigned long *max)
 {
+  struct sysfsparser_attr limits[] = {
+    { .name = sysfsparser_devices_system_cpu_file_numeric[CPUINFO_MIN_FREQ] },
+    { .name = sysfsparser_devices_system_cpu_file_numeric[CPUINFO_MAX_FREQ] }
+  };
+  int dirfd;
+
   if ((!min) || (!max))
     return -EINVAL;
 
-  *min = sysfsparser_cpufreq_get_value (cpu, CPUINFO_MIN_FREQ);
-  if (!*min)
+  dirfd = sysfsparser_opendirfd (PATH_SYS_CPU "/cpu%u/cpufreq", cpu);
+  if (dirfd < 0)
     return -ENODEV;
 
-  *max = sysfsparser_cpufreq_get_value (cpu, CPUINFO_MAX_FREQ);
-  if (!*max)
+  sysfsparser_getvalues_at (dirfd, limits, 2);
+  *min = limits[0].value;
+  *max = limits[1].value;
+  if (!*min || !*max)
     return -ENODEV;
 
   return 0;
@@ -394,7 +567,10 @@ sysfsparser_thermal_get_critical_temperature (unsigned int thermal_zone)
        * cat /sys/class/thermal/thermal_zone0/trip_point_0_type
        *  critical   */
       if (!STRPREFIX (type, "critical"))
-	continue;
+	{
+	  free (type);
+	  continue;
+	}
 
       err = sysfsparser_getvalue (&crit_temp, PATH_SYS_ACPI_THERMAL
 				  "/thermal_zone%u/trip_point_%d_temp",
@@ -130,7 +130,7 @@ strtollint (const char *str, long long int *result,
 	      return -1;
 	    }
 
-	  if (*(end + 1) != '\0')
+	  if (*end != '\0' && *(end + 1) != '\0')
 	    {
 	      *errmesg = xasprintf ("invalid trailing character `%c' in `%s'",
 				    *(end + 1), str);
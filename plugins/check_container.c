@@ -43,6 +43,7 @@ static const char *program_copyright =
   "Copyright (C) 2018,2024 Davide Madrisan <" PACKAGE_BUGREPORT ">\n";
 
 static struct option const longopts[] = {
+  {(char *) "cgroup", no_argument, NULL, 'C'},
   {(char *) "image", required_argument, NULL, 'i'},
   {(char *) "memory", no_argument, NULL, 'M'},
   {(char *) "socket", required_argument, NULL, 's'},
@@ -75,7 +76,15 @@ usage (FILE *out)
   fputs
     ("  -i, --image IMAGE   limit the investigation only to the containers "
      "running IMAGE\n", out);
-  fputs ("  -M, --memory    check memory utilisation for running containers\n",
+  fputs ("  -M, --memory    check memory utilisation for running containers\n"
+	 "                  (read from the cgroup memory.current of the "
+	 "containers found\n"
+	 "                  in the cgroup v2 hierarchy, and from the API "
+	 "for the others)\n",
+	 out);
+  fputs ("  -C, --cgroup    read the memory and CPU usage of the containers "
+	 "from the\n"
+	 "                  cgroup v2 hierarchy, without querying the API\n",
 	 out);
   fputs ("  -s, --socket SOCKET   the path of the docker or podman socket, usually\n"
 	 "                        " DOCKER_SOCKET " and " PODMAN_SOCKET "\n", out);
@@ -96,6 +105,7 @@ usage (FILE *out)
   fprintf (out, "  %s --socket /run/user/1000/podman/podman.sock\n",
 	   program_name);
   fprintf (out, "  %s -w 100 -c 120\n", program_name);
+  fprintf (out, "  %s --memory --cgroup -m -w 512 -c 640\n", program_name);
 /*  fprintf (out, "  %s --socket " PODMAN_SOCKET " --image nginx -c 5:\n",
 	   program_name);
   fprintf (out,
@@ -121,7 +131,7 @@ main (int argc, char **argv)
 {
   int c;
   int shift = k_shift;
-  bool check_memory = false, verbose = false;
+  bool check_memory = false, use_cgroup = false, verbose = false;
   char *image = NULL;
   char *socket = NULL;
   char *critical = NULL, *warning = NULL;
@@ -134,7 +144,7 @@ main (int argc, char **argv)
   set_program_name (argv[0]);
 
   while ((c = getopt_long (argc, argv,
-			   "i:s:Mkmgc:w:v" GETOPT_HELP_VERSION_STRING,
+			   "Ci:s:Mkmgc:w:v" GETOPT_HELP_VERSION_STRING,
 			   longopts, NULL)) != -1)
     {
       switch (c)
@@ -142,6 +152,9 @@ main (int argc, char **argv)
 	default:
 	  usage (stderr);
 	  break;
+	case 'C':
+	  use_cgroup = true;
+	  break;
 	case 'i':
 	  image = optarg;
 	  break;
@@ -190,14 +203,44 @@ main (int argc, char **argv)
 		      "too large delay value (greater than %d)", DELAY_MAX);
     }
 
-  if (check_memory && image)
+  if ((check_memory && image) || (use_cgroup && !check_memory))
     usage (stderr);
 
   status = set_thresholds (&my_threshold, warning, critical);
   if (status == NP_RANGE_UNPARSEABLE)
     usage (stderr);
 
-  if (check_memory)
+  if (check_memory && use_cgroup)
+    {
+      struct container_stats stats;
+      long long unsigned int kb_memory_used_total;
+
+      /* output in kilobytes by default */
+      if (units == NULL)
+	units = xstrdup ("kB");
+
+      if (cgroup_containers_stats (&stats) < 0)
+	plugin_error (STATE_UNKNOWN, 0,
+		      "the cgroup v2 unified hierarchy is not mounted");
+      kb_memory_used_total = stats.memory_current >> 10;
+      status = get_status (UNIT_CONVERT (kb_memory_used_total, shift),
+			   my_threshold);
+
+      status_msg =
+	xasprintf ("%s: %llu %s memory used by %u container(s)",
+		   state_text (status), UNIT_STR (kb_memory_used_total),
+		   stats.containers);
+      perfdata_msg =
+	xasprintf ("used=%llu%s anon=%llu%s file=%llu%s swap=%llu%s "
+		   "cpu_user=%lluc cpu_system=%lluc containers=%u"
+		   , UNIT_STR (kb_memory_used_total)
+		   , UNIT_STR (stats.memory_anon >> 10)
+		   , UNIT_STR (stats.memory_file >> 10)
+		   , UNIT_STR (stats.memory_swap >> 10)
+		   , stats.cpu_user_usec, stats.cpu_system_usec
+		   , stats.containers);
+    }
+  else if (check_memory)
     {
       long long unsigned int kb_memory_used_total;
 
@@ -63,6 +63,7 @@ static struct option const longopts[] = {
   {(char *) "critical", required_argument, NULL, 'c'},
   {(char *) "warning", required_argument, NULL, 'w'},
   {(char *) "verbose", no_argument, NULL, 'v'},
+  {(char *) "cache-dir", required_argument, NULL, 0},
   {(char *) "help", no_argument, NULL, GETOPT_HELP_CHAR},
   {(char *) "version", no_argument, NULL, GETOPT_VERSION_CHAR},
   {NULL, 0, NULL, 0}
@@ -75,9 +76,9 @@ usage (FILE * out)
   fputs (program_shorthelp, out);
   fputs (program_copyright, out);
   fputs (USAGE_HEADER, out);
-  fprintf (out, "  %s [-v] [-m] [-p] [-w PERC] [-c PERC] [delay [count]]\n",
-	   program_name);
-  fprintf (out, "  %s --cpuinfo\n", program_name);
+  fprintf (out, "  %s [-v] [-m] [-p] [-w PERC] [-c PERC] "
+	   "[--cache-dir CACHEDIR] [delay [count]]\n", program_name);
+  fprintf (out, "  %s --cpuinfo [--cache-dir CACHEDIR]\n", program_name);
   fputs (USAGE_OPTIONS, out);
   fputs ("  -m, --no-cpu-model  "
 	 "do not display the CPU model in the output message\n", out);
@@ -88,6 +89,10 @@ usage (FILE * out)
          "(Nagios may truncate output)\n", out);
   fputs ("  -i, --cpuinfo   show the CPU characteristics (for debugging)\n",
 	 out);
+  fputs ("  --cache-dir CACHEDIR   save the CPU description and topology "
+	 "in CACHEDIR,\n"
+	 "    for reusing them until the next reboot or CPU hotplug event\n",
+	 out);
   fputs (USAGE_HELP, out);
   fputs (USAGE_VERSION, out);
   fprintf (out, "  delay is the delay between updates in seconds "
@@ -121,7 +126,8 @@ print_version (void)
 #define print_range_s(_key, _val1, _val2) \
         printf ("%-30s%s - %s\n", _key, _val1, _val2)
 
-static void cpu_desc_summary (struct cpu_desc *cpudesc)
+static void cpu_desc_summary (struct cpu_desc *cpudesc,
+			      const struct cputopology *topology)
 {
   printf ("-= CPU Characteristics =-\n");
 
@@ -156,12 +162,27 @@ static void cpu_desc_summary (struct cpu_desc *cpudesc)
 
   print_d("CPU(s):", ncpus);
 
-  unsigned int nsockets, ncores, nthreads;
-  get_cputopology_read (&nsockets, &ncores, &nthreads);
+  print_u("Thread(s) per core:", topology->threads_per_core);
+  print_u("Core(s) per socket:", topology->cores_per_socket);
+  print_u("Socket(s):", topology->npackages);
+  if (topology->ndies > topology->npackages)
+    print_u("Die(s):", topology->ndies);
+  if (topology->nnodes > 0)
+    print_u("NUMA node(s):", topology->nnodes);
 
-  print_u("Thread(s) per core:", nthreads);
-  print_u("Core(s) per socket:", ncores);
-  print_u("Socket(s):", nsockets);
+  unsigned int i;
+  for (i = 0; i < topology->ncaches; i++)
+    {
+      const struct cputopology_cache *cache = &topology->caches[i];
+      char key[32];
+
+      snprintf (key, sizeof key, "L%u%s cache:", cache->level,
+		STREQ (cache->type, "Data") ? "d" :
+		STREQ (cache->type, "Instruction") ? "i" : "");
+      print_key_s(key);
+      printf ("%luK (%u instance%s)\n", cache->size, cache->ninstances,
+	      cache->ninstances > 1 ? "s" : "");
+    }
 
   print_s("Vendor ID:", cpu_desc_get_vendor (cpudesc));
   print_s("CPU Family:", cpu_desc_get_family (cpudesc));
@@ -243,10 +264,10 @@ static void cpu_desc_summary (struct cpu_desc *cpudesc)
 int
 main (int argc, char **argv)
 {
-  int c, err;
-  bool verbose, cpu_model, per_cpu_stats;
+  int c, err, option_index = 0;
+  bool verbose, cpu_model, per_cpu_stats, cpuinfo;
   unsigned long len, i, count, delay;
-  char *critical = NULL, *warning = NULL;
+  char *critical = NULL, *warning = NULL, *cachedir = NULL;
   char *p = NULL, *cpu_progname;
   nagstatus currstatus, status;
   thresholds *my_threshold = NULL;
@@ -284,21 +305,24 @@ main (int argc, char **argv)
     plugin_error (STATE_UNKNOWN, err, "memory exhausted");
 
   /* default values */
-  verbose = per_cpu_stats = false;
+  verbose = per_cpu_stats = cpuinfo = false;
   cpu_model = true;
 
   while ((c = getopt_long (
 		argc, argv, "c:w:vifmp"
-		GETOPT_HELP_VERSION_STRING, longopts, NULL)) != -1)
+		GETOPT_HELP_VERSION_STRING, longopts, &option_index)) != -1)
     {
       switch (c)
 	{
 	default:
 	  usage (stderr);
+	case 0:
+	  if (STREQ (longopts[option_index].name, "cache-dir"))
+	    cachedir = optarg;
+	  break;
 	case 'i':
-	  cpu_desc_read (cpudesc);
-	  cpu_desc_summary (cpudesc);
-	  return STATE_UNKNOWN;
+	  cpuinfo = true;
+	  break;
 	case 'm':
 	  cpu_model = false;
 	  break;
@@ -321,6 +345,13 @@ main (int argc, char **argv)
 	}
     }
 
+  if (cpuinfo)
+    {
+      cpu_desc_read_cached (cpudesc, cachedir);
+      cpu_desc_summary (cpudesc, cputopology_read (cachedir));
+      return STATE_UNKNOWN;
+    }
+
   if (!thresholds_expressed_as_percentages (warning, critical))
     usage (stderr);
 
@@ -435,10 +466,13 @@ main (int argc, char **argv)
 	status = currstatus;
     }
 
-  cpu_desc_read (cpudesc);
-  char *cpu_model_str =
-    cpu_model ?	xasprintf ("(%s) ",
-			   cpu_desc_get_model_name (cpudesc)) : NULL;
+  char *cpu_model_str = NULL;
+  if (cpu_model)
+    {
+      cpu_desc_read_cached (cpudesc, cachedir);
+      cpu_model_str =
+	xasprintf ("(%s) ", cpu_desc_get_model_name (cpudesc));
+    }
 
   printf ("%s %s%s - cpu %s %.1f%% |"
 	  , program_name_short, cpu_model ? cpu_model_str : ""
@@ -21,9 +21,12 @@
  * This software is based on the source code of the tool "vmstat".
  */
 
+#include <errno.h>
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "common.h"
 #include "cpudesc.h"
@@ -33,11 +36,13 @@
 #include "messages.h"
 #include "progname.h"
 #include "progversion.h"
+#include "string-macros.h"
 #include "sysfsparser.h"
 #include "thresholds.h"
 #include "units.h"
 #include "xalloc.h"
 #include "xasprintf.h"
+#include "xstrton.h"
 
 static const char *program_copyright =
   "Copyright (C) 2014,2015,2019,2022 Davide Madrisan <" PACKAGE_BUGREPORT ">\n";
@@ -50,6 +55,10 @@ static struct option const longopts[] = {
   {(char *) "gHz", no_argument, NULL, 'G'},
   {(char *) "critical", required_argument, NULL, 'c'},
   {(char *) "warning", required_argument, NULL, 'w'},
+  {(char *) "below", required_argument, NULL, 'b'},
+  {(char *) "throttle-warning", required_argument, NULL, 0},
+  {(char *) "throttle-critical", required_argument, NULL, 0},
+  {(char *) "cache-dir", required_argument, NULL, 0},
   {(char *) "help", no_argument, NULL, GETOPT_HELP_CHAR},
   {(char *) "version", no_argument, NULL, GETOPT_VERSION_CHAR},
   {NULL, 0, NULL, 0}
@@ -64,6 +73,10 @@ usage (FILE * out)
   fputs (USAGE_HEADER, out);
   fprintf (out, "  %s [-m] [-H,-K,-M,-G] [-w COUNTER] [-c COUNTER]\n",
 	   program_name);
+  fprintf (out, "  %s [-m] -b FREQ [-w PERC] [-c PERC]\n"
+	   "    [--throttle-warning RATE] [--throttle-critical RATE] [delay]\n",
+	   program_name);
+  fputs ("    [--cache-dir CACHEDIR]\n", out);
   fputs (USAGE_OPTIONS, out);
   fputs ("  -m, --no-cpu-model  "
 	 "do not display the CPU model in the output message\n", out);
@@ -71,10 +84,28 @@ usage (FILE * out)
          "show output in Hz, kHz (the default), mHz, or gHz\n", out);
   fputs ("  -w, --warning COUNTER (kHz)   warning threshold\n", out);
   fputs ("  -c, --critical COUNTER (kHz)   critical threshold\n", out);
+  fputs ("  -b, --below FREQ (kHz)   sample the cpufreq statistics and "
+	 "report the\n"
+	 "    percentage of time spent below FREQ; the thresholds are "
+	 "percentages\n", out);
+  fputs ("  --throttle-warning RATE   warning threshold for the thermal "
+	 "throttling\n"
+	 "    events per minute (x86 only)\n", out);
+  fputs ("  --throttle-critical RATE   critical threshold for the thermal "
+	 "throttling\n"
+	 "    events per minute (x86 only)\n", out);
+  fputs ("  --cache-dir CACHEDIR   save the CPU description and topology "
+	 "in CACHEDIR,\n"
+	 "    for reusing them until the next reboot or CPU hotplug event\n",
+	 out);
   fputs (USAGE_HELP, out);
   fputs (USAGE_VERSION, out);
+  fprintf (out, "  delay is the sampling interval in seconds "
+	   "(default: %dsec)\n", DELAY_DEFAULT);
   fputs (USAGE_EXAMPLES, out);
   fprintf (out, "  %s -m -w 800000:\n", program_name);
+  fprintf (out, "  %s -b 2000000 -w 20 -c 50 --throttle-critical 10 60\n",
+	   program_name);
 
   exit (out == stderr ? STATE_UNKNOWN : STATE_OK);
 }
@@ -89,17 +120,181 @@ print_version (void)
   exit (STATE_OK);
 }
 
+/* The CPUs sharing a frequency domain are reported once */
+static const char *
+policy_label (const struct cpufreq_policy *policy, char *buf, size_t size)
+{
+  if (policy->ncpus > 1)
+    snprintf (buf, size, "policy%u", policy->id);
+  else
+    snprintf (buf, size, "cpu%u", policy->cpu);
+  return buf;
+}
+
+struct cpufreq_sample
+{
+  unsigned long long below, total;	/* time_in_state (10ms) */
+  struct cpufreq_throttle throttle;
+  bool has_time_in_state, has_throttle;
+};
+
+static void
+cpufreq_sample_read (const struct cpufreq_policy *policies,
+		     unsigned int npolicies, unsigned long below,
+		     struct cpufreq_sample *samples)
+{
+  unsigned int i;
+
+  for (i = 0; i < npolicies; i++)
+    {
+      /* below is 0 when only the throttling is checked */
+      samples[i].has_time_in_state = below
+	&& (cpufreq_get_time_in_state (policies[i].cpu, below,
+				       &samples[i].below,
+				       &samples[i].total) == 0);
+      samples[i].has_throttle =
+	(cpufreq_get_throttle (policies[i].cpu, &samples[i].throttle) == 0);
+    }
+}
+
+static inline double
+events_per_minute (unsigned long long before, unsigned long long after,
+		   unsigned long delay)
+{
+  return (after > before) ? (after - before) * 60.0 / delay : 0;
+}
+
+/* Sample the time spent below the frequency 'below' and the thermal
+ * throttling events of all the policies over 'delay' seconds */
+static nagstatus
+check_residency (const struct cpufreq_policy *policies,
+		 unsigned int npolicies, unsigned long below,
+		 unsigned long delay, thresholds *below_threshold,
+		 thresholds *throttle_threshold, const char *cpu_model_str,
+		 char *warning, char *critical, char *throttle_warning,
+		 char *throttle_critical)
+{
+  struct cpufreq_sample *before = xnmalloc (npolicies ? npolicies : 1,
+					    sizeof (struct cpufreq_sample)),
+			*after = xnmalloc (npolicies ? npolicies : 1,
+					   sizeof (struct cpufreq_sample));
+  double below_max = 0, throttle_max = 0;
+  bool has_time_in_state = false, has_throttle = false;
+  nagstatus currstatus, status = STATE_OK;
+  char label[32], *perfdata = NULL, *below_str;
+  size_t perfdata_size = 0;
+  unsigned int i, j;
+  FILE *out;
+
+  cpufreq_sample_read (policies, npolicies, below, before);
+  sleep (delay);
+  cpufreq_sample_read (policies, npolicies, below, after);
+
+  if ((out = open_memstream (&perfdata, &perfdata_size)) == NULL)
+    plugin_error (STATE_UNKNOWN, errno, "memory exhausted");
+
+  for (i = 0; i < npolicies; i++)
+    {
+      policy_label (&policies[i], label, sizeof label);
+
+      if (before[i].has_time_in_state && after[i].has_time_in_state
+	  && after[i].total > before[i].total)
+	{
+	  double below_perc = (after[i].below - before[i].below) * 100.0
+	    / (after[i].total - before[i].total);
+	  has_time_in_state = true;
+	  if (below_perc > below_max)
+	    below_max = below_perc;
+	  currstatus = get_status (below_perc, below_threshold);
+	  if (currstatus > status)
+	    status = currstatus;
+	  fprintf (out, " %s_below=%.1f%%;%s;%s;0;100", label, below_perc,
+		   warning ? warning : "", critical ? critical : "");
+	}
+
+      if (before[i].has_throttle && after[i].has_throttle)
+	{
+	  double rate = events_per_minute (before[i].throttle.core_count,
+					   after[i].throttle.core_count,
+					   delay);
+	  has_throttle = true;
+	  if (rate > throttle_max)
+	    throttle_max = rate;
+	  /* the core counter is read from the first CPU of the policy
+	   * only, so the label names that CPU */
+	  fprintf (out, " cpu%u_throttle=%.1f;%s;%s;0", policies[i].cpu, rate,
+		   throttle_warning ? throttle_warning : "",
+		   throttle_critical ? throttle_critical : "");
+	}
+    }
+
+  /* the package counters are shared by all the CPUs of the package */
+  for (i = 0; i < npolicies; i++)
+    {
+      const struct cpufreq_throttle *throttle = &after[i].throttle;
+
+      if (!before[i].has_throttle || !after[i].has_throttle
+	  || !throttle->has_package_count)
+	continue;
+      for (j = 0; j < i; j++)
+	if (after[j].has_throttle && after[j].throttle.has_package_count
+	    && after[j].throttle.package_id == throttle->package_id)
+	  break;
+      if (j < i)
+	continue;
+
+      double rate = events_per_minute (before[i].throttle.package_count,
+				       throttle->package_count, delay);
+      if (rate > throttle_max)
+	throttle_max = rate;
+      fprintf (out, " package%u_throttle=%.1f;%s;%s;0", throttle->package_id,
+	       rate, throttle_warning ? throttle_warning : "",
+	       throttle_critical ? throttle_critical : "");
+    }
+  fclose (out);
+
+  if (!has_time_in_state && !has_throttle)
+    plugin_error (STATE_UNKNOWN, 0,
+		  "neither the cpufreq statistics nor the thermal throttling "
+		  "counters are available");
+
+  if (has_throttle)
+    {
+      currstatus = get_status (throttle_max, throttle_threshold);
+      if (currstatus > status)
+	status = currstatus;
+    }
+
+  below_str = cpufreq_freq_to_string (below);
+  printf ("%s %s%s:", program_name_short, cpu_model_str ? cpu_model_str : "",
+	  state_text (status));
+  if (has_time_in_state)
+    printf (" %.1f%% of time below %s", below_max, below_str);
+  if (has_throttle)
+    printf ("%s %.1f throttling events/min", has_time_in_state ? "," : "",
+	    throttle_max);
+  printf (" |%s\n", perfdata);
+
+  free (below_str);
+  free (perfdata);
+  free (before);
+  free (after);
+
+  return status;
+}
+
 int
 main (int argc, char **argv)
 {
-  int c, err;
-  bool cpu_model;
-  char *critical = NULL, *warning = NULL;
+  int c, err, option_index = 0;
+  bool cpu_model, residency = false;
+  char *critical = NULL, *warning = NULL, *cachedir = NULL,
+       *throttle_critical = NULL, *throttle_warning = NULL;
   float factor = 1.0;
   nagstatus currstatus, status = STATE_OK;
-  thresholds *my_threshold = NULL;
+  thresholds *my_threshold = NULL, *throttle_threshold = NULL;
+  unsigned long below = 0, delay = DELAY_DEFAULT;
   struct cpu_desc *cpudesc = NULL;
-  unsigned long freq_min, freq_max, freq_kernel;
 
   set_program_name (argv[0]);
 
@@ -113,13 +308,34 @@ main (int argc, char **argv)
   cpu_model = true;
 
   while ((c = getopt_long (
-		argc, argv, "c:w:mHKMG"
-		GETOPT_HELP_VERSION_STRING, longopts, NULL)) != -1)
+		argc, argv, "b:c:w:mHKMG"
+		GETOPT_HELP_VERSION_STRING, longopts, &option_index)) != -1)
     {
       switch (c)
 	{
 	default:
 	  usage (stderr);
+	case 0:
+	  if (STREQ (longopts[option_index].name, "cache-dir"))
+	    {
+	      cachedir = optarg;
+	      break;
+	    }
+	  if (STREQ (longopts[option_index].name, "throttle-warning"))
+	    throttle_warning = optarg;
+	  else if (STREQ (longopts[option_index].name, "throttle-critical"))
+	    throttle_critical = optarg;
+	  residency = true;
+	  break;
+	case 'b':
+	  {
+	    long freq = strtol_or_err (optarg, "failed to parse argument");
+	    if (freq <= 0)
+	      usage (stderr);
+	    below = freq;
+	    residency = true;
+	  }
+	  break;
 	case 'm':
 	  cpu_model = false;
 	  break;
@@ -143,18 +359,54 @@ main (int argc, char **argv)
   status = set_thresholds (&my_threshold, warning, critical);
   if (status == NP_RANGE_UNPARSEABLE)
     usage (stderr);
+  status = set_thresholds (&throttle_threshold, throttle_warning,
+			   throttle_critical);
+  if (status == NP_RANGE_UNPARSEABLE)
+    usage (stderr);
+  status = STATE_OK;
+
+  if (optind < argc)
+    {
+      if (!residency)
+	usage (stderr);
+      delay = strtol_or_err (argv[optind++], "failed to parse argument");
+      if (delay < 1)
+	plugin_error (STATE_UNKNOWN, 0, "delay must be positive integer");
+      else if (DELAY_MAX < delay)
+	plugin_error (STATE_UNKNOWN, 0,
+		      "too large delay value (greater than %d)", DELAY_MAX);
+    }
 
   int ncpus = get_processor_number_total ();
+  unsigned int i, npolicies;
+  struct cpufreq_policy *policies =
+    cpufreq_get_policies (ncpus > 0 ? ncpus : 0, &npolicies);
 
-  cpu_desc_read (cpudesc);
-  char *cpu_model_str =
-    cpu_model ?	xasprintf ("(%s) ",
-			   cpu_desc_get_model_name (cpudesc)) : NULL;
+  char *cpu_model_str = NULL;
+  if (cpu_model)
+    {
+      cpu_desc_read_cached (cpudesc, cachedir);
+      cpu_model_str =
+	xasprintf ("(%s) ", cpu_desc_get_model_name (cpudesc));
+    }
 
-  for (c = 0; c < ncpus; c++)
-    if ((freq_kernel = cpufreq_get_freq_kernel (c)) > 0)
+  if (residency)
+    {
+      /* the packages of the CPUs, for the throttling counters */
+      cputopology_read (cachedir);
+      status = check_residency (policies, npolicies, below, delay,
+				my_threshold, throttle_threshold,
+				cpu_model_str, warning, critical,
+				throttle_warning, throttle_critical);
+      cpufreq_policies_free (policies);
+      cpu_desc_unref (cpudesc);
+      return status;
+    }
+
+  for (i = 0; i < npolicies; i++)
+    if (policies[i].freq_kernel > 0)
       {
-	currstatus = get_status (freq_kernel, my_threshold);
+	currstatus = get_status (policies[i].freq_kernel, my_threshold);
 	if (currstatus > status)
 	  status = currstatus;
       }
@@ -163,23 +415,25 @@ main (int argc, char **argv)
 	  , program_name_short, cpu_model ? cpu_model_str : ""
 	  , state_text (status));
 #define unit_convert(_val, _factor) (unsigned long long)(_val * _factor)
-  for (c = 0; c < ncpus; c++)
+  for (i = 0; i < npolicies; i++)
     {
-      if (0 == cpufreq_get_hardware_limits (c, &freq_min, &freq_max))
-	{
-	  freq_kernel = cpufreq_get_freq_kernel (c);
-	  /* expected format for the Nagios performance data:
-	   *   'label'=value[UOM];[warn];[crit];[min];[max]	*/
-	  if (freq_kernel)
-	    printf (" cpu%d_freq=%llu;;;%llu;%llu",
-		    c,
-		    unit_convert(freq_kernel, factor),
-		    unit_convert(freq_min, factor),
-		    unit_convert(freq_max, factor));
-	}
+      const struct cpufreq_policy *policy = &policies[i];
+      char label[32];
+
+      if (!policy->freq_min || !policy->freq_max || !policy->freq_kernel)
+	continue;
+
+      /* expected format for the Nagios performance data:
+       *   'label'=value[UOM];[warn];[crit];[min];[max]	*/
+      printf (" %s_freq=%llu;;;%llu;%llu",
+	      policy_label (policy, label, sizeof label),
+	      unit_convert(policy->freq_kernel, factor),
+	      unit_convert(policy->freq_min, factor),
+	      unit_convert(policy->freq_max, factor));
     }
 #undef unit_convert
   putchar ('\n');
+  cpufreq_policies_free (policies);
   cpu_desc_unref (cpudesc);
 
   return status;
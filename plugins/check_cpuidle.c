@@ -0,0 +1,328 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A Nagios plugin to check the residency of the CPUs in the idle states.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The deep idle states (C-states) save power but add wake-up latency.
+ * The time spent by the CPUs in each state and the number of entries
+ * (wakeups) are sampled over an interval and summed per socket; the
+ * thresholds apply to the percentage of time spent in the states whose
+ * exit latency is above a cap.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "cpuidle.h"
+#include "cputopology.h"
+#include "messages.h"
+#include "progname.h"
+#include "progversion.h"
+#include "sysfsparser.h"
+#include "thresholds.h"
+#include "xalloc.h"
+#include "xstrton.h"
+
+static const char *program_copyright =
+  "Copyright (C) 2026 Davide Madrisan <" PACKAGE_BUGREPORT ">\n";
+
+static struct option const longopts[] = {
+  {(char *) "latency", required_argument, NULL, 'l'},
+  {(char *) "critical", required_argument, NULL, 'c'},
+  {(char *) "warning", required_argument, NULL, 'w'},
+  {(char *) "help", no_argument, NULL, GETOPT_HELP_CHAR},
+  {(char *) "version", no_argument, NULL, GETOPT_VERSION_CHAR},
+  {NULL, 0, NULL, 0}
+};
+
+static _Noreturn void
+usage (FILE * out)
+{
+  fprintf (out, "%s (" PACKAGE_NAME ") v%s\n", program_name, program_version);
+  fputs ("This plugin checks the residency of the CPUs in the idle states "
+	 "(C-states).\n", out);
+  fputs (program_copyright, out);
+  fputs (USAGE_HEADER, out);
+  fprintf (out, "  %s [-l LATENCY] [-w PERC] [-c PERC] [delay]\n",
+	   program_name);
+  fputs (USAGE_OPTIONS, out);
+  fputs ("  -l, --latency LATENCY (us)   the idle states with an exit "
+	 "latency above\n"
+	 "    LATENCY are the deep states (default: 0, all but POLL)\n", out);
+  fputs ("  -w, --warning PERC   warning threshold for the percentage of "
+	 "time spent\n"
+	 "    in the deep states by a socket\n", out);
+  fputs ("  -c, --critical PERC   critical threshold for the percentage of "
+	 "time spent\n"
+	 "    in the deep states by a socket\n", out);
+  fputs (USAGE_HELP, out);
+  fputs (USAGE_VERSION, out);
+  fprintf (out, "  delay is the sampling interval in seconds "
+	   "(default: %dsec)\n", DELAY_DEFAULT);
+  fputs (USAGE_EXAMPLES, out);
+  fprintf (out, "  %s -l 20 -w 10 -c 30 5\n", program_name);
+
+  exit (out == stderr ? STATE_UNKNOWN : STATE_OK);
+}
+
+static _Noreturn void
+print_version (void)
+{
+  printf ("%s (" PACKAGE_NAME ") v%s\n", program_name, program_version);
+  fputs (program_copyright, stdout);
+  fputs (GPLv3_DISCLAIMER, stdout);
+
+  exit (STATE_OK);
+}
+
+/* The idle states of all the CPUs of a socket: 'time' and 'usage' hold
+ * the increments over the sampling interval */
+struct socket_stats
+{
+  int id;
+  unsigned int ncpus;
+  unsigned int nstates;
+  struct cpuidle_state states[CPUIDLE_STATES_MAX];
+};
+
+static struct cpuidle_state *
+cpuidle_sample (unsigned int ncpus, int *nstates)
+{
+  struct cpuidle_state *states =
+    xnmalloc ((ncpus ? ncpus : 1) * CPUIDLE_STATES_MAX,
+	      sizeof (struct cpuidle_state));
+  unsigned int cpu;
+
+  for (cpu = 0; cpu < ncpus; cpu++)
+    nstates[cpu] =
+      cpuidle_get_states (cpu, states + cpu * CPUIDLE_STATES_MAX);
+
+  return states;
+}
+
+static double
+timespec_diff_us (const struct timespec *t0, const struct timespec *t1)
+{
+  return (t1->tv_sec - t0->tv_sec) * 1e6
+    + (t1->tv_nsec - t0->tv_nsec) / 1e3;
+}
+
+static inline unsigned long long
+counter_delta (unsigned long long before, unsigned long long after)
+{
+  return (after > before) ? after - before : 0;
+}
+
+static unsigned int
+sum_per_socket (unsigned int ncpus, const struct cpuidle_state *before,
+		const int *nbefore, const struct cpuidle_state *after,
+		const int *nafter, struct socket_stats **sockets)
+{
+  unsigned int cpu, i, m, nsockets = 0;
+
+  *sockets = NULL;
+  for (cpu = 0; cpu < ncpus; cpu++)
+    {
+      const struct cpuidle_state *b = before + cpu * CPUIDLE_STATES_MAX,
+	*a = after + cpu * CPUIDLE_STATES_MAX;
+      int nstates = (nbefore[cpu] < nafter[cpu]) ? nbefore[cpu] : nafter[cpu];
+      int id;
+
+      /* offline CPU or no cpuidle driver */
+      if (nstates <= 0)
+	continue;
+
+      if ((id = get_cputopology_package_id (cpu)) < 0)
+	id = 0;
+      for (i = 0; i < nsockets; i++)
+	if ((*sockets)[i].id == id)
+	  break;
+      if (i == nsockets)
+	{
+	  *sockets = xrealloc (*sockets, (nsockets + 1)
+			       * sizeof (struct socket_stats));
+	  memset (&(*sockets)[i], 0, sizeof (struct socket_stats));
+	  (*sockets)[i].id = id;
+	  nsockets++;
+	}
+
+      struct socket_stats *socket = &(*sockets)[i];
+      socket->ncpus++;
+      for (m = 0; m < (unsigned int) nstates; m++)
+	{
+	  if (m >= socket->nstates)
+	    {
+	      memcpy (socket->states[m].name, a[m].name,
+		      sizeof (a[m].name));
+	      socket->states[m].latency = a[m].latency;
+	      socket->nstates = m + 1;
+	    }
+	  socket->states[m].time += counter_delta (b[m].time, a[m].time);
+	  socket->states[m].usage += counter_delta (b[m].usage, a[m].usage);
+	}
+    }
+
+  return nsockets;
+}
+
+/* The percentage of the time of the socket spent in the idle states
+ * with an exit latency above 'latency_cap' */
+static double
+socket_deep_residency (const struct socket_stats *socket, double elapsed,
+		       unsigned long long latency_cap)
+{
+  double deep = 0;
+  unsigned int m;
+
+  for (m = 0; m < socket->nstates; m++)
+    if (socket->states[m].latency > latency_cap)
+      deep += socket->states[m].time;
+  deep = deep * 100.0 / (elapsed * socket->ncpus);
+
+  return (deep > 100) ? 100 : deep;
+}
+
+int
+main (int argc, char **argv)
+{
+  int c, *nbefore, *nafter;
+  char *critical = NULL, *warning = NULL;
+  nagstatus status = STATE_OK;
+  thresholds *my_threshold = NULL;
+  unsigned long long latency_cap = 0;
+  unsigned long delay = DELAY_DEFAULT;
+  unsigned int i, m, ncpus, nsockets;
+  struct cpuidle_state *before, *after;
+  struct socket_stats *sockets;
+  struct timespec t0, t1;
+  double elapsed, deep_max = 0;
+
+  set_program_name (argv[0]);
+
+  while ((c = getopt_long (argc, argv, "c:w:l:" GETOPT_HELP_VERSION_STRING,
+			   longopts, NULL)) != -1)
+    {
+      switch (c)
+	{
+	default:
+	  usage (stderr);
+	case 'c':
+	  critical = optarg;
+	  break;
+	case 'w':
+	  warning = optarg;
+	  break;
+	case 'l':
+	  {
+	    long latency = strtol_or_err (optarg, "failed to parse argument");
+	    if (latency < 0)
+	      usage (stderr);
+	    latency_cap = latency;
+	  }
+	  break;
+
+	case_GETOPT_HELP_CHAR
+	case_GETOPT_VERSION_CHAR
+
+	}
+    }
+
+  if (optind < argc)
+    {
+      delay = strtol_or_err (argv[optind++], "failed to parse argument");
+      if (delay < 1)
+	plugin_error (STATE_UNKNOWN, 0, "delay must be positive integer");
+      else if (DELAY_MAX < delay)
+	plugin_error (STATE_UNKNOWN, 0,
+		      "too large delay value (greater than %d)", DELAY_MAX);
+    }
+
+  status = set_thresholds (&my_threshold, warning, critical);
+  if (status == NP_RANGE_UNPARSEABLE)
+    usage (stderr);
+
+  sysfsparser_check_for_sysfs ();
+
+  c = get_processor_number_total ();
+  ncpus = (c > 0) ? c : 0;
+  nbefore = xnmalloc (ncpus ? ncpus : 1, sizeof (int));
+  nafter = xnmalloc (ncpus ? ncpus : 1, sizeof (int));
+
+  clock_gettime (CLOCK_MONOTONIC, &t0);
+  before = cpuidle_sample (ncpus, nbefore);
+  sleep (delay);
+  clock_gettime (CLOCK_MONOTONIC, &t1);
+  after = cpuidle_sample (ncpus, nafter);
+  elapsed = timespec_diff_us (&t0, &t1);
+
+  nsockets = sum_per_socket (ncpus, before, nbefore, after, nafter,
+			     &sockets);
+  if (0 == nsockets)
+    plugin_error (STATE_UNKNOWN, 0,
+		  "no cpuidle statistics found in " PATH_SYS
+		  "/devices/system/cpu");
+
+  for (i = 0; i < nsockets; i++)
+    {
+      double deep = socket_deep_residency (&sockets[i], elapsed, latency_cap);
+      if (deep > deep_max)
+	deep_max = deep;
+    }
+
+  status = get_status (deep_max, my_threshold);
+
+  printf ("%s %s: %.1f%% of time in the idle states with exit latency "
+	  "above %lluus |", program_name_short, state_text (status),
+	  deep_max, latency_cap);
+
+  for (i = 0; i < nsockets; i++)
+    {
+      const struct socket_stats *socket = &sockets[i];
+
+      for (m = 0; m < socket->nstates; m++)
+	{
+	  const struct cpuidle_state *state = &socket->states[m];
+	  double residency =
+	    state->time * 100.0 / (elapsed * socket->ncpus);
+
+	  /* expected format for the Nagios performance data:
+	   *   'label'=value[UOM];[warn];[crit];[min];[max]	*/
+	  printf (" socket%d_%s=%.1f%%;;;0;100 socket%d_%s_wakeups=%.1f;;;0",
+		  socket->id, state->name, residency > 100 ? 100 : residency,
+		  socket->id, state->name, state->usage * 1e6 / elapsed);
+	}
+      printf (" socket%d_deep=%.1f%%;%s;%s;0;100", socket->id,
+	      socket_deep_residency (socket, elapsed, latency_cap),
+	      warning ? warning : "", critical ? critical : "");
+    }
+  putchar ('\n');
+
+  free (sockets);
+  free (before);
+  free (after);
+  free (nbefore);
+  free (nafter);
+
+  return status;
+}
@@ -0,0 +1,669 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * A Nagios plugin to check the disk space and inode usage of the mounted
+ * file systems.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The statvfs() calls are issued by a small pool of threads, and every
+ * call has its own deadline: a mount that does not answer in time (a dead
+ * NFS server for instance) is reported as UNKNOWN, its thread is left
+ * behind and a new one is started to check the remaining mounts.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/statvfs.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "fsfilter.h"
+#include "logging.h"
+#include "messages.h"
+#include "mountlist.h"
+#include "progname.h"
+#include "progversion.h"
+#include "string-macros.h"
+#include "thresholds.h"
+#include "xalloc.h"
+#include "xasprintf.h"
+#include "xstrton.h"
+
+#define DISK_DEFAULT_TIMEOUT	5
+#define DISK_DEFAULT_THREADS	4
+
+static const char *program_copyright =
+  "Copyright (C) 2026 Davide Madrisan <" PACKAGE_BUGREPORT ">\n";
+
+/* The file system types to check or omit, the file systems given in the
+ * command line, and the -a and -l flags.  */
+static struct fs_filter fs_filter;
+
+static bool verbose = false;
+
+enum disk_state
+{
+  DISK_PENDING,
+  DISK_RUNNING,
+  DISK_DONE,
+  DISK_FAILED,
+  DISK_TIMEDOUT
+};
+
+struct disk_entry
+{
+  const struct mount_entry *me;
+  enum disk_state state;
+  int err;			/* errno of a failed statvfs() */
+  struct statvfs st;
+};
+
+struct disk_pool;
+
+struct disk_worker
+{
+  struct disk_pool *pool;
+  pthread_t thread;
+  struct disk_entry *entry;	/* the mount being checked, or NULL */
+  struct timespec deadline;
+  bool abandoned;		/* the statvfs() call timed out */
+};
+
+struct disk_pool
+{
+  pthread_mutex_t lock;		/* protects everything below */
+  pthread_cond_t completed;
+  struct disk_entry *entries;
+  size_t nentries;
+  size_t next;			/* the next pending entry */
+  size_t ncompleted;		/* entries done, failed or timed out */
+  unsigned int timeout;
+  struct disk_worker *workers;	/* room for a replacement of each entry */
+  unsigned int nworkers;
+};
+
+static struct option const longopts[] = {
+  {(char *) "all", no_argument, NULL, 'a'},
+  {(char *) "local", no_argument, NULL, 'l'},
+  {(char *) "type", required_argument, NULL, 'T'},
+  {(char *) "exclude", no_argument, NULL, 'x'},
+  {(char *) "exclude-type", required_argument, NULL, 'X'},
+  {(char *) "warning", required_argument, NULL, 'w'},
+  {(char *) "critical", required_argument, NULL, 'c'},
+  {(char *) "inode-warning", required_argument, NULL, 'W'},
+  {(char *) "inode-critical", required_argument, NULL, 'K'},
+  {(char *) "threads", required_argument, NULL, 'j'},
+  {(char *) "timeout", required_argument, NULL, 't'},
+  {(char *) "verbose", no_argument, NULL, 'v'},
+  {(char *) "help", no_argument, NULL, GETOPT_HELP_CHAR},
+  {(char *) "version", no_argument, NULL, GETOPT_VERSION_CHAR},
+  {NULL, 0, NULL, 0}
+};
+
+static _Noreturn void
+usage (FILE * out)
+{
+  fprintf (out, "%s (" PACKAGE_NAME ") v%s\n", program_name, program_version);
+  fputs ("This plugin checks the disk space and inode usage "
+	 "of the mounted file systems.\n", out);
+  fputs (program_copyright, out);
+  fputs (USAGE_HEADER, out);
+  fprintf (out, "  %s [OPTION]... -w PERC -c PERC [FILESYSTEM]...\n",
+	   program_name);
+  fputs (USAGE_OPTIONS, out);
+  fputs ("  -a, --all       include dummy file systems\n", out);
+  fputs ("  -l, --local     limit listing to local file systems\n",
+	 out);
+  fputs ("  -T, --type=TYPE   limit listing to file systems of type TYPE\n",
+	 out);
+  fputs ("  -x, --exclude   "
+	 "check all but file systems passed as arguments\n", out);
+  fputs ("  -X, --exclude-type=TYPE   "
+	 "limit listing to file systems not of type TYPE\n", out);
+  fputs ("  -w, --warning PERCENT   warning threshold for the used space\n",
+	 out);
+  fputs ("  -c, --critical PERCENT   critical threshold for the used space\n",
+	 out);
+  fputs ("  -W, --inode-warning PERCENT   "
+	 "warning threshold for the used inodes\n", out);
+  fputs ("  -K, --inode-critical PERCENT   "
+	 "critical threshold for the used inodes\n", out);
+  fputs ("  -j, --threads COUNTER   "
+	 "number of concurrent statvfs() calls (default: 4)\n", out);
+  fputs ("  -t, --timeout SECONDS   "
+	 "give up on a file system after SECONDS (default: 5)\n", out);
+  fputs ("  -v, --verbose   show details for command-line debugging "
+         "(Nagios may truncate output)\n", out);
+  fputs (USAGE_HELP, out);
+  fputs (USAGE_VERSION, out);
+  fputs (USAGE_EXAMPLES, out);
+  fprintf (out, "  %s -l -w 80%% -c 90%%\n", program_name);
+  fprintf (out, "  %s -l -X vfat -w 80%% -c 90%% -W 80%% -K 90%%\n",
+	   program_name);
+  fprintf (out, "  %s -T nfs -T nfs4 -t 2 -w 90%% -c 95%%\n", program_name);
+  fprintf (out, "  %s -w 80%% -c 90%% / /var\n", program_name);
+
+  exit (out == stderr ? STATE_UNKNOWN : STATE_OK);
+}
+
+static _Noreturn void
+print_version (void)
+{
+  printf ("%s (" PACKAGE_NAME ") v%s\n", program_name, program_version);
+  fputs (program_copyright, stdout);
+  fputs (GPLv3_DISCLAIMER, stdout);
+
+  exit (STATE_OK);
+}
+
+static int
+disk_entry_cmp (const void *a, const void *b)
+{
+  const struct disk_entry *const *ea = a, *const *eb = b;
+  int cmp = strcmp ((*ea)->me->me_mountdir, (*eb)->me->me_mountdir);
+
+  return cmp ? cmp : (*ea < *eb) ? -1 : (*ea > *eb);
+}
+
+/* Drop the mounts hidden by a later mount on the same directory (the
+ * only ones statvfs() can reach) and return the new number of entries */
+
+static size_t
+disk_entries_dedup (struct disk_entry *entries, size_t nentries)
+{
+  struct disk_entry **sorted;
+  size_t i, n;
+
+  if (nentries < 2)
+    return nentries;
+
+  sorted = xnmalloc (nentries, sizeof (struct disk_entry *));
+  for (i = 0; i < nentries; i++)
+    sorted[i] = &entries[i];
+  qsort (sorted, nentries, sizeof (struct disk_entry *), disk_entry_cmp);
+  for (i = 0; i + 1 < nentries; i++)
+    if (STREQ (sorted[i]->me->me_mountdir, sorted[i + 1]->me->me_mountdir))
+      sorted[i]->me = NULL;
+  free (sorted);
+
+  for (i = n = 0; i < nentries; i++)
+    if (entries[i].me)
+      entries[n++] = entries[i];
+
+  return n;
+}
+
+static bool
+timespec_before (const struct timespec *a, const struct timespec *b)
+{
+  return a->tv_sec < b->tv_sec
+    || (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+static void *
+disk_worker_run (void *arg)
+{
+  struct disk_worker *worker = arg;
+  struct disk_pool *pool = worker->pool;
+
+  pthread_mutex_lock (&pool->lock);
+  while (pool->next < pool->nentries)
+    {
+      struct disk_entry *entry = &pool->entries[pool->next++];
+      struct statvfs st;
+      int err;
+
+      entry->state = DISK_RUNNING;
+      worker->entry = entry;
+      clock_gettime (CLOCK_MONOTONIC, &worker->deadline);
+      worker->deadline.tv_sec += pool->timeout;
+      pthread_mutex_unlock (&pool->lock);
+
+      err = (statvfs (entry->me->me_mountdir, &st) < 0) ? errno : 0;
+
+      pthread_mutex_lock (&pool->lock);
+      /* too late: the main thread has already reported this mount and
+       * started another worker in our place */
+      if (worker->abandoned)
+	break;
+
+      entry->st = st;
+      entry->err = err;
+      entry->state = err ? DISK_FAILED : DISK_DONE;
+      worker->entry = NULL;
+      pool->ncompleted++;
+      pthread_cond_signal (&pool->completed);
+    }
+  pthread_mutex_unlock (&pool->lock);
+
+  return NULL;
+}
+
+/* Start a new worker.  Must be called with the pool lock held.  */
+
+static void
+disk_worker_start (struct disk_pool *pool)
+{
+  struct disk_worker *worker = &pool->workers[pool->nworkers];
+  int err;
+
+  worker->pool = pool;
+  if ((err = pthread_create (&worker->thread, NULL, disk_worker_run,
+			     worker)) != 0)
+    plugin_error (STATE_UNKNOWN, err, "pthread_create() failed");
+  pool->nworkers++;
+}
+
+/* Run statvfs() on all the 'nentries' file systems, using at most
+ * 'nthreads' concurrent threads, and give up on the mounts that do not
+ * answer within 'timeout' seconds.  Return true if some threads have
+ * been left blocked in the kernel: 'pool' must then have static storage
+ * and is never released, because these threads will lock it and read
+ * their 'abandoned' flag when (and if) statvfs() returns.  */
+
+static bool
+disk_statvfs_all (struct disk_pool *pool, struct disk_entry *entries,
+		  size_t nentries, unsigned int nthreads,
+		  unsigned int timeout)
+{
+  pthread_condattr_t attr;
+  size_t nabandoned = 0;
+  unsigned int i;
+
+  pool->entries = entries;
+  pool->nentries = nentries;
+  pool->next = pool->ncompleted = 0;
+  pool->timeout = timeout;
+  pool->nworkers = 0;
+  /* each timed out mount is replaced by a new worker */
+  pool->workers = xnmalloc (nthreads + nentries, sizeof (struct disk_worker));
+  memset (pool->workers, 0,
+	  (nthreads + nentries) * sizeof (struct disk_worker));
+
+  pthread_mutex_init (&pool->lock, NULL);
+  pthread_condattr_init (&attr);
+  pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+  pthread_cond_init (&pool->completed, &attr);
+  pthread_condattr_destroy (&attr);
+
+  if (nthreads > nentries)
+    nthreads = nentries;
+
+  pthread_mutex_lock (&pool->lock);
+  for (i = 0; i < nthreads; i++)
+    disk_worker_start (pool);
+
+  while (pool->ncompleted < pool->nentries)
+    {
+      struct timespec deadline, now;
+      bool running = false;
+
+      for (i = 0; i < pool->nworkers; i++)
+	{
+	  struct disk_worker *worker = &pool->workers[i];
+	  if (worker->abandoned || worker->entry == NULL)
+	    continue;
+	  if (!running || timespec_before (&worker->deadline, &deadline))
+	    deadline = worker->deadline;
+	  running = true;
+	}
+
+      if (running)
+	pthread_cond_timedwait (&pool->completed, &pool->lock, &deadline);
+      else
+	pthread_cond_wait (&pool->completed, &pool->lock);
+
+      clock_gettime (CLOCK_MONOTONIC, &now);
+      for (i = 0; i < pool->nworkers; i++)
+	{
+	  struct disk_worker *worker = &pool->workers[i];
+	  if (worker->abandoned || worker->entry == NULL
+	      || timespec_before (&now, &worker->deadline))
+	    continue;
+
+	  dbg ("(e) statvfs() of %s timed out\n",
+	       worker->entry->me->me_mountdir);
+	  worker->entry->state = DISK_TIMEDOUT;
+	  worker->abandoned = true;
+	  pool->ncompleted++;
+	  nabandoned++;
+	  pthread_detach (worker->thread);
+	  if (pool->next < pool->nentries)
+	    disk_worker_start (pool);
+	}
+    }
+  pthread_mutex_unlock (&pool->lock);
+
+  for (i = 0; i < pool->nworkers; i++)
+    if (!pool->workers[i].abandoned)
+      pthread_join (pool->workers[i].thread, NULL);
+
+  /* the lock, the condition and the workers can be released only when
+   * all the workers have been joined */
+  if (nabandoned > 0)
+    return true;
+
+  free (pool->workers);
+  pthread_cond_destroy (&pool->completed);
+  pthread_mutex_destroy (&pool->lock);
+
+  return false;
+}
+
+/* The percentage of used blocks, computed like df does: the blocks
+ * reserved to root are not counted as available.  */
+
+static double
+disk_used_percent (const struct statvfs *st)
+{
+  unsigned long long used = st->f_blocks - st->f_bfree,
+		     total = used + st->f_bavail;
+
+  return (total > 0) ? used * 100.0 / total : 0;
+}
+
+static double
+disk_inodes_used_percent (const struct statvfs *st)
+{
+  return (st->f_files > 0)
+    ? (st->f_files - st->f_ffree) * 100.0 / st->f_files : 0;
+}
+
+/* The threshold 'str' without the percent signs, for the perfdata */
+
+static char *
+perfdata_threshold (const char *str)
+{
+  char *p, *q, *threshold = xstrdup (str ? str : "");
+
+  for (p = q = threshold; *p; p++)
+    if (*p != '%')
+      *q++ = *p;
+  *q = '\0';
+
+  return threshold;
+}
+
+static nagstatus
+worst_status (nagstatus a, nagstatus b)
+{
+  static const int severity[] = {
+    [STATE_OK] = 0, [STATE_WARNING] = 2, [STATE_CRITICAL] = 3,
+    [STATE_UNKNOWN] = 1, [STATE_DEPENDENT] = 0
+  };
+
+  return (severity[b] > severity[a]) ? b : a;
+}
+
+int
+main (int argc, char **argv)
+{
+  bool abandoned = false, exclude_mode = false;
+  int c, i;
+  long nthreads = DISK_DEFAULT_THREADS, timeout = DISK_DEFAULT_TIMEOUT;
+  nagstatus status = STATE_OK;
+  char *critical = NULL, *warning = NULL,
+       *inode_critical = NULL, *inode_warning = NULL;
+  char *warn, *crit, *inode_warn, *inode_crit;
+  char *bp_msg, *bp_perfdata;
+  size_t size_msg, size_perfdata, n, nentries, nchecked = 0;
+  FILE *msg, *perfdata;
+  thresholds *my_threshold = NULL, *inode_threshold = NULL;
+  struct mount_entry *mount_list, *me;
+  struct disk_entry *entries;
+  /* static: the workers left blocked in statvfs() can still lock it while
+   * the process exits, after main() has returned */
+  static struct disk_pool pool;
+  const char *fstype;
+
+  set_program_name (argv[0]);
+
+  while ((c = getopt_long (argc, argv,
+          "alT:xX:w:c:W:K:j:t:v" GETOPT_HELP_VERSION_STRING,
+	  longopts, NULL)) != -1)
+    {
+      switch (c)
+	{
+	default:
+	  usage (stderr);
+	case 'a':
+	  fs_filter.show_all_fs = true;
+	  break;
+	case 'l':
+	  fs_filter.show_local_fs = true;
+	  break;
+	case 'T':
+	  fs_filter_select_type (&fs_filter, optarg);
+	  break;
+	case 'x':
+	  exclude_mode = true;
+	  break;
+	case 'X':
+	  fs_filter_exclude_type (&fs_filter, optarg);
+	  break;
+	case 'w':
+	  warning = optarg;
+	  break;
+	case 'c':
+	  critical = optarg;
+	  break;
+	case 'W':
+	  inode_warning = optarg;
+	  break;
+	case 'K':
+	  inode_critical = optarg;
+	  break;
+	case 'j':
+	  nthreads = strtol_or_err (optarg, "the number of threads must be"
+				    " a positive integer");
+	  if (nthreads <= 0)
+	    usage (stderr);
+	  break;
+	case 't':
+	  timeout = strtol_or_err (optarg, "the timeout must be"
+				   " a positive integer");
+	  if (timeout <= 0)
+	    usage (stderr);
+	  break;
+	case 'v':
+	  verbose = true;
+	  break;
+
+	case_GETOPT_HELP_CHAR
+        case_GETOPT_VERSION_CHAR
+
+	}
+    }
+
+  /* Fail if the same file system type was both selected and excluded.  */
+  if ((fstype = fs_filter_type_conflict (&fs_filter)) != NULL)
+    plugin_error (STATE_UNKNOWN, 0,
+		  "file system type `%s' both selected and excluded", fstype);
+
+  for (i = optind; i < argc; ++i)
+    fs_filter_add_mountpoint (&fs_filter, argv[i]);
+
+  if (optind == argc && exclude_mode)
+    plugin_error (STATE_UNKNOWN, 0,
+		  "the --exclude option requires a list of file systems");
+
+  if (!thresholds_expressed_as_percentages (warning, critical)
+      || !thresholds_expressed_as_percentages (inode_warning, inode_critical))
+    usage (stderr);
+
+  if (set_thresholds (&my_threshold, warning, critical)
+      == NP_RANGE_UNPARSEABLE)
+    usage (stderr);
+  if ((inode_warning || inode_critical)
+      && set_thresholds (&inode_threshold, inode_warning, inode_critical)
+	 == NP_RANGE_UNPARSEABLE)
+    usage (stderr);
+
+  /* Do not open the given file systems to trigger the automounter, as
+   * check_readonlyfs does: this could hang on a dead remote server.  */
+  mount_list =
+    read_file_system_list ((fs_filter.select_types != NULL
+			    || fs_filter.exclude_types != NULL
+			    || fs_filter.show_local_fs));
+
+  if (NULL == mount_list)
+    /* Couldn't read the table of mounted file systems. */
+    plugin_error (STATE_UNKNOWN, 0,
+		  "cannot read table of mounted file systems");
+
+  for (nentries = 0, me = mount_list; me; me = me->me_next)
+    nentries++;
+  entries = xnmalloc (nentries, sizeof (struct disk_entry));
+
+  for (n = 0, me = mount_list; me; me = me->me_next)
+    {
+      if (optind < argc && !exclude_mode)
+	{
+	  /* the file systems given in the command line are always checked */
+	  hashable_t *np_dir = fs_filter_mountpoint (&fs_filter,
+						     me->me_mountdir),
+		     *np_dev = fs_filter_mountpoint (&fs_filter,
+						     me->me_devname);
+	  if (NULL == np_dir && NULL == np_dev)
+	    continue;
+	  if (np_dir)
+	    np_dir->count++;
+	  if (np_dev)
+	    np_dev->count++;
+	}
+      else if ((exclude_mode && fs_filter_listed (&fs_filter, me))
+	       || fs_filter_skip (&fs_filter, me))
+	continue;
+
+      entries[n].me = me;
+      entries[n].state = DISK_PENDING;
+      entries[n].err = 0;
+      n++;
+    }
+  nentries = disk_entries_dedup (entries, n);
+
+  if (!exclude_mode)
+    for (i = optind; i < argc; i++)
+      if (0 == fs_filter_mountpoint (&fs_filter, argv[i])->count)
+	plugin_error (STATE_UNKNOWN, 0, "`%s' is not a mounted file system",
+		      argv[i]);
+
+  if (nentries > 0)
+    abandoned =
+      disk_statvfs_all (&pool, entries, nentries, nthreads, timeout);
+
+  warn = perfdata_threshold (warning);
+  crit = perfdata_threshold (critical);
+  inode_warn = perfdata_threshold (inode_warning);
+  inode_crit = perfdata_threshold (inode_critical);
+
+  msg = open_memstream (&bp_msg, &size_msg);
+  perfdata = open_memstream (&bp_perfdata, &size_perfdata);
+
+  for (n = 0; n < nentries; n++)
+    {
+      const struct disk_entry *entry = &entries[n];
+      const struct statvfs *st = &entry->st;
+      const char *mountdir = entry->me->me_mountdir;
+      nagstatus space_status, inode_status = STATE_OK;
+      double space_used, inodes_used;
+
+      if (entry->state == DISK_TIMEDOUT)
+	{
+	  fprintf (msg, "%s%s timed out after %lds",
+		   ftell (msg) ? ", " : "", mountdir, timeout);
+	  status = worst_status (status, STATE_UNKNOWN);
+	  continue;
+	}
+      else if (entry->state == DISK_FAILED)
+	{
+	  fprintf (msg, "%s%s: %s", ftell (msg) ? ", " : "", mountdir,
+		   strerror (entry->err));
+	  status = worst_status (status, STATE_UNKNOWN);
+	  continue;
+	}
+
+      /* pseudo file systems like proc or sysfs */
+      if (st->f_blocks == 0 && !fs_filter.show_all_fs)
+	continue;
+
+      nchecked++;
+      space_used = disk_used_percent (st);
+      inodes_used = disk_inodes_used_percent (st);
+
+      space_status = get_status (space_used, my_threshold);
+      if (inode_threshold && st->f_files > 0)
+	inode_status = get_status (inodes_used, inode_threshold);
+
+      if (verbose)
+	printf ("%-10s %s type %s: %.2f%% used, %.2f%% inodes used\n",
+		entry->me->me_devname, mountdir, entry->me->me_type,
+		space_used, inodes_used);
+
+      if (space_status != STATE_OK)
+	fprintf (msg, "%s%s %.2f%% used", ftell (msg) ? ", " : "", mountdir,
+		 space_used);
+      if (inode_status != STATE_OK)
+	fprintf (msg, "%s%s %.2f%% inodes used", ftell (msg) ? ", " : "",
+		 mountdir, inodes_used);
+      status = worst_status (status, worst_status (space_status,
+						   inode_status));
+
+      fprintf (perfdata, "%s=%.2f%%;%s;%s;0;100 ", mountdir, space_used,
+	       warn, crit);
+      fprintf (perfdata, "%s_used=%lluB;;;0;%llu ", mountdir,
+	       (unsigned long long) (st->f_blocks - st->f_bfree) * st->f_frsize,
+	       (unsigned long long) st->f_blocks * st->f_frsize);
+      if (st->f_files > 0)
+	fprintf (perfdata, "%s_inodes=%.2f%%;%s;%s;0;100 ", mountdir,
+		 inodes_used, inode_warn, inode_crit);
+    }
+
+  fclose (msg);
+  fclose (perfdata);
+
+  if (size_msg > 0)
+    printf ("%s %s: %s | %s\n", program_name_short, state_text (status),
+	    bp_msg, bp_perfdata);
+  else
+    printf ("%s %s: %zu file systems checked | %s\n", program_name_short,
+	    state_text (status), nchecked, bp_perfdata);
+
+  free (bp_msg);
+  free (bp_perfdata);
+  free (warn);
+  free (crit);
+  free (inode_warn);
+  free (inode_crit);
+  free (my_threshold);
+  free (inode_threshold);
+  fs_filter_free (&fs_filter);
+
+  /* the threads still blocked in statvfs() reference the mount list */
+  if (!abandoned)
+    {
+      free (entries);
+      free_mount_list (mount_list);
+    }
+
+  return status;
+}
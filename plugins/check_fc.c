@@ -146,11 +146,11 @@ static uint64_t
 fc_host_get_statistic (const char *which, const char *host)
 {
   unsigned long long value;
-  int err;
+  int dirfd;
 
-  err = sysfsparser_getvalue (&value, PATH_SYS_FC_HOST "/%s/statistics/%s",
-			      host, which);
-  if (err < 0)
+  /* the statistics directory stays open across the samplings */
+  dirfd = sysfsparser_opendirfd (PATH_SYS_FC_HOST "/%s/statistics", host);
+  if (dirfd < 0 || sysfsparser_getvalue_at (dirfd, which, &value) < 0)
     plugin_error (STATE_UNKNOWN, 0,
 		  "an error has occurred while reading "
 		  PATH_SYS_FC_HOST "/%s/statistics/%s",
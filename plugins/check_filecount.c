@@ -26,6 +26,9 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "common.h"
 #include "files.h"
@@ -33,7 +36,10 @@
 #include "messages.h"
 #include "progname.h"
 #include "progversion.h"
+#include "string-macros.h"
 #include "thresholds.h"
+#include "xalloc.h"
+#include "xasprintf.h"
 #include "xstrton.h"
 
 static const char *program_copyright =
@@ -43,10 +49,24 @@ static struct option const longopts[] = {
   {(char *) "ignore-symlinks", no_argument, NULL, 'l'},
   {(char *) "ignore-unknown", no_argument, NULL, 'u'},
   {(char *) "include-hidden", no_argument, NULL, 'H'},
+  {(char *) "io-uring", no_argument, NULL, 0},
   {(char *) "name", required_argument, NULL, 'n'},
+  {(char *) "exclude", required_argument, NULL, 'x'},
   {(char *) "recursive", no_argument, NULL, 'r'},
+  {(char *) "max-depth", required_argument, NULL, 0},
+  {(char *) "one-file-system", no_argument, NULL, 0},
   {(char *) "regular-only", no_argument, NULL, 'f'},
   {(char *) "size", required_argument, NULL, 's'},
+  {(char *) "bytes", no_argument, NULL, 0},
+  {(char *) "size-critical", required_argument, NULL, 0},
+  {(char *) "size-warning", required_argument, NULL, 0},
+  {(char *) "top", required_argument, NULL, 0},
+  {(char *) "age-bins", required_argument, NULL, 0},
+  {(char *) "age-bin-warning", required_argument, NULL, 0},
+  {(char *) "age-bin-critical", required_argument, NULL, 0},
+  {(char *) "cache-dir", required_argument, NULL, 0},
+  {(char *) "cache-max-age", required_argument, NULL, 0},
+  {(char *) "threads", required_argument, NULL, 'j'},
   {(char *) "critical", required_argument, NULL, 'c'},
   {(char *) "warning", required_argument, NULL, 'w'},
   {(char *) "verbose", no_argument, NULL, 'v'},
@@ -65,22 +85,57 @@ usage (FILE * out)
   fputs (USAGE_HEADER, out);
   fprintf (out,
 	   "  %s [-w COUNTER] [-c COUNTER] [-f] [-H] [-l] [-r] [-u] \\\n"
-	   "\t[-s SIZE] [-t AGE] [-n PATTERN] DIR [DIR...]\n", program_name);
+	   "\t[--max-depth LEVELS] [--one-file-system] \\\n"
+	   "\t[-s SIZE] [-t AGE] [-n PATTERN]... [-x PATTERN]... [-j THREADS] \\\n"
+	   "\t[--io-uring] [--bytes] [--size-warning SIZE]"
+	   " [--size-critical SIZE] [--top N] \\\n"
+	   "\t[--age-bins AGES [--age-bin-warning BIN=COUNTER]..."
+	   " [--age-bin-critical BIN=COUNTER]...] \\\n"
+	   "\t[--cache-dir CACHEDIR [--cache-max-age AGE]] DIR [DIR...]\n",
+	   program_name);
   fputs (USAGE_OPTIONS, out);
   fputs ("  -f, --regular-only       count regular files only\n", out);
   fputs ("  -H, --include-hidden     do not skip the hidden files\n", out);
+  fputs ("  -j, --threads THREADS    number of threads scanning each DIR"
+	 " with -r\n", out);
+  fputs ("      --io-uring           stat the files in batches through"
+	 " io_uring\n", out);
   fputs ("  -l, --ignore-symlinks    ignore symlinks\n", out);
-  fputs ("  -n, --name               only count files that match PATTERN\n",
+  fputs ("  -n, --name PATTERN       only count files that match PATTERN\n",
 	 out);
   fputs ("  -r, --recursive          check recursively each subdirectory\n",
 	 out);
+  fputs ("      --max-depth LEVELS   descend at most LEVELS levels below DIR"
+	 " with -r\n", out);
+  fputs ("      --one-file-system    skip the directories on other file"
+	 " systems with -r\n", out);
   fputs ("  -s, --size               count only files of a specific size\n",
 	 out);
   fputs ("  -t, --time               count only files of a specific age\n",
 	 out);
   fputs ("  -u, --ignore-unknown     ignore file with type unknown\n", out);
+  fputs ("  -x, --exclude PATTERN    do not count files that match PATTERN\n",
+	 out);
   fputs ("  -w, --warning COUNTER    warning threshold\n", out);
   fputs ("  -c, --critical COUNTER   critical threshold\n", out);
+  fputs ("      --bytes              sum the size of the regular files"
+	 " counted\n", out);
+  fputs ("      --size-warning SIZE  warning threshold on the total size\n",
+	 out);
+  fputs ("      --size-critical SIZE critical threshold on the total size\n",
+	 out);
+  fputs ("      --top N              report the N largest and N oldest"
+	 " files\n", out);
+  fputs ("      --age-bins AGES      count the regular files by age\n",
+	 out);
+  fputs ("      --age-bin-warning BIN=COUNTER   warning threshold on an age"
+	 " bin\n", out);
+  fputs ("      --age-bin-critical BIN=COUNTER  critical threshold on an age"
+	 " bin\n", out);
+  fputs ("      --cache-dir CACHEDIR only read the directories changed since"
+	 " the last run\n", out);
+  fputs ("      --cache-max-age AGE  read again the directories counted"
+	 " before AGE\n", out);
   fputs ("  -v, --verbose   show details for command-line debugging "
 	 "(Nagios may truncate output)\n", out);
   fputs (USAGE_HELP, out);
@@ -96,7 +151,14 @@ usage (FILE * out)
 	 " wildcard\n"
 	 "    as understood by fnmatch(3).  Only the filename is checked against"
 	 " the\n"
-	 "    pattern, not the entire path.\n",
+	 "    pattern, not the entire path.  This option may be repeated: a"
+	 " file is then\n"
+	 "    counted when it matches at least one of the patterns.\n",
+	 out);
+  fputs ("  Option \"exclude\".\n"
+	 "    Do not count the files that match PATTERN, even if they match"
+	 " one of the\n"
+	 "    patterns given with \"name\".  This option may be repeated.\n",
 	 out);
   fputs ("  Option \"size\".\n"
 	 "    When SIZE is a positive number, only files that are at least"
@@ -120,6 +182,69 @@ usage (FILE * out)
 	 " m (minute),\n"
 	 "    h (hour), d (day), w (week), and y (year).\n",
 	 out);
+  fputs ("  Option \"threads\".\n"
+	 "    The subdirectories are scanned in parallel by THREADS threads"
+	 " (default: 1).\n"
+	 "    With THREADS set to 0, one thread per online CPU is started."
+	 "  This may\n"
+	 "    speed up the scan of large trees, mostly on network or"
+	 " parallel storage.\n",
+	 out);
+  fputs ("  Option \"age-bins\".\n"
+	 "    AGES is a comma separated list of ages in ascending order,"
+	 " with the\n"
+	 "    multipliers of the option \"time\".  The regular files counted"
+	 " are split\n"
+	 "    into the bins lt_AGE (younger than AGE, and not younger than the"
+	 " previous\n"
+	 "    AGE) and ge_LASTAGE (older than the last AGE), and the age of"
+	 " the oldest\n"
+	 "    file is reported.  A threshold on the number of files of any bin"
+	 " can be\n"
+	 "    set with --age-bin-warning and --age-bin-critical.\n",
+	 out);
+  fputs ("  Option \"io-uring\".\n"
+	 "    With the options \"size\" and \"time\", every regular file"
+	 " is stat'ed: the\n"
+	 "    requests for a whole directory block are then submitted at"
+	 " once.  This\n"
+	 "    helps on high latency file systems (NFS, FUSE, cold caches) but"
+	 " is slower\n"
+	 "    than the synchronous calls on local warm caches.  This option is"
+	 " ignored\n"
+	 "    when the plugin is built without liburing, or when io_uring is"
+	 " disabled.\n",
+	 out);
+  fputs ("  Options \"bytes\", \"size-warning\", \"size-critical\" and"
+	 " \"top\".\n"
+	 "    The apparent size and the disk space allocated for the regular"
+	 " files\n"
+	 "    counted are summed during the scan and reported as perfdata."
+	 "  The size\n"
+	 "    thresholds apply to the total of all the DIRs and accept the"
+	 " multipliers\n"
+	 "    of the option \"size\".  With \"top\", the paths of the N"
+	 " largest and of the\n"
+	 "    N oldest files (by modification time) are reported in the"
+	 " long output.\n",
+	 out);
+  fputs ("  Options \"cache-dir\" and \"cache-max-age\".\n"
+	 "    The counters of each directory are saved in a file in CACHEDIR"
+	 " (for\n"
+	 "    instance /var/cache/nagios-plugins-linux or /run/...), and the"
+	 " next runs\n"
+	 "    only read again the directories whose modification time has"
+	 " changed, or\n"
+	 "    that hold files whose age has crossed the \"time\" boundary.  The"
+	 " files\n"
+	 "    modified in place do not change their directory: AGE (same"
+	 " format as for\n"
+	 "    \"time\") sets how long the counters of a directory can be"
+	 " trusted.\n"
+	 "    The cache is ignored with \"top\" and \"age-bins\", and the"
+	 " scan is not\n"
+	 "    parallel.\n",
+	 out);
 
   fputs (USAGE_EXAMPLES, out);
   fprintf (out, "  %s -l -r /tmp\n", program_name);
@@ -130,6 +255,16 @@ usage (FILE * out)
   fprintf (out, "  %s -r -t -1h /tmp/myapp   # files modified in the last"
 	   " hour\n", program_name);
   fprintf (out, "  %s -f -n \"myapp-202207*.log\" /var/log/myapp\n", program_name);
+  fprintf (out, "  %s -r -j 8 /srv/nfs/spool\n", program_name);
+  fprintf (out, "  %s -r --max-depth 2 --one-file-system /var\n",
+	   program_name);
+  fprintf (out, "  %s -r -f --size-warning 8g --size-critical 10g --top 5"
+	   " /var/spool/myapp\n", program_name);
+  fprintf (out, "  %s -f --age-bins 1m,5m,1h,1d --age-bin-warning ge_1h=1"
+	   " \\\n\t--age-bin-critical ge_1d=1 /var/spool/postfix/deferred\n",
+	   program_name);
+  fprintf (out, "  %s -r -t 1d --cache-dir /var/cache/nagios-plugins-linux"
+	   " \\\n\t--cache-max-age 1h /srv/archive\n", program_name);
 
   exit (out == stderr ? STATE_UNKNOWN : STATE_OK);
 }
@@ -144,31 +279,192 @@ print_version (void)
   exit (STATE_OK);
 }
 
+/* Convert a size (with an optional multiplier) into a threshold string */
+static char *
+size_threshold (const char *str)
+{
+  long long int bytes;
+  char *errmesg = NULL;
+
+  if (sizetollint (str, &bytes, &errmesg) < 0)
+    plugin_error (STATE_UNKNOWN, errno, "failed to parse size threshold: %s",
+		  errmesg);
+  if (bytes < 0)
+    usage (stderr);
+
+  return xasprintf ("%lld", bytes);
+}
+
+/* Parse a list of ages ("1m,5m,1h,1d") into the upper bounds of the age
+ * bins and the names of the nbins + 1 bins ("lt_1m", ..., "ge_1d") */
+static unsigned int
+parse_age_bins (const char *list, int64_t **bins, char ***names)
+{
+  char *copy = xstrdup (list), *token, *last = NULL, *saveptr,
+       *errmesg = NULL;
+  unsigned int nbins = 0;
+  long long int age;
+
+  *bins = xnmalloc (strlen (list) + 1, sizeof (int64_t));
+  *names = xnmalloc (strlen (list) + 2, sizeof (char *));
+  for (token = strtok_r (copy, ",", &saveptr); token;
+       token = strtok_r (NULL, ",", &saveptr))
+    {
+      if (agetollint (token, &age, &errmesg) < 0)
+	plugin_error (STATE_UNKNOWN, errno, "failed to parse age bin: %s",
+		      errmesg);
+      if (age <= 0 || (nbins > 0 && age <= (*bins)[nbins - 1]))
+	plugin_error (STATE_UNKNOWN, 0,
+		      "the age bins must be positive and in ascending order");
+      (*bins)[nbins] = age;
+      (*names)[nbins++] = xasprintf ("lt_%s", token);
+      last = token;
+    }
+
+  if (0 == nbins)
+    usage (stderr);
+  (*names)[nbins] = xasprintf ("ge_%s", last);
+
+  free (copy);
+  return nbins;
+}
+
+/* Assign the threshold "BIN=COUNTER" to the age bin BIN */
+static void
+set_age_bin_threshold (char *spec, char **bin_thresholds,
+		       char *const *names, unsigned int nbins)
+{
+  char *counter = strchr (spec, '=');
+  unsigned int i;
+
+  if (NULL == counter)
+    usage (stderr);
+  *counter++ = '\0';
+
+  for (i = 0; i <= nbins; i++)
+    if (STREQ (names[i], spec))
+      {
+	bin_thresholds[i] = counter;
+	return;
+      }
+
+  plugin_error (STATE_UNKNOWN, 0, "unknown age bin: %s", spec);
+}
+
+static void
+print_top_files (FILE *out, const char *dir,
+		 const struct files_types *filecount, time_t now)
+{
+  unsigned int i;
+
+  for (i = 0; i < filecount->nlargest; i++)
+    fprintf (out, "%s: largest #%u: %s (%lld bytes)\n", dir, i + 1,
+	     filecount->largest[i].path,
+	     (long long) filecount->largest[i].size);
+  for (i = 0; i < filecount->noldest; i++)
+    fprintf (out, "%s: oldest #%u: %s (modified %.2f days ago)\n", dir,
+	     i + 1, filecount->oldest[i].path,
+	     (now - filecount->oldest[i].mtime) / 60.0 / 60.0 / 24.0);
+}
+
 int
 main (int argc, char **argv)
 {
-  int c, i, ret;
-  bool verbose = false;
+  int c, i, ret, option_index;
+  bool verbose = false, no_recursion = false;
   char *bp, *critical = NULL, *warning = NULL,
        *errmesg_fage = NULL, *errmesg_fsize = NULL,
-       *pattern = NULL;
-  long long int fileage = 0, filesize = 0;
-  size_t size;
+       *size_critical = NULL, *size_warning = NULL,
+       *lp = NULL, *errmesg_cache_age = NULL, *cachedir = NULL,
+       *cachefile;
+  long long int fileage = 0, filesize = 0, cache_max_age = 0;
+  long nthreads;
+  size_t size, lsize;
   unsigned int filecount_flags = FILES_DEFAULT;
-  FILE *perfdata;
-  nagstatus status = STATE_OK;
-  thresholds *my_threshold = NULL;
+  struct files_options opts = { .nthreads = 1 };
+  const char **include_patterns, **exclude_patterns;
+  char **age_bin_warnings, **age_bin_criticals, **age_bin_names = NULL,
+       **bin_warning = NULL, **bin_critical = NULL;
+  unsigned int nage_bin_warnings = 0, nage_bin_criticals = 0, n;
+  int64_t *age_bins = NULL;
+  thresholds **bin_thresholds = NULL;
+  FILE *perfdata, *longoutput = NULL;
+  nagstatus status = STATE_OK, size_status, age_bins_status = STATE_OK;
+  thresholds *my_threshold = NULL, *my_size_threshold = NULL;
 
   set_program_name (argv[0]);
 
+  include_patterns = xnmalloc (argc, sizeof (char *));
+  exclude_patterns = xnmalloc (argc, sizeof (char *));
+  opts.include = include_patterns;
+  opts.exclude = exclude_patterns;
+  age_bin_warnings = xnmalloc (argc, sizeof (char *));
+  age_bin_criticals = xnmalloc (argc, sizeof (char *));
+
   while ((c = getopt_long (argc, argv,
-			   "c:fHln:rs:t:uvw:" GETOPT_HELP_VERSION_STRING,
-			   longopts, NULL)) != -1)
+			   "c:fHj:ln:rs:t:uvw:x:" GETOPT_HELP_VERSION_STRING,
+			   longopts, &option_index)) != -1)
     {
       switch (c)
 	{
 	default:
 	  usage (stderr);
+	case 0:
+	  if (STREQ (longopts[option_index].name, "io-uring"))
+	    filecount_flags |= FILES_URING_STAT;
+	  else if (STREQ (longopts[option_index].name, "bytes"))
+	    filecount_flags |= FILES_SUM_SIZES;
+	  else if (STREQ (longopts[option_index].name, "size-critical"))
+	    size_critical = size_threshold (optarg);
+	  else if (STREQ (longopts[option_index].name, "size-warning"))
+	    size_warning = size_threshold (optarg);
+	  else if (STREQ (longopts[option_index].name, "max-depth"))
+	    {
+	      long max_depth = strtol_or_err (optarg, "the argument of"
+					      " --max-depth must be a"
+					      " positive integer");
+	      if (max_depth < 0)
+		usage (stderr);
+	      /* "--max-depth 0" does not descend into the subdirectories */
+	      if (0 == max_depth)
+		no_recursion = true;
+	      opts.max_depth = max_depth;
+	    }
+	  else if (STREQ (longopts[option_index].name, "one-file-system"))
+	    filecount_flags |= FILES_ONE_FILE_SYSTEM;
+	  else if (STREQ (longopts[option_index].name, "age-bins"))
+	    {
+	      free (age_bins);
+	      opts.nage_bins = parse_age_bins (optarg, &age_bins,
+					       &age_bin_names);
+	      opts.age_bins = age_bins;
+	    }
+	  else if (STREQ (longopts[option_index].name, "age-bin-warning"))
+	    age_bin_warnings[nage_bin_warnings++] = optarg;
+	  else if (STREQ (longopts[option_index].name, "age-bin-critical"))
+	    age_bin_criticals[nage_bin_criticals++] = optarg;
+	  else if (STREQ (longopts[option_index].name, "cache-dir"))
+	    cachedir = optarg;
+	  else if (STREQ (longopts[option_index].name, "cache-max-age"))
+	    {
+	      ret = agetollint (optarg, &cache_max_age, &errmesg_cache_age);
+	      if (ret < 0)
+		plugin_error (STATE_UNKNOWN, errno
+			      , "failed to parse cache age argument: %s"
+			      , errmesg_cache_age);
+	      if (cache_max_age < 0)
+		usage (stderr);
+	      opts.cache_max_age = cache_max_age;
+	    }
+	  else if (STREQ (longopts[option_index].name, "top"))
+	    {
+	      long ntop = strtol_or_err (optarg, "the argument of --top must"
+					 " be a positive integer");
+	      if (ntop < 0)
+		usage (stderr);
+	      opts.ntop = ntop;
+	    }
+	  break;
 	case 'c':
 	  critical = optarg;
 	  break;
@@ -178,11 +474,20 @@ main (int argc, char **argv)
 	case 'H':
 	  filecount_flags |= FILES_INCLUDE_HIDDEN;
 	  break;
+	case 'j':
+	  nthreads = strtol_or_err (optarg, "the number of threads must be"
+				    " a positive integer");
+	  if (nthreads < 0)
+	    usage (stderr);
+	  else if (0 == nthreads)
+	    nthreads = sysconf (_SC_NPROCESSORS_ONLN);
+	  opts.nthreads = (nthreads > 0) ? nthreads : 1;
+	  break;
 	case 'l':
 	  filecount_flags |= FILES_IGNORE_SYMLINKS;
 	  break;
 	case 'n':
-	  pattern = optarg;
+	  include_patterns[opts.ninclude++] = optarg;
 	  break;
 	case 'r':
 	  filecount_flags |= FILES_RECURSIVE;
@@ -207,6 +512,9 @@ main (int argc, char **argv)
 	case 'w':
 	  warning = optarg;
 	  break;
+	case 'x':
+	  exclude_patterns[opts.nexclude++] = optarg;
+	  break;
 	case 'v':
 	  verbose = true;
 	  break;
@@ -220,9 +528,43 @@ main (int argc, char **argv)
   if (argc <= optind)
     usage (stderr);
 
+  if (size_warning || size_critical)
+    filecount_flags |= FILES_SUM_SIZES;
+  if (no_recursion)
+    filecount_flags &= ~FILES_RECURSIVE;
+
+  if ((nage_bin_warnings > 0 || nage_bin_criticals > 0)
+      && 0 == opts.nage_bins)
+    usage (stderr);
+  if (opts.nage_bins > 0)
+    {
+      bin_warning = xnmalloc (opts.nage_bins + 1, sizeof (char *));
+      bin_critical = xnmalloc (opts.nage_bins + 1, sizeof (char *));
+      bin_thresholds = xnmalloc (opts.nage_bins + 1, sizeof (thresholds *));
+      for (n = 0; n <= opts.nage_bins; n++)
+	{
+	  bin_warning[n] = bin_critical[n] = NULL;
+	  bin_thresholds[n] = NULL;
+	}
+      for (n = 0; n < nage_bin_warnings; n++)
+	set_age_bin_threshold (age_bin_warnings[n], bin_warning,
+			       age_bin_names, opts.nage_bins);
+      for (n = 0; n < nage_bin_criticals; n++)
+	set_age_bin_threshold (age_bin_criticals[n], bin_critical,
+			       age_bin_names, opts.nage_bins);
+      for (n = 0; n <= opts.nage_bins; n++)
+	if ((bin_warning[n] || bin_critical[n])
+	    && set_thresholds (&bin_thresholds[n], bin_warning[n],
+			       bin_critical[n]) == NP_RANGE_UNPARSEABLE)
+	  usage (stderr);
+    }
+
   struct files_types *filecount;
   perfdata = open_memstream (&bp, &size);
-  int64_t total = 0;
+  if (opts.ntop > 0)
+    longoutput = open_memstream (&lp, &lsize);
+  int64_t total = 0, total_bytes = 0;
+  time_t now = time (NULL);
 
   for (i = optind; i < argc; ++i)
     {
@@ -238,12 +580,27 @@ main (int argc, char **argv)
 	dbg ("looking for files with size %s than %lld bytes...\n"
 	     , (filesize < 0) ? "less" : "greater"
 	     , (filesize < 0) ? -filesize : filesize);
-      if (pattern != NULL)
-	dbg ("looking for files that math the pattern `%s'...\n", pattern);
+      for (n = 0; n < opts.ninclude; n++)
+	dbg ("looking for files that match the pattern `%s'...\n",
+	     opts.include[n]);
+      for (n = 0; n < opts.nexclude; n++)
+	dbg ("skipping the files that match the pattern `%s'...\n",
+	     opts.exclude[n]);
 
       filecount = NULL;
-      ret = files_filecount (argv[i], filecount_flags,
-			     fileage, filesize, pattern, &filecount);
+      opts.flags = filecount_flags;
+      opts.age = fileage;
+      opts.size = filesize;
+      cachefile = NULL;
+      if (cachedir)
+	{
+	  cachefile = files_cache_path (cachedir, argv[i], &opts);
+	  opts.cache_file = cachefile;
+	  if (verbose)
+	    printf ("using the cache file %s\n", cachefile);
+	}
+      ret = files_filecount_opts (argv[i], &opts, &filecount);
+      free (cachefile);
       if (ret < 0)
 	plugin_error (STATE_UNKNOWN, errno, "Cannot open %s", argv[i]);
 
@@ -272,11 +629,60 @@ main (int argc, char **argv)
       fprintf (perfdata, "%s_unknown=%lu ", argv[i],
 	       (unsigned long)filecount->unknown);
 
+      if (filecount_flags & FILES_SUM_SIZES)
+	{
+	  fprintf (perfdata, "%s_bytes=%lldB;%s;%s ", argv[i],
+		   (long long) filecount->bytes,
+		   size_warning ? size_warning : "",
+		   size_critical ? size_critical : "");
+	  fprintf (perfdata, "%s_allocated=%lldB ", argv[i],
+		   (long long) filecount->blocks * 512);
+	}
+
+      for (n = 0; n < filecount->nage_bins + 1 && filecount->age_count; n++)
+	{
+	  fprintf (perfdata, "%s_age_%s=%lld;%s;%s ", argv[i],
+		   age_bin_names[n], (long long) filecount->age_count[n],
+		   bin_warning[n] ? bin_warning[n] : "",
+		   bin_critical[n] ? bin_critical[n] : "");
+	  if (bin_thresholds[n])
+	    {
+	      nagstatus bin_status =
+		get_status (filecount->age_count[n], bin_thresholds[n]);
+	      if (bin_status > age_bins_status)
+		age_bins_status = bin_status;
+	    }
+	}
+      if (opts.nage_bins > 0)
+	fprintf (perfdata, "%s_oldest_age=%llds ", argv[i],
+		 (long long) filecount->oldest_age);
+
+      if (longoutput)
+	print_top_files (longoutput, argv[i], filecount, now);
+
       total += filecount->total;
-      free (filecount);
+      total_bytes += filecount->bytes;
+      files_types_free (filecount);
     }
 
   fclose (perfdata);
+  if (longoutput)
+    fclose (longoutput);
+
+  free (include_patterns);
+  free (exclude_patterns);
+  free (age_bin_warnings);
+  free (age_bin_criticals);
+  for (n = 0; n < opts.nage_bins + 1 && age_bin_names; n++)
+    {
+      free (age_bin_names[n]);
+      free (bin_thresholds[n]);
+    }
+  free (age_bin_names);
+  free (age_bins);
+  free (bin_warning);
+  free (bin_critical);
+  free (bin_thresholds);
 
   status = set_thresholds (&my_threshold, warning, critical);
   if (status == NP_RANGE_UNPARSEABLE)
@@ -284,9 +690,30 @@ main (int argc, char **argv)
 
   status = get_status (total, my_threshold);
   free (my_threshold);
+  if (age_bins_status > status)
+    status = age_bins_status;
+
+  if (filecount_flags & FILES_SUM_SIZES)
+    {
+      size_status =
+	set_thresholds (&my_size_threshold, size_warning, size_critical);
+      if (size_status == NP_RANGE_UNPARSEABLE)
+	usage (stderr);
+      size_status = get_status (total_bytes, my_size_threshold);
+      free (my_size_threshold);
+      if (size_status > status)
+	status = size_status;
+
+      printf ("%s %s - total number of files: %lu, total size: %lld bytes"
+	      " | %s\n", program_name_short, state_text (status),
+	      (unsigned long)total, (long long)total_bytes, bp);
+    }
+  else
+    printf ("%s %s - total number of files: %lu | %s\n",
+	    program_name_short, state_text (status), (unsigned long)total, bp);
 
-  printf ("%s %s - total number of files: %lu | %s\n",
-	  program_name_short, state_text (status), (unsigned long)total, bp);
+  if (lp)
+    fputs (lp, stdout);
 
   return status;
 }
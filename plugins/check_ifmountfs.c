@@ -27,6 +27,7 @@
 #include <unistd.h>
 
 #include "common.h"
+#include "fsfilter.h"
 #include "string-macros.h"
 #include "messages.h"
 #include "mountlist.h"
@@ -40,6 +41,9 @@ static const char *program_copyright =
 /* Linked list of mounted file systems. */
 static struct mount_entry *mount_list;
 
+/* The file systems given in the command line. */
+static struct fs_filter fs_filter;
+
 static struct option const longopts[] = {
   {(char *) "list", no_argument, NULL, 'l'},
   {(char *) "help", no_argument, NULL, GETOPT_HELP_CHAR},
@@ -76,16 +80,20 @@ print_version (void)
   exit (STATE_OK);
 }
 
-static nagstatus
-check_entry (char const *mountpoint)
+/* Count how many times each of the file systems given in the command
+ * line is mounted */
+
+static void
+check_entries (void)
 {
   struct mount_entry *me;
 
   for (me = mount_list; me; me = me->me_next)
-    if (STREQ (me->me_mountdir, mountpoint))
-      return STATE_OK;
-
-  return STATE_CRITICAL;
+    {
+      hashable_t *np = fs_filter_mountpoint (&fs_filter, me->me_mountdir);
+      if (np)
+	np->count++;
+    }
 }
 
 int
@@ -138,7 +146,11 @@ main (int argc, char **argv)
   }
 
   for (i = optind; i < argc; ++i)
-    if (STATE_CRITICAL == check_entry (argv[i]))
+    fs_filter_add_mountpoint (&fs_filter, argv[i]);
+  check_entries ();
+
+  for (i = optind; i < argc; ++i)
+    if (0 == fs_filter_mountpoint (&fs_filter, argv[i])->count)
       status = STATE_CRITICAL;
     else
       /* This is allowed. See:
@@ -154,5 +166,6 @@ main (int argc, char **argv)
     printf (" unmounted!");
   putchar ('\n');
 
+  fs_filter_free (&fs_filter);
   return status;
 }
@@ -34,6 +34,7 @@
 #include "logging.h"
 #include "messages.h"
 #include "netinfo.h"
+#include "netns.h"
 #include "progname.h"
 #include "progversion.h"
 #include "string-macros.h"
@@ -49,9 +50,12 @@ static const char *program_copyright =
   "Copyright (C) 2014,2015,2020 Davide Madrisan <" PACKAGE_BUGREPORT ">\n";
 
 static struct option const longopts[] = {
+  {(char *) "backlog-critical", required_argument, NULL, 0},
+  {(char *) "backlog-warning", required_argument, NULL, 0},
   {(char *) "check-link", no_argument, NULL, 'k'},
   {(char *) "ifname", required_argument, NULL, 'i'},
   {(char *) "ifname-debug", no_argument, NULL, 0},
+  {(char *) "kind", required_argument, NULL, 'K'},
   {(char *) "no-bytes", no_argument, NULL, 'b'},
   {(char *) "no-collisions", no_argument, NULL, 'C'},
   {(char *) "no-drops", no_argument, NULL, 'd'},
@@ -60,7 +64,9 @@ static struct option const longopts[] = {
   {(char *) "no-multicast", no_argument, NULL, 'm'},
   {(char *) "no-packets", no_argument, NULL, 'p'},
   {(char *) "no-wireless", no_argument, NULL, 'W'},
+  {(char *) "netns", no_argument, NULL, 'n'},
   {(char *) "perc", no_argument, NULL, '%'},
+  {(char *) "rollup", no_argument, NULL, 0},
   {(char *) "rx-only", no_argument, NULL, 'r'},
   {(char *) "tx-only", no_argument, NULL, 't'},
   {(char *) "help", no_argument, NULL, GETOPT_HELP_CHAR},
@@ -75,7 +81,8 @@ typedef enum network_check
   CHECK_COLLISIONS,
   CHECK_DROPPED,
   CHECK_ERRORS,
-  CHECK_MULTICAST
+  CHECK_MULTICAST,
+  CHECK_QDISC
 } network_check;
 
 static _Noreturn void
@@ -85,10 +92,12 @@ usage (FILE * out)
   fputs ("This plugin displays some network interfaces statistics.\n", out);
   fputs (program_copyright, out);
   fputs (USAGE_HEADER, out);
-  fprintf (out, "  %s [-klW] [-bCdemp] [-i <ifname-regex>] [delay]\n",
-	   program_name);
+  fprintf (out, "  %s [-klW] [-bCdemp] [-i <ifname-regex>] [-K <kinds>] "
+	   "[--rollup] [delay]\n", program_name);
   fprintf (out, "  %s [-klW] [-bCdemp] [-i <ifname-regex>] --ifname-debug\n",
 	   program_name);
+  fprintf (out, "  %s --netns [-lW] [-bCdemp] [-i <ifname-regex>] [delay]\n",
+	   program_name);
   fputs (USAGE_OPTIONS, out);
   fputs ("  -i, --ifname         only display interfaces matching a regular "
 	 "expression\n", out);
@@ -96,8 +105,22 @@ usage (FILE * out)
 	 out);
   fputs ("  -k, --check-link     report an error if at least a link is down\n",
 	 out);
+  fputs ("  -K, --kind LIST      only display the interfaces of the given "
+	 "kinds:\n"
+	 "                       physical, bond, bridge, vlan, veth, other, "
+	 "all\n", out);
+  fputs ("      --rollup         do not display the interfaces enslaved to a "
+	 "bond:\n"
+	 "                       a bond reports the sum of the counters of its "
+	 "slaves,\n"
+	 "                       a bridge its own counters only (its ports are "
+	 "still\n"
+	 "                       displayed and listed by --ifname-debug)\n",
+	 out);
   fputs ("  -l, --no-loopback    skip the loopback interface\n", out);
   fputs ("  -W, --no-wireless    skip the wireless interfaces\n", out);
+  fputs ("  -n, --netns          report the aggregated statistics of each "
+	 "network namespace\n", out);
   fputs ("  -%, --perc           return percentage metrics if possible\n",
 	 out);
   fputs ("  -w, --warning COUNTER   warning threshold\n", out);
@@ -124,12 +147,24 @@ usage (FILE * out)
 	 "the thresholds\n", out);
   fputs ("  -t, --tx-only        consider the transmitted traffic only in "
 	 "the thresholds\n", out);
+  fputs ("  When the plugin is called as check_network_qdisc, the drops of "
+	 "the root\n  queueing disciplines are checked instead:\n", out);
+  fputs ("  -w, --warning COUNTER   warning threshold on the drops/s\n", out);
+  fputs ("  -c, --critical COUNTER   critical threshold on the drops/s\n",
+	 out);
+  fputs ("      --backlog-warning BYTES   warning threshold on the backlog\n",
+	 out);
+  fputs ("      --backlog-critical BYTES   critical threshold on the "
+	 "backlog\n", out);
   fputs (USAGE_NOTE, out);
   fputs ("  - The option --ifname supports the POSIX Extended Regular Expression "
 	 "syntax.\n", out);
   fputs ("    See: https://man7.org/linux/man-pages/man7/regex.7.html\n", out);
   fputs ("  - You cannot select both the options r/rx-only and t/tx-only.\n",
 	 out);
+  fputs ("  - The option --netns requires the CAP_SYS_ADMIN and "
+	 "CAP_SYS_PTRACE capabilities\n"
+	 "    and cannot be used with --check-link and --perc.\n", out);
   fputs (USAGE_EXAMPLES, out);
   fprintf (out, "  %s\n", program_name);
   fprintf (out, "  %s --check-link --ifname \"^(enp|eth)\" 15\n", program_name);
@@ -140,6 +175,11 @@ usage (FILE * out)
   fprintf (out, "  %s --perc --ifname \"^(enp|eth)\" -w 80%% 15\n",
 	   program_name);
   fprintf (out, "  %s --no-loopback --no-wireless 15\n", program_name);
+  fprintf (out, "  %s --kind physical,bond --rollup 15\n", program_name);
+  fprintf (out, "  check_network_qdisc --ifname ^eth -w 10 -c 100 "
+	   "--backlog-critical 1000000 15\n");
+  fprintf (out, "  %s --netns --no-loopback --ifname \"^(eth|veth)\" 15\n",
+	   program_name);
 
   exit (out == stderr ? STATE_UNKNOWN : STATE_OK);
 }
@@ -195,12 +235,233 @@ fmt_perfdata_bytes (const char *ifname, const char *label,
   return perfdata;
 }
 
+/* Return the counter compared against the thresholds */
+static unsigned int
+get_check_counter (network_check check, const struct ifstats *stats,
+		   bool tx_only, bool rx_only)
+{
+  switch (check)
+    {
+    default:
+      return get_threshold_metric (stats->tx_bytes, stats->rx_bytes,
+				   tx_only, rx_only);
+    case CHECK_COLLISIONS:
+      return stats->collisions;
+    case CHECK_DROPPED:
+      return get_threshold_metric (stats->tx_dropped, stats->rx_dropped,
+				   tx_only, rx_only);
+    case CHECK_ERRORS:
+      return get_threshold_metric (stats->tx_errors, stats->rx_errors,
+				   tx_only, rx_only);
+    case CHECK_MULTICAST:
+      return stats->multicast;
+    }
+}
+
+/* Check and report the drops and backlog of the queueing disciplines */
+static _Noreturn void
+check_qdisc (const char *plugin_progname, const char *ifname_regex,
+	     unsigned long delay, bool ifname_debug,
+	     char *warning, char *critical,
+	     char *backlog_warning, char *backlog_critical)
+{
+  char *bp;
+  int i = 0;
+  size_t size;
+  unsigned int nqdiscs;
+  nagstatus status;
+  thresholds *my_threshold = NULL, *backlog_threshold = NULL;
+  FILE *perfdata;
+  struct qdisclist *qd, *qdhead = qdiscinfo (ifname_regex, delay, &nqdiscs);
+
+  if (ifname_debug)
+    {
+      print_qdisc_debug (qdhead);
+      exit (STATE_UNKNOWN);
+    }
+
+  if (set_thresholds (&my_threshold, warning, critical)
+      == NP_RANGE_UNPARSEABLE
+      || set_thresholds (&backlog_threshold, backlog_warning, backlog_critical)
+	 == NP_RANGE_UNPARSEABLE)
+    usage (stderr);
+
+  perfdata = open_memstream (&bp, &size);
+  status = STATE_OK;
+
+  qdisclist_foreach (qd, qdhead)
+    {
+      const char *ifname = qdisclist_get_ifname (qd);
+      nagstatus qd_status;
+
+      dbg ("qdisc %s on %s: drops:%u/s backlog:%uB\n"
+	   , qdisclist_get_kind (qd), ifname
+	   , qdisclist_get_drops (qd), qdisclist_get_backlog (qd));
+
+      qd_status = get_status (qdisclist_get_drops (qd), my_threshold);
+      if (qd_status > status)
+	status = qd_status;
+      qd_status = get_status (qdisclist_get_backlog (qd), backlog_threshold);
+      if (qd_status > status)
+	status = qd_status;
+
+      fprintf (perfdata
+	       , "%s_qdrop/s=%u %s_qbacklog=%uB %s_qoverlimit/s=%u "
+		 "%s_qrequeue/s=%u "
+	       , ifname, qdisclist_get_drops (qd)
+	       , ifname, qdisclist_get_backlog (qd)
+	       , ifname, qdisclist_get_overlimits (qd)
+	       , ifname, qdisclist_get_requeues (qd));
+    }
+
+  fclose (perfdata);
+
+  if (nqdiscs < 1)
+    status = STATE_UNKNOWN;
+
+  printf ("%s %s - found %u qdisc(s): "
+	  , plugin_progname
+	  , state_text (status)
+	  , nqdiscs);
+  qdisclist_foreach (qd, qdhead)
+    if (i++ < MAX_PRINTED_INTERFACES)
+      printf ("%s%s (%s)", i < 2 ? "" : ","
+	      , qdisclist_get_ifname (qd), qdisclist_get_kind (qd));
+    else
+      {
+	printf (",...");
+	break;
+      }
+  printf (" | %s\n", bp);
+
+  freeqdisclist (qdhead);
+  free (my_threshold);
+  free (backlog_threshold);
+
+  exit (status);
+}
+
+/* Check and report the statistics aggregated by network namespace */
+static _Noreturn void
+check_netns (const char *plugin_progname, network_check check,
+	     unsigned int options, unsigned int kinds, const char *ifname_regex,
+	     unsigned long delay, bool ifname_debug,
+	     char *warning, char *critical)
+{
+  bool pd_bytes      = (options & NO_BYTES) != NO_BYTES,
+       pd_collisions = (options & NO_COLLISIONS) != NO_COLLISIONS,
+       pd_drops      = (options & NO_DROPS) != NO_DROPS,
+       pd_errors     = (options & NO_ERRORS) != NO_ERRORS,
+       pd_multicast  = (options & NO_MULTICAST) != NO_MULTICAST,
+       pd_packets    = (options & NO_PACKETS) != NO_PACKETS,
+       rx_only       = options & RX_ONLY,
+       tx_only       = options & TX_ONLY;
+  char *bp;
+  int i = 0;
+  size_t size;
+  unsigned int n, nnamespaces, nunreachable = 0;
+  nagstatus status;
+  thresholds *my_threshold = NULL;
+  FILE *perfdata;
+  struct netnsinfo *nslist =
+    netns_netinfo (options, kinds, ifname_regex, delay, &nnamespaces);
+
+  if (ifname_debug)
+    {
+      for (n = 0; n < nnamespaces; n++)
+	if (nslist[n].error)
+	  printf ("%s (not reachable: %s)\n", nslist[n].name,
+		  strerror (nslist[n].error));
+	else
+	  printf ("%s (%u interface(s))\n", nslist[n].name,
+		  nslist[n].ninterfaces);
+      exit (STATE_UNKNOWN);
+    }
+
+  status = set_thresholds (&my_threshold, warning, critical);
+  if (status == NP_RANGE_UNPARSEABLE)
+    usage (stderr);
+
+  perfdata = open_memstream (&bp, &size);
+  status = STATE_OK;
+
+  for (n = 0; n < nnamespaces; n++)
+    {
+      const struct ifstats *st = &nslist[n].stats;
+      const char *name = nslist[n].name;
+      unsigned int counter;
+      nagstatus ns_status;
+
+      if (nslist[n].error)
+	{
+	  nunreachable++;
+	  continue;
+	}
+
+      counter = get_check_counter (check, st, tx_only, rx_only);
+      dbg ("namespace %s: threshold counter: %u with w:%s c:%s\n"
+	   , name, counter
+	   , warning ? warning : "unset"
+	   , critical ? critical : "unset");
+
+      ns_status = get_status (counter, my_threshold);
+      if (ns_status > status)
+	status = ns_status;
+
+      if (pd_bytes)
+	fprintf (perfdata, "%s_txbyte/s=%u %s_rxbyte/s=%u "
+		 , name, st->tx_bytes, name, st->rx_bytes);
+      if (pd_errors)
+	fprintf (perfdata, "%s_txerr/s=%u %s_rxerr/s=%u "
+		 , name, st->tx_errors, name, st->rx_errors);
+      if (pd_drops)
+	fprintf (perfdata, "%s_txdrop/s=%u %s_rxdrop/s=%u "
+		 , name, st->tx_dropped, name, st->rx_dropped);
+      if (pd_packets)
+	fprintf (perfdata, "%s_txpck/s=%u %s_rxpck/s=%u "
+		 , name, st->tx_packets, name, st->rx_packets);
+      if (pd_collisions)
+	fprintf (perfdata, "%s_coll/s=%u ", name, st->collisions);
+      if (pd_multicast)
+	fprintf (perfdata, "%s_mcast/s=%u ", name, st->multicast);
+    }
+
+  fclose (perfdata);
+
+  printf ("%s %s - found %u namespace(s)"
+	  , plugin_progname
+	  , state_text (status)
+	  , nnamespaces - nunreachable);
+  if (nunreachable > 0)
+    printf (" (%u not reachable)", nunreachable);
+  printf (": ");
+  for (n = 0; n < nnamespaces; n++)
+    {
+      if (nslist[n].error)
+	continue;
+      if (i++ < MAX_PRINTED_INTERFACES)
+	printf ("%s%s", i < 2 ? "" : ",", nslist[n].name);
+      else
+	{
+	  printf (",...");
+	  break;
+	}
+    }
+  printf (" | %s\n", bp);
+
+  netns_free (nslist, nnamespaces);
+  free (my_threshold);
+
+  exit (status);
+}
+
 int
 main (int argc, char **argv)
 {
   int c, option_index = 0;
   nagstatus status;
   bool ifname_debug = false,
+       netns_mode = false,
        pd_bytes = true,
        pd_collisions = true,
        pd_drops = true,
@@ -212,9 +473,10 @@ main (int argc, char **argv)
        tx_only = false;
   char *p = NULL, *plugin_progname,
        *critical = NULL, *warning = NULL,
+       *backlog_critical = NULL, *backlog_warning = NULL,
        *bp, *ifname_regex = NULL;
   size_t size;
-  unsigned int options = 0;
+  unsigned int options = 0, kinds = IF_KIND_ALL;
   unsigned long delay, len;
   FILE *perfdata;
   network_check check = CHECK_DEFAULT;
@@ -223,7 +485,7 @@ main (int argc, char **argv)
   set_program_name (argv[0]);
 
   while ((c = getopt_long (argc, argv,
-			   "Cc:bdei:klmpWw:%" GETOPT_HELP_VERSION_STRING,
+			   "Cc:bdei:kK:lmnpWw:%" GETOPT_HELP_VERSION_STRING,
 			   longopts, &option_index)) != -1)
     {
       switch (c)
@@ -233,6 +495,12 @@ main (int argc, char **argv)
 	case 0:
 	  if (STREQ (longopts[option_index].name, "ifname-debug"))
 	    ifname_debug = true;
+	  else if (STREQ (longopts[option_index].name, "rollup"))
+	    options |= ROLLUP_SLAVES;
+	  else if (STREQ (longopts[option_index].name, "backlog-critical"))
+	    backlog_critical = optarg;
+	  else if (STREQ (longopts[option_index].name, "backlog-warning"))
+	    backlog_warning = optarg;
 	  break;
 	case 'b':
 	  options |= NO_BYTES;
@@ -259,6 +527,9 @@ main (int argc, char **argv)
 	case 'k':
 	  options |= CHECK_LINK;
 	  break;
+	case 'K':
+	  kinds = if_kinds_parse (optarg);
+	  break;
 	case 'l':
 	  options |= NO_LOOPBACK;
 	  break;
@@ -266,6 +537,9 @@ main (int argc, char **argv)
 	  options |= NO_MULTICAST;
 	  pd_multicast = false;
 	  break;
+	case 'n':
+	  netns_mode = true;
+	  break;
 	case 'p':
 	  options |= NO_PACKETS;
 	  pd_packets = false;
@@ -309,6 +583,8 @@ main (int argc, char **argv)
 
   if (tx_only && rx_only)
     usage (stderr);
+  if (netns_mode && (report_perc || (options & CHECK_LINK)))
+    usage (stderr);
 
   len = strlen (program_name);
   if (len > 6 && STRPREFIX (program_name, "check_"))
@@ -345,12 +621,27 @@ main (int argc, char **argv)
 	usage (stderr);
       plugin_progname = xstrdup ("network multicast");
     }
+  else if (STRPREFIX (p, "network_qdisc"))
+    {
+      check = CHECK_QDISC;
+      if (netns_mode || report_perc)
+	usage (stderr);
+      plugin_progname = xstrdup ("network qdisc");
+    }
   else
     plugin_progname = xstrdup ("network");
 
+  if (check == CHECK_QDISC)
+    check_qdisc (plugin_progname, ifname_regex, delay, ifname_debug,
+		 warning, critical, backlog_warning, backlog_critical);
+
+  if (netns_mode)
+    check_netns (plugin_progname, check, options, kinds, ifname_regex, delay,
+		 ifname_debug, warning, critical);
+
   unsigned int ninterfaces;
   struct iflist *ifl, *iflhead =
-    netinfo (options, ifname_regex, delay, &ninterfaces);
+    netinfo (options, kinds, ifname_regex, delay, &ninterfaces);
 
   /* just print the list of matching interfaces and exit */
   if (ifname_debug)
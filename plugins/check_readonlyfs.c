@@ -19,7 +19,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>
 #include <getopt.h>
+#include <limits.h>
 #include <mntent.h>
 #include <fcntl.h>
 #include <stdio.h>
@@ -27,54 +29,32 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "common.h"
+#include "fsfilter.h"
 #include "string-macros.h"
 #include "messages.h"
 #include "mountlist.h"
+#include "mountwatch.h"
 #include "xalloc.h"
+#include "xasprintf.h"
+#include "xstrton.h"
 #include "progname.h"
 #include "progversion.h"
 
 static const char *program_copyright =
   "Copyright (C) 2013-2015,2025 Davide Madrisan <" PACKAGE_BUGREPORT ">\n";
 
-/* A file system type to display. */
-
-struct fs_type_list
-{
-  char *fs_name;
-  struct fs_type_list *fs_next;
-};
-
-/* Linked list of file system types to display.
- * If 'fs_select_list' is NULL, list all types.
- * This table is generated dynamically from command-line options,
- * rather than hardcoding into the program what it thinks are the
- * valid file system types; let the user specify any file system type
- * they want to, and if there are any file systems of that type, they
- * will be shown.
- *
- * Some file system types:
- * 4.2 4.3 ufs nfs swap ignore io vm efs dbg */
-
-static struct fs_type_list *fs_select_list;
-
-/* Linked list of file system types to omit.
- *    If the list is empty, don't exclude any types.  */
-static struct fs_type_list *fs_exclude_list;
+/* The file system types to check or omit (a type can be any string: the
+ * list of the valid types is not hardcoded into the program), the file
+ * systems given in the command line, and the -a and -l flags.  */
+static struct fs_filter fs_filter;
 
 /* Linked list of mounted file systems. */
 static struct mount_entry *mount_list;
 
-/* If true, show even file systems with zero size or
-   uninteresting types. */
-static bool show_all_fs;
-
-/* If true, show only local file systems.  */
-static bool show_local_fs;
-
 /* If true, show each file system corresponding to the
    command line arguments.  */
 static bool verbose = false;
@@ -85,6 +65,10 @@ static struct option const longopts[] = {
   {(char *) "type", required_argument, NULL, 'T'},
   {(char *) "exclude", no_argument, NULL, 'x'},
   {(char *) "exclude-type", required_argument, NULL, 'X'},
+  {(char *) "watch", no_argument, NULL, 0},
+  {(char *) "state-file", required_argument, NULL, 0},
+  {(char *) "state-max-age", required_argument, NULL, 0},
+  {(char *) "interval", required_argument, NULL, 0},
   {(char *) "verbose", no_argument, NULL, 'v'},
   {(char *) "help", no_argument, NULL, GETOPT_HELP_CHAR},
   {(char *) "version", no_argument, NULL, GETOPT_VERSION_CHAR},
@@ -109,6 +93,20 @@ usage (FILE * out)
 	 "check all but file systems passed as arguments\n", out);
   fputs ("  -X, --exclude-type=TYPE   "
 	 "limit listing to file systems not of type TYPE\n", out);
+  fputs ("      --watch     do not exit and record in the state file the "
+	 "mounts\n"
+	 "                  becoming read-only (or read-write)\n", out);
+  fputs ("      --state-file FILE   the state file written in watch mode\n",
+	 out);
+  fputs ("      --interval TIME   in watch mode, reread the mount table "
+	 "also every\n"
+	 "                  TIME (default: 1m), to catch the file systems "
+	 "remounted\n"
+	 "                  read-only by the kernel after an error\n", out);
+  fputs ("      --state-max-age AGE   "
+	 "warn about the read-only transitions recorded\n"
+	 "                  in the state file in the last AGE (default: 1d)\n",
+	 out);
   fputs ("  -v, --verbose   show details for command-line debugging "
          "(Nagios may truncate output)\n", out);
   fputs (USAGE_HELP, out);
@@ -118,6 +116,10 @@ usage (FILE * out)
   fprintf (out, "  %s -l -X vfat\n", program_name);
   fprintf (out, "  %s -x /run/credentials/systemd-journald.service /dev/sr0\n",
 	   program_name);
+  fprintf (out, "  %s -l --watch --state-file /run/readonlyfs.state &\n",
+	   program_name);
+  fprintf (out, "  %s -l --state-file /run/readonlyfs.state "
+	   "--state-max-age 12h\n", program_name);
 
   exit (out == stderr ? STATE_UNKNOWN : STATE_OK);
 }
@@ -132,189 +134,252 @@ print_version (void)
   exit (STATE_OK);
 }
 
-/* Add FSTYPE to the list of file system types to display. */
-
-static void
-add_fs_type (const char *fstype)
+static bool
+skip_mount_entry (const struct mount_entry *me)
 {
-  struct fs_type_list *fsp;
-
-  fsp = xmalloc (sizeof *fsp);
-  fsp->fs_name = (char *) fstype;
-  fsp->fs_next = fs_select_list;
-  fs_select_list = fsp;
+  return fs_filter_skip (&fs_filter, me);
 }
 
-/* Is FSTYPE a type of file system that should be listed?  */
-
-static bool
-selected_fstype (const char *fstype)
+static struct mount_entry *
+read_mount_list (void)
 {
-  const struct fs_type_list *fsp;
-
-  if (fs_select_list == NULL || fstype == NULL)
-    return true;
-  for (fsp = fs_select_list; fsp; fsp = fsp->fs_next)
-    if (STREQ (fstype, fsp->fs_name))
-      return true;
-  return false;
+  return read_file_system_list (true);
 }
 
-/* Add FSTYPE to the list of file system types to be omitted. */
+/* Watch the mount table and record the read-only transitions of the
+ * file systems not filtered out by -a/-l/-T/-X into 'state_file'.
+ * The table is reread at every change and every 'interval' seconds.  */
 
-static void
-add_excluded_fs_type (const char *fstype)
+static _Noreturn void
+watch_mount_table (const char *state_file, long long interval)
 {
-  struct fs_type_list *fsp;
+  struct mountwatch_state state;
+  struct mount_entry *mounts;
+  unsigned int i;
+  int err, fd, nevents;
+
+  if ((err = mountwatch_state_read (state_file, &state)) < 0)
+    plugin_error (STATE_UNKNOWN, -err, "cannot read the state file `%s'",
+		  state_file);
+  if ((fd = mountwatch_open ()) < 0)
+    plugin_error (STATE_UNKNOWN, -fd, "cannot watch the mount table");
+  if ((mounts = read_mount_list ()) == NULL)
+    plugin_error (STATE_UNKNOWN, 0,
+		  "cannot read table of mounted file systems");
 
-  fsp = xmalloc (sizeof *fsp);
-  fsp->fs_name = (char *) fstype;
-  fsp->fs_next = fs_exclude_list;
-  fs_exclude_list = fsp;
+  for (;;)
+    {
+      nevents = mountwatch_update (fd, interval * 1000, &mounts,
+				   read_mount_list, skip_mount_entry, &state);
+      if (nevents < 0)
+	plugin_error (STATE_UNKNOWN, -nevents,
+		      "cannot watch the mount table");
+      if (nevents > 0)
+	{
+	  if (verbose)
+	    for (i = state.nevents - nevents; i < state.nevents; i++)
+	      printf ("%s is now %s\n", state.events[i].mountdir,
+		      state.events[i].readonly ? "read-only" : "read-write");
+	  fflush (stdout);
+	  if ((err = mountwatch_state_write (state_file, &state)) < 0)
+	    plugin_error (STATE_UNKNOWN, -err,
+			  "cannot write the state file `%s'", state_file);
+	}
+    }
 }
 
-/* Is FSTYPE a type of file system that should be omitted?  */
+/* Look in 'state_file' for the file systems that became read-only in
+ * the last 'max_age' seconds (possibly remounted read-write since then).
+ * The file systems are selected by type and by the mount points given in
+ * the command line.  Return STATE_WARNING and their list in 'transitions'
+ * if some are found.  */
 
-static bool
-excluded_fstype (const char *fstype)
+static int
+check_state_file (const char *state_file, long long max_age,
+		  bool exclude_mode, char **transitions)
 {
-  const struct fs_type_list *fsp;
-
-  if (fs_exclude_list == NULL || fstype == NULL)
-    return false;
-  for (fsp = fs_exclude_list; fsp; fsp = fsp->fs_next)
-    if (STREQ (fstype, fsp->fs_name))
-      return true;
-  return false;
-}
+  struct mountwatch_state state;
+  time_t now = time (NULL);
+  char *bp;
+  size_t size;
+  unsigned int i;
+  FILE *stream;
+  int err;
+
+  *transitions = NULL;
+  if ((err = mountwatch_state_read (state_file, &state)) < 0)
+    plugin_error (STATE_UNKNOWN, -err, "cannot read the state file `%s'",
+		  state_file);
+
+  stream = open_memstream (&bp, &size);
+  for (i = 0; i < state.nevents; i++)
+    {
+      const struct mountwatch_event *event = &state.events[i];
+      char date[32];
 
-static bool
-skip_mount_entry (struct mount_entry *me)
-{
-  if (me->me_remote && show_local_fs)
-    return true;
+      if (!event->readonly || now - event->when > max_age)
+	continue;
+      if (!fs_filter_selected_fstype (&fs_filter, event->type)
+	  || fs_filter_excluded_fstype (&fs_filter, event->type))
+	continue;
+      if (fs_filter.mountpoints
+	  && (fs_filter_mountpoint (&fs_filter, event->mountdir) != NULL)
+	     == exclude_mode)
+	continue;
 
-  if (me->me_dummy && !show_all_fs)
-    return true;
+      strftime (date, sizeof date, "%F %T", localtime (&event->when));
+      fprintf (stream, "%s%s was readonly at %s",
+	       ftell (stream) ? ", " : "", event->mountdir, date);
+    }
+  fclose (stream);
+  mountwatch_state_free (&state);
 
-  if (!selected_fstype (me->me_type) || excluded_fstype (me->me_type))
-    return true;
+  if (0 == size)
+    {
+      free (bp);
+      return STATE_OK;
+    }
 
-  return false;
+  *transitions = bp;
+  return STATE_WARNING;
+}
+
+static void
+print_mount_entry (const struct mount_entry *me)
+{
+  printf ("%-10s %s type %s (%s) %s\n",
+	  me->me_devname, me->me_mountdir, me->me_type, me->me_opts,
+	  (me->me_readonly) ? "<< read-only" : "");
 }
 
 static int
-check_all_entries (char **ro_filesystems, char **fs_exclude)
+check_all_entries (char **ro_filesystems, bool exclude_mode)
 {
   struct mount_entry *me;
   int status = STATE_OK;
-  bool ignore;
-  char *p;
-  char **fs;
-  size_t len;
+  size_t size;
+  FILE *stream = open_memstream (ro_filesystems, &size);
 
   for (me = mount_list; me; me = me->me_next)
     {
-      ignore = false;
-      if (fs_exclude)
-	for (fs = fs_exclude; *fs; fs++)
-	  if (STREQ(*fs, me->me_devname) || STREQ(*fs, me->me_mountdir))
-	    {
-	      ignore = true;
-	      break;
-	    }
-      if (ignore)
+      if (exclude_mode && fs_filter_listed (&fs_filter, me))
 	continue;
 
       if (skip_mount_entry (me))
 	continue;
 
       if (verbose)
-	printf ("%-10s %s type %s (%s) %s\n",
-		me->me_devname, me->me_mountdir, me->me_type, me->me_opts,
-		(me->me_readonly) ? "<< read-only" : "");
+	print_mount_entry (me);
 
       if (me->me_readonly)
 	{
-	  if (*ro_filesystems == NULL)
-	    *ro_filesystems = xstrdup (me->me_mountdir);
-	  else
-	    {
-	      len = strlen (*ro_filesystems) + strlen (me->me_mountdir) + 2;
-	      p = xrealloc (*ro_filesystems, len);
-	      sprintf (p, "%s %s", *ro_filesystems, me->me_mountdir);
-	      *ro_filesystems = p;
-	    }
+	  fprintf (stream, "%s%s", ftell (stream) ? " " : "", me->me_mountdir);
 	  status = STATE_CRITICAL;
 	}
     }
 
+  fclose (stream);
   return status;
 }
 
+/* Count in the entries of the mount points given in the command line
+ * how many read-only file systems are mounted there.  Like the original
+ * per-argument scan, the mounts stacked on a mount point are checked in
+ * the mount table order, and the check stops at the first one that is
+ * read-only or filtered out.  */
+
 static int
-check_entry (char const *name)
+check_listed_entries (void)
 {
+  hashtable_t *checked = counter_create ();
   struct mount_entry *me;
-
-  if (name == NULL)
-    return STATE_OK;
+  int status = STATE_OK;
 
   for (me = mount_list; me; me = me->me_next)
-    if (STREQ (me->me_mountdir, name))
-      {
-	if (skip_mount_entry (me))
-	  return STATE_OK;
+    {
+      hashable_t *np = fs_filter_mountpoint (&fs_filter, me->me_mountdir);
+
+      if (NULL == np || counter_lookup (checked, me->me_mountdir))
+	continue;
+      if (skip_mount_entry (me))
+	{
+	  counter_put (checked, me->me_mountdir, 1);
+	  continue;
+	}
 
-	if (verbose)
-	  printf ("%-10s %s type %s (%s) %s\n",
-		  me->me_devname, me->me_mountdir, me->me_type, me->me_opts,
-		  (me->me_readonly) ? "<< read-only" : "");
+      if (verbose)
+	print_mount_entry (me);
 
-	if (me->me_readonly)
-	  return STATE_CRITICAL;
-      }
+      if (me->me_readonly)
+	{
+	  counter_put (checked, me->me_mountdir, 1);
+	  np->count++;
+	  status = STATE_CRITICAL;
+	}
+    }
 
-  return STATE_OK;
+  counter_free (checked);
+  return status;
 }
 
 int
 main (int argc, char **argv)
 {
-  bool exclude_mode = false;
-  int c, i;
-  int status = STATE_OK;
-  char *ro_filesystems = NULL;
-
-  fs_select_list = NULL;
-  fs_exclude_list = NULL;
-
-  show_local_fs = false;
-  show_all_fs = false;
+  bool exclude_mode = false, watch_mode = false;
+  int c, i, option_index = 0;
+  int status = STATE_OK, state_status = STATE_OK;
+  char *ro_filesystems = NULL, *state_file = NULL, *transitions = NULL;
+  long long state_max_age = 86400, watch_interval = 60;
+  const char *fstype;
 
   set_program_name (argv[0]);
 
   while ((c = getopt_long (argc, argv,
-          "alT:xX:v" GETOPT_HELP_VERSION_STRING, longopts, NULL)) != -1)
+          "alT:xX:v" GETOPT_HELP_VERSION_STRING, longopts,
+          &option_index)) != -1)
     {
       switch (c)
 	{
 	default:
 	  usage (stderr);
+	case 0:
+	  if (STREQ (longopts[option_index].name, "watch"))
+	    watch_mode = true;
+	  else if (STREQ (longopts[option_index].name, "state-file"))
+	    state_file = optarg;
+	  else if (STREQ (longopts[option_index].name, "state-max-age"))
+	    {
+	      char *errmesg = NULL;
+	      if (agetollint (optarg, &state_max_age, &errmesg) < 0)
+		plugin_error (STATE_UNKNOWN, errno,
+			      "failed to parse the state age: %s", errmesg);
+	      if (state_max_age < 0)
+		usage (stderr);
+	    }
+	  else if (STREQ (longopts[option_index].name, "interval"))
+	    {
+	      char *errmesg = NULL;
+	      if (agetollint (optarg, &watch_interval, &errmesg) < 0)
+		plugin_error (STATE_UNKNOWN, errno,
+			      "failed to parse the interval: %s", errmesg);
+	      if (watch_interval <= 0 || watch_interval > INT_MAX / 1000)
+		usage (stderr);
+	    }
+	  break;
 	case 'a':
-	  show_all_fs = true;
+	  fs_filter.show_all_fs = true;
 	  break;
 	case 'l':
-	  show_local_fs = true;
+	  fs_filter.show_local_fs = true;
 	  break;
 	case 'T':
-	  add_fs_type (optarg);
+	  fs_filter_select_type (&fs_filter, optarg);
 	  break;
 	case 'x':
 	  exclude_mode = true;
 	  break;
 	case 'X':
-	  add_excluded_fs_type (optarg);
+	  fs_filter_exclude_type (&fs_filter, optarg);
 	  break;
 	case 'v':
 	  verbose = true;
@@ -327,21 +392,20 @@ main (int argc, char **argv)
     }
 
   /* Fail if the same file system type was both selected and excluded.  */
-  {
-    struct fs_type_list *fs_incl;
-    for (fs_incl = fs_select_list; fs_incl; fs_incl = fs_incl->fs_next)
-      {
-	struct fs_type_list *fs_excl;
-	for (fs_excl = fs_exclude_list; fs_excl; fs_excl = fs_excl->fs_next)
-	  {
-	    if (STREQ (fs_incl->fs_name, fs_excl->fs_name))
-	      plugin_error (STATE_UNKNOWN, 0,
-		            "file system type `%s' both selected and "
-                            "excluded",
-		            fs_incl->fs_name);
-	  }
-      }
-  }
+  if ((fstype = fs_filter_type_conflict (&fs_filter)) != NULL)
+    plugin_error (STATE_UNKNOWN, 0,
+		  "file system type `%s' both selected and excluded", fstype);
+
+  for (i = optind; i < argc; ++i)
+    fs_filter_add_mountpoint (&fs_filter, argv[i]);
+
+  if (watch_mode)
+    {
+      if (NULL == state_file)
+	plugin_error (STATE_UNKNOWN, 0,
+		      "the --watch option requires a --state-file");
+      watch_mount_table (state_file, watch_interval);
+    }
 
   if (optind < argc && !exclude_mode)
     {
@@ -361,23 +425,30 @@ main (int argc, char **argv)
 		  "the --exclude option requires a list of file systems");
 
   mount_list =
-    read_file_system_list ((fs_select_list != NULL
-			    || fs_exclude_list != NULL || show_local_fs));
+    read_file_system_list ((fs_filter.select_types != NULL
+			    || fs_filter.exclude_types != NULL
+			    || fs_filter.show_local_fs));
 
   if (NULL == mount_list)
     /* Couldn't read the table of mounted file systems. */
     plugin_error (STATE_UNKNOWN, 0,
 		  "cannot read table of mounted file systems");
 
+  /* the read-only transitions missed between two checks */
+  if (state_file)
+    state_status =
+      check_state_file (state_file, state_max_age, exclude_mode,
+			&transitions);
+
   if (!exclude_mode && optind < argc)
     {
+      status = check_listed_entries ();
       for (i = optind; i < argc; ++i)
-	{
-	  if (STATE_CRITICAL == check_entry (argv[i]))
-	    status = STATE_CRITICAL;
-	  else
-	    argv[i] = NULL;
-	}
+	if (0 == fs_filter_mountpoint (&fs_filter, argv[i])->count)
+	  argv[i] = NULL;
+
+      if (STATE_OK == status)
+	status = state_status;
 
       printf ("%s %s", program_name_short, state_text (status));
       if (STATE_CRITICAL == status)
@@ -387,23 +458,34 @@ main (int argc, char **argv)
 	      printf (" %s", argv[i]);
 	  printf (" readonly!");
 	}
+      if (transitions)
+	printf ("%s%s", (STATE_CRITICAL == status) ? ", " : " ", transitions);
 
       putchar ('\n');
+      free (transitions);
+      fs_filter_free (&fs_filter);
       return status;
     }
   else
-      status =
-	check_all_entries (&ro_filesystems,
-			   exclude_mode ? argv + optind : NULL);
+      status = check_all_entries (&ro_filesystems, exclude_mode);
 
   if (STATE_CRITICAL == status)
     {
-      printf ("%s %s: %s readonly!\n", program_name_short, state_text (status),
-	      ro_filesystems);
-      free (ro_filesystems);
+      printf ("%s %s: %s readonly!%s%s\n", program_name_short,
+	      state_text (status), ro_filesystems,
+	      transitions ? ", " : "", transitions ? transitions : "");
+    }
+  else if (transitions)
+    {
+      status = state_status;
+      printf ("%s %s: %s\n", program_name_short, state_text (status),
+	      transitions);
     }
   else
     printf ("%s %s\n", program_name_short, state_text (status));
 
+  free (ro_filesystems);
+  free (transitions);
+  fs_filter_free (&fs_filter);
   return status;
 }
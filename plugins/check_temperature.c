@@ -23,9 +23,11 @@
  *
  * See also the official kernel documentation:
  *  <https://www.kernel.org/doc/Documentation/thermal/sysfs-api.txt>
+ *  <https://www.kernel.org/doc/Documentation/hwmon/sysfs-interface>
  */
 
 #include <errno.h>
+#include <fnmatch.h>
 #include <getopt.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -33,6 +35,8 @@
 #include <unistd.h>
 
 #include "common.h"
+#include "hwmon.h"
+#include "logging.h"
 #include "messages.h"
 #include "progname.h"
 #include "progversion.h"
@@ -55,6 +59,8 @@ static struct option const longopts[] = {
   {(char *) "kelvin", required_argument, NULL, 'k'},
   {(char *) "list", no_argument, NULL, 'l'},
   {(char *) "thermal_zone", required_argument, NULL, 't'},
+  {(char *) "hwmon", no_argument, NULL, 'H'},
+  {(char *) "label", required_argument, NULL, 'L'},
   {(char *) "critical", required_argument, NULL, 'c'},
   {(char *) "warning", required_argument, NULL, 'w'},
   {(char *) "help", no_argument, NULL, GETOPT_HELP_CHAR},
@@ -67,18 +73,26 @@ usage (FILE * out)
 {
   fprintf (out, "%s (" PACKAGE_NAME ") v%s\n", program_name, program_version);
   fputs ("This plugin monitors the hardware's temperature.\n", out);
-  fprintf (out, "It requires the sysfs tree %s to be mounted and readable.\n",
-           sysfsparser_thermal_sysfs_path ());
+  fprintf (out, "It requires the sysfs tree %s (or %s\n"
+	   "with the option --hwmon) to be mounted and readable.\n",
+	   sysfsparser_thermal_sysfs_path (), hwmon_sysfs_path ());
   fputs (program_copyright, out);
   fputs (USAGE_HEADER, out);
   fprintf (out, "  %s [-f|-k] [-t <thermal_zone_num>] "
 	   "[-w COUNTER] [-c COUNTER]\n", program_name);
+  fprintf (out, "  %s -H [-f|-k] [-L LABEL=WARN,CRIT]... "
+	   "[-w COUNTER] [-c COUNTER]\n", program_name);
   fputs (USAGE_OPTIONS, out);
   fputs ("  -f, --fahrenheit  use fahrenheit as the temperature unit\n", out);
   fputs ("  -k, --kelvin      use kelvin as the temperature unit\n", out);
   fputs ("  -l, --list        list all the thermal sensors reported by the"
 	 " kernel\n", out);
   fputs ("  -t, --thermal_zone    only consider a specific thermal zone\n", out);
+  fputs ("  -H, --hwmon       read the hwmon sensors instead of the thermal"
+	 " zones\n", out);
+  fputs ("  -L, --label LABEL=WARN,CRIT   thresholds for the hwmon sensors"
+	 " whose label\n"
+	 "    matches the shell pattern LABEL (implies --hwmon)\n", out);
   fputs ("  -w, --warning COUNTER   warning threshold\n", out);
   fputs ("  -c, --critical COUNTER   critical threshold\n", out);
   fputs (USAGE_HELP, out);
@@ -89,10 +103,15 @@ usage (FILE * out)
 	 "  with the highest temperature is selected. Note that this zone"
 	 " may change\n"
 	 "  at each plugin execution.\n", out);
+  fputs ("  With '-H|--hwmon', the plugin reports the highest and the average"
+	 " temperature\n"
+	 "  of each hwmon chip; the thresholds are checked against every"
+	 " sensor.\n", out);
   fputs (USAGE_EXAMPLES, out);
   fprintf (out, "  %s --list\n", program_name);
   fprintf (out, "  %s -w 80 -c 90\n", program_name);
   fprintf (out, "  %s -t 0 -w 80 -c 90\n", program_name);
+  fprintf (out, "  %s -H -w 80 -c 90 -L 'Composite=60,70'\n", program_name);
 
   exit (out == stderr ? STATE_UNKNOWN : STATE_OK);
 }
@@ -108,7 +127,7 @@ print_version (void)
 }
 
 static double
-get_real_temp (unsigned long temperature, char **scale, int temp_units)
+get_real_temp (long temperature, char **scale, int temp_units)
 {
   double real_temp = (double) temperature / 1000.0;
   const double absolute_zero = 273.1;
@@ -133,20 +152,175 @@ get_real_temp (unsigned long temperature, char **scale, int temp_units)
 }
 
 #ifndef NPL_TESTING
+
+/* The thresholds of the hwmon sensors whose label matches 'pattern' */
+struct label_threshold
+{
+  const char *pattern;
+  char *warning, *critical;	/* for the perfdata */
+  thresholds *threshold;
+};
+
+/* Parse the argument "LABEL=WARN,CRIT" of the option --label */
+static void
+label_threshold_parse (char *arg, struct label_threshold *lt)
+{
+  char *warning, *critical;
+
+  if ((warning = strrchr (arg, '=')) == NULL || warning == arg)
+    usage (stderr);
+  *warning++ = '\0';
+  if ((critical = strchr (warning, ',')) == NULL)
+    usage (stderr);
+  *critical++ = '\0';
+
+  lt->pattern = arg;
+  lt->warning = *warning ? warning : NULL;
+  lt->critical = *critical ? critical : NULL;
+  lt->threshold = NULL;
+  if (set_thresholds (&lt->threshold, lt->warning,
+		      lt->critical) == NP_RANGE_UNPARSEABLE)
+    usage (stderr);
+}
+
+/* Return the thresholds of the first --label matching 'label', or NULL */
+static const struct label_threshold *
+label_threshold_lookup (const struct label_threshold *labels,
+			unsigned int nlabels, const char *label)
+{
+  unsigned int i;
+
+  for (i = 0; i < nlabels; i++)
+    if (fnmatch (labels[i].pattern, label, 0) == 0)
+      return &labels[i];
+
+  return NULL;
+}
+
+static void
+hwmon_listall (void)
+{
+  unsigned int i, j, nchips;
+  struct hwmon_chip *chips = hwmon_get_chips (&nchips);
+
+  printf ("Temperature sensors reported by the hwmon drivers (%s):\n",
+	  hwmon_sysfs_path ());
+
+  for (i = 0; i < nchips; i++)
+    {
+      printf (" - hwmon%u [%s]\n", chips[i].id, chips[i].name);
+      for (j = 0; j < chips[i].nsensors; j++)
+	{
+	  const struct hwmon_sensor *sensor = &chips[i].sensors[j];
+	  printf ("   - temp%u \"%s\", %.1f°C", sensor->index, sensor->label,
+		  sensor->input / 1000.0);
+	  if (sensor->has_crit && sensor->crit > 0)
+	    printf (", critical at %.1f°C", sensor->crit / 1000.0);
+	  putchar ('\n');
+	}
+    }
+
+  hwmon_chips_free (chips, nchips);
+}
+
+/* Check all the hwmon sensors and report the highest and the average
+ * temperature of each chip */
+static nagstatus
+check_hwmon (int temperature_unit, thresholds *my_threshold,
+	     const char *warning, const char *critical,
+	     const struct label_threshold *labels, unsigned int nlabels)
+{
+  const struct hwmon_chip *worst_chip = NULL;
+  const struct hwmon_sensor *worst = NULL;
+  struct hwmon_chip *chips;
+  nagstatus status = STATE_OK;
+  double worst_temp = 0;
+  char *perfdata = NULL, *scale = "";
+  size_t perfdata_size = 0;
+  unsigned int i, j, nchips;
+  FILE *out;
+
+  chips = hwmon_get_chips (&nchips);
+  if (0 == nchips)
+    plugin_error (STATE_UNKNOWN, 0,
+		  "no hwmon temperature sensor has been found in %s",
+		  hwmon_sysfs_path ());
+
+  if ((out = open_memstream (&perfdata, &perfdata_size)) == NULL)
+    plugin_error (STATE_UNKNOWN, errno, "memory exhausted");
+
+  for (i = 0; i < nchips; i++)
+    {
+      const struct hwmon_chip *chip = &chips[i];
+      const char *max_warning = warning, *max_critical = critical;
+      double max = 0, sum = 0;
+
+      for (j = 0; j < chip->nsensors; j++)
+	{
+	  const struct hwmon_sensor *sensor = &chip->sensors[j];
+	  const struct label_threshold *lt =
+	    label_threshold_lookup (labels, nlabels, sensor->label);
+	  double temp =
+	    get_real_temp (sensor->input, &scale, temperature_unit);
+	  nagstatus currstatus =
+	    get_status (temp, lt ? lt->threshold : my_threshold);
+
+	  dbg ("hwmon%u [%s]: \"%s\" %.1f%s\n", chip->id, chip->name,
+	       sensor->label, temp, scale);
+	  /* the perfdata of the hottest sensor show its own thresholds */
+	  if (j == 0 || temp > max)
+	    {
+	      max = temp;
+	      max_warning = lt ? lt->warning : warning;
+	      max_critical = lt ? lt->critical : critical;
+	    }
+	  sum += temp;
+
+	  /* the sensor with the worst status, or the hottest one */
+	  if (NULL == worst || currstatus > status
+	      || (currstatus == status && temp > worst_temp))
+	    {
+	      worst = sensor;
+	      worst_chip = chip;
+	      worst_temp = temp;
+	      status = currstatus;
+	    }
+	}
+
+      fprintf (out, " %s_hwmon%u_max=%.1f;%s;%s %s_hwmon%u_avg=%.1f",
+	       chip->name, chip->id, max, max_warning ? max_warning : "",
+	       max_critical ? max_critical : "", chip->name, chip->id,
+	       sum / chip->nsensors);
+    }
+  fclose (out);
+
+  printf ("%s %s - %+.1f%s (hwmon%u [%s], sensor: \"%s\") |%s\n",
+	  program_name_short, state_text (status), worst_temp, scale,
+	  worst_chip->id, worst_chip->name, worst->label, perfdata);
+
+  free (perfdata);
+  hwmon_chips_free (chips, nchips);
+
+  return status;
+}
+
 int
 main (int argc, char **argv)
 {
   int c, temperature_unit = TEMP_CELSIUS;
   unsigned int thermal_zone, selected_thermal_zone = ALL_THERMAL_ZONES;
+  unsigned int i, nlabels = 0;
   char *critical = NULL, *warning = NULL,
        *end, *type, *scale;
+  bool hwmon = false, list = false;
   nagstatus status = STATE_OK;
   thresholds *my_threshold = NULL;
+  struct label_threshold *labels = NULL;
 
   set_program_name (argv[0]);
 
   while ((c = getopt_long (argc, argv,
-			   "fklt:c:w:v" GETOPT_HELP_VERSION_STRING,
+			   "fklt:HL:c:w:v" GETOPT_HELP_VERSION_STRING,
 			   longopts, NULL)) != -1)
     {
       switch (c)
@@ -160,8 +334,8 @@ main (int argc, char **argv)
 	  temperature_unit = TEMP_KELVIN;
 	  break;
 	case 'l':
-	  sysfsparser_thermal_listall ();
-	  return STATE_UNKNOWN;
+	  list = true;
+	  break;
 	case 't':
 	  errno = 0;
 	  selected_thermal_zone = strtoul (optarg, &end, 10);
@@ -169,6 +343,16 @@ main (int argc, char **argv)
 	    plugin_error (STATE_UNKNOWN, 0,
 			  "the option '-t' requires an integer");
 	  break;
+	case 'H':
+	  hwmon = true;
+	  break;
+	case 'L':
+	  if ((nlabels & (nlabels - 1)) == 0)
+	    labels = xrealloc (labels, (nlabels ? 2 * nlabels : 1)
+				       * sizeof (struct label_threshold));
+	  label_threshold_parse (optarg, &labels[nlabels++]);
+	  hwmon = true;
+	  break;
 	case 'c':
 	  critical = optarg;
 	  break;
@@ -182,12 +366,35 @@ main (int argc, char **argv)
         }
     }
 
+  if (hwmon && ALL_THERMAL_ZONES != selected_thermal_zone)
+    usage (stderr);
+
+  if (list)
+    {
+      if (hwmon)
+	hwmon_listall ();
+      else
+	sysfsparser_thermal_listall ();
+      return STATE_UNKNOWN;
+    }
+
   status = set_thresholds (&my_threshold, warning, critical);
   if (status == NP_RANGE_UNPARSEABLE)
     usage (stderr);
 
   sysfsparser_check_for_sysfs ();
 
+  if (hwmon)
+    {
+      status = check_hwmon (temperature_unit, my_threshold, warning,
+			    critical, labels, nlabels);
+      for (i = 0; i < nlabels; i++)
+	free (labels[i].threshold);
+      free (labels);
+      free (my_threshold);
+      return status;
+    }
+
   int max_temp =
     sysfsparser_thermal_get_temperature (selected_thermal_zone,
 					 &thermal_zone, &type);
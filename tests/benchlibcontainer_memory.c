@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Benchmark for docker_running_containers_memory() (lib/container.c)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A mock Docker API server listening on a unix socket lists
+ * NPL_BENCH_CONTAINERS running containers (default: 32) and answers to
+ * each stats query after NPL_BENCH_DELAY milliseconds (default: 100),
+ * like the Docker daemon does when sampling the container statistics.
+ * The memory usage is collected first with one connection and one
+ * blocking query per container, like docker_running_containers_memory()
+ * did before, then with docker_running_containers_memory().
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE		/* activate extra prototypes for glibc */
+#endif
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <curl/curl.h>
+
+#include "container.h"
+#include "testutils.h"
+#include "xalloc.h"
+#include "xasprintf.h"
+
+/* the memory usage (in bytes) of each container */
+#define BENCH_CONTAINER_MEMORY	1048576
+
+static char tmpdir[] = "/tmp/benchlibcontainer.XXXXXX";
+static unsigned int ncontainers;
+static long delay;
+
+static pthread_mutex_t connections_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int connections;
+
+static double
+bench_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+mock_reply (int fd, const char *body)
+{
+  char *reply;
+  int len, ret;
+
+  len = asprintf (&reply,
+		  "HTTP/1.1 200 OK\r\n"
+		  "Content-Type: application/json\r\n"
+		  "Content-Length: %zu\r\n\r\n%s", strlen (body), body);
+  if (len < 0)
+    return -1;
+  ret = (write (fd, reply, len) == len) ? 0 : -1;
+  free (reply);
+
+  return ret;
+}
+
+/* Serve the queries sent through the (keep-alive) connection 'arg' */
+static void *
+mock_connection (void *arg)
+{
+  int fd = (int) (long) arg;
+  char request[4096];
+  size_t len = 0;
+  ssize_t n;
+
+  pthread_mutex_lock (&connections_lock);
+  connections++;
+  pthread_mutex_unlock (&connections_lock);
+
+  while ((n = read (fd, request + len, sizeof (request) - len - 1)) > 0)
+    {
+      char *body;
+      int err;
+
+      len += n;
+      request[len] = '\0';
+      if (NULL == strstr (request, "\r\n\r\n"))
+	continue;
+
+      if (strstr (request, "/containers/json"))
+	{
+	  FILE *stream;
+	  size_t size;
+	  unsigned int i;
+
+	  stream = open_memstream (&body, &size);
+	  for (i = 0; i < ncontainers; i++)
+	    fprintf (stream, "%s{\"Id\":\"%064x\",\"Image\":\"nginx\"}",
+		     i ? "," : "[", i);
+	  fputs (ncontainers ? "]" : "[]", stream);
+	  fclose (stream);
+	}
+      else
+	{
+	  usleep (delay * 1000);
+	  body = xasprintf ("{\"memory_stats\":{\"usage\":%d}}",
+			    BENCH_CONTAINER_MEMORY);
+	}
+
+      err = mock_reply (fd, body);
+      free (body);
+      if (err < 0)
+	break;
+      len = 0;
+    }
+
+  close (fd);
+  return NULL;
+}
+
+static void *
+mock_server (void *arg)
+{
+  int sfd = (int) (long) arg, fd;
+
+  while ((fd = accept (sfd, NULL, NULL)) >= 0)
+    {
+      pthread_t thread;
+
+      if (pthread_create (&thread, NULL, mock_connection,
+			  (void *) (long) fd) != 0)
+	close (fd);
+      else
+	pthread_detach (thread);
+    }
+
+  return NULL;
+}
+
+/* The stats collector used before the curl multi interface */
+static unsigned long long
+bench_sequential (const char *socket, char **ids, unsigned int n)
+{
+  unsigned long long memory = 0;
+  unsigned int i;
+
+  for (i = 0; i < n; i++)
+    {
+      char *url, *value = NULL;
+      chunk_t chunk = { NULL, 0 };
+      FILE *stream;
+      CURL *curl_handle = curl_easy_init ();
+
+      stream = open_memstream (&chunk.memory, &chunk.size);
+      url = xasprintf ("http://v1.24/containers/%s/stats?stream=false",
+		       ids[i]);
+      curl_easy_setopt (curl_handle, CURLOPT_UNIX_SOCKET_PATH, socket);
+      curl_easy_setopt (curl_handle, CURLOPT_URL, url);
+      curl_easy_setopt (curl_handle, CURLOPT_WRITEDATA, stream);
+      curl_easy_perform (curl_handle);
+      curl_easy_cleanup (curl_handle);
+      fclose (stream);
+
+      if ((value = strstr (chunk.memory, "\"usage\":")))
+	memory += strtoull (value + 8, NULL, 10) >> 10;
+      free (chunk.memory);
+      free (url);
+    }
+
+  return memory;
+}
+
+static void
+bench_report (const char *title, double start, unsigned long long memory)
+{
+  pthread_mutex_lock (&connections_lock);
+  printf ("  %-40s %8.3fs  (%u connections, %llukB)\n", title,
+	  bench_now () - start, connections, memory);
+  connections = 0;
+  pthread_mutex_unlock (&connections_lock);
+}
+
+int
+main (void)
+{
+  const char *containers_str = secure_getenv ("NPL_BENCH_CONTAINERS"),
+    *delay_str = secure_getenv ("NPL_BENCH_DELAY");
+  unsigned long long memory, expected;
+  struct sockaddr_un addr = { .sun_family = AF_UNIX };
+  char *socket_path, **ids;
+  pthread_t server;
+  double start;
+  unsigned int i;
+  int sfd, ret = EXIT_SUCCESS;
+
+  ncontainers = containers_str ? atoi (containers_str) : 32;
+  delay = delay_str ? atol (delay_str) : 100;
+  if (delay < 0)
+    delay = 0;
+
+  if (mkdtemp (tmpdir) == NULL)
+    return EXIT_AM_HARDFAIL;
+  socket_path = xasprintf ("%s/docker.sock", tmpdir);
+  snprintf (addr.sun_path, sizeof (addr.sun_path), "%s", socket_path);
+
+  if ((sfd = socket (AF_UNIX, SOCK_STREAM, 0)) < 0
+      || bind (sfd, (void *) &addr, sizeof (addr)) < 0
+      || listen (sfd, 128) < 0
+      || pthread_create (&server, NULL, mock_server,
+			 (void *) (long) sfd) != 0)
+    {
+      rmdir (tmpdir);
+      return EXIT_AM_HARDFAIL;
+    }
+
+  ids = xnmalloc (ncontainers ? ncontainers : 1, sizeof (char *));
+  for (i = 0; i < ncontainers; i++)
+    ids[i] = xasprintf ("%064x", i);
+  expected = (unsigned long long) ncontainers * (BENCH_CONTAINER_MEMORY >> 10);
+
+  printf ("reading the memory usage of %u containers "
+	  "(%ldms per stats query):\n", ncontainers, delay);
+
+  curl_global_init (CURL_GLOBAL_ALL);
+  start = bench_now ();
+  memory = bench_sequential (socket_path, ids, ncontainers);
+  bench_report ("one connection per container", start, memory);
+  curl_global_cleanup ();
+
+  start = bench_now ();
+  docker_running_containers_memory (socket_path, &memory, false);
+  bench_report ("docker_running_containers_memory", start, memory);
+
+  if (memory != expected)
+    {
+      fprintf (stderr, "memory usage: %llukB, expected %llukB\n", memory,
+	       expected);
+      ret = EXIT_FAILURE;
+    }
+
+  shutdown (sfd, SHUT_RDWR);
+  close (sfd);
+  unlink (socket_path);
+  rmdir (tmpdir);
+
+  for (i = 0; i < ncontainers; i++)
+    free (ids[i]);
+  free (ids);
+  free (socket_path);
+
+  return ret;
+}
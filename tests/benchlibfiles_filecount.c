@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Benchmark for the functions files_filecount*() of lib/files.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The tree is created in the directory NPL_BENCH_DIR (default: /dev/shm,
+ * a tmpfs file system) and contains NPL_BENCH_NFILES regular files
+ * (default: 1000000) spread over subdirectories of 1000 files each.
+ * The legacy walker (absolute paths built with snprintf and one lstat()
+ * per entry) is timed as a reference.  The io_uring backend is only timed
+ * when the plugins are built with liburing (otherwise FILES_URING_STAT is
+ * silently ignored).
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE		/* activate extra prototypes for glibc */
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "files.h"
+#include "testutils.h"
+#include "xasprintf.h"
+
+#define BENCH_FILES_PER_DIR	1000
+
+static double
+bench_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The walker used before the openat/fstatat rewrite */
+static int64_t
+legacy_filecount (const char *dir)
+{
+  DIR *dirp;
+  struct dirent *dp;
+  int64_t total = 0;
+
+  if ((dirp = opendir (dir)) == NULL)
+    return 0;
+
+  while ((dp = readdir (dirp)) != NULL)
+    {
+      char abs_path[PATH_MAX];
+      struct stat statbuf;
+
+      if (dp->d_name[0] == '.')
+	continue;
+      snprintf (abs_path, sizeof (abs_path), "%s/%s", dir, dp->d_name);
+      if (lstat (abs_path, &statbuf) != 0)
+	continue;
+      if (S_ISDIR (statbuf.st_mode))
+	total += legacy_filecount (abs_path);
+      total++;
+    }
+
+  closedir (dirp);
+  return total;
+}
+
+static int
+bench_create_tree (const char *basedir, long nfiles)
+{
+  long i;
+
+  for (i = 0; i < nfiles; i++)
+    {
+      if (i % BENCH_FILES_PER_DIR == 0)
+	{
+	  char *subdir =
+	    xasprintf ("%s/d%06ld", basedir, i / BENCH_FILES_PER_DIR);
+	  if (mkdir (subdir, S_IRWXU) < 0)
+	    {
+	      perror (subdir);
+	      return -1;
+	    }
+	  free (subdir);
+	}
+
+      char *path = xasprintf ("%s/d%06ld/f%ld", basedir,
+			      i / BENCH_FILES_PER_DIR, i);
+      int fd = open (path, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+      if (fd < 0)
+	{
+	  perror (path);
+	  return -1;
+	}
+      close (fd);
+      free (path);
+    }
+
+  return 0;
+}
+
+static int
+bench_remove_entry (const char *path, const struct stat *sb, int typeflag,
+		    struct FTW *ftwbuf)
+{
+  (void) sb; (void) typeflag; (void) ftwbuf;
+  return remove (path);
+}
+
+static void
+bench_files_filecount (const char *title, const char *basedir,
+		       unsigned int flags, int64_t age, int64_t size,
+		       unsigned int nthreads)
+{
+  struct files_options opts = {
+    .flags = flags,
+    .age = age,
+    .size = size,
+    .nthreads = nthreads
+  };
+  struct files_types *filecount = NULL;
+  double start = bench_now ();
+
+  files_filecount_opts (basedir, &opts, &filecount);
+  printf ("  %-40s %8.3fs  (%ld files)\n", title, bench_now () - start,
+	  (long) filecount->total);
+  free (filecount);
+}
+
+int
+main (void)
+{
+  const char *dir = secure_getenv ("NPL_BENCH_DIR"),
+	     *nfiles_str = secure_getenv ("NPL_BENCH_NFILES");
+  long nfiles = nfiles_str ? atol (nfiles_str) : 1000000;
+  char *template =
+    xasprintf ("%s/benchlibfiles.XXXXXX", dir ? dir : "/dev/shm");
+  char *basedir;
+  double start;
+  int64_t total;
+
+  if ((basedir = mkdtemp (template)) == NULL)
+    {
+      perror ("mkdtemp");
+      return EXIT_AM_SKIP;
+    }
+
+  printf ("creating %ld files in %s...\n", nfiles, basedir);
+  if (bench_create_tree (basedir, nfiles) < 0)
+    return EXIT_AM_HARDFAIL;
+
+  start = bench_now ();
+  total = legacy_filecount (basedir);
+  printf ("  %-40s %8.3fs  (%ld files)\n", "legacy (snprintf + lstat)",
+	  bench_now () - start, (long) total);
+
+  bench_files_filecount ("files_filecount -r", basedir,
+			 FILES_RECURSIVE, 0, 0, 1);
+  bench_files_filecount ("files_filecount -r -f", basedir,
+			 FILES_RECURSIVE | FILES_REGULAR_ONLY, 0, 0, 1);
+  bench_files_filecount ("files_filecount -r -t 1h", basedir,
+			 FILES_RECURSIVE, 3600, 0, 1);
+  bench_files_filecount ("files_filecount -r -t 1h --io-uring", basedir,
+			 FILES_RECURSIVE | FILES_URING_STAT, 3600, 0, 1);
+  bench_files_filecount ("files_filecount -r -j 2", basedir,
+			 FILES_RECURSIVE, 0, 0, 2);
+  bench_files_filecount ("files_filecount -r -j 4", basedir,
+			 FILES_RECURSIVE, 0, 0, 4);
+  bench_files_filecount ("files_filecount -r -t 1h -j 4", basedir,
+			 FILES_RECURSIVE, 3600, 0, 4);
+
+  nftw (basedir, bench_remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+  free (template);
+
+  return EXIT_SUCCESS;
+}
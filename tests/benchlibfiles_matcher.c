@@ -0,0 +1,216 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Benchmark for the name matcher used by files_filecount*() in lib/files.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The per-entry cost of the compiled patterns is compared with the one of
+ * a fnmatch() call per pattern, on NPL_BENCH_NFILES names (default:
+ * 1000000).  A flat directory with the same number of files is then
+ * created in NPL_BENCH_DIR (default: /dev/shm) and counted with and
+ * without the patterns.
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE		/* activate extra prototypes for glibc */
+#endif
+
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "testutils.h"
+#include "xasprintf.h"
+
+# define NPL_TESTING
+#  include "../lib/files.c"
+# undef NPL_TESTING
+
+static const char *const bench_suffixes[] = {
+  ".log", ".log.gz", ".tmp", ".dat", ".core", ""
+};
+#define BENCH_NSUFFIXES \
+  (sizeof (bench_suffixes) / sizeof (bench_suffixes[0]))
+
+static double
+bench_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char *
+bench_name (long i)
+{
+  return xasprintf ("%s-%07ld%s", (i % 3) ? "app" : "batch", i,
+		    bench_suffixes[i % BENCH_NSUFFIXES]);
+}
+
+static void
+bench_matcher (const char *title, char **names, long nnames,
+	       const char *const *include, unsigned int ninclude,
+	       const char *const *exclude, unsigned int nexclude)
+{
+  struct files_options opts = {
+    .include = include,
+    .ninclude = ninclude,
+    .exclude = exclude,
+    .nexclude = nexclude
+  };
+  struct files_matcher *m = files_matcher_new (&opts);
+  long i, nfnmatch = 0, nmatcher = 0;
+  unsigned int n;
+  double start, t_fnmatch, t_matcher;
+
+  start = bench_now ();
+  for (i = 0; i < nnames; i++)
+    {
+      bool match = (0 == ninclude);
+      for (n = 0; !match && n < ninclude; n++)
+	match = (0 == fnmatch (include[n], names[i], 0));
+      for (n = 0; match && n < nexclude; n++)
+	match = (0 != fnmatch (exclude[n], names[i], 0));
+      nfnmatch += match;
+    }
+  t_fnmatch = bench_now () - start;
+
+  start = bench_now ();
+  for (i = 0; i < nnames; i++)
+    nmatcher += files_matcher_match (m, names[i]);
+  t_matcher = bench_now () - start;
+
+  printf ("  %-28s fnmatch %7.1fns  matcher %7.1fns  (%ld/%ld matches)\n",
+	  title, t_fnmatch * 1e9 / nnames, t_matcher * 1e9 / nnames,
+	  nfnmatch, nmatcher);
+  files_matcher_free (m);
+}
+
+static void
+bench_scan (const char *title, const char *basedir,
+	    const char *const *include, unsigned int ninclude,
+	    const char *const *exclude, unsigned int nexclude)
+{
+  struct files_options opts = {
+    .flags = FILES_DEFAULT,
+    .include = include,
+    .ninclude = ninclude,
+    .exclude = exclude,
+    .nexclude = nexclude,
+    .nthreads = 1
+  };
+  struct files_types *filecount = NULL;
+  double start = bench_now ();
+
+  files_filecount_opts (basedir, &opts, &filecount);
+  printf ("  %-28s %8.3fs  (%ld files)\n", title, bench_now () - start,
+	  (long) filecount->total);
+  files_types_free (filecount);
+}
+
+static int
+bench_remove_entry (const char *path, const struct stat *sb, int typeflag,
+		    struct FTW *ftwbuf)
+{
+  (void) sb; (void) typeflag; (void) ftwbuf;
+  return remove (path);
+}
+
+int
+main (void)
+{
+  const char *dir = secure_getenv ("NPL_BENCH_DIR"),
+	     *nfiles_str = secure_getenv ("NPL_BENCH_NFILES");
+  long i, nfiles = nfiles_str ? atol (nfiles_str) : 1000000;
+  char *template =
+    xasprintf ("%s/benchlibfiles.XXXXXX", dir ? dir : "/dev/shm");
+  char **names, *basedir;
+  int dirfd, ret = EXIT_SUCCESS;
+
+  static const char *const literal[] = { "app-0000043.log.gz" };
+  static const char *const suffix[] = { "*.log" };
+  static const char *const suffixes[] = { "*.log", "*.gz", "*.tmp" };
+  static const char *const prefix[] = { "batch-*" };
+  static const char *const substring[] = { "*core*" };
+  static const char *const glob[] = { "app-00?????.[lt]*" };
+  static const char *const tmp[] = { "*.tmp" };
+
+  if (nfiles <= 0)
+    return EXIT_AM_SKIP;
+
+  names = xnmalloc (nfiles, sizeof (char *));
+  for (i = 0; i < nfiles; i++)
+    names[i] = bench_name (i);
+
+  printf ("matching %ld names (per entry cost):\n", nfiles);
+  bench_matcher ("literal", names, nfiles, literal, 1, NULL, 0);
+  bench_matcher ("suffix", names, nfiles, suffix, 1, NULL, 0);
+  bench_matcher ("3 suffixes", names, nfiles, suffixes, 3, NULL, 0);
+  bench_matcher ("prefix", names, nfiles, prefix, 1, NULL, 0);
+  bench_matcher ("substring", names, nfiles, substring, 1, NULL, 0);
+  bench_matcher ("glob", names, nfiles, glob, 1, NULL, 0);
+  bench_matcher ("3 suffixes - *.tmp", names, nfiles, suffixes, 3, tmp, 1);
+
+  if ((basedir = mkdtemp (template)) == NULL)
+    {
+      perror ("mkdtemp");
+      return EXIT_AM_SKIP;
+    }
+  if ((dirfd = open (basedir, O_RDONLY | O_DIRECTORY)) < 0)
+    {
+      perror (basedir);
+      return EXIT_AM_HARDFAIL;
+    }
+
+  printf ("creating %ld files in %s...\n", nfiles, basedir);
+  for (i = 0; i < nfiles; i++)
+    {
+      int fd = openat (dirfd, names[i], O_WRONLY | O_CREAT,
+		       S_IRUSR | S_IWUSR);
+      if (fd < 0)
+	{
+	  perror (names[i]);
+	  ret = EXIT_AM_HARDFAIL;
+	  break;
+	}
+      close (fd);
+    }
+  close (dirfd);
+
+  if (EXIT_SUCCESS == ret)
+    {
+      bench_scan ("files_filecount", basedir, NULL, 0, NULL, 0);
+      bench_scan ("files_filecount -n *.log", basedir, suffix, 1, NULL, 0);
+      bench_scan ("files_filecount (3 suffixes)", basedir, suffixes, 3,
+		  NULL, 0);
+      bench_scan ("files_filecount (glob)", basedir, glob, 1, NULL, 0);
+    }
+
+  nftw (basedir, bench_remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+  for (i = 0; i < nfiles; i++)
+    free (names[i]);
+  free (names);
+  free (template);
+
+  return ret;
+}
@@ -0,0 +1,220 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Benchmark for the mountinfo parser of lib/mountlist.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * A synthetic mount table of NPL_BENCH_NMOUNTS mounts (default: 10000,
+ * mostly overlay, tmpfs and secrets mounts, like on a container host) is
+ * written both in the mountinfo and in the mtab formats.  The parser is
+ * timed against the getmntent() loop used before, which duplicates four
+ * strings per mount.  The mount table of the running system is then read
+ * with the mountinfo parser and, on Linux 6.8+, with listmount() and
+ * statmount().
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE		/* activate extra prototypes for glibc */
+#endif
+
+#include <time.h>
+
+#include "testutils.h"
+#include "xasprintf.h"
+
+# define NPL_TESTING
+#  include "../lib/mountlist.c"
+# undef NPL_TESTING
+
+#define BENCH_LOOPS	50
+
+static double
+bench_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The mount table reader used before the mountinfo parser */
+static struct mount_entry *
+legacy_read_mtab (const char *table)
+{
+  struct mount_entry *mount_list, *me, **mtail = &mount_list;
+  struct mntent *mnt;
+  FILE *fp;
+
+  if ((fp = setmntent (table, "r")) == NULL)
+    return NULL;
+
+  while ((mnt = getmntent (fp)))
+    {
+      me = xmalloc (sizeof *me);
+      me->me_devname = xstrdup (mnt->mnt_fsname);
+      me->me_mountdir = xstrdup (mnt->mnt_dir);
+      me->me_type = xstrdup (mnt->mnt_type);
+      me->me_type_malloced = 1;
+      me->me_opts = xstrdup (mnt->mnt_opts);
+      me->me_opts_malloced = 1;
+      me->me_arena = 0;
+      me->me_dummy = ME_DUMMY (me->me_devname, me->me_type);
+      me->me_remote = ME_REMOTE (me->me_devname, me->me_type);
+      me->me_readonly = (hasmntopt (mnt, "ro") != NULL);
+      *mtail = me;
+      mtail = &me->me_next;
+    }
+  endmntent (fp);
+
+  *mtail = NULL;
+  return mount_list;
+}
+
+static int
+bench_write_tables (FILE *mountinfo, FILE *mtab, long nmounts)
+{
+  unsigned long i;
+
+  for (i = 0; i < (unsigned long) nmounts; i++)
+    {
+      switch (i % 3)
+	{
+	case 0:
+	  fprintf (mountinfo, "%lu 1 0:%lu / /var/lib/docker/overlay2/"
+		   "%064lx/merged rw,relatime shared:%lu - overlay overlay "
+		   "rw,lowerdir=/var/lib/docker/overlay2/l/A:/var/lib/docker/"
+		   "overlay2/l/B,upperdir=/var/lib/docker/overlay2/%064lx/diff"
+		   "\n", i + 100, i + 50, i, i, i);
+	  fprintf (mtab, "overlay /var/lib/docker/overlay2/%064lx/merged "
+		   "overlay rw,relatime,lowerdir=/var/lib/docker/overlay2/l/A:"
+		   "/var/lib/docker/overlay2/l/B,upperdir=/var/lib/docker/"
+		   "overlay2/%064lx/diff 0 0\n", i, i);
+	  break;
+	case 1:
+	  fprintf (mountinfo, "%lu %lu 0:%lu / /var/lib/kubelet/pods/"
+		   "%032lx/volumes/kubernetes.io~projected/kube-api-access "
+		   "rw,relatime - tmpfs tmpfs rw,size=65536k\n",
+		   i + 100, i + 99, i + 50, i);
+	  fprintf (mtab, "tmpfs /var/lib/kubelet/pods/%032lx/volumes/"
+		   "kubernetes.io~projected/kube-api-access tmpfs "
+		   "rw,relatime,size=65536k 0 0\n", i);
+	  break;
+	default:
+	  fprintf (mountinfo, "%lu %lu 0:%lu / /run/secrets/app\\040%lu "
+		   "ro,nosuid,nodev master:3 - tmpfs tmpfs ro,size=4k\n",
+		   i + 100, i + 99, i + 50, i);
+	  fprintf (mtab, "tmpfs /run/secrets/app\\040%lu tmpfs "
+		   "ro,nosuid,nodev,size=4k 0 0\n", i);
+	  break;
+	}
+    }
+
+  return (fflush (mountinfo) == 0 && fflush (mtab) == 0) ? 0 : -1;
+}
+
+static void
+bench_read (const char *title, struct mount_entry *(*reader) (const char *),
+	    const char *path)
+{
+  struct mount_entry *mount_list, *me;
+  double start = bench_now ();
+  long nmounts = 0, nreadonly = 0;
+  int i;
+
+  for (i = 0; i < BENCH_LOOPS; i++)
+    {
+      mount_list = reader (path);
+      for (me = mount_list; me; me = me->me_next)
+	if (i == 0)
+	  {
+	    nmounts++;
+	    nreadonly += me->me_readonly;
+	  }
+      free_mount_list (mount_list);
+    }
+
+  printf ("  %-36s %8.3fms  (%ld mounts, %ld read-only)\n", title,
+	  (bench_now () - start) * 1000 / BENCH_LOOPS, nmounts, nreadonly);
+}
+
+static struct mount_entry *
+bench_mountinfo_live (const char *path)
+{
+  (void) path;
+  return mountinfo_read (MOUNTINFO);
+}
+
+#ifdef __NR_statmount
+static struct mount_entry *
+bench_statmount_live (const char *path)
+{
+  (void) path;
+  return statmount_read ();
+}
+#endif
+
+int
+main (void)
+{
+  const char *nmounts_str = secure_getenv ("NPL_BENCH_NMOUNTS");
+  long nmounts = nmounts_str ? atol (nmounts_str) : 10000;
+  char mountinfo_path[] = "/tmp/benchlibmountlist.mountinfo.XXXXXX",
+       mtab_path[] = "/tmp/benchlibmountlist.mtab.XXXXXX";
+  int fd_mountinfo, fd_mtab, ret = EXIT_SUCCESS;
+  FILE *mountinfo, *mtab;
+
+  if ((fd_mountinfo = mkstemp (mountinfo_path)) < 0)
+    return EXIT_AM_SKIP;
+  if ((fd_mtab = mkstemp (mtab_path)) < 0)
+    {
+      unlink (mountinfo_path);
+      return EXIT_AM_SKIP;
+    }
+  mountinfo = fdopen (fd_mountinfo, "w");
+  mtab = fdopen (fd_mtab, "w");
+
+  if (bench_write_tables (mountinfo, mtab, nmounts) < 0)
+    ret = EXIT_AM_HARDFAIL;
+  else
+    {
+      printf ("reading a table of %ld mounts (%d loops):\n", nmounts,
+	      BENCH_LOOPS);
+      bench_read ("legacy (getmntent + xstrdup)", legacy_read_mtab,
+		  mtab_path);
+      bench_read ("mountinfo_read", mountinfo_read, mountinfo_path);
+
+      printf ("reading the mount table of this system (%d loops):\n",
+	      BENCH_LOOPS);
+      bench_read ("mountinfo_read", bench_mountinfo_live, NULL);
+#ifdef __NR_statmount
+      struct mount_entry *mount_list = statmount_read ();
+      if (mount_list)
+	{
+	  free_mount_list (mount_list);
+	  bench_read ("statmount_read", bench_statmount_live, NULL);
+	}
+      else
+	printf ("  %-36s %s\n", "statmount_read", strerror (errno));
+#endif
+    }
+
+  fclose (mountinfo);
+  fclose (mtab);
+  unlink (mountinfo_path);
+  unlink (mtab_path);
+
+  return ret;
+}
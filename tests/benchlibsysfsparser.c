@@ -0,0 +1,188 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Benchmark for the cached sysfs reader of lib/sysfsparser.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * The topology and the cpufreq attributes of all the CPUs listed in
+ * /sys/devices/system/cpu are read NPL_BENCH_LOOPS times (default: 100),
+ * first like sysfsparser_getvalue() did before (vasprintf + fopen +
+ * getline + fclose for each file), then with the cached directories and
+ * the batch reader.  The gap grows with the number of CPUs of the host.
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE		/* activate extra prototypes for glibc */
+#endif
+
+#include <time.h>
+
+#include "testutils.h"
+
+# define NPL_TESTING
+#  include "../lib/sysfsparser.c"
+# undef NPL_TESTING
+
+static const char *topology_attrs[] = {
+  "core_id", "physical_package_id", "die_id", "cluster_id"
+};
+static const char *cpufreq_attrs[] = {
+  "cpuinfo_min_freq", "cpuinfo_max_freq", "scaling_cur_freq",
+  "scaling_min_freq", "scaling_max_freq"
+};
+
+#define NTOPOLOGY_ATTRS (sizeof (topology_attrs) / sizeof (char *))
+#define NCPUFREQ_ATTRS (sizeof (cpufreq_attrs) / sizeof (char *))
+
+static double
+bench_now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* The reader used before the cached directories */
+static int _attribute_format_printf_ (2, 3)
+legacy_getvalue (unsigned long long *value, const char *format, ...)
+{
+  char *filename, *line = NULL, *endptr;
+  size_t len = 0;
+  ssize_t chread;
+  va_list args;
+  FILE *fp;
+  int ret;
+
+  va_start (args, format);
+  ret = vasprintf (&filename, format, args);
+  va_end (args);
+  if (ret < 0)
+    return -1;
+
+  fp = fopen (filename, "r");
+  free (filename);
+  if (NULL == fp)
+    return -1;
+
+  chread = getline (&line, &len, fp);
+  fclose (fp);
+  if (chread < 1)
+    {
+      free (line);
+      return -1;
+    }
+
+  errno = 0;
+  *value = strtoull (line, &endptr, 0);
+  ret = (endptr == line || errno == ERANGE) ? -1 : 0;
+  free (line);
+
+  return ret;
+}
+
+static unsigned long
+bench_legacy (unsigned int ncpus)
+{
+  unsigned long long value;
+  unsigned long nread = 0;
+  unsigned int cpu;
+  size_t i;
+
+  for (cpu = 0; cpu < ncpus; cpu++)
+    {
+      for (i = 0; i < NTOPOLOGY_ATTRS; i++)
+	nread += (legacy_getvalue (&value, PATH_SYS_CPU "/cpu%u/topology/%s",
+				   cpu, topology_attrs[i]) == 0);
+      for (i = 0; i < NCPUFREQ_ATTRS; i++)
+	nread += (legacy_getvalue (&value, PATH_SYS_CPU "/cpu%u/cpufreq/%s",
+				   cpu, cpufreq_attrs[i]) == 0);
+    }
+
+  return nread;
+}
+
+static unsigned long
+bench_cached (unsigned int ncpus)
+{
+  struct sysfsparser_attr topology[NTOPOLOGY_ATTRS],
+    cpufreq[NCPUFREQ_ATTRS];
+  unsigned long nread = 0;
+  unsigned int cpu;
+  size_t i;
+  int dirfd;
+
+  for (i = 0; i < NTOPOLOGY_ATTRS; i++)
+    topology[i].name = topology_attrs[i];
+  for (i = 0; i < NCPUFREQ_ATTRS; i++)
+    cpufreq[i].name = cpufreq_attrs[i];
+
+  for (cpu = 0; cpu < ncpus; cpu++)
+    {
+      if ((dirfd = sysfsparser_opendirfd (PATH_SYS_CPU "/cpu%u/topology",
+					  cpu)) >= 0)
+	nread += sysfsparser_getvalues_at (dirfd, topology, NTOPOLOGY_ATTRS);
+      if ((dirfd = sysfsparser_opendirfd (PATH_SYS_CPU "/cpu%u/cpufreq",
+					  cpu)) >= 0)
+	nread += sysfsparser_getvalues_at (dirfd, cpufreq, NCPUFREQ_ATTRS);
+    }
+
+  return nread;
+}
+
+static void
+bench_run (const char *title, unsigned long (*reader) (unsigned int),
+	   unsigned int ncpus, long loops)
+{
+  double start = bench_now ();
+  unsigned long nread = 0;
+  long i;
+
+  for (i = 0; i < loops; i++)
+    nread = reader (ncpus);
+
+  printf ("  %-36s %8.3fms  (%lu attributes)\n", title,
+	  (bench_now () - start) * 1000 / loops, nread);
+}
+
+int
+main (void)
+{
+  const char *loops_str = secure_getenv ("NPL_BENCH_LOOPS");
+  long loops = loops_str ? atol (loops_str) : 100;
+  unsigned int ncpus = 0;
+
+  if (loops < 1)
+    loops = 1;
+  while (sysfsparser_path_exist (PATH_SYS_CPU "/cpu%u", ncpus))
+    ncpus++;
+  if (0 == ncpus)
+    return EXIT_AM_SKIP;
+
+  printf ("reading the attributes of %u CPUs (%ld loops):\n", ncpus, loops);
+  bench_run ("legacy (vasprintf + fopen + getline)", bench_legacy, ncpus,
+	     loops);
+  bench_run ("cached directories (openat + pread)", bench_cached, ncpus,
+	     loops);
+
+  /* a cache smaller than the number of directories read per loop is
+   * refilled at every loop: show it */
+  printf ("  (%d directories cached, %u read per loop)\n",
+	  SYSFSPARSER_DIRFD_CACHE_SIZE, ncpus * 2);
+
+  sysfsparser_closedirfds ();
+  return EXIT_SUCCESS;
+}
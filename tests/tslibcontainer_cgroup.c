@@ -0,0 +1,287 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Unit test for the cgroup v2 backend of lib/container.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE		/* activate extra prototypes for glibc */
+#endif
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "container.h"
+#include "testutils.h"
+#include "xasprintf.h"
+
+#define NPL_TESTING
+
+static int docker_get (chunk_t * chunk, const int query, const char *id);
+static void docker_close (chunk_t * chunk);
+
+#include "../lib/container.c"
+
+/* the Docker API is not used by the cgroup backend */
+static int
+docker_get (chunk_t *chunk, const int query, const char *id)
+{
+  (void) query;
+  (void) id;
+  chunk->memory = NULL;
+  chunk->size = 0;
+  return EXIT_AM_HARDFAIL;
+}
+
+static void
+docker_close (chunk_t *chunk)
+{
+  free (chunk->memory);
+}
+
+#undef NPL_TESTING
+
+#define ID(C) \
+  C C C C C C C C C C C C C C C C C C C C C C C C C C C C C C C C \
+  C C C C C C C C C C C C C C C C C C C C C C C C C C C C C C C C
+
+#define ID_DOCKER	ID ("a")
+#define ID_CGROUPFS	ID ("b")
+#define ID_PODMAN	ID ("c")
+
+/* a fake /sys/fs/cgroup */
+static char cgroot[] = "/tmp/tslibcontainer_cgroup.XXXXXX";
+
+/* Write 'value' in the file 'name', creating the missing directories */
+static int
+cgroot_write (const char *name, const char *value)
+{
+  char *path = xasprintf ("%s/%s", cgroot, name), *p;
+  FILE *fp;
+  int err = 0;
+
+  for (p = path + strlen (cgroot) + 1; (p = strchr (p, '/')); p++)
+    {
+      *p = '\0';
+      mkdir (path, S_IRWXU);
+      *p = '/';
+    }
+
+  if ((fp = fopen (path, "w")) == NULL)
+    err = -1;
+  else
+    {
+      fputs (value, fp);
+      fclose (fp);
+    }
+
+  free (path);
+  return err;
+}
+
+static int
+cgroot_container (const char *cgroup, const char *memory_current,
+		  const char *anon, const char *file, const char *user_usec)
+{
+  char *name, *value;
+  int err;
+
+  name = xasprintf ("%s/memory.current", cgroup);
+  err = cgroot_write (name, memory_current);
+  free (name);
+
+  name = xasprintf ("%s/memory.stat", cgroup);
+  value = xasprintf ("anon %s\nfile %s\nkernel 8192\nanon_thp 0\n"
+		     "file_mapped 4096\n", anon, file);
+  err |= cgroot_write (name, value);
+  free (value);
+  free (name);
+
+  name = xasprintf ("%s/cpu.stat", cgroup);
+  value = xasprintf ("usage_usec 1000\nuser_usec %s\nsystem_usec 400\n"
+		     "nr_periods 0\n", user_usec);
+  err |= cgroot_write (name, value);
+  free (value);
+  free (name);
+
+  return err;
+}
+
+static int
+cgroot_remove_entry (const char *path, const struct stat *sb,
+		     int typeflag, struct FTW *ftwbuf)
+{
+  (void) sb;
+  (void) typeflag;
+  (void) ftwbuf;
+  return remove (path);
+}
+
+static int
+test_cgroup_container_id (const void *tdata)
+{
+  char id[CONTAINER_ID_LEN + 1];
+  int ret = 0;
+
+  (void) tdata;
+  TEST_ASSERT_EQUAL_NUMERIC (cgroup_container_id ("system.slice",
+						  "docker-" ID_DOCKER
+						  ".scope", id), true);
+  TEST_ASSERT_EQUAL_STRING (id, ID_DOCKER);
+  TEST_ASSERT_EQUAL_NUMERIC (cgroup_container_id ("docker", ID_CGROUPFS,
+						  id), true);
+  TEST_ASSERT_EQUAL_STRING (id, ID_CGROUPFS);
+
+  TEST_ASSERT_EQUAL_NUMERIC (cgroup_container_id ("machine.slice",
+						  "libpod-conmon-" ID_PODMAN
+						  ".scope", id), false);
+  TEST_ASSERT_EQUAL_NUMERIC (cgroup_container_id ("system.slice",
+						  "docker.service", id),
+			     false);
+  TEST_ASSERT_EQUAL_NUMERIC (cgroup_container_id ("system.slice",
+						  "docker-" ID_DOCKER, id),
+			     false);
+  TEST_ASSERT_EQUAL_NUMERIC (cgroup_container_id ("docker", "abc", id),
+			     false);
+
+  return ret;
+}
+
+static int
+test_cgroup_containers_read (const void *tdata)
+{
+  struct container_stats stats;
+  struct cgroup_container *containers;
+  unsigned int n;
+  bool cgroup2;
+  int ret = 0;
+
+  (void) tdata;
+
+  containers = cgroup_containers_scan (cgroot, &n, &cgroup2);
+  TEST_ASSERT_EQUAL_NUMERIC (cgroup2, true);
+  TEST_ASSERT_EQUAL_NUMERIC (n, 4);
+  TEST_ASSERT_EQUAL_NUMERIC (cgroup_container_lookup (containers, n,
+						      ID_PODMAN) != NULL,
+			     true);
+  TEST_ASSERT_EQUAL_NUMERIC (cgroup_container_lookup (containers, n,
+						      ID ("d")) == NULL,
+			     true);
+  cgroup_containers_free (containers, n);
+
+  /* the cgroup of the stopped container is skipped */
+  TEST_ASSERT_EQUAL_NUMERIC (cgroup_containers_read (cgroot, &stats), 0);
+  TEST_ASSERT_EQUAL_NUMERIC (stats.containers, 3);
+  TEST_ASSERT_EQUAL_NUMERIC (stats.memory_current, 1048576 + 2097152 + 4096);
+  TEST_ASSERT_EQUAL_NUMERIC (stats.memory_anon, 524288 + 1048576 + 0);
+  TEST_ASSERT_EQUAL_NUMERIC (stats.memory_file, 262144 + 524288 + 4096);
+  /* only the Podman container has the swap accounting */
+  TEST_ASSERT_EQUAL_NUMERIC (stats.memory_swap, 65536);
+  TEST_ASSERT_EQUAL_NUMERIC (stats.cpu_usage_usec, 3000);
+  TEST_ASSERT_EQUAL_NUMERIC (stats.cpu_user_usec, 600 + 500 + 10);
+  TEST_ASSERT_EQUAL_NUMERIC (stats.cpu_system_usec, 1200);
+
+  return ret;
+}
+
+static int
+test_cgroup_containers_memory (const void *tdata)
+{
+  char *ids[] = { ID ("d"), ID_DOCKER, ID ("e"), ID_PODMAN };
+  long long unsigned int memory = 0;
+  int ret = 0;
+
+  (void) tdata;
+
+  /* the containers not found in the cgroup hierarchy are left to the API */
+  TEST_ASSERT_EQUAL_NUMERIC (cgroup_containers_memory (cgroot, ids, 4,
+						       &memory), 2);
+  TEST_ASSERT_EQUAL_STRING (ids[0], ID ("d"));
+  TEST_ASSERT_EQUAL_STRING (ids[1], ID ("e"));
+  TEST_ASSERT_EQUAL_NUMERIC (memory, 1024 + 4);
+
+  return ret;
+}
+
+static int
+test_cgroup_v1 (const void *tdata)
+{
+  struct container_stats stats;
+  char *cgroup_v1 = xasprintf ("%s/system.slice", cgroot);
+  int ret = 0;
+
+  (void) tdata;
+
+  /* a directory without cgroup.controllers is not a cgroup v2 hierarchy */
+  TEST_ASSERT_EQUAL_NUMERIC (cgroup_containers_read (cgroup_v1, &stats), -1);
+  free (cgroup_v1);
+
+  return ret;
+}
+
+static int
+mymain (void)
+{
+  int ret = 0;
+
+  if (mkdtemp (cgroot) == NULL)
+    return EXIT_FAILURE;
+
+  if (cgroot_write ("cgroup.controllers", "cpu io memory pids\n") < 0
+      || cgroot_container ("system.slice/docker-" ID_DOCKER ".scope",
+			   "1048576\n", "524288", "262144", "600") < 0
+      || cgroot_container ("docker/" ID_CGROUPFS,
+			   "2097152\n", "1048576", "524288", "500") < 0
+      || cgroot_container ("machine.slice/libpod-" ID_PODMAN ".scope",
+			   "4096\n", "0", "4096", "10") < 0
+      || cgroot_write ("machine.slice/libpod-" ID_PODMAN
+		       ".scope/memory.swap.current", "65536\n") < 0
+      /* these cgroups do not belong to a container */
+      || cgroot_container ("machine.slice/libpod-conmon-" ID_PODMAN ".scope",
+			   "8192\n", "8192", "0", "20") < 0
+      || cgroot_container ("system.slice/docker.service",
+			   "16384\n", "16384", "0", "30") < 0
+      /* a stopped container whose cgroup has not been removed yet */
+      || cgroot_write ("system.slice/docker-" ID ("e") ".scope/cpu.stat",
+		       "usage_usec 0\n") < 0)
+    ret = -1;
+  else
+    {
+      if (test_run ("check cgroup_container_id", test_cgroup_container_id,
+		    NULL) < 0)
+	ret = -1;
+      if (test_run ("check cgroup_containers_read",
+		    test_cgroup_containers_read, NULL) < 0)
+	ret = -1;
+      if (test_run ("check cgroup_containers_memory",
+		    test_cgroup_containers_memory, NULL) < 0)
+	ret = -1;
+      if (test_run ("check a cgroup v1 hierarchy", test_cgroup_v1, NULL) < 0)
+	ret = -1;
+    }
+
+  sysfsparser_closedirfds ();
+  nftw (cgroot, cgroot_remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+TEST_MAIN (mymain)
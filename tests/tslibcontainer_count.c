@@ -95,6 +95,25 @@ test_docker_running_containers (const void *tdata)
   return ret;
 }
 
+/* without a cgroup v2 hierarchy, all the containers are left to the API */
+static int
+test_cgroup_containers_memory (const void *tdata)
+{
+  char *ids[] = { "a1b2c3", "d4e5f6" };
+  long long unsigned int memory = 0;
+  int ret = 0;
+
+  (void) tdata;
+
+  TEST_ASSERT_EQUAL_NUMERIC (cgroup_containers_memory ("/nonexistent", ids, 2,
+						       &memory), 2);
+  TEST_ASSERT_EQUAL_STRING (ids[0], "a1b2c3");
+  TEST_ASSERT_EQUAL_STRING (ids[1], "d4e5f6");
+  TEST_ASSERT_EQUAL_NUMERIC (memory, 0);
+
+  return ret;
+}
+
 static int
 mymain (void)
 {
@@ -120,6 +139,10 @@ mymain (void)
   DO_TEST ("check running containers", NULL,
 	   "containers_redis=1 containers_nginx=3 containers_total=4", 4);
 
+  if (test_run ("check the containers without a cgroup",
+		test_cgroup_containers_memory, NULL) < 0)
+    ret = -1;
+
   return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Unit test for lib/cpudesc.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE		/* activate extra prototypes for glibc */
+#endif
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "testutils.h"
+#include "xasprintf.h"
+
+# define NPL_TESTING
+#  include "../lib/cpudesc.c"
+# undef NPL_TESTING
+
+#define CPUINFO_BLOCK(ID, MODEL_NAME, MHZ)		\
+  "processor\t: " ID "\n"				\
+  "vendor_id\t: GenuineIntel\n"				\
+  "cpu family\t: 6\n"					\
+  "model\t\t: 207\n"					\
+  "model name\t: " MODEL_NAME "\n"			\
+  "cpu MHz\t\t: " MHZ "\n"				\
+  "flags\t\t: fpu vme de pse tsc msr pae vmx lm\n"	\
+  "\n"
+
+/* a fake /proc/cpuinfo, with the boot id and the cache directory */
+static char tmpdir[] = "/tmp/tslibcpudesc.XXXXXX";
+static char *cpuinfo, *boot_id_path, *cachedir, *cachefile;
+
+static int
+write_file (const char *path, const char *value)
+{
+  FILE *fp;
+
+  if ((fp = fopen (path, "w")) == NULL)
+    return -1;
+  fputs (value, fp);
+  fclose (fp);
+
+  return 0;
+}
+
+static int
+test_cpu_desc_parse (const void *tdata)
+{
+  struct cpu_desc *cpudesc;
+  int ret = 0;
+
+  (void) tdata;
+  if (cpu_desc_new (&cpudesc) < 0)
+    return -1;
+
+  /* only the first processor block is read */
+  cpu_desc_load (cpudesc, cpuinfo, boot_id_path, NULL);
+  TEST_ASSERT_EQUAL_STRING (cpudesc->vendor, "GenuineIntel");
+  TEST_ASSERT_EQUAL_STRING (cpudesc->family, "6");
+  TEST_ASSERT_EQUAL_STRING (cpudesc->model, "207");
+  TEST_ASSERT_EQUAL_STRING (cpudesc->modelname, "Intel(R) Xeon(R) 0");
+  TEST_ASSERT_EQUAL_STRING (cpudesc->flags,
+			    "fpu vme de pse tsc msr pae vmx lm");
+  /* the frequency is only read on request */
+  TEST_ASSERT_EQUAL_NUMERIC (cpudesc->mhz == NULL, true);
+
+  cpu_desc_unref (cpudesc);
+
+  char *mhz = cpu_desc_read_mhz (cpuinfo);
+  TEST_ASSERT_EQUAL_STRING (mhz, "2100.000");
+  free (mhz);
+
+  return ret;
+}
+
+static int
+test_cpu_desc_cache (const void *tdata)
+{
+  struct cpu_desc *cpudesc;
+  int ret = 0;
+
+  (void) tdata;
+
+  /* the first call saves the descriptor in the cache */
+  if (cpu_desc_new (&cpudesc) < 0)
+    return -1;
+  cpu_desc_load (cpudesc, cpuinfo, boot_id_path, cachedir);
+  TEST_ASSERT_EQUAL_STRING (cpudesc->modelname, "Intel(R) Xeon(R) 0");
+  cpu_desc_unref (cpudesc);
+  TEST_ASSERT_EQUAL_NUMERIC (access (cachefile, R_OK), 0);
+
+  /* the cache is used until the next reboot... */
+  write_file (cpuinfo,
+	      CPUINFO_BLOCK ("0", "Intel(R) Core(TM) 0", "800.000"));
+  cpu_desc_new (&cpudesc);
+  cpu_desc_load (cpudesc, cpuinfo, boot_id_path, cachedir);
+  TEST_ASSERT_EQUAL_STRING (cpudesc->vendor, "GenuineIntel");
+  TEST_ASSERT_EQUAL_STRING (cpudesc->model, "207");
+  TEST_ASSERT_EQUAL_STRING (cpudesc->modelname, "Intel(R) Xeon(R) 0");
+  TEST_ASSERT_EQUAL_STRING (cpudesc->flags,
+			    "fpu vme de pse tsc msr pae vmx lm");
+  cpu_desc_unref (cpudesc);
+
+  /* ...where the boot id changes */
+  write_file (boot_id_path, "2f1c7e5a-0000-4000-8000-000000000002\n");
+  cpu_desc_new (&cpudesc);
+  cpu_desc_load (cpudesc, cpuinfo, boot_id_path, cachedir);
+  TEST_ASSERT_EQUAL_STRING (cpudesc->modelname, "Intel(R) Core(TM) 0");
+  cpu_desc_unref (cpudesc);
+
+  /* a cache with an unknown format is discarded */
+  write_file (cachefile, "NPLCPUDESC 0\n"
+	      "boot_id\t: 2f1c7e5a-0000-4000-8000-000000000002\n"
+	      "model name\t: garbage\n");
+  cpu_desc_new (&cpudesc);
+  cpu_desc_load (cpudesc, cpuinfo, boot_id_path, cachedir);
+  TEST_ASSERT_EQUAL_STRING (cpudesc->modelname, "Intel(R) Core(TM) 0");
+  cpu_desc_unref (cpudesc);
+
+  return ret;
+}
+
+static int
+mymain (void)
+{
+  int ret = 0;
+
+  if (mkdtemp (tmpdir) == NULL)
+    return EXIT_FAILURE;
+  cpuinfo = xasprintf ("%s/cpuinfo", tmpdir);
+  boot_id_path = xasprintf ("%s/boot_id", tmpdir);
+  cachedir = xasprintf ("%s/cache", tmpdir);
+  cachefile = xasprintf ("%s/cpudesc", cachedir);
+
+  if (write_file (cpuinfo,
+		  CPUINFO_BLOCK ("0", "Intel(R) Xeon(R) 0", "2100.000")
+		  CPUINFO_BLOCK ("1", "Intel(R) Xeon(R) 1", "3500.000")) < 0
+      || write_file (boot_id_path,
+		     "2f1c7e5a-0000-4000-8000-000000000001\n") < 0
+      || mkdir (cachedir, S_IRWXU) < 0)
+    ret = -1;
+  else
+    {
+      if (test_run ("check the cpuinfo parser", test_cpu_desc_parse,
+		    NULL) < 0)
+	ret = -1;
+      if (test_run ("check the cpu description cache", test_cpu_desc_cache,
+		    NULL) < 0)
+	ret = -1;
+    }
+
+  unlink (cachefile);
+  rmdir (cachedir);
+  unlink (boot_id_path);
+  unlink (cpuinfo);
+  rmdir (tmpdir);
+  free (cachefile);
+  free (cachedir);
+  free (boot_id_path);
+  free (cpuinfo);
+
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+TEST_MAIN (mymain)
@@ -0,0 +1,278 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Unit test for lib/cpufreq.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE		/* activate extra prototypes for glibc */
+#endif
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "testutils.h"
+
+# define NPL_TESTING
+#  include "../lib/cpufreq.c"
+# undef NPL_TESTING
+
+/* a fake /sys/devices/system/cpu */
+static char syscpu[] = "/tmp/tslibcpufreq.XXXXXX";
+
+static int
+syscpu_write (const char *name, const char *content)
+{
+  char *path = xasprintf ("%s/%s", syscpu, name);
+  FILE *fp = fopen (path, "w");
+
+  free (path);
+  if (NULL == fp)
+    return -1;
+  fputs (content, fp);
+  return fclose (fp);
+}
+
+static int
+syscpu_policy (unsigned int id, const char *related_cpus,
+	       const char *cur_freq)
+{
+  char *name = xasprintf ("%s/cpufreq/policy%u", syscpu, id);
+  int err = mkdir (name, S_IRWXU);
+  free (name);
+  if (err < 0)
+    return -1;
+
+#define POLICY_WRITE(file, content)                               \
+  do                                                              \
+    {                                                             \
+      char *_file = xasprintf ("cpufreq/policy%u/" file, id);     \
+      err = syscpu_write (_file, content);                        \
+      free (_file);                                               \
+      if (err < 0)                                                \
+	return -1;                                                \
+    }                                                             \
+  while (0)
+
+  POLICY_WRITE ("related_cpus", related_cpus);
+  POLICY_WRITE ("cpuinfo_min_freq", "800000\n");
+  POLICY_WRITE ("cpuinfo_max_freq", "3600000\n");
+  POLICY_WRITE ("scaling_cur_freq", cur_freq);
+#undef POLICY_WRITE
+
+  name = xasprintf ("%s/cpufreq/policy%u/stats", syscpu, id);
+  err = mkdir (name, S_IRWXU);
+  free (name);
+
+  return err;
+}
+
+static int
+syscpu_throttle (unsigned int cpu, const char *core_count)
+{
+  char *name = xasprintf ("cpu%u/thermal_throttle", cpu);
+  char *path = xasprintf ("%s/%s", syscpu, name);
+  int err = mkdir (path, S_IRWXU);
+  free (path);
+  free (name);
+  if (err < 0)
+    return -1;
+
+  name = xasprintf ("cpu%u/thermal_throttle/core_throttle_count", cpu);
+  err = syscpu_write (name, core_count);
+  free (name);
+
+  return err;
+}
+
+static int
+syscpu_cpu (unsigned int cpu, int policy)
+{
+  char *name = xasprintf ("%s/cpu%u", syscpu, cpu), *link, *target;
+  int err = mkdir (name, S_IRWXU);
+  free (name);
+  if (err < 0 || policy < 0)
+    return err;
+
+  link = xasprintf ("%s/cpu%u/cpufreq", syscpu, cpu);
+  target = xasprintf ("../cpufreq/policy%d", policy);
+  err = symlink (target, link);
+  free (link);
+  free (target);
+
+  return err;
+}
+
+static int
+syscpu_create (void)
+{
+  char *name;
+  int err;
+
+  if (mkdtemp (syscpu) == NULL)
+    return -1;
+  name = xasprintf ("%s/cpufreq", syscpu);
+  err = mkdir (name, S_IRWXU);
+  free (name);
+  if (err < 0)
+    return -1;
+
+  /* cpu0-3 and cpu4-5 are two frequency domains, the last one with an
+   * offline CPU (no current frequency), cpu6 has no cpufreq driver */
+  if (syscpu_policy (0, "0 1 2 3\n", "2400000\n") < 0
+      || syscpu_policy (4, "4 5\n", "") < 0)
+    return -1;
+  if (syscpu_cpu (0, 0) < 0 || syscpu_cpu (1, 0) < 0
+      || syscpu_cpu (2, 0) < 0 || syscpu_cpu (3, 0) < 0
+      || syscpu_cpu (4, 4) < 0 || syscpu_cpu (5, 4) < 0
+      || syscpu_cpu (6, -1) < 0)
+    return -1;
+
+  /* the stats of policy4 are empty, cpu6 has no package counter */
+  if (syscpu_write ("cpufreq/policy0/stats/time_in_state",
+		    "3600000 250\n2400000 150\n1200000 100\n") < 0
+      || syscpu_write ("cpufreq/policy4/stats/time_in_state", "") < 0
+      || syscpu_throttle (0, "12\n") < 0
+      || syscpu_throttle (6, "3\n") < 0
+      || syscpu_write ("cpu0/thermal_throttle/package_throttle_count",
+		       "40\n") < 0)
+    return -1;
+
+  return 0;
+}
+
+static int
+syscpu_remove_entry (const char *path, const struct stat *sb, int typeflag,
+		     struct FTW *ftwbuf)
+{
+  (void) sb;
+  (void) typeflag;
+  (void) ftwbuf;
+  return remove (path);
+}
+
+static int
+test_cpufreq_policies (const void *tdata)
+{
+  struct cpufreq_policy *policies;
+  unsigned int npolicies;
+  int ret = 0;
+
+  (void) tdata;
+  policies = cpufreq_read_policies (syscpu, 7, &npolicies);
+
+  TEST_ASSERT_EQUAL_NUMERIC (npolicies, 2);
+  TEST_ASSERT_EQUAL_NUMERIC (policies[0].id, 0);
+  TEST_ASSERT_EQUAL_NUMERIC (policies[0].cpu, 0);
+  TEST_ASSERT_EQUAL_NUMERIC (policies[0].ncpus, 4);
+  TEST_ASSERT_EQUAL_NUMERIC (policies[0].freq_min, 800000);
+  TEST_ASSERT_EQUAL_NUMERIC (policies[0].freq_max, 3600000);
+  TEST_ASSERT_EQUAL_NUMERIC (policies[0].freq_kernel, 2400000);
+  TEST_ASSERT_EQUAL_NUMERIC (policies[1].id, 4);
+  TEST_ASSERT_EQUAL_NUMERIC (policies[1].cpu, 4);
+  TEST_ASSERT_EQUAL_NUMERIC (policies[1].ncpus, 2);
+  TEST_ASSERT_EQUAL_NUMERIC (policies[1].freq_kernel, 0);
+
+  cpufreq_policies_free (policies);
+
+  /* the CPUs beyond 'ncpus' are ignored */
+  policies = cpufreq_read_policies (syscpu, 2, &npolicies);
+  TEST_ASSERT_EQUAL_NUMERIC (npolicies, 1);
+  TEST_ASSERT_EQUAL_NUMERIC (policies[0].ncpus, 4);
+  cpufreq_policies_free (policies);
+
+  return ret;
+}
+
+static int
+test_cpufreq_time_in_state (const void *tdata)
+{
+  unsigned long long below, total;
+  int ret = 0;
+
+  (void) tdata;
+  TEST_ASSERT_EQUAL_NUMERIC (
+    cpufreq_read_time_in_state (syscpu, 1, 2400000, &below, &total), 0);
+  TEST_ASSERT_EQUAL_NUMERIC (below, 100);
+  TEST_ASSERT_EQUAL_NUMERIC (total, 500);
+  TEST_ASSERT_EQUAL_NUMERIC (
+    cpufreq_read_time_in_state (syscpu, 0, 3600001, &below, &total), 0);
+  TEST_ASSERT_EQUAL_NUMERIC (below, 500);
+
+  TEST_ASSERT_EQUAL_NUMERIC (
+    cpufreq_read_time_in_state (syscpu, 4, 2400000, &below, &total),
+    -ENODEV);
+  TEST_ASSERT_EQUAL_NUMERIC (
+    cpufreq_read_time_in_state (syscpu, 6, 2400000, &below, &total),
+    -ENODEV);
+
+  return ret;
+}
+
+static int
+test_cpufreq_throttle (const void *tdata)
+{
+  struct cpufreq_throttle throttle;
+  int ret = 0;
+
+  (void) tdata;
+  TEST_ASSERT_EQUAL_NUMERIC (cpufreq_read_throttle (syscpu, 0, &throttle), 0);
+  TEST_ASSERT_EQUAL_NUMERIC (throttle.core_count, 12);
+  TEST_ASSERT_EQUAL_NUMERIC (throttle.has_package_count, true);
+  TEST_ASSERT_EQUAL_NUMERIC (throttle.package_count, 40);
+
+  TEST_ASSERT_EQUAL_NUMERIC (cpufreq_read_throttle (syscpu, 6, &throttle), 0);
+  TEST_ASSERT_EQUAL_NUMERIC (throttle.core_count, 3);
+  TEST_ASSERT_EQUAL_NUMERIC (throttle.has_package_count, false);
+
+  TEST_ASSERT_EQUAL_NUMERIC (cpufreq_read_throttle (syscpu, 1, &throttle),
+			     -ENODEV);
+
+  return ret;
+}
+
+static int
+mymain (void)
+{
+  int ret = 0;
+
+  if (syscpu_create () < 0)
+    ret = -1;
+  else
+    {
+      if (test_run ("check cpufreq_read_policies", test_cpufreq_policies,
+		    NULL) < 0)
+	ret = -1;
+      if (test_run ("check cpufreq_read_time_in_state",
+		    test_cpufreq_time_in_state, NULL) < 0)
+	ret = -1;
+      if (test_run ("check cpufreq_read_throttle", test_cpufreq_throttle,
+		    NULL) < 0)
+	ret = -1;
+    }
+
+  sysfsparser_closedirfds ();
+  nftw (syscpu, syscpu_remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+TEST_MAIN (mymain)
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Unit test for lib/cpuidle.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE		/* activate extra prototypes for glibc */
+#endif
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "testutils.h"
+#include "xasprintf.h"
+
+# define NPL_TESTING
+#  include "../lib/cpuidle.c"
+# undef NPL_TESTING
+
+/* a fake /sys/devices/system/cpu */
+static char syscpu[] = "/tmp/tslibcpuidle.XXXXXX";
+
+static int
+syscpu_state (unsigned int cpu, unsigned int state, const char *name,
+	      const char *latency, const char *time, const char *usage)
+{
+  const char *files[][2] = {
+    { "name", name }, { "latency", latency }, { "time", time },
+    { "usage", usage }
+  };
+  char *dir = xasprintf ("%s/cpu%u", syscpu, cpu);
+  unsigned int i;
+  int err = 0;
+
+  mkdir (dir, S_IRWXU);
+  free (dir);
+  dir = xasprintf ("%s/cpu%u/cpuidle", syscpu, cpu);
+  mkdir (dir, S_IRWXU);
+  free (dir);
+  dir = xasprintf ("%s/cpu%u/cpuidle/state%u", syscpu, cpu, state);
+  if (mkdir (dir, S_IRWXU) < 0)
+    err = -1;
+
+  for (i = 0; i < 4 && err == 0; i++)
+    {
+      char *path;
+      FILE *fp;
+
+      if (NULL == files[i][1])
+	continue;
+      path = xasprintf ("%s/%s", dir, files[i][0]);
+      if ((fp = fopen (path, "w")) == NULL)
+	err = -1;
+      else
+	{
+	  fputs (files[i][1], fp);
+	  fclose (fp);
+	}
+      free (path);
+    }
+
+  free (dir);
+  return err;
+}
+
+static int
+syscpu_remove_entry (const char *path, const struct stat *sb, int typeflag,
+		     struct FTW *ftwbuf)
+{
+  (void) sb;
+  (void) typeflag;
+  (void) ftwbuf;
+  return remove (path);
+}
+
+static int
+test_cpuidle_read_states (const void *tdata)
+{
+  struct cpuidle_state states[CPUIDLE_STATES_MAX];
+  int ret = 0;
+
+  (void) tdata;
+  TEST_ASSERT_EQUAL_NUMERIC (cpuidle_read_states (syscpu, 0, states), 3);
+  TEST_ASSERT_EQUAL_STRING (states[0].name, "POLL");
+  TEST_ASSERT_EQUAL_NUMERIC (states[0].latency, 0);
+  TEST_ASSERT_EQUAL_STRING (states[2].name, "C6");
+  TEST_ASSERT_EQUAL_NUMERIC (states[2].latency, 133);
+  TEST_ASSERT_EQUAL_NUMERIC (states[2].time, 123456789012ULL);
+  TEST_ASSERT_EQUAL_NUMERIC (states[2].usage, 4242);
+
+  /* a state without a name and with a missing counter */
+  TEST_ASSERT_EQUAL_NUMERIC (cpuidle_read_states (syscpu, 1, states), 1);
+  TEST_ASSERT_EQUAL_STRING (states[0].name, "state0");
+  TEST_ASSERT_EQUAL_NUMERIC (states[0].usage, 0);
+
+  TEST_ASSERT_EQUAL_NUMERIC (cpuidle_read_states (syscpu, 2, states),
+			     -ENODEV);
+
+  return ret;
+}
+
+static int
+mymain (void)
+{
+  int ret = 0;
+
+  if (mkdtemp (syscpu) == NULL
+      || syscpu_state (0, 0, "POLL\n", "0\n", "1000\n", "10\n") < 0
+      || syscpu_state (0, 1, "C1\n", "2\n", "5000\n", "100\n") < 0
+      || syscpu_state (0, 2, "C6\n", "133\n", "123456789012\n", "4242\n") < 0
+      || syscpu_state (1, 0, NULL, "1\n", "1000\n", NULL) < 0)
+    ret = -1;
+  else if (test_run ("check cpuidle_read_states", test_cpuidle_read_states,
+		     NULL) < 0)
+    ret = -1;
+
+  sysfsparser_closedirfds ();
+  nftw (syscpu, syscpu_remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+TEST_MAIN (mymain)
@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Unit test for lib/cputopology.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE		/* activate extra prototypes for glibc */
+#endif
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "testutils.h"
+#include "xasprintf.h"
+
+# define NPL_TESTING
+#  include "../lib/cputopology.c"
+# undef NPL_TESTING
+
+/* a fake /sys/devices/system, with the boot id and the cache directory */
+static char syssystem[] = "/tmp/tslibcputopology.XXXXXX";
+static char *boot_id_path, *cachedir;
+
+/* Write 'value' in the file 'name', creating the missing directories */
+static int
+syssystem_write (const char *name, const char *value)
+{
+  char *path = xasprintf ("%s/%s", syssystem, name), *p;
+  FILE *fp;
+  int err = 0;
+
+  for (p = path + strlen (syssystem) + 1; (p = strchr (p, '/')); p++)
+    {
+      *p = '\0';
+      mkdir (path, S_IRWXU);
+      *p = '/';
+    }
+
+  if ((fp = fopen (path, "w")) == NULL)
+    err = -1;
+  else
+    {
+      fputs (value, fp);
+      fclose (fp);
+    }
+
+  free (path);
+  return err;
+}
+
+static int
+syssystem_cpu (unsigned int cpu, const char *package_id,
+	       const char *core_id)
+{
+  char *name;
+  int err;
+
+  name = xasprintf ("cpu/cpu%u/topology/physical_package_id", cpu);
+  err = syssystem_write (name, package_id);
+  free (name);
+  name = xasprintf ("cpu/cpu%u/topology/core_id", cpu);
+  err |= syssystem_write (name, core_id);
+  free (name);
+
+  return err;
+}
+
+static int
+syssystem_cache (unsigned int index, const char *level, const char *type,
+		 const char *size, const char *shared_cpu_list)
+{
+  const char *files[][2] = {
+    { "level", level }, { "type", type }, { "size", size },
+    { "shared_cpu_list", shared_cpu_list }
+  };
+  unsigned int i;
+  int err = 0;
+
+  for (i = 0; i < 4; i++)
+    {
+      char *name = xasprintf ("cpu/cpu0/cache/index%u/%s", index,
+			      files[i][0]);
+      err |= syssystem_write (name, files[i][1]);
+      free (name);
+    }
+
+  return err;
+}
+
+static int
+syssystem_remove_entry (const char *path, const struct stat *sb,
+			int typeflag, struct FTW *ftwbuf)
+{
+  (void) sb;
+  (void) typeflag;
+  (void) ftwbuf;
+  return remove (path);
+}
+
+static int
+test_cpulist_parse (const void *tdata)
+{
+  unsigned int n, *cpus;
+  int ret = 0;
+
+  (void) tdata;
+  cpus = cpulist_parse ("0-2,5,7-8\n", &n);
+  TEST_ASSERT_EQUAL_NUMERIC (n, 6);
+  TEST_ASSERT_EQUAL_NUMERIC (cpus[2], 2);
+  TEST_ASSERT_EQUAL_NUMERIC (cpus[3], 5);
+  TEST_ASSERT_EQUAL_NUMERIC (cpus[5], 8);
+  free (cpus);
+
+  TEST_ASSERT_EQUAL_NUMERIC (cpulist_weight ("3-1"), 0);
+  TEST_ASSERT_EQUAL_NUMERIC (cpulist_weight (""), 0);
+
+  return ret;
+}
+
+static int
+test_cputopology_build (const void *tdata)
+{
+  struct cputopology *topology;
+  int ret = 0;
+
+  (void) tdata;
+  topology = cputopology_build (syssystem);
+
+  TEST_ASSERT_EQUAL_NUMERIC (topology->ncpus, 4);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->nonline, 3);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->npackages, 2);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->ndies, 2);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->ncores, 2);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->nnodes, 2);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->threads_per_core, 2);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->cores_per_socket, 1);
+
+  /* the offline CPU has no topology */
+  TEST_ASSERT_EQUAL_NUMERIC (cputopology_get_cpu (topology, 3)->online,
+			     false);
+  TEST_ASSERT_EQUAL_NUMERIC (cputopology_get_cpu (topology, 3)->package_id,
+			     -1);
+  TEST_ASSERT_EQUAL_NUMERIC (cputopology_get_cpu (topology, 3)->node, 1);
+  TEST_ASSERT_EQUAL_NUMERIC (cputopology_get_cpu (topology, 2)->package_id,
+			     1);
+  TEST_ASSERT_EQUAL_NUMERIC (cputopology_get_cpu (topology, 4) == NULL,
+			     true);
+
+  TEST_ASSERT_EQUAL_NUMERIC (topology->ncaches, 3);
+  TEST_ASSERT_EQUAL_STRING (topology->caches[0].type, "Data");
+  TEST_ASSERT_EQUAL_NUMERIC (topology->caches[0].size, 48);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->caches[0].ninstances, 2);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->caches[2].level, 3);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->caches[2].size, 30720);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->caches[2].ninstances, 1);
+
+  cputopology_free (topology);
+  return ret;
+}
+
+static int
+test_cputopology_cache (const void *tdata)
+{
+  const struct cputopology_cpu *cpu;
+  struct cputopology *topology;
+  char *key, *content;
+  int ret = 0;
+
+  (void) tdata;
+
+  /* the first call saves the topology in the cache */
+  topology = cputopology_load (syssystem, boot_id_path, cachedir);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->ncores, 2);
+  cputopology_free (topology);
+
+  /* a change in the topology is ignored while the key is unchanged... */
+  syssystem_cpu (2, "1\n", "5\n");
+  syssystem_write ("cpu/cpu2/topology/die_id", "3\n");
+  topology = cputopology_load (syssystem, boot_id_path, cachedir);
+  TEST_ASSERT_EQUAL_NUMERIC (cputopology_get_cpu (topology, 2)->core_id, 0);
+  TEST_ASSERT_EQUAL_NUMERIC (cputopology_get_cpu (topology, 3)->node, 1);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->nonline, 3);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->ncaches, 3);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->caches[1].size, 1280);
+  cputopology_free (topology);
+
+  /* ...and the topology is read again after a CPU hotplug event */
+  syssystem_write ("cpu/online", "0-3\n");
+  topology = cputopology_load (syssystem, boot_id_path, cachedir);
+  TEST_ASSERT_EQUAL_NUMERIC (cputopology_get_cpu (topology, 2)->core_id, 5);
+  TEST_ASSERT_EQUAL_NUMERIC (cputopology_get_cpu (topology, 2)->die_id, 3);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->nonline, 4);
+  TEST_ASSERT_EQUAL_NUMERIC (topology->ndies, 2);
+  cputopology_free (topology);
+
+  /* ...or a reboot */
+  syssystem_cpu (2, "1\n", "6\n");
+  syssystem_write ("boot_id", "2f1c7e5a-0000-4000-8000-000000000002\n");
+  topology = cputopology_load (syssystem, boot_id_path, cachedir);
+  TEST_ASSERT_EQUAL_NUMERIC (cputopology_get_cpu (topology, 2)->core_id, 6);
+  cputopology_free (topology);
+
+  /* a corrupted cache is discarded */
+  syssystem_cpu (2, "1\n", "7\n");
+  syssystem_write ("cache/cputopology", "NPLTOPO 1\ngarbage\n");
+  topology = cputopology_load (syssystem, boot_id_path, cachedir);
+  TEST_ASSERT_EQUAL_NUMERIC (cputopology_get_cpu (topology, 2)->core_id, 7);
+  cputopology_free (topology);
+
+  /* and so is a cache with the cpus out of order (bsearch needs them
+   * sorted) */
+  syssystem_cpu (2, "1\n", "8\n");
+  key = cputopology_cache_key (syssystem, boot_id_path);
+  content = xasprintf ("NPLTOPO 1\n%s\n3\ncpu 0 0 0 0 0 1\n"
+		       "cpu 2 1 0 99 1 1\ncpu 1 0 0 0 0 1\n", key);
+  syssystem_write ("cache/cputopology", content);
+  topology = cputopology_load (syssystem, boot_id_path, cachedir);
+  cpu = cputopology_get_cpu (topology, 2);
+  TEST_ASSERT_EQUAL_NUMERIC (cpu != NULL && cpu->core_id == 8, true);
+  cputopology_free (topology);
+  free (content);
+  free (key);
+
+  return ret;
+}
+
+static int
+mymain (void)
+{
+  int ret = 0;
+
+  if (mkdtemp (syssystem) == NULL)
+    return EXIT_FAILURE;
+  boot_id_path = xasprintf ("%s/boot_id", syssystem);
+  cachedir = xasprintf ("%s/cache", syssystem);
+
+  if (syssystem_write ("boot_id",
+		       "2f1c7e5a-0000-4000-8000-000000000001\n") < 0
+      || syssystem_write ("cache/.keep", "") < 0
+      || syssystem_write ("cpu/present", "0-3\n") < 0
+      || syssystem_write ("cpu/online", "0-2\n") < 0
+      || syssystem_cpu (0, "0\n", "0\n") < 0
+      || syssystem_cpu (1, "0\n", "0\n") < 0
+      || syssystem_cpu (2, "1\n", "0\n") < 0
+      || syssystem_write ("node/node0/cpulist", "0-1\n") < 0
+      || syssystem_write ("node/node1/cpulist", "2-3\n") < 0
+      || syssystem_write ("node/possible", "0-1\n") < 0
+      || syssystem_cache (0, "1\n", "Data\n", "48K\n", "0-1\n") < 0
+      || syssystem_cache (1, "2\n", "Unified\n", "1280K\n", "0-1\n") < 0
+      || syssystem_cache (2, "3\n", "Unified\n", "30720K\n", "0-3\n") < 0)
+    ret = -1;
+  else
+    {
+      if (test_run ("check cpulist_parse", test_cpulist_parse, NULL) < 0)
+	ret = -1;
+      if (test_run ("check cputopology_build", test_cputopology_build,
+		    NULL) < 0)
+	ret = -1;
+      if (test_run ("check the topology cache", test_cputopology_cache,
+		    NULL) < 0)
+	ret = -1;
+    }
+
+  sysfsparser_closedirfds ();
+  nftw (syssystem, syssystem_remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+  free (boot_id_path);
+  free (cachedir);
+
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+TEST_MAIN (mymain)
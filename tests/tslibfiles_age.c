@@ -20,6 +20,10 @@
  *
  */
 
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE /* activate extra prototypes for glibc */
+#endif
+
 #include "testutils.h"
 
 # define NPL_TESTING
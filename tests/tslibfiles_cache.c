@@ -0,0 +1,249 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Unit test for lib/files.c (incremental scan)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE /* activate extra prototypes for glibc */
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "testutils.h"
+#include "xasprintf.h"
+
+# define NPL_TESTING
+#  include "../lib/files.c"
+# undef NPL_TESTING
+
+typedef struct test_data
+{
+  int64_t age;
+  time_t now;
+  time_t scan_time;
+  time_t min_mtime, max_mtime;
+  bool expect_value;
+} test_data;
+
+static char *basedir, *cachefile;
+
+/* A record matching 'st', scanned at 'scan_time', is still valid at 'now' */
+static int
+test_files_cache_valid (const void *tdata)
+{
+  const struct test_data *data = tdata;
+  const struct files_walk w = { .age = data->age, .now = data->now };
+  const struct files_cache c = { .w = &w };
+  const struct stat st = {
+    .st_mtim = { .tv_sec = 1000, .tv_nsec = 1 },
+    .st_ctim = { .tv_sec = 1000, .tv_nsec = 2 }
+  };
+  const struct files_cache_record r = {
+    .mtime_sec = 1000, .mtime_nsec = 1,
+    .ctime_sec = 1000, .ctime_nsec = 2,
+    .scan_time = data->scan_time,
+    .min_mtime = data->min_mtime,
+    .max_mtime = data->max_mtime
+  };
+  int ret = 0;
+
+  TEST_ASSERT_EQUAL_NUMERIC (files_cache_valid (&c, &r, &st),
+			     data->expect_value);
+  return ret;
+}
+
+static int64_t
+test_count_bytes (const char *cache_file)
+{
+  struct files_types *filecount = NULL;
+  struct files_options opts = {
+    .flags = FILES_RECURSIVE | FILES_SUM_SIZES,
+    .nthreads = 1,
+    .cache_file = cache_file
+  };
+  int64_t bytes;
+
+  if (files_filecount_opts (basedir, &opts, &filecount) < 0)
+    return -1;
+  bytes = filecount->bytes + 1000000 * filecount->total;
+  files_types_free (filecount);
+
+  return bytes;
+}
+
+static int
+test_set_size (const char *name, off_t size)
+{
+  char *path = xasprintf ("%s/%s", basedir, name);
+  int ret = truncate (path, size);
+  if (ret < 0 && errno == ENOENT)
+    {
+      int fd = open (path, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
+      ret = (fd < 0) ? -1 : ftruncate (fd, size);
+      if (fd >= 0)
+	close (fd);
+    }
+  free (path);
+  return ret;
+}
+
+/* Move the modification time of a directory in the past, so that its
+ * record can be trusted */
+static void
+test_age_dir (const char *name)
+{
+  const struct timespec times[2] = {
+    { .tv_sec = 0, .tv_nsec = UTIME_OMIT },
+    { .tv_sec = time (NULL) - 600, .tv_nsec = 0 }
+  };
+  utimensat (AT_FDCWD, name, times, 0);
+}
+
+static int
+test_files_cache_scan (const void *tdata)
+{
+  char *subdir = xasprintf ("%s/a", basedir);
+  int64_t before, cached, uncached;
+  int ret = 0;
+
+  (void) tdata;
+
+  /* first run, without a cache file: full scan */
+  before = test_count_bytes (cachefile);
+  TEST_ASSERT_EQUAL_NUMERIC (before, 3 * 1000000 + 100 + 200);
+
+  /* a file modified in place does not change its directory: the cached
+   * counters are used, while a full scan sees the new size */
+  test_set_size ("a/2", 250);
+  cached = test_count_bytes (cachefile);
+  uncached = test_count_bytes (NULL);
+  TEST_ASSERT_EQUAL_NUMERIC (cached, before);
+  TEST_ASSERT_EQUAL_NUMERIC (uncached, before + 50);
+
+  /* a new file changes the time of its directory, that is read again */
+  test_set_size ("a/3", 300);
+  test_age_dir (subdir);
+  cached = test_count_bytes (cachefile);
+  TEST_ASSERT_EQUAL_NUMERIC (cached, 4 * 1000000 + 100 + 250 + 300);
+
+  free (subdir);
+  return ret;
+}
+
+static int
+test_files_cache_check_records (const void *tdata)
+{
+  struct files_cache_record r[2];
+  int ret = 0;
+
+  (void) tdata;
+  memset (r, 0, sizeof r);
+  r[0].names = 0;
+  r[0].nsubdirs = 2;
+  r[1].names = 5;
+  r[1].nsubdirs = 1;
+
+#define CHECK(NAMES) \
+  files_cache_check_records (r, 2, NAMES, sizeof (NAMES) - 1)
+  TEST_ASSERT_EQUAL_NUMERIC (CHECK ("a\0bc\0def\0"), true);
+  /* a truncated names block */
+  TEST_ASSERT_EQUAL_NUMERIC (CHECK ("a\0bc\0de"), false);
+  TEST_ASSERT_EQUAL_NUMERIC (CHECK ("a\0bc\0"), false);
+  /* names that would escape the tree or loop on the same directory */
+  TEST_ASSERT_EQUAL_NUMERIC (CHECK ("a\0..\0def\0"), false);
+  TEST_ASSERT_EQUAL_NUMERIC (CHECK (".\0bc\0def\0"), false);
+  TEST_ASSERT_EQUAL_NUMERIC (CHECK ("a\0b/\0def\0"), false);
+  TEST_ASSERT_EQUAL_NUMERIC (CHECK ("\0\0bc\0def\0"), false);
+#undef CHECK
+
+  /* an offset out of the names block */
+  r[1].names = 100;
+  TEST_ASSERT_EQUAL_NUMERIC (files_cache_check_records (r, 2, "a\0bc\0", 5),
+			     false);
+
+  return ret;
+}
+
+static int
+mymain (void)
+{
+  static char template[] = "/tmp/tslibfiles_cache.XXXXXX";
+  int ret = 0;
+  time_t now = 100000;
+
+# define DO_TEST(TEST, AGE, SCAN_TIME, MIN_MTIME, MAX_MTIME, EXPECT_VALUE) \
+  do                                                                     \
+    {                                                                    \
+      test_data data = {                                                 \
+        .age = AGE,                                                      \
+        .now = now,                                                      \
+        .scan_time = SCAN_TIME,                                          \
+        .min_mtime = MIN_MTIME,                                          \
+        .max_mtime = MAX_MTIME,                                          \
+        .expect_value = EXPECT_VALUE,                                    \
+      };                                                                 \
+      if (test_run("check function files_cache_valid (" TEST ")",        \
+                   test_files_cache_valid, (&data)) < 0)                 \
+        ret = -1;                                                        \
+    }                                                                    \
+  while (0)
+
+  /* the age boundary moved from 'now - 300 - 3600' to 'now - 3600' */
+  DO_TEST ("no age filter", 0, now - 300, now - 5000, now, true);
+  DO_TEST ("no regular files", 3600, now - 300, INT64_MAX, INT64_MIN, true);
+  DO_TEST ("all files older", 3600, now - 300,
+	   now - 9000, now - 5000, true);
+  DO_TEST ("all files newer", 3600, now - 300, now - 3000, now - 10, true);
+  DO_TEST ("boundary crossed", 3600, now - 300,
+	   now - 5000, now - 3700, false);
+  DO_TEST ("boundary crossed (negative age)", -3600, now - 300,
+	   now - 3800, now - 10, false);
+
+  if (test_run ("check function files_cache_check_records",
+		test_files_cache_check_records, NULL) < 0)
+    ret = -1;
+
+  if (mkdtemp (template) == NULL)
+    return EXIT_AM_HARDFAIL;
+  cachefile = xasprintf ("%s/cache", template);
+  basedir = xasprintf ("%s/tree", template);
+
+  char *subdir = xasprintf ("%s/a", basedir);
+  mkdir (basedir, S_IRWXU);
+  mkdir (subdir, S_IRWXU);
+  if (test_set_size ("1", 100) < 0 || test_set_size ("a/2", 200) < 0)
+    return EXIT_AM_HARDFAIL;
+  test_age_dir (subdir);
+  test_age_dir (basedir);
+  free (subdir);
+
+  if (test_run ("check the incremental scan", test_files_cache_scan,
+		NULL) < 0)
+    ret = -1;
+
+  free (cachefile);
+  free (basedir);
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+TEST_MAIN (mymain)
@@ -20,7 +20,12 @@
  *
  */
 
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE /* activate extra prototypes for glibc */
+#endif
+
 #include <fcntl.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -35,10 +40,9 @@
 typedef struct test_data
 {
   char *basedir;
-  unsigned int flags;
-  int64_t age;
-  int64_t size;
-  char *pattern;
+  /* call files_filecount_opts() instead of files_filecount() */
+  bool use_opts;
+  struct files_options opts;
   int64_t expect_value;
 } test_data;
 
@@ -80,8 +84,18 @@ test_files_filecount (const void *tdata)
   struct files_types *filecount = NULL;
   int ret = 0;
 
-  ret = files_filecount (data->basedir, data->flags, data->age, data->size,
-			 data->pattern, &filecount);
+  if (data->use_opts)
+    {
+      struct files_options opts = data->opts;
+      while (opts.include && opts.include[opts.ninclude])
+	opts.ninclude++;
+      while (opts.exclude && opts.exclude[opts.nexclude])
+	opts.nexclude++;
+      ret = files_filecount_opts (data->basedir, &opts, &filecount);
+    }
+  else
+    ret = files_filecount (data->basedir, data->opts.flags, data->opts.age,
+			   data->opts.size, data->opts.pattern, &filecount);
   if (ret < 0)
     return EXIT_AM_HARDFAIL;
 
@@ -94,12 +108,12 @@ test_files_filecount (const void *tdata)
 static int
 test_create_tree (char **basedir)
 {
-  char template[] = "/tmp/tslibfiles_filecount.XXXXXX";
+  static char template[] = "/tmp/tslibfiles_filecount.XXXXXX";
   test_environment e = env[0];
   int i = 0;
 
   *basedir = mkdtemp (template);
-  if (NULL == basedir)
+  if (NULL == *basedir)
     {
       perror ("mkdtemp failed in test_create_tree ()");
       return EXIT_AM_HARDFAIL;
@@ -158,10 +172,12 @@ mymain (void)
     {                                                                    \
       test_data data = {                                                 \
         .basedir = BASEDIR,                                              \
-        .flags = FLAGS,                                                  \
-        .age = AGE,                                                      \
-        .size = SIZE,                                                    \
-        .pattern = PATTERN,                                              \
+        .opts = {                                                        \
+          .flags = FLAGS,                                                \
+          .age = AGE,                                                    \
+          .size = SIZE,                                                  \
+          .pattern = PATTERN,                                            \
+        },                                                               \
         .expect_value = EXPECT_VALUE,                                    \
       };                                                                 \
       if (test_run("check function files_filecount (" TEST ")",          \
@@ -170,6 +186,23 @@ mymain (void)
     }                                                                    \
   while (0)
 
+  /* the trailing arguments initialize the struct files_options passed to
+   * files_filecount_opts(), e.g. '.flags = FILES_RECURSIVE, .nthreads = 4' */
+# define DO_TEST_OPTS(TEST, BASEDIR, EXPECT_VALUE, ...)                  \
+  do                                                                     \
+    {                                                                    \
+      test_data data = {                                                 \
+        .basedir = BASEDIR,                                              \
+        .use_opts = true,                                                \
+        .opts = { __VA_ARGS__ },                                         \
+        .expect_value = EXPECT_VALUE,                                    \
+      };                                                                 \
+      if (test_run("check function files_filecount_opts (" TEST ")",     \
+                   test_files_filecount, (&data)) < 0)                   \
+        ret = -1;                                                        \
+    }                                                                    \
+  while (0)
+
   /* test the function files_filecount() */
 
   ret = test_create_tree (&basedir);
@@ -220,6 +253,111 @@ mymain (void)
 	   basedir,
 	   FILES_RECURSIVE | FILES_INCLUDE_HIDDEN | FILES_IGNORE_SYMLINKS,
 	   0, 0, NULL, 17);
+  DO_TEST ("recursive + age (fstatat path)",
+	   basedir,
+	   FILES_RECURSIVE,
+	   -3600, 0, NULL, 18);
+  DO_TEST ("recursive + age (io_uring)",
+	   basedir,
+	   FILES_RECURSIVE | FILES_URING_STAT,
+	   -3600, 0, NULL, 18);
+  DO_TEST ("recursive + hidden + age (io_uring)",
+	   basedir,
+	   FILES_RECURSIVE | FILES_INCLUDE_HIDDEN | FILES_URING_STAT,
+	   -3600, 0, NULL, 20);
+
+  /* the parallel walker must return the same counters */
+  DO_TEST_OPTS ("recursive, 4 threads",
+		basedir, 18,
+		.flags = FILES_RECURSIVE,
+		.nthreads = 4);
+  DO_TEST_OPTS ("recursive + hidden, 4 threads",
+		basedir, 20,
+		.flags = FILES_RECURSIVE | FILES_INCLUDE_HIDDEN,
+		.nthreads = 4);
+  DO_TEST_OPTS ("recursive + regular, 2 threads",
+		basedir, 13,
+		.flags = FILES_RECURSIVE | FILES_REGULAR_ONLY,
+		.nthreads = 2);
+  DO_TEST_OPTS ("default, 4 threads (not recursive)",
+		basedir, 8,
+		.flags = FILES_DEFAULT,
+		.nthreads = 4);
+
+  DO_TEST ("pattern literal",
+	   basedir,
+	   FILES_RECURSIVE,
+	   0, 0, "2", 3);
+  DO_TEST ("pattern prefix",
+	   basedir,
+	   FILES_DEFAULT,
+	   0, 0, "link*", 1);
+  DO_TEST ("pattern suffix",
+	   basedir,
+	   FILES_RECURSIVE,
+	   0, 0, "*1", 4);
+  DO_TEST ("pattern substring",
+	   basedir,
+	   FILES_RECURSIVE,
+	   0, 0, "*ink*", 3);
+  DO_TEST ("pattern glob",
+	   basedir,
+	   FILES_RECURSIVE,
+	   0, 0, "[ab]", 2);
+
+  static const char *const names_12[] = { "1", "2", NULL };
+  static const char *const names_any[] = { "*", NULL };
+  static const char *const names_single[] = { "?", NULL };
+  static const char *const names_link[] = { "link*", NULL };
+  static const char *const names_34[] = { "[34]", NULL };
+
+  DO_TEST_OPTS ("two include patterns",
+		basedir, 6,
+		.flags = FILES_RECURSIVE,
+		.include = names_12);
+  DO_TEST_OPTS ("exclude pattern only",
+		basedir, 15,
+		.flags = FILES_RECURSIVE,
+		.exclude = names_link);
+  DO_TEST_OPTS ("include and exclude patterns",
+		basedir, 15,
+		.flags = FILES_RECURSIVE,
+		.include = names_any,
+		.exclude = names_link);
+  DO_TEST_OPTS ("include and exclude globs",
+		basedir, 10,
+		.flags = FILES_RECURSIVE,
+		.include = names_single,
+		.exclude = names_34);
+
+  DO_TEST_OPTS ("recursive, max depth 1",
+		basedir, 13,
+		.flags = FILES_RECURSIVE,
+		.max_depth = 1);
+  DO_TEST_OPTS ("recursive, max depth 2",
+		basedir, 18,
+		.flags = FILES_RECURSIVE,
+		.max_depth = 2);
+  DO_TEST_OPTS ("recursive, max depth 1, 4 threads",
+		basedir, 13,
+		.flags = FILES_RECURSIVE,
+		.max_depth = 1,
+		.nthreads = 4);
+  DO_TEST_OPTS ("recursive + hidden, max depth 1",
+		basedir, 15,
+		.flags = FILES_RECURSIVE | FILES_INCLUDE_HIDDEN,
+		.max_depth = 1);
+  DO_TEST_OPTS ("recursive, one file system",
+		basedir, 18,
+		.flags = FILES_RECURSIVE | FILES_ONE_FILE_SYSTEM);
+  DO_TEST_OPTS ("recursive, one file system (io_uring)",
+		basedir, 18,
+		.flags = FILES_RECURSIVE | FILES_ONE_FILE_SYSTEM
+			 | FILES_URING_STAT);
+  DO_TEST_OPTS ("recursive, one file system, 4 threads",
+		basedir, 18,
+		.flags = FILES_RECURSIVE | FILES_ONE_FILE_SYSTEM,
+		.nthreads = 4);
 
   return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
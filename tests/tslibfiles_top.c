@@ -0,0 +1,275 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Unit test for lib/files.c (size accounting and top-N files)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE /* activate extra prototypes for glibc */
+#endif
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "testutils.h"
+#include "xasprintf.h"
+
+# define NPL_TESTING
+#  include "../lib/files.c"
+# undef NPL_TESTING
+
+#define NTOP	3
+
+typedef struct test_data
+{
+  const char *basedir;
+  unsigned int nthreads;
+} test_data;
+
+static int
+test_files_top_heaps (const void *tdata)
+{
+  const off_t sizes[] = { 5, 1, 9, 3, 7, 8 };
+  const time_t mtimes[] = { 100, 50, 300, 10, 200, 400 };
+  struct files_types *filecount = NULL;
+  size_t i;
+  int ret = 0;
+
+  (void) tdata;
+  files_data_init (&filecount);
+  files_top_init (filecount, NTOP);
+
+  for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      struct stat statbuf = { .st_size = sizes[i], .st_mtime = mtimes[i] };
+      char name[16];
+      snprintf (name, sizeof (name), "f%zu", i);
+      files_top_add (filecount, NTOP, "/base", name, &statbuf);
+    }
+
+  qsort (filecount->largest, filecount->nlargest,
+	 sizeof (struct files_entry), files_cmp_largest);
+  qsort (filecount->oldest, filecount->noldest,
+	 sizeof (struct files_entry), files_cmp_oldest);
+
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->nlargest, NTOP);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->largest[0].size, 9);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->largest[1].size, 8);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->largest[2].size, 7);
+  TEST_ASSERT_EQUAL_STRING (filecount->largest[0].path, "/base/f2");
+
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->noldest, NTOP);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->oldest[0].mtime, 10);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->oldest[1].mtime, 50);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->oldest[2].mtime, 100);
+  TEST_ASSERT_EQUAL_STRING (filecount->oldest[0].path, "/base/f3");
+
+  files_types_free (filecount);
+  return ret;
+}
+
+static int
+test_files_filecount_sizes (const void *tdata)
+{
+  const struct test_data *data = tdata;
+  struct files_types *filecount = NULL;
+  struct files_options opts = {
+    .flags = FILES_RECURSIVE | FILES_SUM_SIZES,
+    .nthreads = data->nthreads,
+    .ntop = 2
+  };
+  char *path;
+  int ret = 0;
+
+  if (files_filecount_opts (data->basedir, &opts, &filecount) < 0)
+    return EXIT_AM_HARDFAIL;
+
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->regular_file, 4);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->bytes, 1000 + 2000 + 3000 + 4000);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->nlargest, 2);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->largest[0].size, 4000);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->largest[1].size, 3000);
+
+  path = xasprintf ("%s/a/b/4", data->basedir);
+  TEST_ASSERT_EQUAL_STRING (filecount->largest[0].path, path);
+  free (path);
+
+  /* the file '1' has been created with the oldest modification time */
+  path = xasprintf ("%s/1", data->basedir);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->noldest, 2);
+  TEST_ASSERT_EQUAL_STRING (filecount->oldest[0].path, path);
+  free (path);
+
+  files_types_free (filecount);
+  return ret;
+}
+
+static int
+test_files_age_bin (const void *tdata)
+{
+  const int64_t bins[] = { 60, 300, 3600 };
+  int ret = 0;
+
+  (void) tdata;
+  TEST_ASSERT_EQUAL_NUMERIC (files_age_bin (bins, 3, -10), 0);
+  TEST_ASSERT_EQUAL_NUMERIC (files_age_bin (bins, 3, 0), 0);
+  TEST_ASSERT_EQUAL_NUMERIC (files_age_bin (bins, 3, 59), 0);
+  TEST_ASSERT_EQUAL_NUMERIC (files_age_bin (bins, 3, 60), 1);
+  TEST_ASSERT_EQUAL_NUMERIC (files_age_bin (bins, 3, 299), 1);
+  TEST_ASSERT_EQUAL_NUMERIC (files_age_bin (bins, 3, 300), 2);
+  TEST_ASSERT_EQUAL_NUMERIC (files_age_bin (bins, 3, 3600), 3);
+  TEST_ASSERT_EQUAL_NUMERIC (files_age_bin (bins, 3, 86400), 3);
+
+  return ret;
+}
+
+static int
+test_files_filecount_ages (const void *tdata)
+{
+  const struct test_data *data = tdata;
+  const int64_t bins[] = { 90, 150, 600 };
+  struct files_types *filecount = NULL;
+  struct files_options opts = {
+    .flags = FILES_RECURSIVE,
+    .nthreads = data->nthreads,
+    .age_bins = bins,
+    .nage_bins = 3
+  };
+  int ret = 0;
+
+  if (files_filecount_opts (data->basedir, &opts, &filecount) < 0)
+    return EXIT_AM_HARDFAIL;
+
+  /* the files have been modified 60s, 120s, 180s and 3600s ago */
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->nage_bins, 3);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->age_count[0], 1);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->age_count[1], 1);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->age_count[2], 1);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->age_count[3], 1);
+  TEST_ASSERT_EQUAL_NUMERIC (filecount->oldest_age / 60, 60);
+
+  files_types_free (filecount);
+  return ret;
+}
+
+static int
+test_create_file (const char *basedir, const char *name, off_t size,
+		  time_t mtime)
+{
+  char *path = xasprintf ("%s/%s", basedir, name);
+  struct timespec times[2] = {
+    { .tv_sec = mtime, .tv_nsec = 0 },
+    { .tv_sec = mtime, .tv_nsec = 0 }
+  };
+  int fd, ret = 0;
+
+  if ((fd = open (path, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR)) < 0
+      || ftruncate (fd, size) < 0 || futimens (fd, times) < 0)
+    {
+      perror (path);
+      ret = -1;
+    }
+  if (fd >= 0)
+    close (fd);
+  free (path);
+
+  return ret;
+}
+
+static int
+test_create_tree (char **basedir)
+{
+  static char template[] = "/tmp/tslibfiles_top.XXXXXX";
+  time_t now = time (NULL);
+  char *subdir;
+
+  if ((*basedir = mkdtemp (template)) == NULL)
+    {
+      perror ("mkdtemp failed in test_create_tree ()");
+      return -1;
+    }
+
+  subdir = xasprintf ("%s/a", *basedir);
+  mkdir (subdir, S_IRWXU);
+  free (subdir);
+  subdir = xasprintf ("%s/a/b", *basedir);
+  mkdir (subdir, S_IRWXU);
+  free (subdir);
+
+  if (test_create_file (*basedir, "1", 1000, now - 3600) < 0
+      || test_create_file (*basedir, "2", 2000, now - 60) < 0
+      || test_create_file (*basedir, "a/3", 3000, now - 120) < 0
+      || test_create_file (*basedir, "a/b/4", 4000, now - 180) < 0)
+    return -1;
+
+  return 0;
+}
+
+static int
+mymain (void)
+{
+  int ret = 0;
+  char *basedir;
+
+  if (test_run ("check the top-N heaps", test_files_top_heaps, NULL) < 0)
+    ret = -1;
+  if (test_run ("check the age bins", test_files_age_bin, NULL) < 0)
+    ret = -1;
+
+  if (test_create_tree (&basedir) < 0)
+    return EXIT_AM_HARDFAIL;
+
+# define DO_TEST(TEST, NTHREADS)                                         \
+  do                                                                     \
+    {                                                                    \
+      test_data data = {                                                 \
+        .basedir = basedir,                                              \
+        .nthreads = NTHREADS,                                            \
+      };                                                                 \
+      if (test_run("check the size accounting (" TEST ")",               \
+                   test_files_filecount_sizes, (&data)) < 0)             \
+        ret = -1;                                                        \
+    }                                                                    \
+  while (0)
+
+  DO_TEST ("serial walker", 1);
+  DO_TEST ("parallel walker", 3);
+
+# define DO_TEST_AGES(TEST, NTHREADS)                                    \
+  do                                                                     \
+    {                                                                    \
+      test_data data = {                                                 \
+        .basedir = basedir,                                              \
+        .nthreads = NTHREADS,                                            \
+      };                                                                 \
+      if (test_run("check the age histogram (" TEST ")",                 \
+                   test_files_filecount_ages, (&data)) < 0)              \
+        ret = -1;                                                        \
+    }                                                                    \
+  while (0)
+
+  DO_TEST_AGES ("serial walker", 1);
+  DO_TEST_AGES ("parallel walker", 3);
+
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+TEST_MAIN (mymain)
@@ -0,0 +1,188 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Unit test for lib/fsfilter.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+
+#include "testutils.h"
+#include "xasprintf.h"
+
+# define NPL_TESTING
+#  include "../lib/fsfilter.c"
+# undef NPL_TESTING
+
+#define NMOUNTPOINTS 5000
+
+typedef struct test_data
+{
+  const char *devname;
+  const char *mountdir;
+  const char *type;
+  bool remote;
+  bool dummy;
+  bool expect_skip;
+  bool expect_listed;
+} test_data;
+
+static struct fs_filter filter;
+
+static int
+test_fs_filter_skip (const void *tdata)
+{
+  const struct test_data *data = tdata;
+  struct mount_entry me = {
+    .me_devname = (char *) data->devname,
+    .me_mountdir = (char *) data->mountdir,
+    .me_type = (char *) data->type,
+    .me_remote = data->remote,
+    .me_dummy = data->dummy
+  };
+  int ret = 0;
+
+  TEST_ASSERT_EQUAL_NUMERIC (fs_filter_skip (&filter, &me),
+			     data->expect_skip);
+  TEST_ASSERT_EQUAL_NUMERIC (fs_filter_listed (&filter, &me),
+			     data->expect_listed);
+
+  return ret;
+}
+
+static int
+test_fs_filter_type_conflict (const void *tdata)
+{
+  struct fs_filter conflict = { .show_all_fs = false };
+  int ret = 0;
+
+  (void) tdata;
+  fs_filter_select_type (&conflict, "ext4");
+  fs_filter_select_type (&conflict, "xfs");
+  TEST_ASSERT_EQUAL_NUMERIC (fs_filter_type_conflict (&conflict) == NULL,
+			     true);
+  fs_filter_exclude_type (&conflict, "xfs");
+  TEST_ASSERT_EQUAL_STRING (fs_filter_type_conflict (&conflict), "xfs");
+
+  fs_filter_free (&conflict);
+  return ret;
+}
+
+/* The hash table grows and keeps all the mount points */
+static int
+test_fs_filter_mountpoints (const void *tdata)
+{
+  struct fs_filter many = { .show_all_fs = false };
+  unsigned int i, found = 0;
+  int ret = 0;
+
+  (void) tdata;
+  for (i = 0; i < NMOUNTPOINTS; i++)
+    {
+      char *mountdir = xasprintf ("/srv/volume%u", i);
+      fs_filter_add_mountpoint (&many, mountdir)->count = i;
+      free (mountdir);
+    }
+  TEST_ASSERT_EQUAL_NUMERIC (many.mountpoints->uniq, NMOUNTPOINTS);
+  TEST_ASSERT_EQUAL_NUMERIC (many.mountpoints->capacity >= NMOUNTPOINTS,
+			     true);
+
+  for (i = 0; i < NMOUNTPOINTS; i++)
+    {
+      char *mountdir = xasprintf ("/srv/volume%u", i);
+      hashable_t *np = fs_filter_mountpoint (&many, mountdir);
+      if (np && np->count == i
+	  && STREQ (many.mountpoints->keys[i], mountdir))
+	found++;
+      free (mountdir);
+    }
+  TEST_ASSERT_EQUAL_NUMERIC (found, NMOUNTPOINTS);
+  TEST_ASSERT_EQUAL_NUMERIC (fs_filter_mountpoint (&many, "/srv") == NULL,
+			     true);
+
+  fs_filter_free (&many);
+  return ret;
+}
+
+static int
+mymain (void)
+{
+  int ret = 0;
+
+# define DO_TEST(DEVNAME, MOUNTDIR, TYPE, REMOTE, DUMMY,              \
+		 EXPECT_SKIP, EXPECT_LISTED)                             \
+  do                                                                   \
+    {                                                                  \
+      test_data data = {                                               \
+	.devname = DEVNAME,                                            \
+	.mountdir = MOUNTDIR,                                          \
+	.type = TYPE,                                                  \
+	.remote = REMOTE,                                              \
+	.dummy = DUMMY,                                                \
+	.expect_skip = EXPECT_SKIP,                                    \
+	.expect_listed = EXPECT_LISTED                                 \
+      };                                                               \
+      if (test_run ("check fs_filter with " MOUNTDIR " (" TYPE ")",    \
+		    test_fs_filter_skip, (&data)) < 0)                 \
+	ret = -1;                                                      \
+    }                                                                  \
+  while (0)
+
+  /* no filter */
+  DO_TEST ("/dev/sda1", "/", "ext4", false, false, false, false);
+  DO_TEST ("proc", "/proc", "proc", false, true, true, false);
+  DO_TEST ("nas:/export", "/srv/nfs", "nfs4", true, false, false, false);
+
+  /* -a -l -X nfs4 -X vfat, and some file systems in the command line */
+  filter.show_all_fs = true;
+  filter.show_local_fs = true;
+  fs_filter_exclude_type (&filter, "nfs4");
+  fs_filter_exclude_type (&filter, "vfat");
+  fs_filter_add_mountpoint (&filter, "/boot/efi");
+  fs_filter_add_mountpoint (&filter, "/dev/sdb1");
+
+  DO_TEST ("/dev/sda1", "/", "ext4", false, false, false, false);
+  DO_TEST ("proc", "/proc", "proc", false, true, false, false);
+  DO_TEST ("nas:/export", "/srv/nfs", "nfs4", true, false, true, false);
+  DO_TEST ("/dev/sda2", "/boot/efi", "vfat", false, false, true, true);
+  DO_TEST ("/dev/sdb1", "/srv/data", "xfs", false, false, false, true);
+
+  /* -T ext4 -T xfs */
+  fs_filter_free (&filter);
+  filter.show_all_fs = filter.show_local_fs = false;
+  fs_filter_select_type (&filter, "ext4");
+  fs_filter_select_type (&filter, "xfs");
+
+  DO_TEST ("/dev/sda1", "/", "ext4", false, false, false, false);
+  DO_TEST ("/dev/sdb1", "/srv/data", "xfs", false, false, false, false);
+  DO_TEST ("/dev/sda2", "/boot/efi", "vfat", false, false, true, false);
+  DO_TEST ("tmpfs", "/tmp", "tmpfs", false, false, true, false);
+
+  fs_filter_free (&filter);
+
+  if (test_run ("check the type conflicts", test_fs_filter_type_conflict,
+		NULL) < 0)
+    ret = -1;
+  if (test_run ("check a large set of mount points",
+		test_fs_filter_mountpoints, NULL) < 0)
+    ret = -1;
+
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+TEST_MAIN (mymain)
@@ -0,0 +1,154 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Unit test for lib/hwmon.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE		/* activate extra prototypes for glibc */
+#endif
+
+#include <ftw.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "testutils.h"
+#include "xasprintf.h"
+
+# define NPL_TESTING
+#  include "../lib/hwmon.c"
+# undef NPL_TESTING
+
+/* a fake /sys/class/hwmon */
+static char syshwmon[] = "/tmp/tslibhwmon.XXXXXX";
+
+/* Write 'value' in the file 'name', creating the missing directories */
+static int
+syshwmon_write (const char *name, const char *value)
+{
+  char *path = xasprintf ("%s/%s", syshwmon, name), *p;
+  FILE *fp;
+  int err = 0;
+
+  for (p = path + strlen (syshwmon) + 1; (p = strchr (p, '/')); p++)
+    {
+      *p = '\0';
+      mkdir (path, S_IRWXU);
+      *p = '/';
+    }
+
+  if ((fp = fopen (path, "w")) == NULL)
+    err = -1;
+  else
+    {
+      fputs (value, fp);
+      fclose (fp);
+    }
+
+  free (path);
+  return err;
+}
+
+static int
+syshwmon_remove_entry (const char *path, const struct stat *sb,
+		       int typeflag, struct FTW *ftwbuf)
+{
+  (void) sb;
+  (void) typeflag;
+  (void) ftwbuf;
+  return remove (path);
+}
+
+static int
+test_hwmon_read_chips (const void *tdata)
+{
+  struct hwmon_chip *chips;
+  unsigned int nchips;
+  int ret = 0;
+
+  (void) tdata;
+  chips = hwmon_read_chips (syshwmon, &nchips);
+
+  /* hwmon2 has no temperature sensors */
+  TEST_ASSERT_EQUAL_NUMERIC (nchips, 3);
+
+  TEST_ASSERT_EQUAL_NUMERIC (chips[0].id, 0);
+  TEST_ASSERT_EQUAL_STRING (chips[0].name, "coretemp");
+  TEST_ASSERT_EQUAL_NUMERIC (chips[0].nsensors, 3);
+  TEST_ASSERT_EQUAL_STRING (chips[0].sensors[0].label, "Package id 0");
+  TEST_ASSERT_EQUAL_NUMERIC (chips[0].sensors[0].input, 62000);
+  TEST_ASSERT_EQUAL_NUMERIC (chips[0].sensors[0].has_crit, true);
+  TEST_ASSERT_EQUAL_NUMERIC (chips[0].sensors[0].crit, 100000);
+  /* the sensors are sorted by index */
+  TEST_ASSERT_EQUAL_NUMERIC (chips[0].sensors[2].index, 10);
+  TEST_ASSERT_EQUAL_STRING (chips[0].sensors[2].label, "Core 8");
+  TEST_ASSERT_EQUAL_NUMERIC (chips[0].sensors[2].has_crit, false);
+
+  /* a sensor without label and a temperature below zero */
+  TEST_ASSERT_EQUAL_NUMERIC (chips[1].id, 1);
+  TEST_ASSERT_EQUAL_STRING (chips[1].sensors[0].label, "temp1");
+  TEST_ASSERT_EQUAL_NUMERIC (chips[1].sensors[0].input, -5000);
+
+  /* an old driver exporting the attributes in the device directory */
+  TEST_ASSERT_EQUAL_NUMERIC (chips[2].id, 12);
+  TEST_ASSERT_EQUAL_STRING (chips[2].name, "nvme");
+  TEST_ASSERT_EQUAL_NUMERIC (chips[2].nsensors, 1);
+  TEST_ASSERT_EQUAL_STRING (chips[2].sensors[0].label, "Composite");
+  TEST_ASSERT_EQUAL_NUMERIC (chips[2].sensors[0].input, 38850);
+
+  hwmon_chips_free (chips, nchips);
+  return ret;
+}
+
+static int
+mymain (void)
+{
+  int ret = 0;
+
+  if (mkdtemp (syshwmon) == NULL
+      || syshwmon_write ("hwmon0/name", "coretemp\n") < 0
+      || syshwmon_write ("hwmon0/temp1_label", "Package id 0\n") < 0
+      || syshwmon_write ("hwmon0/temp1_input", "62000\n") < 0
+      || syshwmon_write ("hwmon0/temp1_crit", "100000\n") < 0
+      || syshwmon_write ("hwmon0/temp2_label", "Core 0\n") < 0
+      || syshwmon_write ("hwmon0/temp2_input", "55000\n") < 0
+      || syshwmon_write ("hwmon0/temp10_label", "Core 8\n") < 0
+      || syshwmon_write ("hwmon0/temp10_input", "48000\n") < 0
+      || syshwmon_write ("hwmon1/name", "acpitz\n") < 0
+      || syshwmon_write ("hwmon1/temp1_input", "-5000\n") < 0
+      || syshwmon_write ("hwmon2/name", "nct6775\n") < 0
+      || syshwmon_write ("hwmon2/fan1_input", "1200\n") < 0
+      || syshwmon_write ("hwmon12/device/name", "nvme\n") < 0
+      || syshwmon_write ("hwmon12/device/temp1_label", "Composite\n") < 0
+      || syshwmon_write ("hwmon12/device/temp1_input", "38850\n") < 0
+      /* a sensor not connected has no readable input */
+      || syshwmon_write ("hwmon12/device/temp2_input", "") < 0)
+    ret = -1;
+  else if (test_run ("check hwmon_read_chips", test_hwmon_read_chips,
+		     NULL) < 0)
+    ret = -1;
+
+  sysfsparser_closedirfds ();
+  nftw (syshwmon, syshwmon_remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+TEST_MAIN (mymain)
@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Unit test for the mountinfo parser of lib/mountlist.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "testutils.h"
+
+# define NPL_TESTING
+#  include "../lib/mountlist.c"
+# undef NPL_TESTING
+
+static struct mount_entry *mount_list;
+
+typedef struct test_data
+{
+  unsigned int index;
+  const char *devname;
+  const char *mountdir;
+  const char *type;
+  unsigned int mntid;
+  unsigned int parentid;
+  unsigned int major;
+  unsigned int minor;
+  bool readonly;
+  bool remote;
+  bool dummy;
+} test_data;
+
+static int
+test_mountinfo_entry (const void *tdata)
+{
+  const struct test_data *data = tdata;
+  struct mount_entry *me = mount_list;
+  unsigned int i;
+  int ret = 0;
+
+  for (i = 0; me && i < data->index; i++)
+    me = me->me_next;
+  if (NULL == me)
+    return -1;
+
+  TEST_ASSERT_EQUAL_STRING (me->me_devname, data->devname);
+  TEST_ASSERT_EQUAL_STRING (me->me_mountdir, data->mountdir);
+  TEST_ASSERT_EQUAL_STRING (me->me_type, data->type);
+  TEST_ASSERT_EQUAL_NUMERIC (me->me_mntid, data->mntid);
+  TEST_ASSERT_EQUAL_NUMERIC (me->me_parentid, data->parentid);
+  TEST_ASSERT_EQUAL_NUMERIC (major (me->me_dev), data->major);
+  TEST_ASSERT_EQUAL_NUMERIC (minor (me->me_dev), data->minor);
+  TEST_ASSERT_EQUAL_NUMERIC (me->me_readonly, data->readonly);
+  TEST_ASSERT_EQUAL_NUMERIC (me->me_remote, data->remote);
+  TEST_ASSERT_EQUAL_NUMERIC (me->me_dummy, data->dummy);
+
+  return ret;
+}
+
+static int
+test_mountinfo_count (const void *tdata)
+{
+  struct mount_entry *me;
+  unsigned int count = 0;
+  int ret = 0;
+
+  (void) tdata;
+  for (me = mount_list; me; me = me->me_next)
+    count++;
+
+  /* the malformed line is skipped */
+  TEST_ASSERT_EQUAL_NUMERIC (count, 7);
+  return ret;
+}
+
+#ifdef __NR_statmount
+/* The two backends must return the same mounts */
+static int
+test_statmount_live (const void *tdata)
+{
+  struct mount_entry *mountinfo_list, *statmount_list, *me, *sme;
+  unsigned int nmatches = 0;
+  int ret = 0;
+
+  (void) tdata;
+  if ((statmount_list = statmount_read ()) == NULL)
+    /* Linux < 6.8, or a kernel without the mount source in statmount() */
+    return 0;
+  if ((mountinfo_list = mountinfo_read (MOUNTINFO)) == NULL)
+    {
+      free_mount_list (statmount_list);
+      return 0;
+    }
+
+  for (me = mountinfo_list; me; me = me->me_next)
+    for (sme = statmount_list; sme; sme = sme->me_next)
+      if (sme->me_mntid == me->me_mntid)
+	{
+	  TEST_ASSERT_EQUAL_STRING (sme->me_devname, me->me_devname);
+	  TEST_ASSERT_EQUAL_STRING (sme->me_mountdir, me->me_mountdir);
+	  TEST_ASSERT_EQUAL_STRING (sme->me_type, me->me_type);
+	  TEST_ASSERT_EQUAL_STRING (sme->me_opts, me->me_opts);
+	  TEST_ASSERT_EQUAL_NUMERIC (sme->me_parentid, me->me_parentid);
+	  TEST_ASSERT_EQUAL_NUMERIC (sme->me_dev, me->me_dev);
+	  TEST_ASSERT_EQUAL_NUMERIC (sme->me_readonly, me->me_readonly);
+	  nmatches++;
+	  break;
+	}
+  TEST_ASSERT_EQUAL_NUMERIC (nmatches > 0, true);
+
+  free_mount_list (mountinfo_list);
+  free_mount_list (statmount_list);
+  return ret;
+}
+#endif
+
+static int
+mymain (void)
+{
+  int ret = 0;
+
+  mount_list = mountinfo_read (NPL_TEST_PATH_PROCMOUNTINFO);
+  if (NULL == mount_list)
+    return EXIT_AM_HARDFAIL;
+
+  if (test_run ("check the number of mounts", test_mountinfo_count,
+		NULL) < 0)
+    ret = -1;
+
+# define DO_TEST(INDEX, DEVNAME, MOUNTDIR, TYPE, MNTID, PARENTID,        \
+		MAJOR, MINOR, READONLY, REMOTE, DUMMY)                   \
+  do                                                                     \
+    {                                                                    \
+      test_data data = {                                                 \
+        .index = INDEX,                                                  \
+        .devname = DEVNAME,                                              \
+        .mountdir = MOUNTDIR,                                            \
+        .type = TYPE,                                                    \
+        .mntid = MNTID,                                                  \
+        .parentid = PARENTID,                                            \
+        .major = MAJOR,                                                  \
+        .minor = MINOR,                                                  \
+        .readonly = READONLY,                                            \
+        .remote = REMOTE,                                                \
+        .dummy = DUMMY                                                   \
+      };                                                                 \
+      if (test_run ("check the mount " MOUNTDIR,                         \
+                    test_mountinfo_entry, (&data)) < 0)                  \
+        ret = -1;                                                        \
+    }                                                                    \
+  while (0)
+
+  DO_TEST (0, "/dev/mapper/root", "/", "ext4", 22, 1, 253, 0,
+	   false, false, false);
+  DO_TEST (1, "proc", "/proc", "proc", 23, 22, 0, 21,
+	   false, false, true);
+  DO_TEST (2, "sysfs", "/sys", "sysfs", 24, 22, 0, 22,
+	   false, false, true);
+  /* read-only super block, escaped space */
+  DO_TEST (3, "/dev/mapper/data", "/mnt/my data", "xfs", 41, 22, 253, 2,
+	   true, false, false);
+  /* read-only mount, optional fields */
+  DO_TEST (4, "nas:/export", "/srv/nfs", "nfs4", 42, 22, 0, 45,
+	   true, true, false);
+  DO_TEST (5, "overlay", "/var/log/app", "overlay", 43, 22, 0, 46,
+	   false, false, false);
+  DO_TEST (6, "tmpfs", "/srv/nfs/sub", "tmpfs", 44, 42, 0, 47,
+	   false, false, false);
+
+  free_mount_list (mount_list);
+
+#ifdef __NR_statmount
+  if (test_run ("check statmount() against mountinfo", test_statmount_live,
+		NULL) < 0)
+    ret = -1;
+#endif
+
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+TEST_MAIN (mymain)
@@ -0,0 +1,254 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Unit test for lib/mountwatch.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "testutils.h"
+#include "xasprintf.h"
+
+# define NPL_TESTING
+#  include "../lib/mountwatch.c"
+# undef NPL_TESTING
+
+#define NMOUNTS 4
+
+/* Fill 'list' with a mount table; 'readonly' is a string of NMOUNTS
+ * characters 'r' (read-only) or 'w' (read-write) */
+static struct mount_entry *
+mount_table (struct mount_entry *list, const char *readonly)
+{
+  static char *mountdirs[NMOUNTS] = { "/", "/home", "/srv/data", "/boot" };
+  static char *types[NMOUNTS] = { "ext4", "xfs", "nfs4", "vfat" };
+  unsigned int i;
+
+  for (i = 0; i < NMOUNTS; i++)
+    {
+      memset (&list[i], 0, sizeof (struct mount_entry));
+      list[i].me_mountdir = mountdirs[i];
+      list[i].me_type = types[i];
+      list[i].me_mntid = 20 + (i * 7) % NMOUNTS;
+      list[i].me_readonly = (readonly[i] == 'r');
+      list[i].me_next = (i + 1 < NMOUNTS) ? &list[i + 1] : NULL;
+    }
+
+  return list;
+}
+
+static bool
+skip_vfat (const struct mount_entry *me)
+{
+  return STREQ (me->me_type, "vfat");
+}
+
+static int
+test_mountwatch_diff (const void *tdata)
+{
+  struct mount_entry old_list[NMOUNTS], new_list[NMOUNTS];
+  struct mountwatch_state state = { .nevents = 0 };
+  int ret = 0;
+
+  (void) tdata;
+
+  /* nothing changed */
+  TEST_ASSERT_EQUAL_NUMERIC (
+    mountwatch_diff (mount_table (old_list, "wwww"),
+		     mount_table (new_list, "wwww"), 1000, NULL, &state), 0);
+
+  /* /srv/data became read-only, /boot is filtered out */
+  TEST_ASSERT_EQUAL_NUMERIC (
+    mountwatch_diff (mount_table (old_list, "wwww"),
+		     mount_table (new_list, "wwrr"), 1000, skip_vfat,
+		     &state), 1);
+  TEST_ASSERT_EQUAL_NUMERIC (state.nevents, 1);
+  TEST_ASSERT_EQUAL_STRING (state.events[0].mountdir, "/srv/data");
+  TEST_ASSERT_EQUAL_STRING (state.events[0].type, "nfs4");
+  TEST_ASSERT_EQUAL_NUMERIC (state.events[0].readonly, true);
+  TEST_ASSERT_EQUAL_NUMERIC (state.events[0].when, 1000);
+
+  /* and was remounted read-write, while / became read-only */
+  TEST_ASSERT_EQUAL_NUMERIC (
+    mountwatch_diff (mount_table (old_list, "wwrw"),
+		     mount_table (new_list, "rwww"), 1060, NULL, &state), 2);
+  TEST_ASSERT_EQUAL_NUMERIC (state.nevents, 3);
+
+  /* a mount replaced by a read-only one (new mount ID) is not a
+   * transition */
+  mount_table (old_list, "wwww");
+  mount_table (new_list, "wrww");
+  new_list[1].me_mntid = 99;
+  TEST_ASSERT_EQUAL_NUMERIC (
+    mountwatch_diff (old_list, new_list, 1100, NULL, &state), 0);
+
+  mountwatch_state_free (&state);
+  return ret;
+}
+
+/* The mount tables returned by the successive rereads */
+static const char *const rescans[] = { "wwww", "rwww", "rwww", "wwww" };
+static unsigned int nrescans;
+
+static struct mount_entry *
+read_synthetic_list (void)
+{
+  struct mount_entry *list = xnmalloc (NMOUNTS, sizeof (struct mount_entry));
+
+  mount_table (list, rescans[nrescans++]);
+  /* free_mount_list() releases the whole table with a single free() */
+  list->me_arena = true;
+  return list;
+}
+
+static int
+test_mountwatch_update (const void *tdata)
+{
+  struct mountwatch_state state = { .nevents = 0 };
+  struct mount_entry *mounts;
+  int ret = 0, pipefd[2];
+
+  (void) tdata;
+
+  /* a pipe never raises POLLPRI: like a file system remounted read-only
+   * after an I/O error, the changes are only seen when the timeout
+   * expires */
+  if (pipe (pipefd) < 0)
+    return -1;
+
+  nrescans = 0;
+  mounts = read_synthetic_list ();
+
+  /* / became read-only */
+  TEST_ASSERT_EQUAL_NUMERIC (mountwatch_update (pipefd[0], 0, &mounts,
+						read_synthetic_list, NULL,
+						&state), 1);
+  TEST_ASSERT_EQUAL_NUMERIC (state.nevents, 1);
+  TEST_ASSERT_EQUAL_STRING (state.events[0].mountdir, "/");
+  TEST_ASSERT_EQUAL_NUMERIC (state.events[0].readonly, true);
+
+  /* nothing changed */
+  TEST_ASSERT_EQUAL_NUMERIC (mountwatch_update (pipefd[0], 0, &mounts,
+						read_synthetic_list, NULL,
+						&state), 0);
+
+  /* and was remounted read-write */
+  TEST_ASSERT_EQUAL_NUMERIC (mountwatch_update (pipefd[0], 0, &mounts,
+						read_synthetic_list, NULL,
+						&state), 1);
+  TEST_ASSERT_EQUAL_NUMERIC (state.nevents, 2);
+  TEST_ASSERT_EQUAL_STRING (state.events[1].mountdir, "/");
+  TEST_ASSERT_EQUAL_NUMERIC (state.events[1].readonly, false);
+  TEST_ASSERT_EQUAL_NUMERIC (nrescans, 4);
+
+  free_mount_list (mounts);
+  close (pipefd[0]);
+  close (pipefd[1]);
+  mountwatch_state_free (&state);
+  return ret;
+}
+
+static int
+test_mountwatch_state_overflow (const void *tdata)
+{
+  struct mountwatch_state state = { .nevents = 0 };
+  unsigned int i;
+  int ret = 0;
+
+  (void) tdata;
+  for (i = 0; i < MOUNTWATCH_MAX_EVENTS + 10; i++)
+    mountwatch_state_add (&state, i, true, "ext4", "/");
+
+  TEST_ASSERT_EQUAL_NUMERIC (state.nevents, MOUNTWATCH_MAX_EVENTS);
+  /* the oldest events have been discarded */
+  TEST_ASSERT_EQUAL_NUMERIC (state.events[0].when, 10);
+  TEST_ASSERT_EQUAL_NUMERIC (state.events[MOUNTWATCH_MAX_EVENTS - 1].when,
+			     MOUNTWATCH_MAX_EVENTS + 9);
+
+  mountwatch_state_free (&state);
+  return ret;
+}
+
+static int
+test_mountwatch_state_file (const void *tdata)
+{
+  struct mountwatch_state state = { .nevents = 0 }, loaded;
+  char template[] = "/tmp/tslibmountwatch.XXXXXX", *path;
+  FILE *fp;
+  int ret = 0;
+
+  (void) tdata;
+  if (mkdtemp (template) == NULL)
+    return -1;
+  path = xasprintf ("%s/state", template);
+
+  /* a missing file is an empty state */
+  TEST_ASSERT_EQUAL_NUMERIC (mountwatch_state_read (path, &loaded), 0);
+  TEST_ASSERT_EQUAL_NUMERIC (loaded.nevents, 0);
+
+  mountwatch_state_add (&state, 1760000000, true, "ext4", "/srv/my data");
+  mountwatch_state_add (&state, 1760000060, false, "ext4", "/srv/my data");
+  TEST_ASSERT_EQUAL_NUMERIC (mountwatch_state_write (path, &state), 0);
+
+  /* the malformed lines are skipped */
+  if ((fp = fopen (path, "a")) != NULL)
+    {
+      fputs ("garbage\n1760000120 xx ext4 /\n1760000180 ro ext4\n", fp);
+      fclose (fp);
+    }
+
+  TEST_ASSERT_EQUAL_NUMERIC (mountwatch_state_read (path, &loaded), 0);
+  TEST_ASSERT_EQUAL_NUMERIC (loaded.nevents, 2);
+  TEST_ASSERT_EQUAL_NUMERIC (loaded.events[0].when, 1760000000);
+  TEST_ASSERT_EQUAL_NUMERIC (loaded.events[0].readonly, true);
+  TEST_ASSERT_EQUAL_STRING (loaded.events[0].type, "ext4");
+  TEST_ASSERT_EQUAL_STRING (loaded.events[0].mountdir, "/srv/my data");
+  TEST_ASSERT_EQUAL_NUMERIC (loaded.events[1].readonly, false);
+
+  mountwatch_state_free (&loaded);
+  mountwatch_state_free (&state);
+  unlink (path);
+  rmdir (template);
+  free (path);
+  return ret;
+}
+
+static int
+mymain (void)
+{
+  int ret = 0;
+
+  if (test_run ("check the read-only transitions", test_mountwatch_diff,
+		NULL) < 0)
+    ret = -1;
+  if (test_run ("check the rereads of the mount table",
+		test_mountwatch_update, NULL) < 0)
+    ret = -1;
+  if (test_run ("check the events limit", test_mountwatch_state_overflow,
+		NULL) < 0)
+    ret = -1;
+  if (test_run ("check the state file", test_mountwatch_state_file,
+		NULL) < 0)
+    ret = -1;
+
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+TEST_MAIN (mymain)
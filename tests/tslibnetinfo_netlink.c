@@ -0,0 +1,256 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Unit test for the netlink parsers of lib/netinfo-private.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE		/* activate extra prototypes for glibc */
+#endif
+
+#include <stdlib.h>
+
+#include "testutils.h"
+
+# define NPL_TESTING
+#  include "../lib/netinfo-private.c"
+# undef NPL_TESTING
+
+#define NLMSG_BUFFER	1024
+
+/* Append the attribute 'type' with the payload 'data' to the message 'h' */
+static struct rtattr *
+nlmsg_put_attr (struct nlmsghdr *h, int type, const void *data, size_t len)
+{
+  struct rtattr *rta =
+    (struct rtattr *) ((char *) h + NLMSG_ALIGN (h->nlmsg_len));
+
+  rta->rta_type = type;
+  rta->rta_len = RTA_LENGTH (len);
+  if (data)
+    memcpy (RTA_DATA (rta), data, len);
+  h->nlmsg_len = NLMSG_ALIGN (h->nlmsg_len) + RTA_ALIGN (rta->rta_len);
+
+  return rta;
+}
+
+/* Build a canned RTM_NEWLINK message, like the ones of a RTM_GETLINK dump */
+static struct nlmsghdr *
+nlmsg_newlink (char *buf, int ifindex, const char *ifname, const char *kind,
+	       int master, unsigned int tx_bytes, unsigned int rx_bytes)
+{
+  struct nlmsghdr *h = (struct nlmsghdr *) buf;
+  struct ifinfomsg *ifi;
+  struct rtnl_link_stats stats;
+
+  memset (buf, 0, NLMSG_BUFFER);
+  h->nlmsg_type = RTM_NEWLINK;
+  h->nlmsg_len = NLMSG_LENGTH (sizeof (struct ifinfomsg));
+  ifi = NLMSG_DATA (h);
+  ifi->ifi_index = ifindex;
+  ifi->ifi_flags = IFF_UP | IFF_RUNNING;
+
+  nlmsg_put_attr (h, IFLA_IFNAME, ifname, strlen (ifname) + 1);
+  if (kind)
+    {
+      struct rtattr *linkinfo = nlmsg_put_attr (h, IFLA_LINKINFO, NULL, 0);
+      nlmsg_put_attr (h, IFLA_INFO_KIND, kind, strlen (kind) + 1);
+      linkinfo->rta_len = (char *) h + h->nlmsg_len - (char *) linkinfo;
+    }
+  if (master > 0)
+    nlmsg_put_attr (h, IFLA_MASTER, &master, sizeof (master));
+
+  memset (&stats, 0, sizeof (stats));
+  stats.tx_bytes = tx_bytes;
+  stats.rx_bytes = rx_bytes;
+  stats.tx_packets = tx_bytes / 1000;
+  nlmsg_put_attr (h, IFLA_STATS, &stats, sizeof (stats));
+
+  return h;
+}
+
+static int
+test_iflist_new_from_nlmsg (const void *tdata)
+{
+  char buf[NLMSG_BUFFER];
+  struct iflist *ifl;
+  int ret = 0;
+
+  (void) tdata;
+
+  ifl = iflist_new_from_nlmsg (nlmsg_newlink (buf, 4, "veth0", "veth", 7,
+					      3000, 5000));
+  TEST_ASSERT_EQUAL_STRING (ifl->ifname, "veth0");
+  TEST_ASSERT_EQUAL_STRING (ifl->kind, "veth");
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->ifindex, 4);
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->master, 7);
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->stats->tx_bytes, 3000);
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->stats->rx_bytes, 5000);
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->stats->tx_packets, 3);
+  TEST_ASSERT_EQUAL_NUMERIC (if_kind_class (ifl->kind, ifl->flags),
+			     IF_KIND_VETH);
+  freeiflist (ifl);
+
+  /* a physical device has neither a kind nor a master */
+  ifl = iflist_new_from_nlmsg (nlmsg_newlink (buf, 2, "eth0", NULL, 0,
+					      0, 0));
+  TEST_ASSERT_EQUAL_STRING (ifl->ifname, "eth0");
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->kind == NULL, true);
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->master, 0);
+  TEST_ASSERT_EQUAL_NUMERIC (if_kind_class (ifl->kind, ifl->flags),
+			     IF_KIND_PHYSICAL);
+  freeiflist (ifl);
+
+  return ret;
+}
+
+static struct iflist *
+iflist_append (struct iflist **iflhead, struct iflist *ifl)
+{
+  struct iflist **pifl;
+
+  for (pifl = iflhead; *pifl; pifl = &(*pifl)->next)
+    ;
+  return *pifl = ifl;
+}
+
+static int
+test_rollup_slaves (const void *tdata)
+{
+  char buf[NLMSG_BUFFER];
+  struct iflist *iflhead = NULL, *ifl;
+  int ret = 0;
+
+  (void) tdata;
+
+  /* eth0 and eth1 are the slaves of bond0, a port of br0 with veth0,
+   * eth2 and eth3 are the slaves of bond1 and eth4 is not enslaved */
+#define ADD_LINK(IFINDEX, NAME, KIND, MASTER, TX, RX)			    \
+  iflist_append (&iflhead,						    \
+		 iflist_new_from_nlmsg (nlmsg_newlink (buf, IFINDEX, NAME,  \
+						       KIND, MASTER, TX, RX)))
+  ADD_LINK (2, "eth0", NULL, 10, 1000, 2000);
+  ADD_LINK (3, "eth1", NULL, 10, 3000, 4000);
+  ADD_LINK (10, "bond0", "bond", 20, 4000, 6000);
+  ADD_LINK (11, "veth0", "veth", 20, 500, 700);
+  ADD_LINK (20, "br0", "bridge", 0, 600, 900);
+  ADD_LINK (4, "eth2", NULL, 12, 100, 200);
+  ADD_LINK (5, "eth3", NULL, 12, 300, 400);
+  ADD_LINK (12, "bond1", "bond", 0, 1, 1);
+  ADD_LINK (6, "eth4", NULL, 0, 10, 20);
+#undef ADD_LINK
+
+  iflhead = rollup_slaves (iflhead);
+
+  /* a bond reports the sum of the counters of its slaves, also when it
+   * is a bridge port */
+  ifl = iflhead;
+  TEST_ASSERT_EQUAL_STRING (ifl->ifname, "bond0");
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->stats->tx_bytes, 4000);
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->stats->rx_bytes, 6000);
+
+  ifl = ifl->next;
+  TEST_ASSERT_EQUAL_STRING (ifl->ifname, "veth0");
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->stats->tx_bytes, 500);
+
+  /* the bridge keeps its own counters: the traffic forwarded between its
+   * ports is not counted twice */
+  ifl = ifl->next;
+  TEST_ASSERT_EQUAL_STRING (ifl->ifname, "br0");
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->stats->tx_bytes, 600);
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->stats->rx_bytes, 900);
+  TEST_ASSERT_EQUAL_STRING (ifl->ports, "bond0,veth0");
+
+  ifl = ifl->next;
+  TEST_ASSERT_EQUAL_STRING (ifl->ifname, "bond1");
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->stats->tx_bytes, 400);
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->stats->rx_bytes, 600);
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->ports == NULL, true);
+
+  ifl = ifl->next;
+  TEST_ASSERT_EQUAL_STRING (ifl->ifname, "eth4");
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->stats->tx_bytes, 10);
+  TEST_ASSERT_EQUAL_NUMERIC (ifl->next == NULL, true);
+
+  freeiflist (iflhead);
+  return ret;
+}
+
+static int
+test_parse_qdisc_stats (const void *tdata)
+{
+  char buf[NLMSG_BUFFER];
+  struct nlmsghdr *h = (struct nlmsghdr *) buf;
+  struct rtattr *tb[TCA_MAX+1], *stats2;
+  struct gnet_stats_basic bs = { .bytes = 123456, .packets = 789 };
+  struct gnet_stats_queue q =
+    { .qlen = 3, .backlog = 4500, .drops = 17, .requeues = 2,
+      .overlimits = 5 };
+  struct qdiscstats qstats;
+  struct tcmsg *tcm;
+  int ret = 0;
+
+  (void) tdata;
+
+  memset (buf, 0, sizeof buf);
+  h->nlmsg_type = RTM_NEWQDISC;
+  h->nlmsg_len = NLMSG_LENGTH (sizeof (struct tcmsg));
+  tcm = NLMSG_DATA (h);
+  tcm->tcm_parent = TC_H_ROOT;
+  nlmsg_put_attr (h, TCA_KIND, "fq_codel", sizeof ("fq_codel"));
+  stats2 = nlmsg_put_attr (h, TCA_STATS2, NULL, 0);
+  nlmsg_put_attr (h, TCA_STATS_BASIC, &bs, sizeof (bs));
+  nlmsg_put_attr (h, TCA_STATS_QUEUE, &q, sizeof (q));
+  stats2->rta_len = (char *) h + h->nlmsg_len - (char *) stats2;
+
+  parse_rtattr (tb, TCA_MAX, TCA_RTA (tcm),
+		h->nlmsg_len - NLMSG_LENGTH (sizeof (*tcm)));
+  TEST_ASSERT_EQUAL_STRING ((char *) RTA_DATA (tb[TCA_KIND]), "fq_codel");
+  TEST_ASSERT_EQUAL_NUMERIC (parse_qdisc_stats (tb, &qstats), true);
+  TEST_ASSERT_EQUAL_NUMERIC (qstats.bytes, 123456);
+  TEST_ASSERT_EQUAL_NUMERIC (qstats.packets, 789);
+  TEST_ASSERT_EQUAL_NUMERIC (qstats.drops, 17);
+  TEST_ASSERT_EQUAL_NUMERIC (qstats.backlog, 4500);
+  TEST_ASSERT_EQUAL_NUMERIC (qstats.qlen, 3);
+
+  /* no statistics at all */
+  memset (tb, 0, sizeof tb);
+  TEST_ASSERT_EQUAL_NUMERIC (parse_qdisc_stats (tb, &qstats), false);
+
+  return ret;
+}
+
+static int
+mymain (void)
+{
+  int ret = 0;
+
+  if (test_run ("check the RTM_NEWLINK parser", test_iflist_new_from_nlmsg,
+		NULL) < 0)
+    ret = -1;
+  if (test_run ("check rollup_slaves", test_rollup_slaves, NULL) < 0)
+    ret = -1;
+  if (test_run ("check parse_qdisc_stats", test_parse_qdisc_stats,
+		NULL) < 0)
+    ret = -1;
+
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+TEST_MAIN (mymain)
@@ -0,0 +1,246 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+/*
+ * License: GPLv3+
+ * Copyright (c) 2026 Davide Madrisan <davide.madrisan@gmail.com>
+ *
+ * Unit test for lib/sysfsparser.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE		/* activate extra prototypes for glibc */
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "testutils.h"
+
+# define NPL_TESTING
+#  include "../lib/sysfsparser.c"
+# undef NPL_TESTING
+
+/* a fake sysfs device directory */
+static char sysdir[] = "/tmp/tslibsysfsparser.XXXXXX";
+
+static const char *attributes[][2] = {
+  { "cpuinfo_min_freq", "800000\n" },
+  { "cpuinfo_max_freq", "3600000\n" },
+  { "scaling_governor", "powersave\n" },
+  { "empty", "" },
+  { "garbage", "n/a\n" }
+};
+
+#define NATTRIBUTES (sizeof (attributes) / sizeof (attributes[0]))
+
+static int
+sysdir_create (void)
+{
+  size_t i;
+
+  if (mkdtemp (sysdir) == NULL)
+    return -1;
+
+  for (i = 0; i < NATTRIBUTES; i++)
+    {
+      char *path = xasprintf ("%s/%s", sysdir, attributes[i][0]);
+      FILE *fp = fopen (path, "w");
+      free (path);
+      if (NULL == fp)
+	return -1;
+      fputs (attributes[i][1], fp);
+      fclose (fp);
+    }
+
+  return 0;
+}
+
+static void
+sysdir_remove (void)
+{
+  size_t i;
+
+  for (i = 0; i < NATTRIBUTES; i++)
+    {
+      char *path = xasprintf ("%s/%s", sysdir, attributes[i][0]);
+      unlink (path);
+      free (path);
+    }
+  rmdir (sysdir);
+}
+
+static int
+test_sysfsparser_legacy (const void *tdata)
+{
+  unsigned long long value;
+  char *line;
+  int ret = 0;
+
+  (void) tdata;
+  TEST_ASSERT_EQUAL_NUMERIC (
+    sysfsparser_path_exist ("%s/%s", sysdir, "empty"), true);
+  TEST_ASSERT_EQUAL_NUMERIC (
+    sysfsparser_path_exist ("%s/%s", sysdir, "missing"), false);
+
+  TEST_ASSERT_EQUAL_NUMERIC (
+    sysfsparser_getvalue (&value, "%s/cpuinfo_max_freq", sysdir), 0);
+  TEST_ASSERT_EQUAL_NUMERIC (value, 3600000);
+  TEST_ASSERT_EQUAL_NUMERIC (
+    sysfsparser_getvalue (&value, "%s/garbage", sysdir), -1);
+  TEST_ASSERT_EQUAL_NUMERIC (
+    sysfsparser_getvalue (&value, "%s/missing", sysdir), -1);
+
+  line = sysfsparser_getline ("%s/scaling_governor", sysdir);
+  TEST_ASSERT_EQUAL_STRING (line, "powersave");
+  free (line);
+  TEST_ASSERT_EQUAL_NUMERIC (
+    sysfsparser_getline ("%s/empty", sysdir) == NULL, true);
+
+  return ret;
+}
+
+static int
+test_sysfsparser_read_at (const void *tdata)
+{
+  char buf[SYSFSPARSER_VALUE_MAX], small[5];
+  unsigned long long value;
+  int dirfd, ret = 0;
+
+  (void) tdata;
+  dirfd = sysfsparser_opendirfd ("%s", sysdir);
+  TEST_ASSERT_EQUAL_NUMERIC (dirfd >= 0, true);
+
+  /* the directory is opened once */
+  TEST_ASSERT_EQUAL_NUMERIC (sysfsparser_opendirfd ("%s", sysdir), dirfd);
+
+  TEST_ASSERT_EQUAL_NUMERIC (
+    sysfsparser_read_at (dirfd, "scaling_governor", buf, sizeof buf), 9);
+  TEST_ASSERT_EQUAL_STRING (buf, "powersave");
+  TEST_ASSERT_EQUAL_NUMERIC (
+    sysfsparser_read_at (dirfd, "empty", buf, sizeof buf), 0);
+  TEST_ASSERT_EQUAL_STRING (buf, "");
+  TEST_ASSERT_EQUAL_NUMERIC (
+    sysfsparser_read_at (dirfd, "missing", buf, sizeof buf), -ENOENT);
+
+  /* the content is truncated to the size of the buffer */
+  TEST_ASSERT_EQUAL_NUMERIC (
+    sysfsparser_read_at (dirfd, "scaling_governor", small, sizeof small), 4);
+  TEST_ASSERT_EQUAL_STRING (small, "powe");
+
+  TEST_ASSERT_EQUAL_NUMERIC (
+    sysfsparser_getvalue_at (dirfd, "cpuinfo_min_freq", &value), 0);
+  TEST_ASSERT_EQUAL_NUMERIC (value, 800000);
+  TEST_ASSERT_EQUAL_NUMERIC (
+    sysfsparser_getvalue_at (dirfd, "garbage", &value), -1);
+
+  TEST_ASSERT_EQUAL_NUMERIC (
+    sysfsparser_opendirfd ("%s/missing", sysdir), -ENOENT);
+
+  return ret;
+}
+
+static int
+test_sysfsparser_getvalues_at (const void *tdata)
+{
+  struct sysfsparser_attr attrs[] = {
+    { .name = "cpuinfo_min_freq" },
+    { .name = "missing" },
+    { .name = "cpuinfo_max_freq" },
+    { .name = "garbage" }
+  };
+  int dirfd, ret = 0;
+
+  (void) tdata;
+  dirfd = sysfsparser_opendirfd ("%s", sysdir);
+  TEST_ASSERT_EQUAL_NUMERIC (sysfsparser_getvalues_at (dirfd, attrs, 4), 2);
+  TEST_ASSERT_EQUAL_NUMERIC (attrs[0].err, 0);
+  TEST_ASSERT_EQUAL_NUMERIC (attrs[0].value, 800000);
+  TEST_ASSERT_EQUAL_NUMERIC (attrs[1].err, -1);
+  TEST_ASSERT_EQUAL_NUMERIC (attrs[1].value, 0);
+  TEST_ASSERT_EQUAL_NUMERIC (attrs[2].value, 3600000);
+  TEST_ASSERT_EQUAL_NUMERIC (attrs[3].err, -1);
+
+  return ret;
+}
+
+/* The oldest directories are closed when the cache is full */
+static int
+test_sysfsparser_dirfd_cache (const void *tdata)
+{
+  /* the same directory, as seen by SYSFSPARSER_DIRFD_CACHE_SIZE + 1
+   * different paths */
+  char *dots = xmalloc (SYSFSPARSER_DIRFD_CACHE_SIZE * 2 + 1);
+  unsigned int i;
+  int dirfd, ret = 0;
+
+  (void) tdata;
+  for (i = 0; i < SYSFSPARSER_DIRFD_CACHE_SIZE; i++)
+    memcpy (dots + i * 2, "/.", 2);
+  dots[SYSFSPARSER_DIRFD_CACHE_SIZE * 2] = '\0';
+
+  sysfsparser_closedirfds ();
+  dirfd = sysfsparser_opendirfd ("%s", sysdir);
+
+  for (i = 1; i < SYSFSPARSER_DIRFD_CACHE_SIZE; i++)
+    TEST_ASSERT_EQUAL_NUMERIC (
+      sysfsparser_opendirfd ("%s%.*s", sysdir, (int) i * 2, dots) >= 0, true);
+  TEST_ASSERT_EQUAL_NUMERIC (sysfsparser_opendirfd ("%s", sysdir), dirfd);
+
+  /* one more directory: the first one is evicted */
+  TEST_ASSERT_EQUAL_NUMERIC (
+    sysfsparser_opendirfd ("%s%.*s", sysdir,
+			   SYSFSPARSER_DIRFD_CACHE_SIZE * 2, dots) >= 0, true);
+  TEST_ASSERT_EQUAL_NUMERIC (STREQ (dirfd_cache[0].path, sysdir), false);
+
+  sysfsparser_closedirfds ();
+  for (i = 0; i < SYSFSPARSER_DIRFD_CACHE_SIZE; i++)
+    TEST_ASSERT_EQUAL_NUMERIC (dirfd_cache[i].path == NULL, true);
+
+  free (dots);
+  return ret;
+}
+
+static int
+mymain (void)
+{
+  int ret = 0;
+
+  if (sysdir_create () < 0)
+    {
+      sysdir_remove ();
+      return EXIT_AM_HARDFAIL;
+    }
+
+  if (test_run ("check sysfsparser_getline and sysfsparser_getvalue",
+		test_sysfsparser_legacy, NULL) < 0)
+    ret = -1;
+  if (test_run ("check sysfsparser_read_at", test_sysfsparser_read_at,
+		NULL) < 0)
+    ret = -1;
+  if (test_run ("check sysfsparser_getvalues_at",
+		test_sysfsparser_getvalues_at, NULL) < 0)
+    ret = -1;
+  if (test_run ("check the cache of directories",
+		test_sysfsparser_dirfd_cache, NULL) < 0)
+    ret = -1;
+
+  sysfsparser_closedirfds ();
+  sysdir_remove ();
+
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+TEST_MAIN (mymain)
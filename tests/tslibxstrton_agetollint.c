@@ -72,6 +72,7 @@ mymain (void)
 #define ONE_WEEK (7 * ONE_DAY)
 #define ONE_YEAR (365.25 * ONE_DAY)
 
+  DO_TEST ("100", 100);
   DO_TEST ("100s", 100);
   DO_TEST ("30m", 30 * ONE_MIN);
   DO_TEST ("4h", 4 * ONE_HOUR);